@@ -0,0 +1,215 @@
+/*
+  Thin client for the compile server started with `--server`.
+
+  It takes the same options and files as the compiler itself. The arguments,
+  the working directory and the standard streams are handed to a warm server
+  worker, which compiles (and runs) as if it had been started here; the
+  client exits with the compiler's status.
+
+  Build:  gcc -O2 -o compiler_client compiler_client.c
+  Usage:  compiler_client [--socket=<path>] [compiler options] <file>...
+
+  Only a server running as the same user is talked to: the socket file and
+  the process behind it must both belong to this user.
+*/
+
+#define _GNU_SOURCE // struct ucred for SO_PEERCRED
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// Must match mini_projet_compilation.c
+#define SERVER_SOCKET_NAME "mini_compiler.sock"        // in $XDG_RUNTIME_DIR, or $MINI_COMPILER_SOCKET
+#define SERVER_SOCKET_DIRECTORY "/tmp/mini_compiler-%u" // per user, 0700, without $XDG_RUNTIME_DIR
+#define SERVER_MAGIC 0x314f434d                         // "MCO1"
+#define SERVER_FDS 4                                    // stdin, stdout, stderr, working directory
+
+typedef struct
+{
+    int magic;  // SERVER_MAGIC, sent with the SERVER_FDS descriptors
+    int argc;
+    int length; // bytes of the NUL-terminated arguments that follow
+} ServerRequest;
+
+void defaultServerSocket(char *path, size_t size);
+int connectServer(const char *socketPath);
+int peerIsOwner(int connection);
+int sendRequest(int connection, int argc, char *argv[]);
+int writeAll(int fd, const char *data, size_t size);
+
+int main(int argc, char *argv[])
+{
+    char defaultSocket[256];
+    const char *socketPath = getenv("MINI_COMPILER_SOCKET");
+    if (socketPath == NULL)
+    {
+        defaultServerSocket(defaultSocket, sizeof(defaultSocket));
+        socketPath = defaultSocket;
+    }
+    if (argc > 1 && strncmp(argv[1], "--socket=", 9) == 0)
+    {
+        socketPath = argv[1] + 9;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    // Our descriptors and directory go to whoever owns the socket: it must be us
+    struct stat info;
+    if (lstat(socketPath, &info) == 0 && info.st_uid != geteuid())
+    {
+        fprintf(stderr, "Error: '%s' belongs to another user\n", socketPath);
+        return 1;
+    }
+    int connection = connectServer(socketPath);
+    if (connection < 0)
+    {
+        fprintf(stderr, "Error: No compile server on '%s': %s\n", socketPath, strerror(errno));
+        return 1;
+    }
+    if (!peerIsOwner(connection))
+    {
+        fprintf(stderr, "Error: The server on '%s' runs as another user\n", socketPath);
+        close(connection);
+        return 1;
+    }
+    if (sendRequest(connection, argc, argv) != 0)
+    {
+        fprintf(stderr, "Error: Cannot send the request: %s\n", strerror(errno));
+        close(connection);
+        return 1;
+    }
+
+    // The worker writes to our stdout and stderr directly, then answers with the status
+    int status;
+    size_t received = 0;
+    while (received < sizeof(status))
+    {
+        ssize_t count = read(connection, (char *)&status + received, sizeof(status) - received);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        received += (size_t)count;
+    }
+    close(connection);
+    // A worker that stops mid-request (too many errors) exits with 1, as the compiler does
+    return received == sizeof(status) ? status : 1;
+}
+
+void defaultServerSocket(char *path, size_t size)
+{
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime != NULL && runtime[0] != '\0')
+        snprintf(path, size, "%s/%s", runtime, SERVER_SOCKET_NAME);
+    else
+    {
+        char directory[64];
+        snprintf(directory, sizeof(directory), SERVER_SOCKET_DIRECTORY, (unsigned)geteuid());
+        snprintf(path, size, "%s/%s", directory, SERVER_SOCKET_NAME);
+    }
+}
+int connectServer(const char *socketPath)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0)
+        return -1;
+    if (connect(connection, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        int error = errno;
+        close(connection);
+        errno = error;
+        return -1;
+    }
+    return connection;
+}
+int peerIsOwner(int connection)
+{
+#ifdef __linux__
+    struct ucred peer;
+    socklen_t size = sizeof(peer);
+    return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0 && peer.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(connection, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+int sendRequest(int connection, int argc, char *argv[])
+{
+    size_t length = 0;
+    for (int i = 0; i < argc; i++)
+        length += strlen(argv[i]) + 1;
+    char *arguments = (char *)malloc(length + 1);
+    size_t offset = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        size_t size = strlen(argv[i]) + 1;
+        memcpy(arguments + offset, argv[i], size);
+        offset += size;
+    }
+
+    int fds[SERVER_FDS] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, open(".", O_RDONLY | O_DIRECTORY)};
+    if (fds[3] < 0)
+    {
+        free(arguments);
+        return -1;
+    }
+    ServerRequest request = {SERVER_MAGIC, argc, (int)length};
+    char control[CMSG_SPACE(SERVER_FDS * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec part = {&request, sizeof(request)};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(SERVER_FDS * sizeof(int));
+    memcpy(CMSG_DATA(header), fds, SERVER_FDS * sizeof(int));
+
+    ssize_t sent;
+    do
+        sent = sendmsg(connection, &message, 0);
+    while (sent < 0 && errno == EINTR);
+    int status = sent == (ssize_t)sizeof(request) && writeAll(connection, arguments, length) == 0 ? 0 : -1;
+    close(fds[3]);
+    free(arguments);
+    return status;
+}
+int writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t count = write(fd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return -1;
+        data += count;
+        size -= (size_t)count;
+    }
+    return 0;
+}
@@ -0,0 +1,458 @@
+#!/usr/bin/env python3
+"""Differential test of the compiler against a reference interpreter.
+
+Generates random programs (assignments, writeln, readln, nested if and while,
+32-bit wrapping arithmetic, division with its runtime error, arrays: indexed
+reads and writes, whole-array +, - and *, out-of-bounds indexes with their
+runtime error), runs each in the interpreter below and in the compiler, and
+compares the output and the runtime error:
+  --run at -O0, -O1 and -O2
+  --specialize with the first readln values known, the rest as --input
+  --batch and --parallel over three input records, one per line
+  --tiered=0 (native code from the start) and --superinstructions
+  --layout with a profile written by --block-profile
+  --checkpoint of a copy padded with a long loop, killed once it has written
+    a checkpoint, then --resume appending to the same output
+  --image of a --bundle holding the program
+
+Usage: python3 differential_test.py [compiler] [first seed] [last seed]
+       (defaults: ./compiler 1 200)
+Exits 1 when any program differs; the failing seeds are printed.
+"""
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+M = 2 ** 32
+VARIABLES = ['a', 'b', 'c', 'd', 'e']
+COUNTERS = ['i1', 'i2', 'i3', 'i4']
+ARRAYS = [['t', 'u', 'w'], ['s', 'z']]  # one length per group: whole-array operations stay within one
+INPUTS = 20
+RECORDS = 3  # input lines of --batch and --parallel
+BUDGET = 20000  # statements the interpreter runs before a program is skipped
+PADDING = 1500000  # iterations of the loop that keeps a --checkpoint run going past a checkpoint
+TIMEOUT = 10
+
+
+def wrap(x):
+    x %= M
+    return x - M if x >= 2 ** 31 else x
+
+
+class RuntimeFailure(Exception):
+    """A runtime error of the program, with the compiler's message"""
+
+
+class OutOfBudget(Exception):
+    pass
+
+
+def divide(a, b):
+    # Truncating, as C does
+    if b == 0:
+        raise RuntimeFailure("Division by zero")
+    if b == -1:
+        return wrap(-a)
+    q = abs(a) // abs(b)
+    return q if (a < 0) == (b < 0) else -q
+
+
+def check_index(array, index):
+    if not 0 <= index < len(array):
+        raise RuntimeFailure("Array index out of bounds")
+    return index
+
+
+OPS = {'+': lambda a, b: wrap(a + b), '-': lambda a, b: wrap(a - b),
+       '*': lambda a, b: wrap(a * b), '/': divide}
+COMPARISONS = {'<': lambda a, b: a < b, '>': lambda a, b: a > b, '<=': lambda a, b: a <= b,
+               '>=': lambda a, b: a >= b, '=': lambda a, b: a == b}
+
+
+class Generator:
+    def __init__(self, rnd, lengths):
+        self.r = rnd
+        self.lengths = lengths
+        self.depth = 0
+        self.free_counters = list(COUNTERS)
+
+    def expr(self, available, d=0):
+        r = self.r
+        if d > 2 or r.random() < 0.35:
+            k = r.random()
+            if k < 0.1:
+                name = r.choice(list(self.lengths))
+                return ('x', name, self.index(name, available))
+            return ('v', r.choice(available)) if k < 0.6 else ('n', r.randint(0, 20))
+        op = r.choice(['+', '-', '*', '/'])
+        if op == '/' and r.random() < 0.7:
+            return ('b', op, self.expr(available, d + 1), ('n', r.randint(1, 7)))
+        return ('b', op, self.expr(available, d + 1), self.expr(available, d + 1))
+
+    def index(self, name, available):
+        # Constant indexes are checked when compiling, so they stay in bounds; the others may not
+        r = self.r
+        k = r.random()
+        counters = [c for c in COUNTERS if c not in self.free_counters]
+        if k < 0.9 and counters:
+            return ('v', r.choice(counters))
+        if k < 0.95:
+            return ('n', r.randint(0, self.lengths[name] - 1))
+        return ('b', r.choice(['+', '-']), ('v', r.choice(available)), ('n', r.randint(0, 3)))
+
+    def statements(self, n, in_loop):
+        return [self.statement(in_loop) for _ in range(n)]
+
+    def statement(self, in_loop):
+        r = self.r
+        k = r.random()
+        available = VARIABLES + [c for c in COUNTERS if c not in self.free_counters]
+        if k < 0.35:
+            return ('assign', r.choice(VARIABLES), self.expr(available))
+        if k < 0.42:
+            name = r.choice(list(self.lengths))
+            return ('store', name, self.index(name, available), self.expr(available))
+        if k < 0.45:
+            group = r.choice(ARRAYS)
+            return ('array', r.choice(group), r.choice(['+', '-', '*']), r.choice(group), r.choice(group))
+        if k < 0.52:
+            return ('write', r.choice(available))
+        if k < 0.55:
+            name = r.choice(list(self.lengths))
+            return ('write_at', name, self.index(name, available))
+        if k < 0.6 and not in_loop:
+            return ('read', r.choice(VARIABLES))
+        if k < 0.8 and self.depth < 3:
+            self.depth += 1
+            condition = (r.choice(list(COMPARISONS)), self.expr(available), self.expr(available))
+            s = ('if', condition, self.statements(r.randint(1, 3), in_loop))
+            self.depth -= 1
+            return s
+        if self.depth < 3 and self.free_counters:
+            # Counted loops: the counter is only stepped, so every loop ends
+            counter = self.free_counters.pop(0)
+            self.depth += 1
+            down = r.random() < 0.3
+            bound = ('n', r.randint(0, 6)) if r.random() < 0.5 else self.expr(available)
+            body = self.statements(r.randint(1, 4), True)
+            self.depth -= 1
+            self.free_counters.insert(0, counter)
+            step = r.choice([1, 1, 2, 3])
+            return ('while', counter, down, bound, step, r.choice(['i + c', 'c + i']), body)
+        return ('write', r.choice(available))
+
+
+def format_expr(e):
+    if e[0] == 'v':
+        return e[1]
+    if e[0] == 'n':
+        return str(e[1])
+    if e[0] == 'x':
+        return f"{e[1]}[{format_expr(e[2])}]"
+    left = format_expr(e[2])
+    if e[2][0] == 'b':
+        left = '(' + left + ')'
+    return left + ' ' + e[1] + ' ' + format_expr(e[3])
+
+
+def format_statements(statements, indent, lines):
+    sp = '    ' * indent
+    for s in statements:
+        if s[0] == 'assign':
+            lines.append(f"{sp}{s[1]} := {format_expr(s[2])};")
+        elif s[0] == 'store':
+            lines.append(f"{sp}{s[1]}[{format_expr(s[2])}] := {format_expr(s[3])};")
+        elif s[0] == 'array':
+            lines.append(f"{sp}{s[1]} := {s[3]} {s[2]} {s[4]};")
+        elif s[0] == 'write':
+            lines.append(f"{sp}writeln({s[1]});")
+        elif s[0] == 'write_at':
+            lines.append(f"{sp}writeln({s[1]}[{format_expr(s[2])}]);")
+        elif s[0] == 'read':
+            lines.append(f"{sp}readln({s[1]});")
+        elif s[0] == 'pad':
+            lines.append(f"{sp}pad := 0;")
+            lines.append(f"{sp}while pad < {PADDING} do")
+            lines.append(f"{sp}    pad := pad + 1;")
+            lines.append(f"{sp}endwhile")
+        elif s[0] == 'if':
+            op, left, right = s[1]
+            lines.append(f"{sp}if {format_expr(left)} {op} {format_expr(right)} then")
+            format_statements(s[2], indent + 1, lines)
+            lines.append(f"{sp}endif")
+        else:
+            _, c, down, bound, step, form, body = s
+            lines.append(f"{sp}{c} := {format_expr(bound) if down else 0};")
+            lines.append(f"{sp}while {c} > 0 do" if down else f"{sp}while {c} < {format_expr(bound)} do")
+            format_statements(body, indent + 1, lines)
+            if down:
+                lines.append(f"{sp}    {c} := {c} - {step};")
+            elif form == 'i + c':
+                lines.append(f"{sp}    {c} := {c} + {step};")
+            else:
+                lines.append(f"{sp}    {c} := {step} + {c};")
+            lines.append(f"{sp}endwhile")
+
+
+def format_program(statements, lengths, scalars):
+    lines = ["program f;", f"var {', '.join(scalars)}: int;"]
+    for group in ARRAYS:
+        lines.append(f"var {', '.join(group)}: array[{lengths[group[0]]}] of int;")
+    lines.append("begin")
+    format_statements(statements, 1, lines)
+    lines.append("end.")
+    return "\n".join(lines) + "\n"
+
+
+def evaluate(e, env):
+    if e[0] == 'v':
+        return env[e[1]]
+    if e[0] == 'n':
+        return e[1]
+    if e[0] == 'x':
+        array = env[e[1]]
+        return array[check_index(array, evaluate(e[2], env))]
+    return OPS[e[1]](evaluate(e[2], env), evaluate(e[3], env))
+
+
+def spend(budget):
+    budget[0] -= 1
+    if budget[0] < 0:
+        raise OutOfBudget()
+
+
+def interpret(statements, env, inputs, output, budget):
+    for s in statements:
+        spend(budget)
+        if s[0] == 'assign':
+            env[s[1]] = evaluate(s[2], env)
+        elif s[0] == 'store':
+            # The index is computed first and checked once the value is known, as ASSIGN_AT does
+            array = env[s[1]]
+            index = evaluate(s[2], env)
+            value = evaluate(s[3], env)
+            array[check_index(array, index)] = value
+        elif s[0] == 'array':
+            _, target, op, left, right = s
+            env[target] = [OPS[op](x, y) for x, y in zip(env[left], env[right])]
+        elif s[0] == 'write':
+            output.append(env[s[1]])
+        elif s[0] == 'write_at':
+            output.append(evaluate(('x', s[1], s[2]), env))
+        elif s[0] == 'read':
+            env[s[1]] = inputs.pop(0)
+        elif s[0] == 'if':
+            op, left, right = s[1]
+            if COMPARISONS[op](evaluate(left, env), evaluate(right, env)):
+                interpret(s[2], env, inputs, output, budget)
+        else:
+            _, c, down, bound, step, _, body = s
+            env[c] = evaluate(bound, env) if down else 0
+            while env[c] > 0 if down else env[c] < evaluate(bound, env):
+                interpret(body, env, inputs, output, budget)
+                env[c] = wrap(env[c] - step if down else env[c] + step)
+                spend(budget)
+
+
+def execute(statements, lengths, inputs):
+    """(output, runtime error message or None, readln values consumed), or None past the budget"""
+    env = {name: [0] * length for name, length in lengths.items()}
+    remaining = list(inputs)
+    output = []
+    error = None
+    try:
+        interpret(statements, env, remaining, output, [BUDGET])
+    except RuntimeFailure as failure:
+        error = str(failure)
+    except OutOfBudget:
+        return None
+    return output, error, len(inputs) - len(remaining)
+
+
+class Program:
+    """A random program, its inputs and what the interpreter makes of them"""
+
+    def __init__(self, seed):
+        rnd = random.Random(seed)
+        self.lengths = {}
+        for group in ARRAYS:
+            length = rnd.randint(1, 8)
+            self.lengths.update((name, length) for name in group)
+        statements = Generator(rnd, self.lengths).statements(rnd.randint(3, 10), False)
+        names = VARIABLES + COUNTERS
+        init = [('assign', v, ('n', rnd.randint(0, 9))) for v in names]
+        self.source = format_program(init + statements, self.lengths, names)
+        # The padding loop goes between two statements of the program, where no counter is in use
+        padded = list(statements)
+        padded.insert(rnd.randint(0, len(statements)), ('pad',))
+        self.padded = format_program(init + padded, self.lengths, names + ['pad'])
+        self.records = [[rnd.randint(-50, 50) for _ in range(INPUTS)] for _ in range(RECORDS)]
+        self.results = [execute(init + statements, self.lengths, inputs) for inputs in self.records]
+        self.inputs = self.records[0]
+
+    def skipped(self):
+        return any(result is None for result in self.results)
+
+
+def write_numbers(path, numbers):
+    with open(path, 'w') as f:
+        f.write("".join(f"{x}\n" for x in numbers))
+
+
+def read_numbers(text):
+    return [int(line) for line in text.split()] if text.strip() else []
+
+
+def judge(options, stdout, stderr, status, expected, error):
+    """What is wrong with one run of the compiler, None if nothing"""
+    description = ' '.join(options)
+    reports = [line for line in stderr.splitlines() if 'runtime error:' in line or 'Sanitizer' in line]
+    if reports:
+        return f"{description}: sanitizer report: {reports[0]}"
+    if read_numbers(stdout) != expected:
+        return f"{description}: output differs"
+    if error is not None and (status == 0 or error not in stderr):
+        return f"{description}: expected the error '{error}'"
+    if error is None and status != 0:
+        return f"{description}: failed with status {status}"
+    return None
+
+
+def judge_records(options, stdout, stderr, status, results):
+    """What is wrong with a --batch or --parallel run over the records, None if nothing"""
+    description = ' '.join(options)
+    expected = [value for output, _, _ in results for value in output]
+    failing = [r for r, (_, error, _) in enumerate(results) if error is not None]
+    problem = judge(options, stdout, stderr, status, expected, results[failing[0]][1] if failing else None)
+    if problem is not None:
+        return problem
+    reported = [line for line in stderr.splitlines() if line.startswith('Record ')]
+    for r, (_, error, _) in enumerate(results):
+        prefix = f"Record {r + 1}:"
+        lines = [line for line in reported if line.startswith(prefix)]
+        if error is None and lines:
+            return f"{description}: record {r + 1} failed"
+        if error is not None and not any(error in line for line in lines):
+            return f"{description}: expected the error '{error}' in record {r + 1}"
+    return None
+
+
+def run(compiler, options, paths):
+    """(stdout, stderr, status) of one compiler run, None when it timed out"""
+    try:
+        result = subprocess.run([compiler] + options, capture_output=True, text=True, timeout=TIMEOUT,
+                                cwd=os.path.dirname(paths['p.txt']))
+    except subprocess.TimeoutExpired:
+        return None
+    return result.stdout, result.stderr, result.returncode
+
+
+def run_checkpointed(compiler, paths):
+    """(stdout, stderr, status) of a --checkpoint run, resumed when it was killed after a checkpoint"""
+    checkpoint = paths['ckpt']
+    if os.path.exists(checkpoint):
+        os.remove(checkpoint)
+    command = [compiler, '--run', '--checkpoint=' + checkpoint, '--checkpoint-interval=0',
+               '--input=' + paths['in.txt'], paths['padded.txt']]
+    with open(paths['out.txt'], 'w') as out, open(paths['err.txt'], 'w') as err:
+        process = subprocess.Popen(command, stdout=out, stderr=err)
+        deadline = time.time() + TIMEOUT
+        while process.poll() is None and not os.path.exists(checkpoint) and time.time() < deadline:
+            time.sleep(0.001)
+        killed = process.poll() is None
+        if killed:
+            process.kill()
+        process.wait()
+    if killed:
+        # As after an interruption: the resumed run appends to what the killed one wrote
+        with open(paths['out.txt'], 'a') as out, open(paths['err.txt'], 'w') as err:
+            try:
+                process = subprocess.run(command + ['--resume'], stdout=out, stderr=err, timeout=TIMEOUT)
+            except subprocess.TimeoutExpired:
+                return None
+    with open(paths['out.txt']) as out, open(paths['err.txt']) as err:
+        return out.read(), err.read(), process.returncode
+
+
+def check(compiler, directory, seed):
+    """Descriptions of the runs that differ from the interpreter"""
+    program = Program(seed)
+    if program.skipped():
+        return []
+    expected, error, consumed = program.results[0]
+    names = ('p.txt', 'padded.txt', 'in.txt', 'known.txt', 'rest.txt', 'records.txt', 'block.prof', 'p.mcb',
+             'ckpt', 'out.txt', 'err.txt')
+    paths = {name: os.path.join(directory, name) for name in names}
+    with open(paths['p.txt'], 'w') as f:
+        f.write(program.source)
+    with open(paths['padded.txt'], 'w') as f:
+        f.write(program.padded)
+    write_numbers(paths['in.txt'], program.inputs)
+    known = random.Random(seed).randint(0, consumed)
+    write_numbers(paths['known.txt'], program.inputs[:known])
+    write_numbers(paths['rest.txt'], program.inputs[known:])
+    with open(paths['records.txt'], 'w') as f:
+        f.write("".join(' '.join(map(str, inputs)) + "\n" for inputs in program.records))
+    for name in ('block.prof', 'p.mcb'):
+        if os.path.exists(paths[name]):
+            os.remove(paths[name])
+
+    source = paths['p.txt']
+    single = '--input=' + paths['in.txt']
+    runs = [[level, '--run', single, source] for level in ('-O0', '-O1', '-O2')]
+    runs.append(['--specialize=' + paths['known.txt'], '--run', '--input=' + paths['rest.txt'], source])
+    runs.append(['-O2', '--tiered=0', '--run', single, source])
+    runs.append(['--superinstructions', '--run', single, source])
+    runs.append(['-O2', '--run', '--block-profile=' + paths['block.prof'], single, source])
+    runs.append(['-O2', '--layout=' + paths['block.prof'], '--run', single, source])
+    runs.append(['-O2', '--bundle=' + paths['p.mcb'], source])
+    runs.append(['--run', '--image=' + paths['p.mcb'], single, 'p'])
+    records = '--input=' + paths['records.txt']
+    record_runs = [['-O2', '--batch', records, source],
+                   ['-O2', '--parallel=2', '--shard-size=1', records, source]]
+
+    problems = []
+    for options in runs + record_runs:
+        result = run(compiler, options, paths)
+        if result is None:
+            problems.append(f"{' '.join(options)}: timed out")
+            continue
+        if options in record_runs:
+            problem = judge_records(options, *result, program.results)
+        elif any(option.startswith('--bundle=') for option in options):
+            problem = judge(options, '', *result[1:], [], None)
+        else:
+            problem = judge(options, *result, expected, error)
+        if problem is not None:
+            problems.append(problem)
+
+    result = run_checkpointed(compiler, paths)
+    options = ['--checkpoint', '--resume']
+    if result is None:
+        problems.append(f"{' '.join(options)}: timed out")
+    else:
+        problem = judge(options, *result, expected, error)
+        if problem is not None:
+            problems.append(problem)
+    return problems
+
+
+def main():
+    compiler = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else './compiler')
+    first = int(sys.argv[2]) if len(sys.argv) > 2 else 1
+    last = int(sys.argv[3]) if len(sys.argv) > 3 else 200
+    failures = 0
+    with tempfile.TemporaryDirectory() as directory:
+        for seed in range(first, last + 1):
+            for problem in check(compiler, directory, seed):
+                print(f"seed {seed}: {problem}")
+                failures += 1
+    print(f"{last - first + 1} programs, {failures} failures")
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
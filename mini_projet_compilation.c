@@ -1,1255 +1,12737 @@
-/*
-  _  ___    _          _      _____ _        _  _______  _____ ______ _____
- | |/ / |  | |   /\   | |    |_   _| |      | |/ /  __ \|_   _|  ____|_   _|
- | ' /| |__| |  /  \  | |      | | | |      | ' /| |__) | | | | |__    | |
- |  < |  __  | / /\ \ | |      | | | |      |  < |  _  /  | | |  __|   | |
- | . \| |  | |/ ____ \| |____ _| |_| |____  | . \| | \ \ _| |_| |     _| |_
- |_|\_\_|  |_/_/    \_\______|_____|______| |_|\_\_|  \_\_____|_|    |_____|
-
-  ___ ___ ____         _
- |_ _|_ _|___ \       / \
-  | | | |  __) |____ / _ \
-  | | | | / __/_____/ ___ \
- |___|___|_____|   /_/   \_\
-
-*/
-
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include <ctype.h>
-
-#define program 1
-#define begin 2
-#define END 3
-#define id 4
-#define comment 5
-#define nb 6
-#define aff 7
-#define po 8
-#define pf 9
-#define pv 10
-#define dp 11
-#define IF 12
-#define THEN 13
-#define ENDIF 14
-#define VAR 15
-#define INT 16
-#define oparith 17
-#define oprel 18
-#define writeln 19
-#define readln 20
-#define point 21
-#define virg 22
-
-#define MAX_LEXEME_LENGTH 50
-#define MAX_ERROR_LENGTH 100
-#define MAX_ERRORS 8
-#define NB_SymboleS 100
-
-struct
-{
-    const char *keyword;
-    int token_code;
-} keywords[] = {
-    {"program", program},
-    {"begin", begin},
-    {"end", END},
-    {"if", IF},
-    {"then", THEN},
-    {"endif", ENDIF},
-    {"var", VAR},
-    {"int", INT},
-    {"writeln", writeln},
-    {"readln", readln},
-    {NULL, 0}};
-
-struct
-{
-    char *name;
-    int code;
-} IdentTab[NB_SymboleS] = {
-    {"Program", program},
-    {"Begin", begin},
-    {"End", END},
-    {"If", IF},
-    {"Then", THEN},
-    {"Endif", ENDIF},
-    {"Var", VAR},
-    {"Int", INT},
-    {"Writeln", writeln},
-    {"Readln", readln},
-    {NULL, 0}};
-
-typedef enum
-{
-    PUSH,
-    VALUE,
-    STORE,
-    ADD,
-    SUB,
-    MUL,
-    DIV,
-    ASSIGN,
-    COMP_LT,
-    COMP_GT,
-    COMP_LE,
-    COMP_GE,
-    COMP_EQ,
-    COMP_NE,
-    GO_FALSE,
-    GO_TRUE,
-    GOTO,
-    LABEL,
-    READ,
-    WRITE,
-} InstructionType;
-
-typedef enum
-{
-    TYPE_INT,
-    TYPE_UNKNOWN
-} DataType;
-
-typedef struct
-{
-    int code;
-    char name[MAX_LEXEME_LENGTH];
-    int value;
-} Token;
-
-typedef struct
-{
-    char *name;
-    DataType type;
-    int isDeclared;
-    int isInitialized;
-    int value;
-    int line;
-} identifierEntry;
-
-typedef struct
-{
-    identifierEntry *entries;
-    int size;
-    int capacity;
-} IdentifierTable;
-
-typedef struct
-{
-    InstructionType type;
-    char operand[50];
-} Instruction;
-
-typedef struct
-{
-    Instruction *instructions;
-    int size;
-    int capacity;
-    int labelCount;
-} StackCode;
-
-// Global variables//
-StackCode code;
-IdentifierTable identifierTable;
-char lexeme[MAX_LEXEME_LENGTH];
-int line_number = 1;
-int error_count = 0;
-char name[MAX_LEXEME_LENGTH];
-FILE *input_file = NULL;
-Token token;
-int currentIdentIndex = 10;
-
-// Additional functions//
-char ReadLetter(void);
-char SkipWhiteSpace(void);
-const char *CodeToKeyword(int);
-void Safe_Strcpy(char *, const char *, size_t);
-int Isnst(void);
-void Error(const char *message);
-void AddToSymbolesTable(char *, int);
-void resetSymboleTable()
-{
-
-    for (int i = 10; i < currentIdentIndex; i++)
-    {
-        if (IdentTab[i].name != NULL)
-        {
-            free(IdentTab[i].name);
-            IdentTab[i].name = NULL;
-            IdentTab[i].code = 0;
-        }
-    }
-    currentIdentIndex = 10;
-}
-void PrintSymboleTable(void);
-InstructionType getComparisonType(const char *op)
-{
-    if (strcmp(op, "<") == 0)
-        return COMP_LT;
-    if (strcmp(op, ">") == 0)
-        return COMP_GT;
-    if (strcmp(op, "<=") == 0)
-        return COMP_LE;
-    if (strcmp(op, ">=") == 0)
-        return COMP_GE;
-    if (strcmp(op, "=") == 0)
-        return COMP_EQ;
-    if (strcmp(op, "<>") == 0)
-        return COMP_NE;
-    return COMP_EQ;
-}
-
-// Grammar functions//
-void P(void);
-void Dcl(void);
-void ListId(void);
-void ListIdComp(void);
-void ListInst(void);
-void ListInstComp(void);
-void I(void);
-void C(void);
-void Exp(void);
-void ExpComp(void);
-
-// Accept and Next functions//
-void Accept(int expected_token);
-Token Next(void);
-
-// identifier table functions//
-void initidentifierTable(void);
-void freeidentifierTable();
-identifierEntry *lookupidentifier(const char *name);
-void addidentifier(const char *name, DataType type, int line);
-void printidentifierTable();
-
-// Semantic Analysis functions//
-void semanticError(const char *message, int line);
-void semanticP();
-void semanticDcl(const char *varName);
-void semanticAssignment(const char *varName);
-void semanticExpression(const char *varName);
-void semanticReadln(const char *);
-void semanticWriteln(const char *);
-
-// Intermediate code functions//
-void initStackCode();
-char *newStackLabel();
-void emitStack(InstructionType type, const char *operand);
-void printStackCode();
-void generateAssignment(const char *target, const char *arg1, const char *arg2);
-void generateIfStatement(const char *condition_var, const char *constant,
-                         const char *write_var);
-void cleanupStackCode();
-
-// Main function//
-
-int main()
-{
-    char filename[256];
-    char retry = 'y';
-    int choice;
-
-    do
-    {
-        error_count = 0;
-        printf("\nEnter the name of your file: ");
-        if (scanf("%255s", filename) != 1)
-        {
-            printf("Error reading filename\n");
-            return 1;
-        }
-        while (getchar() != '\n')
-            ;
-
-        input_file = fopen(filename, "r");
-        if (input_file == NULL)
-        {
-            printf("Error: Cannot open file '%s'\n", filename);
-            printf("Do you want to try another file? (y/n): ");
-            scanf(" %c", &retry);
-            while (getchar() != '\n')
-                ;
-
-            if (retry != 'y' && retry != 'Y')
-            {
-                printf("Program terminated.\n");
-                return 1;
-            }
-            continue;
-        }
-
-        printf("File '%s' opened successfully!\n", filename);
-        line_number = 1;
-        initStackCode();
-        token = Next();
-        if (token.code == -1)
-        {
-            printf("Error getting first token\n");
-            fclose(input_file);
-            return 1;
-        }
-
-        P();
-        fclose(input_file);
-
-        if (error_count == 0)
-        {
-            printf("\nParsing completed successfully!\n");
-
-            do
-            {
-                printf("\nMenu:\n");
-                printf("1. Show Table of Symboles\n");
-                printf("2. Show Table of identifiers\n");
-                printf("3. Show Intermediate Code\n");
-                printf("4. Compile another file\n");
-                printf("5. Exit\n");
-                printf("Enter your choice (1-5): ");
-
-                if (scanf("%d", &choice) != 1)
-                {
-                    while (getchar() != '\n')
-                        ;
-                    printf("Invalid input. Please enter a number between 1 and 5.\n");
-                    continue;
-                }
-                while (getchar() != '\n')
-                    ;
-
-                switch (choice)
-                {
-                case 1:
-                    printf("\nTable of Symboles:\n");
-                    PrintSymboleTable();
-                    resetSymboleTable();
-                    break;
-
-                case 2:
-                    printf("\nTable of identifiers:\n");
-                    printidentifierTable();
-                    freeidentifierTable();
-                    break;
-
-                case 3:
-                    printStackCode();
-                    cleanupStackCode();
-                    break;
-
-                case 4:
-
-                    retry = 'y';
-                    break;
-
-                case 5:
-                    printf("Exiting program...\n");
-                    retry = 'n';
-                    break;
-
-                default:
-                    printf("Invalid choice. Please enter a number between 1 and 5.\n");
-                    break;
-                }
-            } while (choice != 4 && choice != 5);
-        }
-        else
-        {
-            printf("\nParsing completed with %d errors.\n", error_count);
-            printf("Do you want to try another file? (y/n): ");
-            scanf(" %c", &retry);
-            while (getchar() != '\n')
-                ;
-        }
-
-    } while (retry == 'y' || retry == 'Y');
-
-    resetSymboleTable();
-    cleanupStackCode();
-    freeidentifierTable();
-    return 0;
-}
-
-// Additional functions implementations//
-char ReadLetter()
-{
-    char c = fgetc(input_file);
-    // printf("c=%c \n", c);
-    return c;
-}
-char SkipWhiteSpace(void)
-{
-    char c;
-    while ((c = ReadLetter()) != EOF && isspace(c))
-    {
-        if (c == '\n')
-            line_number++;
-    }
-
-    return c;
-}
-const char *CodeToKeyword(int code)
-{
-    switch (code)
-    {
-    case program:
-        return "program";
-    case begin:
-        return "begin";
-    case END:
-        return "end";
-    case id:
-        return "Symbole";
-    case comment:
-        return "comment";
-    case nb:
-        return "number";
-    case aff:
-        return ":=";
-    case po:
-        return "(";
-    case pf:
-        return ")";
-    case pv:
-        return ";";
-    case dp:
-        return ":";
-    case IF:
-        return "if";
-    case THEN:
-        return "then";
-    case ENDIF:
-        return "endif";
-    case VAR:
-        return "var";
-    case INT:
-        return "int";
-    case oparith:
-        return "arithmetic_operator";
-    case oprel:
-        return "relational_operator";
-    case writeln:
-        return "writeln";
-    case readln:
-        return "readln";
-    case point:
-        return ".";
-    case virg:
-        return ",";
-    default:
-        return "unknown";
-    }
-}
-void Safe_Strcpy(char *dest, const char *src, size_t size)
-{
-    if (size > 0)
-    {
-        strncpy(dest, src, size - 1);
-        dest[size - 1] = '\0';
-    }
-}
-int Isnst()
-{
-    return token.code == id || token.code == writeln ||
-           token.code == readln || token.code == IF;
-}
-void Error(const char *message)
-{
-    error_count++;
-    fprintf(stderr, "Error at line %d: %s\n", line_number, message);
-
-    if (error_count >= MAX_ERRORS)
-    {
-        fprintf(stderr, "Too many errors. Stopping compilation.\n");
-        if (input_file)
-        {
-            fclose(input_file);
-        }
-        exit(1);
-    }
-}
-void AddToSymbolesTable(char *name, int code)
-{
-    if (currentIdentIndex >= NB_SymboleS - 1)
-    {
-        printf("Error: Symbole table is full\n");
-        return;
-    }
-    for (int i = 0; i <= currentIdentIndex; i++)
-    {
-        if (IdentTab[i].name != NULL && strcmp(IdentTab[i].name, name) == 0)
-        {
-            return;
-        }
-    }
-
-    IdentTab[currentIdentIndex].name = strdup(name);
-    IdentTab[currentIdentIndex].code = code;
-    currentIdentIndex++;
-
-    IdentTab[currentIdentIndex].name = NULL;
-    IdentTab[currentIdentIndex].code = 0;
-}
-void PrintSymboleTable(void)
-{
-    printf("\nSymbole Table:\n");
-    printf("    +----------------------+-------+\n");
-    printf("    | %-20s | %-5s |\n", "Name", "Code");
-    printf("    +----------------------+-------+\n");
-
-    for (int i = 0; IdentTab[i].name != NULL; i++)
-    {
-        printf("    | %-20s | %-5d |\n", IdentTab[i].name, IdentTab[i].code);
-        printf("    +----------------------+-------+\n");
-    }
-}
-
-// Grammar functions implementation//
-void P()
-{
-    if (token.code == program)
-    {
-        semanticP();
-        Accept(program);
-        Accept(id);
-        Accept(pv);
-        Dcl();
-        Accept(begin);
-        ListInst();
-        Accept(END);
-        Accept(point);
-    }
-}
-void Dcl()
-{
-    if (token.code == VAR)
-    {
-        Accept(VAR);
-        ListId();
-        Accept(dp);
-        Accept(INT);
-        Accept(pv);
-        Dcl();
-    }
-}
-void ListId()
-{
-    if (token.code == id)
-    {
-        char varName[MAX_LEXEME_LENGTH];
-        strncpy(varName, token.name, MAX_LEXEME_LENGTH - 1);
-        varName[MAX_LEXEME_LENGTH - 1] = '\0';
-        semanticDcl(varName);
-        Accept(id);
-        ListIdComp();
-    }
-}
-void ListIdComp()
-{
-    if (token.code == virg)
-    {
-        Accept(virg);
-        ListId();
-    }
-}
-void ListInst()
-{
-    if (Isnst())
-    {
-
-        I();
-        ListInstComp();
-    }
-}
-void ListInstComp()
-{
-    if (token.code != END && token.code != ENDIF)
-    {
-        ListInst();
-    }
-}
-void I()
-{
-    switch (token.code)
-    {
-    case id:
-    {
-        char varName[MAX_LEXEME_LENGTH];
-        strncpy(varName, token.name, MAX_LEXEME_LENGTH - 1);
-        varName[MAX_LEXEME_LENGTH - 1] = '\0';
-        Accept(id);
-        Accept(aff);
-        semanticAssignment(varName);
-        emitStack(STORE, varName);
-        Token peek = token;
-        if (peek.code == nb)
-        {
-            // Case: x := 2
-            Accept(nb);
-            emitStack(PUSH, peek.name);
-        }
-        else if (peek.code == id)
-        {
-            // Case: x := y or start of x := y + z
-            Accept(id);
-            emitStack(VALUE, peek.name);
-
-            if (token.code == oparith)
-            {
-                // Case: x := y + z
-                char op = token.name[0];
-                Accept(oparith);
-                peek = token;
-                Accept(id);
-                emitStack(VALUE, peek.name);
-                switch (op)
-                {
-                case '+':
-                    emitStack(ADD, NULL);
-                    break;
-                case '-':
-                    emitStack(SUB, NULL);
-                    break;
-                case '*':
-                    emitStack(MUL, NULL);
-                    break;
-                case '/':
-                    emitStack(DIV, NULL);
-                    break;
-                }
-            }
-        }
-        emitStack(ASSIGN, NULL);
-        Accept(pv);
-        break;
-    }
-    case writeln:
-        Accept(writeln);
-        Accept(po);
-        if (token.code == id)
-        {
-            char varName[MAX_LEXEME_LENGTH];
-            strncpy(varName, token.name, MAX_LEXEME_LENGTH - 1);
-            varName[MAX_LEXEME_LENGTH - 1] = '\0';
-            printf("%s\n", varName);
-            semanticWriteln(varName);
-            emitStack(VALUE, varName);
-            emitStack(WRITE, NULL);
-            Accept(id);
-        }
-        Accept(pf);
-        Accept(pv);
-        break;
-
-    case readln:
-        Accept(readln);
-        Accept(po);
-        if (token.code == id)
-        {
-            char varName[MAX_LEXEME_LENGTH];
-            strncpy(varName, token.name, MAX_LEXEME_LENGTH - 1);
-            varName[MAX_LEXEME_LENGTH - 1] = '\0';
-            printf("%s\n", varName);
-            semanticReadln(varName);
-            emitStack(READ, varName);
-            Accept(id);
-        }
-        Accept(pf);
-        Accept(pv);
-        break;
-
-    case IF:
-        Accept(IF);
-        char *falseLabel = newStackLabel();
-        char *endLabel = newStackLabel();
-
-        C();
-        emitStack(GO_FALSE, falseLabel);
-
-        Accept(THEN);
-        ListInst();
-
-        emitStack(GOTO, endLabel);
-        emitStack(LABEL, falseLabel);
-
-        Accept(ENDIF);
-        emitStack(LABEL, endLabel);
-
-        free(falseLabel);
-        free(endLabel);
-        break;
-    }
-}
-void C()
-{
-    Exp();
-    char op[3];
-    strncpy(op, token.name, sizeof(op) - 1);
-    op[sizeof(op) - 1] = '\0';
-    Accept(oprel);
-    Exp();
-    emitStack(getComparisonType(op), NULL);
-}
-void Exp()
-{
-    switch (token.code)
-    {
-    case id:
-    {
-        char varName[MAX_LEXEME_LENGTH];
-        strncpy(varName, token.name, MAX_LEXEME_LENGTH - 1);
-        varName[MAX_LEXEME_LENGTH - 1] = '\0';
-        semanticExpression(varName);
-        emitStack(VALUE, varName);
-        Accept(id);
-        ExpComp();
-        break;
-    }
-    case nb:
-        emitStack(PUSH, token.name);
-        Accept(nb);
-        ExpComp();
-        break;
-    case po:
-        Accept(po);
-        Exp();
-        Accept(pf);
-        ExpComp();
-        break;
-    default:
-        Error("Invalid expression");
-    }
-}
-void ExpComp()
-{
-    if (token.code == oparith)
-    {
-        char op = token.name[0];
-        Accept(oparith);
-        Exp();
-
-        switch (op)
-        {
-        case '+':
-            emitStack(ADD, NULL);
-            break;
-        case '-':
-            emitStack(SUB, NULL);
-            break;
-        case '*':
-            emitStack(MUL, NULL);
-            break;
-        case '/':
-            emitStack(DIV, NULL);
-            break;
-        }
-
-        ExpComp();
-    }
-}
-
-// identifier table functions implementation//
-void initidentifierTable()
-{
-    identifierTable.capacity = 100;
-    identifierTable.size = 0;
-    identifierTable.entries = (identifierEntry *)malloc(identifierTable.capacity * sizeof(identifierEntry));
-}
-void freeidentifierTable()
-{
-    for (int i = 0; i < identifierTable.size; i++)
-    {
-        free(identifierTable.entries[i].name);
-    }
-    free(identifierTable.entries);
-    identifierTable.size = 0;
-    identifierTable.capacity = 0;
-}
-identifierEntry *lookupidentifier(const char *name)
-{
-    for (int i = 0; i < identifierTable.size; i++)
-    {
-        if (strcmp(identifierTable.entries[i].name, name) == 0)
-        {
-            return &identifierTable.entries[i];
-        }
-    }
-    return NULL;
-}
-void addidentifier(const char *name, DataType type, int line)
-{
-    if (identifierTable.size >= identifierTable.capacity)
-    {
-        // Expand table if needed
-        identifierTable.capacity *= 2;
-        identifierTable.entries = (identifierEntry *)realloc(identifierTable.entries,
-                                                             identifierTable.capacity * sizeof(identifierEntry));
-    }
-
-    identifierEntry *entry = &identifierTable.entries[identifierTable.size++];
-    entry->name = strdup(name);
-    entry->type = type;
-    entry->isDeclared = 1;
-    entry->isInitialized = 0;
-    entry->value = 0;
-    entry->line = line;
-}
-void printidentifierTable()
-{
-    printf("\nidentifier Table Contents:\n");
-    printf("+-----------------------------------------------------------------+\n");
-    printf("| %-20s | %-10s | %-12s | %-12s |\n", "Name", "Type", "Declared", "Initialized");
-    printf("+-----------------------------------------------------------------+\n");
-
-    for (int i = 0; i < identifierTable.size; i++)
-    {
-        printf("| %-20s | %-10s | %-12s | %-12s |\n",
-               identifierTable.entries[i].name,
-               identifierTable.entries[i].type == TYPE_INT ? "INT" : "UNKNOWN",
-               identifierTable.entries[i].isDeclared ? "YES" : "NO",
-               identifierTable.entries[i].isInitialized ? "YES" : "NO");
-    }
-
-    printf("+-----------------------------------------------------------------+\n");
-}
-
-// Semantic Analysis functions implementation//
-void semanticError(const char *message, int line)
-{
-    fprintf(stderr, "Semantic Error at line %d: %s\n", line, message);
-    error_count++;
-}
-void semanticP()
-{
-    initidentifierTable();
-}
-void semanticDcl(const char *varName)
-{
-    if (lookupidentifier(varName) != NULL)
-    {
-        char error_msg[100];
-        snprintf(error_msg, sizeof(error_msg), "Variable '%s' already declared", varName);
-        semanticError(error_msg, line_number);
-    }
-    else
-    {
-        addidentifier(varName, TYPE_INT, line_number);
-    }
-}
-void semanticAssignment(const char *varName)
-{
-    identifierEntry *entry = lookupidentifier(varName);
-    if (entry == NULL)
-    {
-        char error_msg[100];
-        snprintf(error_msg, sizeof(error_msg), "Variable '%s' used without declaration", varName);
-        semanticError(error_msg, line_number);
-    }
-    else
-    {
-        entry->isInitialized = 1;
-    }
-}
-void semanticExpression(const char *varName)
-{
-    if (varName != NULL)
-    {
-        identifierEntry *entry = lookupidentifier(varName);
-        if (entry == NULL)
-        {
-            char error_msg[100];
-            snprintf(error_msg, sizeof(error_msg), "Variable '%s' used without declaration", varName);
-            semanticError(error_msg, line_number);
-        }
-        else if (!entry->isInitialized)
-        {
-            char error_msg[100];
-            snprintf(error_msg, sizeof(error_msg), "Variable '%s' used without initialization", varName);
-            semanticError(error_msg, line_number);
-        }
-    }
-}
-void semanticReadln(const char *varName)
-{
-
-    identifierEntry *entry = lookupidentifier(varName);
-    if (entry == NULL)
-    {
-        char error_msg[100];
-        snprintf(error_msg, sizeof(error_msg), "Cannot read into undeclared variable '%s'", varName);
-        semanticError(error_msg, line_number);
-    }
-    else
-    {
-
-        entry->isInitialized = 1;
-    }
-}
-void semanticWriteln(const char *varName)
-{
-    identifierEntry *entry = lookupidentifier(varName);
-    if (entry == NULL)
-    {
-        char error_msg[100];
-        snprintf(error_msg, sizeof(error_msg), "Cannot write undeclared variable '%s'", varName);
-        semanticError(error_msg, line_number);
-    }
-    else if (!entry->isInitialized)
-    {
-        char error_msg[100];
-        snprintf(error_msg, sizeof(error_msg), "Cannot write uninitialized variable '%s'", varName);
-        semanticError(error_msg, line_number);
-    }
-}
-
-// Accept and Next functions implementation//
-void Accept(int expected_token)
-{
-    if (token.code == expected_token)
-    {
-        if (token.code != -5)
-        {
-            Token next = Next();
-            if (next.code == -1)
-            {
-                Error("Lexical error while getting next token");
-            }
-            token = next;
-        }
-    }
-    else
-    {
-        char error_msg[100];
-        snprintf(error_msg, sizeof(error_msg), "Syntax error: Expected \" %s \" but got \" %s \"", CodeToKeyword(expected_token), CodeToKeyword(token.code));
-        Error(error_msg);
-    }
-}
-Token Next()
-{
-    Token tempToken;
-    tempToken.code = -1;
-    tempToken.value = 0;
-    tempToken.name[0] = '\0';
-    char c = SkipWhiteSpace();
-
-    if (c == EOF)
-    {
-        printf("%d", EOF);
-        tempToken.code = -5;
-        return tempToken;
-    }
-
-    if (isalpha(c))
-    {
-        int i = 0;
-        tempToken.name[i++] = tolower(c);
-
-        while ((c = ReadLetter()) != EOF && isalnum(c) && i < (int)(sizeof(tempToken.name) - 1))
-        {
-
-            tempToken.name[i++] = tolower(c);
-        }
-
-        tempToken.name[i] = '\0';
-
-        ungetc(c, input_file);
-        for (int i = 0; keywords[i].keyword != NULL; i++)
-        {
-            if (strcmp(tempToken.name, keywords[i].keyword) == 0)
-            {
-                tempToken.code = keywords[i].token_code;
-                return tempToken;
-            }
-        }
-
-        tempToken.code = id;
-        AddToSymbolesTable(tempToken.name, tempToken.code);
-        return tempToken;
-    }
-
-    if (isdigit(c))
-    {
-        char num_buffer[MAX_LEXEME_LENGTH];
-        int i = 0;
-        do
-        {
-            if (i < MAX_LEXEME_LENGTH - 1)
-            {
-                num_buffer[i++] = c;
-            }
-            c = ReadLetter();
-
-        } while (isdigit(c));
-
-        if (!isspace(c) && c != EOF)
-        {
-            ungetc(c, input_file);
-        }
-
-        num_buffer[i] = '\0';
-        tempToken.code = nb;
-        Safe_Strcpy(tempToken.name, num_buffer, MAX_LEXEME_LENGTH);
-        tempToken.value = atoi(num_buffer);
-        return tempToken;
-    }
-
-    switch (c)
-    {
-    case ':':
-        if ((c = ReadLetter()) == '=')
-        {
-
-            tempToken.code = aff;
-            Safe_Strcpy(tempToken.name, ":=", MAX_LEXEME_LENGTH);
-        }
-        else
-        {
-            ungetc(c, input_file);
-            tempToken.code = dp;
-            Safe_Strcpy(tempToken.name, ":", MAX_LEXEME_LENGTH);
-        }
-        break;
-
-    case '<':
-    case '>':
-    case '=':
-    {
-        char op[3] = {c, '\0', '\0'};
-        if ((c = ReadLetter()) == '=')
-        {
-            op[1] = '=';
-        }
-        else
-        {
-            ungetc(c, input_file);
-        }
-        tempToken.code = oprel;
-        Safe_Strcpy(tempToken.name, op, MAX_LEXEME_LENGTH);
-        break;
-    }
-
-    case '+':
-    case '-':
-    case '*':
-    case '/':
-        tempToken.code = oparith;
-        tempToken.name[0] = c;
-        tempToken.name[1] = '\0';
-        break;
-
-    case '(':
-        tempToken.code = po;
-        Safe_Strcpy(tempToken.name, "(", MAX_LEXEME_LENGTH);
-        break;
-
-    case ')':
-        tempToken.code = pf;
-        Safe_Strcpy(tempToken.name, ")", MAX_LEXEME_LENGTH);
-        break;
-
-    case ';':
-        tempToken.code = pv;
-        Safe_Strcpy(tempToken.name, ";", MAX_LEXEME_LENGTH);
-        break;
-
-    case '.':
-        tempToken.code = point;
-        Safe_Strcpy(tempToken.name, ".", MAX_LEXEME_LENGTH);
-        break;
-
-    case ',':
-        tempToken.code = virg;
-        Safe_Strcpy(tempToken.name, ",", MAX_LEXEME_LENGTH);
-        break;
-
-    default:
-        char error_msg[MAX_ERROR_LENGTH];
-        snprintf(error_msg, MAX_ERROR_LENGTH,
-                 "Invalid character: '%c' (ASCII: %d)", c, (int)c);
-        Error(error_msg);
-        return Next();
-    }
-    if (c == '(')
-    {
-        char nextChar = ReadLetter();
-        if (nextChar == '*')
-        {
-            char prev = '\0';
-            while ((c = ReadLetter()) != EOF)
-            {
-                if (c == '\n')
-                    line_number++;
-                if (prev == '*' && c == ')')
-                    return Next();
-                prev = c;
-            }
-            Error("Unclosed comment");
-            return tempToken;
-        }
-        else
-        {
-            ungetc(nextChar, input_file);
-        }
-    }
-
-    return tempToken;
-}
-
-// Intermediate code functions implementation//
-void initStackCode()
-{
-    code.capacity = 100;
-    code.size = 0;
-    code.labelCount = 0;
-    code.instructions = (Instruction *)malloc(code.capacity * sizeof(Instruction));
-}
-char *newStackLabel()
-{
-    char *label = (char *)malloc(20);
-    sprintf(label, "L%d", ++code.labelCount);
-    return label;
-}
-void emitStack(InstructionType type, const char *operand)
-{
-    if (code.size >= code.capacity)
-    {
-        code.capacity *= 2;
-        code.instructions = (Instruction *)realloc(code.instructions,
-                                                   code.capacity * sizeof(Instruction));
-    }
-
-    code.instructions[code.size].type = type;
-    if (operand)
-    {
-        strncpy(code.instructions[code.size].operand, operand, 49);
-        code.instructions[code.size].operand[49] = '\0';
-    }
-    else
-    {
-        code.instructions[code.size].operand[0] = '\0';
-    }
-    code.size++;
-}
-void printStackCode()
-{
-    // Print header with nice formatting
-    printf("\n+-------------------------------+\n");
-    printf("|     Stack-Based Instructions  |\n");
-    printf("+-------------------------------+\n");
-    printf("| %-29s |\n", "Instruction");
-    printf("+-------------------------------+\n");
-
-    for (int i = 0; i < code.size; i++)
-    {
-        Instruction instr = code.instructions[i];
-        printf("| "); // Start each line with border
-
-        switch (instr.type)
-        {
-        // Value operations
-        case PUSH:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), "push "), instr.operand), "") : "push");
-            break;
-        case VALUE:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), "value "), instr.operand), "") : "value");
-            break;
-        case STORE:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), "store "), instr.operand), "") : "store");
-            break;
-
-        // Arithmetic operators
-        case ADD:
-            printf("%-29s |\n", "+");
-            break;
-        case SUB:
-            printf("%-29s |\n", "-");
-            break;
-        case MUL:
-            printf("%-29s |\n", "*");
-            break;
-        case DIV:
-            printf("%-29s |\n", "/");
-            break;
-        case ASSIGN:
-            printf("%-29s |\n", ":=");
-            break;
-
-        // Comparison operators
-        case COMP_LT:
-            printf("%-29s |\n", "COMP_LT");
-            break;
-        case COMP_GT:
-            printf("%-29s |\n", "COMP_GT");
-            break;
-        case COMP_LE:
-            printf("%-29s |\n", "COMP_LE");
-            break;
-        case COMP_GE:
-            printf("%-29s |\n", "COMP_GE");
-            break;
-        case COMP_EQ:
-            printf("%-29s |\n", "COMP_EQ");
-            break;
-        case COMP_NE:
-            printf("%-29s |\n", "COMP_NE");
-            break;
-
-        // Control flow
-        case GO_FALSE:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), "go_false "), instr.operand), "") : "go_false");
-            break;
-        case GO_TRUE:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), "go_true "), instr.operand), "") : "go_true");
-            break;
-        case GOTO:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), "goto "), instr.operand), "") : "goto");
-            break;
-        case LABEL:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), ""), instr.operand), ":") : "label");
-            break;
-
-        // I/O operations
-        case READ:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), "read "), instr.operand), "") : "read");
-            break;
-        case WRITE:
-            printf("%-29s |\n", instr.operand ? strcat(strcat(strcpy(malloc(32), "write "), instr.operand), "") : "write");
-            break;
-
-        default:
-            printf("%-29s |\n", "unknown instruction");
-        }
-    }
-
-    // Print footer
-    printf("+-------------------------------+\n");
-    printf("| Total Instructions: %-9d |\n", code.size);
-    printf("+-------------------------------+\n\n");
-}
-void generateAssignment(const char *target, const char *arg1, const char *arg2)
-{
-    emitStack(VALUE, arg1);
-    emitStack(VALUE, arg2);
-    emitStack(ADD, NULL);
-    emitStack(STORE, target);
-}
-void generateIfStatement(const char *condition_var, const char *constant,
-                         const char *write_var)
-{
-    char *endLabel = newStackLabel();
-
-    emitStack(VALUE, condition_var);
-    emitStack(PUSH, constant);
-    emitStack(COMP_GT, NULL);
-    emitStack(GO_FALSE, endLabel);
-    emitStack(VALUE, write_var);
-    emitStack(WRITE, NULL);
-    emitStack(LABEL, endLabel);
-    free(endLabel);
-}
-void cleanupStackCode()
-{
-    free(code.instructions);
-    code.size = 0;
-    code.capacity = 0;
-    code.labelCount = 0;
+/*
+  _  ___    _          _      _____ _        _  _______  _____ ______ _____
+ | |/ / |  | |   /\   | |    |_   _| |      | |/ /  __ \|_   _|  ____|_   _|
+ | ' /| |__| |  /  \  | |      | | | |      | ' /| |__) | | | | |__    | |
+ |  < |  __  | / /\ \ | |      | | | |      |  < |  _  /  | | |  __|   | |
+ | . \| |  | |/ ____ \| |____ _| |_| |____  | . \| | \ \ _| |_| |     _| |_
+ |_|\_\_|  |_/_/    \_\______|_____|______| |_|\_\_|  \_\_____|_|    |_____|
+
+  ___ ___ ____         _
+ |_ _|_ _|___ \       / \
+  | | | |  __) |____ / _ \
+  | | | | / __/_____/ ___ \
+ |___|___|_____|   /_/   \_\
+
+*/
+
+#define _GNU_SOURCE // madvise, MAP_ANONYMOUS, st_mtim, strdup: POSIX and Linux extensions beyond strict ISO C
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#endif
+
+#define program 1
+#define begin 2
+#define END 3
+#define id 4
+#define comment 5
+#define nb 6
+#define aff 7
+#define po 8
+#define pf 9
+#define pv 10
+#define dp 11
+#define IF 12
+#define THEN 13
+#define ENDIF 14
+#define VAR 15
+#define INT 16
+#define oparith 17
+#define oprel 18
+#define writeln 19
+#define readln 20
+#define point 21
+#define virg 22
+#define WHILE 23
+#define DO 24
+#define ENDWHILE 25
+#define ARRAY 26
+#define OF 27
+#define co 28
+#define cf 29
+#define LEXICAL_ERROR -2    // scanned invalid character, reported by Next()
+#define UNCLOSED_COMMENT -3 // reported by Next(), then read as '('
+#define NUMBER_TOO_LARGE -4 // integer literal over INT_MAX, reported by Next(), then read as nb
+
+#define MAX_LEXEME_LENGTH 50
+#define MAX_ERROR_LENGTH 100
+#define MAX_ERRORS 8
+#define MAX_STACK_DEPTH 1024
+#define MAX_ARRAY_LENGTH (1 << 24) // elements of one array
+#define IO_BUFFER_SIZE (1 << 20)
+#define INSTANCE_OUTPUT_LIMIT 65536 // unsent output at which an event-loop instance pauses
+
+struct
+{
+    const char *keyword;
+    int token_code;
+} keywords[] = {
+    {"program", program},
+    {"begin", begin},
+    {"end", END},
+    {"if", IF},
+    {"then", THEN},
+    {"endif", ENDIF},
+    {"var", VAR},
+    {"int", INT},
+    {"writeln", writeln},
+    {"readln", readln},
+    {"while", WHILE},
+    {"do", DO},
+    {"endwhile", ENDWHILE},
+    {"array", ARRAY},
+    {"of", OF},
+    {NULL, 0}};
+
+struct
+{
+    char *name;
+    int code;
+} IdentTab[] = {
+    {"Program", program},
+    {"Begin", begin},
+    {"End", END},
+    {"If", IF},
+    {"Then", THEN},
+    {"Endif", ENDIF},
+    {"Var", VAR},
+    {"Int", INT},
+    {"Writeln", writeln},
+    {"Readln", readln},
+    {"While", WHILE},
+    {"Do", DO},
+    {"Endwhile", ENDWHILE},
+    {"Array", ARRAY},
+    {"Of", OF},
+    {NULL, 0}};
+
+typedef enum
+{
+    PUSH,
+    VALUE,
+    STORE,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    ASSIGN,
+    SWAP,
+    COMP_LT,
+    COMP_GT,
+    COMP_LE,
+    COMP_GE,
+    COMP_EQ,
+    COMP_NE,
+    GO_FALSE,
+    GO_TRUE,
+    GOTO,
+    LABEL,
+    READ,
+    WRITE,
+    VALUE_AT,  // pops an index, pushes frame[arg + index]; fails outside [0, length)
+    ASSIGN_AT, // pops a value and an index: frame[arg + index] := value
+    ARRAY_ADD, // frame[arg + k] := frame[arg2 + k] op frame[arg3 + k] for k < length
+    ARRAY_SUB,
+    ARRAY_MUL,
+    SELECT, // pops then, else, condition; pushes condition ? then : else, without a jump
+    VADD,   // frame[arg + k] := frame[arg2 + k] op frame[arg3 + k] for k < VECTOR_WIDTH
+    VSUB,
+    VMUL,
+
+    // Superinstructions, produced by selectSuperinstructions()
+    GO_FALSE_LT, // compare and branch when the comparison fails
+    GO_FALSE_GT,
+    GO_FALSE_LE,
+    GO_FALSE_GE,
+    GO_FALSE_EQ,
+    GO_FALSE_NE,
+    VALUE2_ADD, // push frame[arg] op frame[arg2]
+    VALUE2_SUB,
+    VALUE2_MUL,
+    PUSH_ADD, // top op arg
+    PUSH_SUB,
+    PUSH_MUL,
+    ASSIGN_TO,    // frame[arg] := pop
+    ASSIGN_CONST, // frame[arg] := arg2
+    ASSIGN_VALUE, // frame[arg] := frame[arg2]
+    WRITE_VALUE,  // write frame[arg]
+    INSTRUCTION_TYPE_COUNT
+} InstructionType;
+
+typedef enum
+{
+    TYPE_INT,
+    TYPE_ARRAY, // of int, in length consecutive slots
+    TYPE_UNKNOWN
+} DataType;
+
+typedef struct
+{
+    int code;
+    int symbol;  // interned identifier or keyword, -1 for other tokens
+    long offset; // the lexeme is source_text[offset, offset + length)
+    int length;
+    int value;   // number value, comparison type of oprel, operator of oparith, hash of a scanned word
+    int line;    // line the lexeme starts on
+} Token;
+
+typedef struct
+{
+    char **names;  // symbol -> spelling folded to lower case
+    int *codes;    // symbol -> keyword token code, or id
+    char *listed;  // symbol -> already in the symbol table of the current program
+    int *listedOrder; // identifiers of the symbol table, in the order they were first scanned
+    int listedCount;
+    int listedCapacity;
+    int count;
+    int capacity;
+    int *buckets;  // open addressing, symbol + 1 (0 = empty)
+    int bucketCount;
+} LexemeTable;
+
+typedef struct
+{
+    char *name;
+    DataType type;
+    int isDeclared;
+    int isInitialized;
+    int value;
+    int line;
+    long initOffset; // source offset of the statement that first initializes it, -1 if none
+    int length;      // elements of a TYPE_ARRAY, 0 otherwise
+} identifierEntry;
+
+typedef struct
+{
+    identifierEntry *entries;
+    int size;
+    int capacity;
+    int *bySymbol;      // lexeme symbol -> entry index + 1, 0 when not declared
+    int symbolCapacity;
+} IdentifierTable;
+
+#define VECTOR_WIDTH 4                         // slots per vector instruction: one SSE register
+#define MAX_INSTRUCTION_USES (2 * VECTOR_WIDTH) // variables one instruction reads
+
+typedef struct
+{
+    InstructionType type;
+    int label; // LABEL and jumps: label number, printed L<label>; -1 otherwise
+    int arg;  // variable slot for VALUE/STORE/READ, constant for PUSH, jump target once linked, -1 otherwise
+    int arg2; // second operand of superinstructions
+    int arg3; // third slot of vector instructions
+    int length; // elements of the arrays of VALUE_AT, ASSIGN_AT and ARRAY_ instructions
+    int line; // source line of the statement it was emitted for
+    int block; // basic block it was in before layout, numbered by the layout pass; -1 otherwise
+} Instruction;
+
+typedef struct
+{
+    int label;
+    int position; // instruction the label resolves to after linking
+} LinkedLabel;
+
+typedef struct
+{
+    Instruction *instructions;
+    int size;
+    int capacity;
+    int labelCount;
+    char **variables; // slot -> variable name, filled by emitStack
+    int variableCount;
+    int variableCapacity;
+    int *variableBuckets; // open addressing, slot + 1 (0 = empty)
+    int variableBucketCount;
+    int *symbolSlots;     // lexeme symbol -> slot + 1 (0 = not emitted yet), for the parser
+    int symbolSlotCapacity;
+    int stackDepth;    // operand stack depth after the last emitted instruction
+    int maxStackDepth; // exact maximum over the whole program
+    int verified;      // set by verifyStackCode(), cleared by any emit
+    int linked;        // jumps carry their target position in arg
+    LinkedLabel *labels; // side table kept by linkStackCode() for listings
+    int labelTableSize;
+    int line;            // source line given to emitted instructions
+    int temporaryCount;  // compiler temporaries $t1, $t2... made by the optimizers
+    unsigned long long layoutHash; // code the Instruction.block numbers refer to, set by the layout pass
+    int layoutBlocks;              // blocks numbered, 0 if none
+} StackCode;
+
+typedef struct
+{
+    long long counts[INSTRUCTION_TYPE_COUNT][INSTRUCTION_TYPE_COUNT];
+    long long total;
+} OpcodePairProfile;
+
+typedef enum
+{
+    LOOP_HOIST,  // loop-invariant: computed once before the loop
+    LOOP_REDUCE, // induction variable * invariant: updated along with the variable
+    LOOP_SHARED  // a product already kept by another LOOP_REDUCE value
+} LoopValueKind;
+
+typedef struct
+{
+    LoopValueKind kind;
+    int start;     // code range computing the value
+    int end;
+    int invariant; // pure, cannot trap and reads only variables the loop never writes
+    int temporary; // slot holding the value once hoisted
+    int induction; // LOOP_REDUCE: slot of the induction variable
+    int factor;    // LOOP_REDUCE: position of the invariant operand
+} LoopValue;
+
+typedef struct
+{
+    int *writes;  // slot -> stores in the loop being optimized
+    int *steps;   // slot -> induction steps among them
+    int capacity; // all zero between loops
+} LoopSlots;
+
+typedef struct
+{
+    int **pools;         // height -> temporaries of the loops that high, in the order they take them
+    int *poolSizes;
+    int *poolCapacities;
+    int poolCount;
+    int height;          // of the loop being rewritten: 1 + the highest loop inside it
+    int taken;           // temporaries it has taken from its pool so far
+    int *frameEnds;      // rewritten loops not inside another, in code order: back edge
+    int *frameHeights;
+    int frameCount;
+    int frameCapacity;
+} LoopTemporaries;
+
+typedef struct
+{
+    InstructionType op; // PUSH: constant in left; VALUE: slot left held on entry to the block; READ: input
+    int left;           // operand value numbers otherwise
+    int right;
+    int holder;         // variable last assigned this value, -1 if none
+} ValueNumber;
+
+typedef struct
+{
+    ValueNumber *values;
+    int count;
+    int capacity;
+    int *buckets; // open addressing, value + 1 (0 = empty)
+    int bucketCount;
+    int bucketMask; // part of the buckets used by the current block
+    int *variableValues; // slot -> value number, valid when variableStamps[slot] == stamp
+    int *variableStamps;
+    int variableCapacity;
+    int stamp;           // never reused, so the slot arrays are kept between calls uncleared
+} ValueTable;
+
+typedef struct
+{
+    int number;    // value number of the result
+    int start;     // code range computing it
+    int end;
+    int statement; // first instruction of the enclosing statement
+    int holder;    // variable holding the value when it is computed, -1 if none
+    int temporary; // slot the range is read from instead, -1 if kept
+    int computed;  // computed into the temporary just before its statement
+    int size;      // longest range with the same number: the longest are decided first
+    int next;      // next replaced range starting at the same instruction, by decreasing end
+} NumberedRange;
+
+#define PROFILE_HOTSPOTS 15
+
+typedef struct
+{
+    long long count;
+    int index;
+} RankedCount;
+
+typedef struct
+{
+    long long *hits;  // executions per instruction
+    long long *taken; // per conditional jump: executions that jumped
+    int size;
+    OpcodePairProfile pairs; // dynamic: consecutively executed opcodes
+} ExecutionProfile;
+
+typedef struct
+{
+    int *buckets;   // open addressing, label ordinal + 1 (0 = empty)
+    unsigned mask;
+    int *positions; // label ordinal -> instruction index
+    int count;
+    int capacity;   // positions allocated
+    int duplicate;  // instruction index of the first redefined label, -1 if none
+} LabelIndex;
+
+typedef struct
+{
+    int *depth;   // per join point: operand stack depth, -1 until a path reaches it
+    int *offset;  // per join point: where its operand types start in types
+    char *types;  // the recorded operand types of all join points, one after another
+    int size;
+    int capacity;
+} JoinShapes;
+
+typedef struct
+{
+    long start;    // source offset of the first token
+    long end;      // source offset of the next statement, or of "end"
+    int line;      // source line of the first token
+    int codeStart; // instructions [codeStart, codeEnd), loops already optimized
+    int codeEnd;
+    int maxStackDepth;
+} StatementRange;
+
+typedef struct
+{
+    char *source; // text of the last successful compilation
+    long length;
+    long bodyStart; // first statement after "begin"
+    long bodyEnd;   // the "end" token
+    int endLine;
+    StatementRange *statements;
+    int statementCount;
+    int statementCapacity;
+    int valid;     // code and identifierTable were compiled from source
+    int recording; // StatementList() records statement boundaries
+    int probing;   // errors are counted, not printed: a full compile follows
+    long current;  // start of the statement being parsed
+    int reparsed;  // statements parsed by the last compilation
+} CompilationUnit;
+
+typedef enum
+{
+    VM_HALTED,
+    VM_ERROR,
+    VM_WAITING, // sliced runs only: readln needs input not received yet, pc stays on the READ
+    VM_YIELDED, // sliced runs only: the slice is used up or the output is full
+    VM_PROMOTED // tiered runs only: native code takes over at pc, a backward jump target
+} VmStatus;
+
+typedef struct
+{
+    int fd;
+    FILE *file;     // refilled line by line when the menu shares stdin with readln
+    char *buffer;   // read buffer, or the whole file when mapped
+    size_t size;
+    size_t position;
+    int mapped;
+    int eof;
+    long long consumed; // bytes consumed before the current buffer
+} InputStream;
+
+typedef struct
+{
+    int fd;            // -1: an in-memory buffer that grows instead of flushing
+    char *buffer;
+    size_t size;
+    size_t capacity;
+    long long written; // bytes already flushed
+    int error;         // errno of the first failed write: the rest of the output is dropped
+} OutputStream;
+
+typedef struct
+{
+    int pc;
+    int sp;
+    int *stack;
+    int stackCapacity;
+    int *frame;
+    int frameSize;
+    long long executed;
+    int prompt; // print "name = " before each readln
+    InputStream *input;
+    OutputStream *output;
+    long long record; // input record being run by the parallel runner, 0 otherwise
+    ExecutionProfile *profile; // counts executions when not NULL
+    long long slice; // instructions per runVm() call of an event-loop instance, 0: run to the end
+    int blockingReads; // sliced runs: readln refills the input instead of returning VM_WAITING
+} VmState;
+
+// Lanes of the batch executor: one program instance per lane
+#if defined(__AVX512F__)
+#define BATCH_LANES 16
+#elif defined(__AVX2__)
+#define BATCH_LANES 8
+#else
+#define BATCH_LANES 4 // SSE2/NEON, or lowered to scalar code by the compiler
+#endif
+
+typedef int LaneVector __attribute__((vector_size(BATCH_LANES * sizeof(int))));
+typedef unsigned LaneUVector __attribute__((vector_size(BATCH_LANES * sizeof(int))));
+// Adjacent frame slots, as the vector instructions work on them
+typedef unsigned SlotVector __attribute__((vector_size(VECTOR_WIDTH * sizeof(int))));
+
+typedef struct
+{
+    char *text;
+    size_t size;
+    size_t capacity;
+} LaneOutput;
+
+typedef struct
+{
+    LaneVector *stack; // stack[depth][lane]
+    LaneVector *frame; // frame[slot][lane]
+    int frameSize;
+    int *values;       // readln values of the records in the batch
+    int valueCount;
+    int valueCapacity;
+    int recordStart[BATCH_LANES + 1];
+    int cursor[BATCH_LANES];
+    int failed[BATCH_LANES];
+    LaneOutput output[BATCH_LANES];
+    long long executed;
+} BatchState;
+
+#define DEFAULT_SHARD_SIZE 4096
+#define DEFAULT_BENCH_RUNS 10
+#define SHARD_RANGE(low, high) (((unsigned long long)(high) << 32) | (unsigned)(low))
+
+typedef struct
+{
+    size_t start;          // byte range of the shard's records in the input
+    size_t end;
+    long long firstRecord; // records are numbered from 1
+    OutputStream output;
+    int failed;
+    int done;              // guarded by the pool lock
+} Shard;
+
+typedef struct ShardWorker ShardWorker;
+
+typedef struct
+{
+    const char *data;
+    Shard *shards;
+    int shardCount;
+    ShardWorker *workers;
+    int workerCount;
+    pthread_mutex_t lock;
+    pthread_cond_t shardDone;
+} ShardPool;
+
+struct ShardWorker
+{
+    _Atomic unsigned long long range; // shard indexes [low, high) left to run, see SHARD_RANGE
+    int index;
+    int started;
+    pthread_t thread;
+    ShardPool *pool;
+    VmState vm;
+};
+
+typedef enum
+{
+    EXPR_VARIABLE,
+    EXPR_NUMBER,
+    EXPR_BINARY,
+    EXPR_INDEX // array element: the index expression in left
+} ExprKind;
+
+typedef struct
+{
+    ExprKind kind;
+    InstructionType op; // ADD..DIV or COMP_xx for EXPR_BINARY
+    int left;
+    int right;
+    int need;           // Sethi-Ullman number: stack slots needed to evaluate
+    int name;           // interned symbol of a variable or array, value of a number
+} ExprNode;
+
+typedef struct
+{
+    ExprNode *nodes;
+    int size;
+    int capacity;
+} ExprArena;
+
+typedef struct
+{
+    int start; // first instruction
+    int end;   // one past the last instruction
+    int succ[2];
+    int predStart;
+    int predCount;
+} BasicBlock;
+
+typedef struct
+{
+    BasicBlock *blocks;
+    int blockCount;
+    int *preds;    // predecessor lists, indexed by predStart
+    int *blockOf;  // instruction -> block
+    int *defSlot;  // instruction -> slot it defines (ASSIGN/READ), -1 otherwise
+    int variableCount;
+    int *defStart; // def-use chains: defs[defStart[v] .. defStart[v + 1]]
+    int *defs;
+    int *useStart;
+    int *uses;
+} ControlFlowGraph;
+
+typedef enum
+{
+    DATAFLOW_FORWARD,
+    DATAFLOW_BACKWARD
+} DataflowDirection;
+
+typedef enum
+{
+    MEET_UNION,
+    MEET_INTERSECTION
+} DataflowMeet;
+
+typedef unsigned long long BitWord;
+
+typedef struct
+{
+    DataflowDirection direction;
+    DataflowMeet meet;
+    int bits;
+    int words; // BitWords per set
+    BitWord *gen;
+    BitWord *kill;
+    BitWord *in;
+    BitWord *out;
+} DataflowProblem;
+
+#define SPECIALIZE_VARIANTS 2        // versions of a branch target before differing variables become unknown
+#define SPECIALIZE_STEPS 100000000LL // instructions evaluated at specialization time
+#define SPECIALIZE_CODE (1 << 22)    // residual instructions
+
+typedef struct
+{
+    int known;   // value known at specialization time, not on the residual program's stack
+    int value;
+    int address; // slot pushed by STORE, -1 for values
+} StaticOperand;
+
+typedef struct
+{
+    int pc;       // instruction of the original program, -1 for a saved state that is no program point
+    int consumed; // known inputs read on the way here; the operand stack is empty
+    unsigned char *known; // slot -> value known at specialization time
+    int *values;          // slot -> that value, 0 when unknown
+    int label;            // where the residual code of the point starts, 0 if nowhere
+    int next;             // older point for the same instruction, -1 if none
+} SpecializedPoint;
+
+typedef struct
+{
+    int site;
+    int from; // saved state to store the point's unknown variables from first, -1 if none
+} SpecializationTask;
+
+typedef struct
+{
+    const Instruction *original;
+    int size;
+    int *targets; // jump -> target position
+    int slots;
+    const int *inputs; // known readln values, in reading order
+    int inputCount;
+    SpecializedPoint *points;
+    int pointCount;
+    int pointCapacity;
+    int *versions;  // instruction -> newest point for it, -1 if none
+    int *backEdges; // backward jump -> state it was last taken with, -1 if none
+    const ControlFlowGraph *cfg;
+    const DataflowProblem *liveness; // points forget the variables that are dead there
+    unsigned char *pointKnown; // state of the point being looked up
+    int *pointValues;
+    SpecializationTask *tasks;
+    int taskCount;
+    int taskCapacity;
+    long long steps;
+    int endLabel; // set once a trace jumps to the end of the residual program, 0 before
+    // State of the trace being specialized
+    StaticOperand stack[MAX_STACK_DEPTH];
+    int depth;
+    int consumed;
+    unsigned char *known;
+    int *values;
+} Specializer;
+
+#define DEFAULT_OPTIMIZATION_LEVEL 1
+#define IF_CONVERSION_MAX_ASSIGNMENTS 4 // assignments in an if body turned into selects
+#define IF_CONVERSION_MISS_COST 12      // a mispredicted jump, in interpreted instructions
+
+typedef enum
+{
+    PASS_LOOPS,
+    PASS_VALUE_NUMBERING,
+    PASS_DEAD_STORES,
+    PASS_SIMPLIFY_JUMPS,
+    PASS_IF_CONVERSION,
+    PASS_VECTORIZE,
+    PASS_SPECIALIZE,
+    PASS_LAYOUT,
+    PASS_SUPERINSTRUCTIONS,
+    PASS_LINK,
+    PASS_COUNT
+} PassId;
+
+typedef enum
+{
+    ANALYSIS_LABELS,   // label name -> position
+    ANALYSIS_CFG,      // basic blocks, def-use chains
+    ANALYSIS_LIVENESS, // variables live on block entry and exit, from the CFG
+    ANALYSIS_COUNT
+} AnalysisId;
+
+typedef struct
+{
+    unsigned long long hash; // of the code the blocks were numbered in, before layout
+    int blockCount;
+    long long *counts;       // block -> entries
+    int *jumpTargets;        // block -> block its conditional jump goes to, -1 for the end, -2 if none
+    long long *jumps;        // block -> times the jump was taken
+} BlockProfile;
+
+typedef struct
+{
+    const int *knownInputs; // specialize: leading readln values
+    int knownCount;
+    const OpcodePairProfile *pairProfile; // superinstructions: ranking, NULL to rank by the program's own pairs
+    int stripLabels;                      // link
+    const BlockProfile *blockProfile;     // layout: counts to order the blocks by, NULL to only number them
+} PassOptions;
+
+typedef struct
+{
+    const char *name;
+    int level; // lowest -O level that runs the pass, 0 if only its option does
+    int (*run)(const PassOptions *options); // changes made, -1 on failure
+} OptimizationPass;
+
+typedef struct
+{
+    int runs;
+    double seconds;
+    int before; // instructions before and after the last run
+    int after;
+    int changes;
+} PassRecord;
+
+typedef struct
+{
+    int level;              // -O level
+    const char *printAfter; // pass names separated by commas, or "all"
+    int timePasses;
+    int verifyEach;
+    PassRecord records[PASS_COUNT]; // since the last report
+    // Analyses, computed when first required and dropped when a pass changes the code
+    LabelIndex labels;
+    ControlFlowGraph cfg;
+    DataflowProblem liveness;
+    int valid[ANALYSIS_COUNT];
+    const Instruction *validFor[ANALYSIS_COUNT]; // code they were computed on, checked as well
+    int validSize[ANALYSIS_COUNT];
+    int computed[ANALYSIS_COUNT]; // since the last report
+    int reused[ANALYSIS_COUNT];
+} PassManager;
+
+#define SERVER_SOCKET_NAME "mini_compiler.sock"        // in $XDG_RUNTIME_DIR, or $MINI_COMPILER_SOCKET
+#define SERVER_SOCKET_DIRECTORY "/tmp/mini_compiler-%u" // per user, 0700, without $XDG_RUNTIME_DIR
+#define SERVER_MAGIC 0x314f434d                          // "MCO1"
+#define SERVER_FDS 4                                     // stdin, stdout, stderr, working directory
+#define SERVER_MAX_ARGUMENTS 4096
+#define SERVER_MAX_REQUEST (1 << 20)
+
+typedef struct
+{
+    int magic;  // SERVER_MAGIC, sent with the SERVER_FDS descriptors
+    int argc;
+    int length; // bytes of the NUL-terminated arguments that follow
+} ServerRequest;
+
+#define TOKEN_RING_SLOTS 4096  // must be powers of two
+#define RECORD_RING_SLOTS 8192
+#define RING_BATCH 64          // elements published or released at once
+#define RING_SPINS 2000        // polls before sleeping, when another core can make progress
+#define IR_VARIABLE INSTRUCTION_TYPE_COUNT // IrRecord naming slot arg; the writer frees name
+#define IR_END (INSTRUCTION_TYPE_COUNT + 1) // last IrRecord, arg set if compilation failed
+
+typedef struct
+{
+    // Read-only after initRing()
+    char *slots;
+    int elementSize;
+    unsigned mask;
+    int spins;
+    // Producer side; the indexes count elements and wrap around
+    _Alignas(64) _Atomic unsigned tail; // elements published
+    unsigned writeIndex;                // elements written, published up to tail
+    unsigned headSeen;                  // last head read, so that the consumer line is rarely touched
+    _Atomic int producerWaiting;
+    // Consumer side
+    _Alignas(64) _Atomic unsigned head; // elements released
+    unsigned readIndex;
+    unsigned tailSeen;
+    _Atomic int consumerWaiting;
+} SpscRing;
+
+typedef struct
+{
+    int type;   // InstructionType, IR_VARIABLE or IR_END
+    int arg;    // slot, constant, or label number of LABEL and jumps
+    int arg2;   // operand slots of ARRAY_ instructions
+    int arg3;
+    char *name; // IR_VARIABLE only
+} IrRecord;
+
+typedef struct
+{
+    SpscRing tokens;  // lexer thread -> parser
+    SpscRing records; // parser -> writer thread
+    int active;
+    int tokensEnded;  // the EOF token was taken; it is returned again from then on
+    Token end;
+    int variablesSent;
+    int listing;
+    // Results of the writer thread, read after it is joined
+    long long instructions;
+    int maxStackDepth;
+} Pipeline;
+
+#define INSTANCE_SLICE 20000       // instructions an instance runs before the next one's turn
+#define INSTANCE_BUFFER 256        // initial input and output buffer of an instance
+#define INSTANCE_INPUT_LIMIT 65536 // unread input at which its connection stops being read
+#define EVENT_BATCH 256            // events, accepts and slices per turn of the event loop
+
+typedef enum
+{
+    INSTANCE_QUEUED,  // on the run queue
+    INSTANCE_READING, // stopped at a readln, until a value arrives
+    INSTANCE_WRITING, // stopped until its output is sent
+    INSTANCE_DONE     // halted or failed, closed once its output is sent
+} InstanceState;
+
+typedef struct Instance Instance;
+
+struct Instance
+{
+    int fd;             // the connection: its lines feed readln, writeln writes back to it
+    unsigned events;    // epoll interest currently registered
+    InstanceState state;
+    Instance *next;     // run queue
+    VmState vm;
+    InputStream input;  // received and not yet read, from buffer[position]
+    size_t inputCapacity;
+    OutputStream output;
+    size_t sent;        // bytes of output already written to the connection
+    int broken;         // the connection failed while queued: finished on its turn
+};
+
+typedef struct
+{
+    int epoll;
+    int listener;
+    int signals;        // the loop taking SIGINT and SIGTERM; it stops the others
+    _Atomic int stopping;
+    int started;
+    pthread_t thread;
+    Instance *head;     // run queue, served round robin
+    Instance *tail;
+    long long live;
+    long long served;   // instances finished
+    long long failed;
+    long long executed;
+} EventLoop;
+
+#define DEFAULT_TIER_RUNS 8           // runs of a program before it is compiled to native code
+#define DEFAULT_TIER_BACK_EDGES 10000 // taken backward jumps before it is, counted over all runs
+#define TIER_CHECK_INTERVAL 1024      // backward jumps a run takes between two looks at the tier
+
+typedef enum
+{
+    TIER_INTERPRETED,
+    TIER_COMPILING, // on the compiler thread; runs go on in the interpreter meanwhile
+    TIER_NATIVE,
+    TIER_FAILED     // no native code for this program: interpreted to the end
+} TierState;
+
+typedef struct
+{
+    unsigned char *text; // executable mapping
+    size_t size;
+    int *entries;        // instruction -> offset native code can be entered at, -1 if none
+    VmStatus (*enter)(VmState *vm, const unsigned char *entry);
+} NativeCode;
+
+typedef struct
+{
+    int enabled;
+    long long runThreshold; // 0: compiled in the foreground before the first run
+    long long backEdgeThreshold;
+    _Atomic long long runs;
+    _Atomic long long backEdges;
+    _Atomic int state;      // TierState; the native code is published with TIER_NATIVE
+    NativeCode native;
+    pthread_t compiler;
+    int compilerStarted;
+    // Reported by --stats
+    const char *trigger;    // the counter that crossed its threshold
+    long long runsAtTierUp;
+    long long backEdgesAtTierUp;
+    double compileSeconds;
+    const char *failure;
+    _Atomic long long nativeRuns;   // runs started in native code
+    _Atomic long long switchedRuns; // runs moved to native code at a backward jump
+} TieredEngine;
+
+typedef enum
+{
+    NATIVE_CONSTANT, // value known while compiling, slot numbers pushed by STORE included
+    NATIVE_SLOT,     // frame[value], not loaded yet
+    NATIVE_STACK,    // in vm->stack at its own depth, value
+    NATIVE_EAX,      // at most one entry at a time
+    NATIVE_ECX       // only while one instruction is compiled
+} NativeOperandKind;
+
+typedef struct
+{
+    NativeOperandKind kind;
+    int value;
+} NativeOperand;
+
+// x86-64 registers as ModRM and REX number them: rbx holds the frame, r12 the VmState,
+// r13 the operand stack and r14 the instructions executed by the native code
+enum
+{
+    NATIVE_RAX,
+    NATIVE_RCX,
+    NATIVE_RDX,
+    NATIVE_RBX,
+    NATIVE_RSP,
+    NATIVE_RBP,
+    NATIVE_RSI,
+    NATIVE_RDI,
+    NATIVE_R8,
+    NATIVE_R12 = 12,
+    NATIVE_R13,
+    NATIVE_R14,
+    NATIVE_R15
+};
+
+typedef struct
+{
+    int at;     // offset of the rel32 to patch
+    int target; // instruction, code.size + 1 for the epilogue, -1 - stub for error stubs
+} NativeFixup;
+
+typedef struct
+{
+    int pc;
+    const char *message; // NULL: already reported by the helper that failed
+    int unexecuted;      // instructions of the block counted on entry that did not run
+    int offset;
+} NativeStub;
+
+typedef struct
+{
+    unsigned char *bytes;
+    size_t size;
+    size_t capacity;
+    NativeOperand stack[MAX_STACK_DEPTH + 2]; // the operand stack while compiling, bottom first
+    int depth;
+    int pc;
+    int blockEnd; // first instruction after the block being compiled
+    int *offsets; // instruction -> native offset, then the halt code and the epilogue
+    NativeFixup *fixups;
+    int fixupCount;
+    int fixupCapacity;
+    NativeStub *stubs;
+    int stubCount;
+    int stubCapacity;
+} NativeCompiler;
+
+#define DEFAULT_CHECKPOINT_INTERVAL 10.0 // seconds between two checkpoints
+#define CHECKPOINT_SLICE (1 << 22)       // instructions run between two looks at the clock
+#define CHECKPOINT_MAGIC 0x314b434d      // "MCK1"
+
+typedef struct
+{
+    int magic;                // CHECKPOINT_MAGIC
+    int pc;
+    unsigned long long hash;  // hashStackCode() of the linked code it was taken on
+    int sp;                   // followed by stack[0, sp) and frame[0, frameSize)
+    int frameSize;
+    long long executed;
+    long long inputOffset;    // bytes of input consumed
+    long long outputWritten;  // bytes of output written
+    long long outputPosition; // file offset of stdout after them, -1 if it cannot seek
+} CheckpointHeader;
+
+typedef struct
+{
+    const char *path; // NULL: no checkpoints
+    double interval;
+    int resume;
+    unsigned long long hash;
+    // Reported by --stats
+    int written;
+    double seconds;      // spent writing them
+    long long resumedAt; // instructions executed before the restored checkpoint, -1 if none
+} Checkpointing;
+
+#define BUNDLE_MAGIC 0x3242434d // "MCB2"
+
+// A bundle image is the header, then the sections it gives the offsets of. Names and
+// integer constants are stored once for all programs and referred to by number.
+typedef struct
+{
+    int magic; // BUNDLE_MAGIC
+    int programCount;
+    int indexSize; // buckets of the program index, a power of two
+    int stringCount;
+    int constantCount;
+    int instructionCount;
+    int symbolCount; // slot names of all programs
+    int labelCount;
+    long long stringBytes;
+    long long size; // of the whole image, so that a truncated one is refused
+    long long programs, index, strings, constants, instructions, symbols, labels, stringData; // offsets
+} BundleHeader;
+
+typedef struct
+{
+    int name;  // string
+    int first; // of its instructions, slot names and labels in their sections
+    int size;
+    int variables;
+    int variableCount;
+    int labels;
+    int labelCount;
+    int maxStackDepth;
+    unsigned long long hash; // hashStackCode(): programs with the same code share it
+} BundleProgram;
+
+typedef struct
+{
+    int type;
+    int label;   // LABEL and jumps: label number, -1 otherwise
+    int arg;     // constant of PUSH and PUSH_ADD/SUB/MUL and arg2 of ASSIGN_CONST: index in the pool
+    int arg2;
+    int arg3;
+    int length;
+    int line;
+} BundleInstruction;
+
+typedef struct
+{
+    int label;
+    int position;
+} BundleLabel;
+
+typedef struct
+{
+    BundleProgram *programs;
+    int programCount;
+    int programCapacity;
+    int *strings; // string -> offset in stringData
+    int stringCount;
+    int stringCapacity;
+    char *stringData;
+    long long stringBytes;
+    long long stringDataCapacity;
+    int *stringBuckets; // open addressing, string + 1 (0 = empty)
+    int stringBucketCount;
+    int *constants;
+    int constantCount;
+    int constantCapacity;
+    int *constantBuckets; // open addressing, constant + 1 (0 = empty)
+    int constantBucketCount;
+    BundleInstruction *instructions;
+    int instructionCount;
+    int instructionCapacity;
+    int *symbols;
+    int symbolCount;
+    int symbolCapacity;
+    BundleLabel *labels;
+    int labelCount;
+    int labelCapacity;
+    int shared; // programs stored as the code of an earlier one
+} BundleBuilder;
+
+typedef struct
+{
+    char *path; // the mapping is kept while the file stays the same, across server requests
+    dev_t device;
+    ino_t inode;
+    struct timespec modified;
+    const char *data;
+    size_t size;
+    const BundleHeader *header;
+    const BundleProgram *programs;
+    const int *index;
+    const int *strings;
+    const int *constants;
+    const BundleInstruction *instructions;
+    const int *symbols;
+    const BundleLabel *labels;
+    const char *stringData;
+} BundleImage;
+
+// Global variables//
+StackCode code;
+ExprArena exprArena;
+IdentifierTable identifierTable;
+char lexeme[MAX_LEXEME_LENGTH];
+_Thread_local int line_number = 1; // the lexer thread of a pipelined compile counts its own
+int error_count = 0;
+char name[MAX_LEXEME_LENGTH];
+const char *source_text = NULL; // the lexer reads source_text[source_position, source_length)
+long source_length = 0;
+long source_position = 0;
+LexemeTable lexemes;
+Token token;
+CompilationUnit unit;
+volatile sig_atomic_t serverStopping = 0;
+Pipeline pipeline;
+// Kept between calls: statement-at-a-time callers would otherwise clear
+// slot arrays that grow with every temporary of the program
+ValueTable valueTable;
+LoopSlots loopSlots;
+_Atomic long long instancesStarted = 0; // numbers the instances, as records are numbered
+PassManager passManager = {.level = DEFAULT_OPTIMIZATION_LEVEL};
+TieredEngine tiers;
+Checkpointing checkpoints;
+BundleImage bundle;
+
+// Additional functions//
+char ReadLetter(void);
+void UnreadLetter(char c);
+char SkipWhiteSpace(void);
+const char *CodeToKeyword(int);
+void Safe_Strcpy(char *, const char *, size_t);
+int Isnst(void);
+void Error(const char *message);
+void AddToSymbolesTable(int symbol);
+void resetSymboleTable()
+{
+    for (int i = 0; i < lexemes.listedCount; i++)
+        lexemes.listed[lexemes.listedOrder[i]] = 0;
+    lexemes.listedCount = 0;
+}
+void PrintSymboleTable(void);
+InstructionType getComparisonType(const char *op)
+{
+    if (strcmp(op, "<") == 0)
+        return COMP_LT;
+    if (strcmp(op, ">") == 0)
+        return COMP_GT;
+    if (strcmp(op, "<=") == 0)
+        return COMP_LE;
+    if (strcmp(op, ">=") == 0)
+        return COMP_GE;
+    if (strcmp(op, "=") == 0)
+        return COMP_EQ;
+    if (strcmp(op, "<>") == 0)
+        return COMP_NE;
+    return COMP_EQ;
+}
+
+// Grammar functions//
+void P(void);
+void Dcl(void);
+void ListId(void);
+void ListIdComp(void);
+void ListInst(void);
+void ListInstComp(void);
+void StatementList(void);
+void I(void);
+int C(void);
+int Exp(void);
+int ExpComp(int left);
+int Variable(void);
+int Subscript(void);
+void ArrayOperation(const char *target);
+
+// Accept and Next functions//
+void Accept(int expected_token);
+Token Next(void);
+Token scanToken(void);
+
+// Lexeme functions//
+void openSource(const char *text, long start, long end);
+int internLexeme(const char *text, int length);
+int internHashedLexeme(const char *text, int length, unsigned hash);
+int findLexeme(const char *text, int length);
+const char *lexemeName(int symbol);
+void freeLexemes(void);
+
+// identifier table functions//
+void initidentifierTable(void);
+void freeidentifierTable();
+identifierEntry *lookupidentifier(const char *name);
+identifierEntry *lookupidentifierSymbol(int symbol);
+void addidentifier(const char *name, DataType type, int line);
+void printidentifierTable();
+
+// Semantic Analysis functions//
+void semanticError(const char *message, int line);
+void semanticP();
+void semanticDcl(const char *varName);
+void semanticAssignment(const char *varName);
+void semanticExpression(const identifierEntry *entry, const char *varName);
+void semanticReadln(const char *);
+void semanticWriteln(const char *);
+void semanticArrayDcl(int first, int length);
+void semanticIndex(const char *arrayName, int index);
+void semanticArrayOperation(const char *target, const char *left, const char *right, char op);
+
+// Intermediate code functions//
+void initStackCode();
+int newStackLabel(void);
+void emitStack(InstructionType type, const char *operand);
+void emitStackLabel(InstructionType type, int label);
+void emitStackSlot(InstructionType type, int slot);
+int symbolSlot(int symbol);
+void printStackCode();
+void printListingHeader(void);
+void generateAssignment(const char *target, const char *arg1, const char *arg2);
+void generateIfStatement(const char *condition_var, const char *constant,
+                         const char *write_var);
+void cleanupStackCode();
+unsigned hashName(const char *name);
+int internStackVariable(const char *name);
+int internStackArray(const char *name, int length);
+int isArraySlot(int slot);
+void emitArray(InstructionType type, const char *target, const char *left, const char *right);
+int stackEffect(InstructionType type);
+const char *instructionName(InstructionType type);
+void formatInstruction(const Instruction *instr, char *buffer, size_t size);
+void formatInstructionNames(const Instruction *instr, char *const *names, int nameCount, int linked,
+                            char *buffer, size_t size);
+int instructionUses(const Instruction *instr, int uses[MAX_INSTRUCTION_USES]);
+Instruction *cutInstructions(int start, int *count);
+void appendInstructions(const Instruction *instructions, int count);
+void newStackTemporary(char *name, size_t size);
+
+// Batch execution functions//
+int initBatch(BatchState *batch);
+void freeBatch(BatchState *batch);
+int loadBatch(BatchState *batch, InputStream *in, long long firstRecord);
+void runBatch(BatchState *batch, int lanes, long long firstRecord);
+void laneWrite(LaneOutput *output, int value);
+int executeBatch(const char *inputPath, long long *records, long long *executed);
+
+// Parallel execution functions//
+long long splitShards(ShardPool *pool, size_t size, int shardSize);
+int takeShard(ShardWorker *worker);
+int stealShards(ShardWorker *thief);
+void runShard(ShardWorker *worker, Shard *shard);
+void *shardWorkerMain(void *arg);
+int executeParallel(const char *inputPath, int threads, int shardSize, long long *records, long long *executed);
+
+// Profiler functions//
+int initExecutionProfile(ExecutionProfile *profile);
+void freeExecutionProfile(ExecutionProfile *profile);
+int compareHotspots(const void *a, const void *b);
+void printProfileReport(const ExecutionProfile *profile, const char *sourcePath, FILE *out);
+
+// Loop optimization functions//
+int optimizeLoops(void);
+int optimizeLoopRange(int start);
+int inductionStep(const Instruction *instr, int available, int *step);
+int optimizeLoop(int preheader, int bodyStart, int *loopEnd, LoopTemporaries *temporaries);
+void beginLoopTemporaries(LoopTemporaries *temporaries, int start);
+int takeLoopTemporary(LoopTemporaries *temporaries);
+void endLoopTemporaries(LoopTemporaries *temporaries, int start, int end);
+void freeLoopTemporaries(LoopTemporaries *temporaries);
+
+// Value numbering functions//
+int numberValues(void);
+int numberValueRange(int start);
+int lookupValue(ValueTable *table, InstructionType op, int left, int right);
+int variableValue(ValueTable *table, int slot);
+void assignValue(ValueTable *table, int slot, int number);
+int compareNumberedRanges(const void *a, const void *b);
+int compareComputedRanges(const void *a, const void *b);
+int numberBlock(ValueTable *table, Instruction *block, int count);
+void emitNumberedRange(const Instruction *block, const NumberedRange *ranges, const int *first,
+                       int start, int end);
+
+// Partial evaluation functions//
+int readKnownInputs(const char *path, int **values);
+int specializeProgram(const int *inputs, int inputCount);
+int specializeTrace(Specializer *spec, int pc);
+int foldOperation(InstructionType type, int left, int right);
+int saveSpecializedState(Specializer *spec, int pc, const unsigned char *known, const int *values);
+void loadSpecializedState(Specializer *spec, int site);
+int sameSpecializedState(const Specializer *spec, const SpecializedPoint *site, int consumed,
+                         const unsigned char *known, const int *values);
+void forgetDeadVariables(Specializer *spec, int pc);
+int findSpecializedPoint(Specializer *spec, int pc, int *created);
+int unknownAtPoint(const Specializer *spec, const SpecializedPoint *site);
+int specializeBackEdge(Specializer *spec, int pc, int target);
+int trapRuntimeError(Specializer *spec, const Instruction *failing, int operands);
+void endSpecializedTrace(Specializer *spec);
+void pushSpecializationTask(Specializer *spec, int site, int from);
+void materializeOperands(Specializer *spec);
+void materializeVariables(Specializer *spec, const SpecializedPoint *site);
+
+// Superinstruction functions//
+void collectOpcodePairs(OpcodePairProfile *profile);
+int writeOpcodePairProfile(const OpcodePairProfile *profile, const char *filename);
+int readOpcodePairProfile(OpcodePairProfile *profile, const char *filename);
+int selectSuperinstructions(const OpcodePairProfile *profile);
+
+// Expression tree functions//
+void resetExprArena(void);
+void freeExprArena(void);
+int newExprLeaf(ExprKind kind, int name);
+int newExprNode(InstructionType op, int left, int right);
+int newExprIndex(int name, int index);
+int constantExpression(int node, int *value);
+InstructionType arithmeticType(char op);
+InstructionType mirrorComparison(InstructionType op);
+InstructionType negateComparison(InstructionType op);
+void emitExpression(int node);
+
+// Control flow graph functions//
+int isJumpInstruction(InstructionType type);
+int buildControlFlowGraph(ControlFlowGraph *cfg);
+void freeControlFlowGraph(ControlFlowGraph *cfg);
+void printControlFlowGraph(const ControlFlowGraph *cfg);
+
+// Label index functions//
+void buildLabelIndex(LabelIndex *index);
+void buildLabelRange(LabelIndex *index, int start);
+int findLabel(const LabelIndex *index, int label);
+unsigned hashLabel(int label);
+int addLabel(LabelIndex *index, int position);
+void freeLabelIndex(LabelIndex *index);
+
+// Verifier functions//
+void verifierError(const char *message, int pc);
+int compareInts(const void *a, const void *b);
+int jumpTargetPosition(const Instruction *instr, const LabelIndex *labels);
+int matchJoinShape(JoinShapes *shapes, int join, const char *types, int depth);
+int verifyStackCode(void);
+
+// Linker functions//
+int linkStackCode(int stripLabels);
+int labelAt(int position, int *cursor);
+
+// Execution functions//
+void runtimeError(const char *message, int pc);
+void recordError(long long record, const char *message, int pc);
+int initVm(VmState *vm);
+void freeVm(VmState *vm);
+VmStatus runVm(VmState *vm);
+void runArrayOperation(InstructionType type, int *target, const int *left, const int *right, int length);
+int prepareStackCode(void);
+int executeStackCode(int verbose, const char *inputPath, ExecutionProfile *profile, long long *executed);
+int benchmarkStackCode(const char *inputPath, int runs, long long *executed);
+int compareDoubles(const void *a, const void *b);
+
+// I/O runtime functions//
+int openInput(InputStream *in, const char *path);
+int openInputFile(InputStream *in, FILE *file);
+void openInputMemory(InputStream *in, const char *data, size_t size);
+int loadInput(InputStream *in);
+void closeInput(InputStream *in);
+int refillInput(InputStream *in);
+int readInteger(InputStream *in, int *value);
+int openOutput(OutputStream *out, int fd);
+void flushOutput(OutputStream *out);
+void writeInteger(OutputStream *out, int value);
+void writeText(OutputStream *out, const char *text);
+void writeBytes(OutputStream *out, const char *text, size_t length);
+int formatInteger(char *dest, int value);
+int readLineInteger(InputStream *in, int *value);
+int inputReady(const InputStream *in);
+int skipInput(InputStream *in, long long offset);
+int closeOutput(OutputStream *out);
+
+// Dataflow functions//
+void initDataflow(DataflowProblem *problem, const ControlFlowGraph *cfg, int bits,
+                  DataflowDirection direction, DataflowMeet meet);
+void solveDataflow(DataflowProblem *problem, const ControlFlowGraph *cfg);
+void freeDataflow(DataflowProblem *problem);
+BitWord *dataflowSet(BitWord *sets, const DataflowProblem *problem, int block);
+void bitsetAdd(BitWord *set, int bit);
+void bitsetRemove(BitWord *set, int bit);
+int bitsetContains(const BitWord *set, int bit);
+void computeLiveness(DataflowProblem *problem, const ControlFlowGraph *cfg);
+
+// Pass manager functions//
+const LabelIndex *requireLabels(void);
+const ControlFlowGraph *requireControlFlowGraph(void);
+const DataflowProblem *requireLiveness(void);
+int analysisValid(AnalysisId analysis);
+void invalidateAnalyses(void);
+void freeAnalyses(void);
+int findPass(const char *name, size_t length);
+int checkPassList(const char *list);
+int printsAfter(int pass);
+int runPass(int pass, const PassOptions *options);
+int runPassPipeline(const PassOptions *options);
+int verifyIr(void);
+void printPassReport(const char *filename);
+int loopPass(const PassOptions *options);
+int valueNumberingPass(const PassOptions *options);
+int deadStorePass(const PassOptions *options);
+int simplifyJumpPass(const PassOptions *options);
+int ifConversionPass(const PassOptions *options);
+int vectorizePass(const PassOptions *options);
+int specializePass(const PassOptions *options);
+int layoutPass(const PassOptions *options);
+int superinstructionPass(const PassOptions *options);
+int linkPass(const PassOptions *options);
+
+// Dead code functions//
+int eliminateDeadStores(void);
+int transferStrongLiveness(const ControlFlowGraph *cfg, int b, BitWord *live, const int *storeOf,
+                           char *dead);
+int simplifyJumps(void);
+
+// If-conversion functions//
+int convertBranches(void);
+int convertibleBranch(const Instruction *instructions, int count, const int *depthAt, int jump,
+                      const LabelIndex *labels, int *end);
+int pureExpression(const Instruction *instructions, int start, int end, int divisions);
+
+// Vectorization functions//
+int vectorizeStatements(void);
+InstructionType vectorCandidate(const Instruction *instructions, int pc);
+int placeSlotGroup(int *groupOf, int *groupIndex, int (*groups)[VECTOR_WIDTH], int *groupCount, const int *tuple);
+void renumberSlots(Instruction *instructions, int count, const int *newSlot);
+
+// Layout functions//
+unsigned long long hashStackCode(void);
+int layoutBlocks(const BlockProfile *profile);
+int layoutChain(int *chains, int block);
+int readBlockProfile(BlockProfile *profile, const char *filename);
+int writeBlockProfile(const ExecutionProfile *execution, const char *filename);
+void freeBlockProfile(BlockProfile *profile);
+
+// Tiered execution functions//
+int parseTierThresholds(const char *text);
+VmStatus runTiered(VmState *vm);
+int countBackEdges(long long count);
+void requestTierUp(const char *trigger);
+void *compileTier(void *unused);
+const unsigned char *nativeEntry(int pc);
+void finishTiers(const char *filename, int stats);
+int nativeRead(VmState *vm, int pc);
+void nativeFail(VmState *vm, const char *message, int pc);
+int compileNative(NativeCode *native);
+void freeNativeCode(NativeCode *native);
+int nativeStackDepths(int *depths, char *leaders);
+int compileNativeInstruction(NativeCompiler *c, const Instruction *instr, const char *leaders, int *reachable);
+void nativeByte(NativeCompiler *c, int byte);
+void nativeInt(NativeCompiler *c, int value);
+void nativePrefix(NativeCompiler *c, int prefix, int wide, int opcode, int reg, int index, int base);
+void nativeRegister(NativeCompiler *c, int prefix, int wide, int opcode, int reg, int rm);
+void nativeMemory(NativeCompiler *c, int prefix, int wide, int opcode, int reg, int base, int index, int disp);
+void nativeMoveImmediate(NativeCompiler *c, int reg, int value);
+void nativeCall(NativeCompiler *c, unsigned long long function);
+void nativeJump(NativeCompiler *c, int condition, int target);
+void nativeFailJump(NativeCompiler *c, int condition, const char *message);
+void nativePush(NativeCompiler *c, NativeOperandKind kind, int value);
+void nativeLoad(NativeCompiler *c, const NativeOperand *operand, int reg);
+void nativeFlush(NativeCompiler *c, int k);
+void nativeFlushAll(NativeCompiler *c);
+void nativeFlushSlots(NativeCompiler *c, int first, int last);
+void nativeSpillEax(NativeCompiler *c);
+void nativeStore(NativeCompiler *c, int slot, NativeOperand value);
+int nativeArithmetic(NativeCompiler *c, InstructionType type);
+void nativeDivide(NativeCompiler *c);
+void nativeCompareJump(NativeCompiler *c, InstructionType comparison, int when, int target, int *reachable);
+int nativeCondition(InstructionType comparison);
+
+// Checkpoint functions//
+VmStatus runCheckpointed(VmState *vm);
+int writeCheckpoint(VmState *vm);
+int restoreCheckpoint(VmState *vm);
+int readFully(int fd, void *data, size_t size);
+int writeFully(int fd, const void *data, size_t size);
+
+// Bundle functions//
+void bundleProgramName(const char *filename, char *name, size_t size);
+int bundleConstantField(InstructionType type);
+int addBundleProgram(BundleBuilder *builder, const char *filename);
+int internBundleString(BundleBuilder *builder, const char *text);
+int internBundleConstant(BundleBuilder *builder, int value);
+void *growBundleArray(void *array, int count, int *capacity, size_t size);
+int writeBundle(BundleBuilder *builder, const char *path, int stats);
+void freeBundleBuilder(BundleBuilder *builder);
+int openBundle(const char *path);
+int checkBundle(const BundleHeader *header, size_t size);
+int findBundleProgram(const char *name);
+int loadBundleProgram(const char *name);
+const char *bundleString(int string);
+void closeBundle(void);
+
+// Incremental compilation functions//
+int compileUnit(const char *source, long length);
+int recompileUnit(const char *source, long length);
+int reparseStatements(int first, int last, const char *source, long length);
+void recordStatement(long start, int line, int codeStart);
+void freeUnit(void);
+char *readSource(const char *path, long *length);
+int watchFile(const char *path, int listing, int run, const char *inputPath, int stats);
+
+// Compile server functions//
+int listenSocket(const char *socketPath);
+int defaultServerSocket(char *path, size_t size);
+int peerIsOwner(int connection);
+int runServer(const char *socketPath, int workers);
+pid_t startServerWorker(int listener);
+void stopServer(int signal);
+int serveRequest(int connection);
+void *watchClient(void *arg);
+int receiveRequest(int connection, ServerRequest *request, int fds[SERVER_FDS]);
+
+// Event loop functions//
+int runInstances(const char *socketPath, int loops, long long *instances, long long *executed);
+void *eventLoopMain(void *arg);
+void acceptInstances(EventLoop *loop);
+void queueInstance(EventLoop *loop, Instance *instance);
+void stepInstance(EventLoop *loop, Instance *instance);
+void instanceEvent(EventLoop *loop, Instance *instance, unsigned events);
+int receiveInput(Instance *instance);
+int sendOutput(Instance *instance);
+void watchInstance(EventLoop *loop, Instance *instance);
+void dropInstance(EventLoop *loop, Instance *instance);
+void finishInstance(EventLoop *loop, Instance *instance);
+
+// Pipeline functions//
+int initRing(SpscRing *ring, int slots, int elementSize);
+void freeRing(SpscRing *ring);
+void ringPush(SpscRing *ring, const void *element);
+void ringPop(SpscRing *ring, void *element);
+void ringFlush(SpscRing *ring);
+void ringRelease(SpscRing *ring);
+void ringWait(_Atomic unsigned *index, unsigned seen, _Atomic int *waiting, int spins);
+void ringWake(_Atomic unsigned *index, _Atomic int *waiting);
+Token takeToken(void);
+void publishStatement(int codeStart);
+void *lexerThreadMain(void *arg);
+void *writerThreadMain(void *arg);
+int compilePipelined(const char *filename, int listing);
+
+// Command line functions//
+int compileFile(const char *filename);
+int runCommandLine(int argc, char *argv[]);
+void printUsage(const char *program_name);
+
+// Main function//
+
+int main(int argc, char *argv[])
+{
+    char filename[256];
+    char retry = 'y';
+    int choice;
+
+    if (argc > 1)
+    {
+        int status = runCommandLine(argc, argv);
+        freeLexemes();
+        return status;
+    }
+
+    do
+    {
+        error_count = 0;
+        printf("\nEnter the name of your file: ");
+        if (scanf("%255s", filename) != 1)
+        {
+            printf("Error reading filename\n");
+            return 1;
+        }
+        while (getchar() != '\n')
+            ;
+
+        long length = 0;
+        char *source = readSource(filename, &length);
+        if (source == NULL)
+        {
+            printf("Error: Cannot open file '%s'\n", filename);
+            printf("Do you want to try another file? (y/n): ");
+            scanf(" %c", &retry);
+            while (getchar() != '\n')
+                ;
+
+            if (retry != 'y' && retry != 'Y')
+            {
+                printf("Program terminated.\n");
+                return 1;
+            }
+            continue;
+        }
+
+        printf("File '%s' opened successfully!\n", filename);
+        line_number = 1;
+        cleanupStackCode();
+        freeidentifierTable();
+        resetSymboleTable();
+        initStackCode();
+        openSource(source, 0, length);
+        token = Next();
+        if (token.code == -1)
+        {
+            printf("Error getting first token\n");
+            free(source);
+            return 1;
+        }
+
+        P();
+        free(source);
+
+        if (error_count == 0 && runPassPipeline(NULL) == 0)
+        {
+            printf("\nParsing completed successfully!\n");
+
+            do
+            {
+                printf("\nMenu:\n");
+                printf("1. Show Table of Symboles\n");
+                printf("2. Show Table of identifiers\n");
+                printf("3. Show Intermediate Code\n");
+                printf("4. Show Control Flow Graph\n");
+                printf("5. Execute Intermediate Code\n");
+                printf("6. Compile another file\n");
+                printf("7. Exit\n");
+                printf("Enter your choice (1-7): ");
+
+                if (scanf("%d", &choice) != 1)
+                {
+                    while (getchar() != '\n')
+                        ;
+                    printf("Invalid input. Please enter a number between 1 and 7.\n");
+                    continue;
+                }
+                while (getchar() != '\n')
+                    ;
+
+                switch (choice)
+                {
+                case 1:
+                    printf("\nTable of Symboles:\n");
+                    PrintSymboleTable();
+                    resetSymboleTable();
+                    break;
+
+                case 2:
+                    printf("\nTable of identifiers:\n");
+                    printidentifierTable();
+                    freeidentifierTable();
+                    break;
+
+                case 3:
+                    // The code stays for the graph and execution entries
+                    printStackCode();
+                    break;
+
+                case 4:
+                {
+                    ControlFlowGraph cfg;
+                    if (buildControlFlowGraph(&cfg) == 0)
+                    {
+                        printControlFlowGraph(&cfg);
+                        freeControlFlowGraph(&cfg);
+                    }
+                    break;
+                }
+
+                case 5:
+                    executeStackCode(1, NULL, NULL, NULL);
+                    break;
+
+                case 6:
+
+                    retry = 'y';
+                    break;
+
+                case 7:
+                    printf("Exiting program...\n");
+                    retry = 'n';
+                    break;
+
+                default:
+                    printf("Invalid choice. Please enter a number between 1 and 7.\n");
+                    break;
+                }
+            } while (choice != 6 && choice != 7);
+        }
+        else
+        {
+            printf("\nParsing completed with %d errors.\n", error_count);
+            printf("Do you want to try another file? (y/n): ");
+            scanf(" %c", &retry);
+            while (getchar() != '\n')
+                ;
+        }
+
+    } while (retry == 'y' || retry == 'Y');
+
+    resetSymboleTable();
+    cleanupStackCode();
+    freeidentifierTable();
+    freeLexemes();
+    return 0;
+}
+
+// Command line functions implementation//
+int compileFile(const char *filename)
+{
+    long length = 0;
+    char *source = readSource(filename, &length);
+    if (source == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        return -1;
+    }
+
+    cleanupStackCode();
+    freeidentifierTable();
+    resetSymboleTable();
+    error_count = 0;
+    line_number = 1;
+    initStackCode();
+    openSource(source, 0, length);
+    token = Next();
+    if (token.code == -1)
+    {
+        fprintf(stderr, "Error getting first token\n");
+        free(source);
+        return -1;
+    }
+
+    P();
+    free(source);
+    return error_count;
+}
+void printUsage(const char *program_name)
+{
+    fprintf(stderr, "Usage: %s [options] <file>...\n", program_name);
+    fprintf(stderr, "  --listing                        print the intermediate code (default)\n");
+    fprintf(stderr, "  --run                            execute the program, readln reads stdin\n");
+    fprintf(stderr, "  --input=<file>                   with --run, read readln values from <file> (mapped)\n");
+    fprintf(stderr, "  --specialize=<file>              fold in the first readln values, given in <file>\n");
+    fprintf(stderr, "  --bench[=<runs>]                 time <runs> runs on the same input (default %d)\n", DEFAULT_BENCH_RUNS);
+    fprintf(stderr, "  -O0, -O1, -O2                    optimization level (default -O%d)\n", DEFAULT_OPTIMIZATION_LEVEL);
+    fprintf(stderr, "  --print-after=<pass,...|all>     print the code after each listed pass\n");
+    fprintf(stderr, "  --time-passes                    report the time and effect of each pass\n");
+    fprintf(stderr, "  --verify-each                    check the code after parsing and after every pass\n");
+    fprintf(stderr, "  --batch                          run once per input line, many lines at a time in SIMD lanes\n");
+    fprintf(stderr, "  --parallel[=<threads>]           run once per input line on a thread pool (default: all cores)\n");
+    fprintf(stderr, "  --shard-size=<records>           input lines per parallel work unit (default %d)\n", DEFAULT_SHARD_SIZE);
+    fprintf(stderr, "  --stats                          print static and executed instruction counts\n");
+    fprintf(stderr, "  --profile[=<file>]               with --run, report hot lines, instructions and branches\n");
+    fprintf(stderr, "  --superinstructions[=<profile>]  fuse common sequences, ranked by an opcode-pair profile\n");
+    fprintf(stderr, "  --pair-profile=<file>            write the opcode-pair profile of all files\n");
+    fprintf(stderr, "  --block-profile=<file>           with --run, add the executed block counts to <file>\n");
+    fprintf(stderr, "  --layout=<profile>               order the basic blocks by a --block-profile, hot paths first\n");
+    fprintf(stderr, "  --tiered[=<runs>[,<back edges>]] interpret, then switch to native x86-64 code compiled in the\n");
+    fprintf(stderr, "                                   background once a count is reached (default %d,%d)\n",
+            DEFAULT_TIER_RUNS, DEFAULT_TIER_BACK_EDGES);
+    fprintf(stderr, "  --checkpoint=<file>              with --run, save the running state to <file> now and then\n");
+    fprintf(stderr, "  --checkpoint-interval=<seconds>  time between two checkpoints (default %g)\n", DEFAULT_CHECKPOINT_INTERVAL);
+    fprintf(stderr, "  --resume                         continue from the --checkpoint file, if there is one\n");
+    fprintf(stderr, "  --bundle=<image>                 compile the files into one image, programs named after them\n");
+    fprintf(stderr, "  --image=<image>                  the <file>s are programs of a --bundle image, loaded compiled\n");
+    fprintf(stderr, "  --link                           resolve jump labels to instruction positions\n");
+    fprintf(stderr, "  --strip-labels                   link and drop the LABEL pseudo-instructions\n");
+    fprintf(stderr, "  --watch                          recompile the changed statements whenever the file changes\n");
+    fprintf(stderr, "  --pipeline                       lex, parse and write the listing on three threads\n");
+    fprintf(stderr, "  --server[=<socket>]              serve compiler_client requests of this user (default\n"
+                    "                                   $XDG_RUNTIME_DIR/%s, else in " SERVER_SOCKET_DIRECTORY ")\n",
+            SERVER_SOCKET_NAME, (unsigned)geteuid());
+    fprintf(stderr, "  --workers=<n>                    with --server, requests served at once (default: all cores)\n");
+    fprintf(stderr, "  --listen=<socket>                run the program once per connection, readln reading from it\n");
+    fprintf(stderr, "  --loops=<n>                      with --listen, event-loop threads (default 1)\n");
+    fprintf(stderr, "A <file> of '-' reads the program from stdin.\n");
+    fprintf(stderr, "Without arguments the interactive menu is started.\n");
+}
+int runCommandLine(int argc, char *argv[])
+{
+    int listing = 0, run = 0, batch = 0, stats = 0, superinstructions = 0, link = 0, stripLabels = 0;
+    int parallel = 0, threads = 0, shardSize = DEFAULT_SHARD_SIZE, watch = 0, workers = 0, pipelined = 0;
+    const char *serverSocket = NULL;
+    char defaultSocket[256];
+    const char *instanceSocket = NULL;
+    int loops = 1, benchRuns = 0;
+    const char *superProfile = NULL;
+    const char *pairProfile = NULL;
+    const char *inputPath = NULL;
+    const char *knownPath = NULL;
+    const char *profileReport = NULL; // "-" for stderr
+    const char *blockProfilePath = NULL;
+    const char *layoutPath = NULL;
+    const char *bundlePath = NULL;
+    const char *imagePath = NULL;
+    int fileCount = 0;
+    // Server workers run one command line after another
+    passManager.level = DEFAULT_OPTIMIZATION_LEVEL;
+    passManager.printAfter = NULL;
+    passManager.timePasses = passManager.verifyEach = 0;
+    tiers.enabled = 0;
+    tiers.runThreshold = DEFAULT_TIER_RUNS;
+    tiers.backEdgeThreshold = DEFAULT_TIER_BACK_EDGES;
+    memset(&checkpoints, 0, sizeof(checkpoints));
+    checkpoints.interval = DEFAULT_CHECKPOINT_INTERVAL;
+    checkpoints.resumedAt = -1;
+    int checkpointOptions = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--listing") == 0)
+            listing = 1;
+        else if (strcmp(arg, "--run") == 0)
+            run = 1;
+        else if (strcmp(arg, "--batch") == 0)
+            run = batch = 1;
+        else if (strcmp(arg, "--parallel") == 0)
+            run = parallel = 1;
+        else if (strncmp(arg, "--parallel=", 11) == 0)
+        {
+            run = parallel = 1;
+            threads = atoi(arg + 11);
+        }
+        else if (strncmp(arg, "--shard-size=", 13) == 0)
+        {
+            shardSize = atoi(arg + 13);
+            if (shardSize <= 0)
+            {
+                fprintf(stderr, "Invalid shard size '%s'\n", arg + 13);
+                return 2;
+            }
+        }
+        else if (strcmp(arg, "--stats") == 0)
+            stats = 1;
+        else if (strcmp(arg, "--bench") == 0)
+        {
+            run = 1;
+            benchRuns = DEFAULT_BENCH_RUNS;
+        }
+        else if (strncmp(arg, "--bench=", 8) == 0)
+        {
+            run = 1;
+            benchRuns = atoi(arg + 8);
+            if (benchRuns <= 0)
+            {
+                fprintf(stderr, "Invalid run count '%s'\n", arg + 8);
+                return 2;
+            }
+        }
+        else if (strcmp(arg, "--profile") == 0)
+            profileReport = "-";
+        else if (strncmp(arg, "--profile=", 10) == 0)
+            profileReport = arg + 10;
+        else if (strcmp(arg, "--tiered") == 0)
+            tiers.enabled = 1;
+        else if (strncmp(arg, "--tiered=", 9) == 0)
+        {
+            tiers.enabled = 1;
+            if (parseTierThresholds(arg + 9) != 0)
+            {
+                fprintf(stderr, "Invalid tier thresholds '%s'\n", arg + 9);
+                return 2;
+            }
+        }
+        else if (strncmp(arg, "--checkpoint=", 13) == 0)
+            checkpoints.path = arg + 13;
+        else if (strncmp(arg, "--checkpoint-interval=", 22) == 0)
+        {
+            char *end;
+            checkpoints.interval = strtod(arg + 22, &end);
+            if (end == arg + 22 || *end != '\0' || checkpoints.interval < 0)
+            {
+                fprintf(stderr, "Invalid checkpoint interval '%s'\n", arg + 22);
+                return 2;
+            }
+            checkpointOptions = 1;
+        }
+        else if (strcmp(arg, "--resume") == 0)
+            checkpoints.resume = checkpointOptions = 1;
+        else if (strncmp(arg, "--bundle=", 9) == 0)
+            bundlePath = arg + 9;
+        else if (strncmp(arg, "--image=", 8) == 0)
+            imagePath = arg + 8;
+        else if (strcmp(arg, "--link") == 0)
+            link = 1;
+        else if (strcmp(arg, "--strip-labels") == 0)
+            link = stripLabels = 1;
+        else if (strcmp(arg, "--superinstructions") == 0)
+            superinstructions = 1;
+        else if (strncmp(arg, "--superinstructions=", 20) == 0)
+        {
+            superinstructions = 1;
+            superProfile = arg + 20;
+        }
+        else if (strncmp(arg, "--pair-profile=", 15) == 0)
+            pairProfile = arg + 15;
+        else if (strncmp(arg, "--block-profile=", 16) == 0)
+            blockProfilePath = arg + 16;
+        else if (strncmp(arg, "--layout=", 9) == 0)
+            layoutPath = arg + 9;
+        else if (strncmp(arg, "--input=", 8) == 0)
+            inputPath = arg + 8;
+        else if (strncmp(arg, "--specialize=", 13) == 0)
+            knownPath = arg + 13;
+        else if (strcmp(arg, "-O0") == 0 || strcmp(arg, "-O1") == 0 || strcmp(arg, "-O2") == 0)
+            passManager.level = arg[2] - '0';
+        else if (strncmp(arg, "--print-after=", 14) == 0)
+        {
+            if (checkPassList(arg + 14) != 0)
+                return 2;
+            passManager.printAfter = arg + 14;
+        }
+        else if (strcmp(arg, "--time-passes") == 0)
+            passManager.timePasses = 1;
+        else if (strcmp(arg, "--verify-each") == 0)
+            passManager.verifyEach = 1;
+        else if (strcmp(arg, "--watch") == 0)
+            watch = 1;
+        else if (strcmp(arg, "--pipeline") == 0)
+            pipelined = 1;
+        else if (strcmp(arg, "--server") == 0)
+        {
+            serverSocket = getenv("MINI_COMPILER_SOCKET");
+            if (serverSocket == NULL)
+            {
+                if (defaultServerSocket(defaultSocket, sizeof(defaultSocket)) != 0)
+                    return 1;
+                serverSocket = defaultSocket;
+            }
+        }
+        else if (strncmp(arg, "--server=", 9) == 0)
+            serverSocket = arg + 9;
+        else if (strncmp(arg, "--workers=", 10) == 0)
+            workers = atoi(arg + 10);
+        else if (strncmp(arg, "--listen=", 9) == 0)
+        {
+            run = 1;
+            instanceSocket = arg + 9;
+        }
+        else if (strncmp(arg, "--loops=", 8) == 0)
+            loops = atoi(arg + 8);
+        else if (arg[0] == '-' && arg[1] != '\0')
+        {
+            fprintf(stderr, "Unknown option '%s'\n", arg);
+            printUsage(argv[0]);
+            return 2;
+        }
+        else
+            argv[1 + fileCount++] = argv[i];
+    }
+    if (serverSocket)
+    {
+        if (fileCount != 0)
+        {
+            fprintf(stderr, "--server takes no files, clients send them\n");
+            return 2;
+        }
+        return runServer(serverSocket, workers);
+    }
+    if (fileCount == 0)
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (!listing && !run && !pairProfile && !bundlePath)
+        listing = 1;
+    if ((pipelined || watch) && (passManager.printAfter || passManager.timePasses || passManager.verifyEach))
+    {
+        // Both optimize statement by statement, outside the pass manager
+        fprintf(stderr, "--print-after, --time-passes and --verify-each need whole-program compilation\n");
+        return 2;
+    }
+    if ((pipelined || watch) && passManager.level > 1)
+    {
+        // The -O2 passes rewrite across statements, which neither mode keeps together
+        fprintf(stderr, "--pipeline and --watch optimize at -O0 or -O1 only\n");
+        return 2;
+    }
+    if (pipelined)
+    {
+        // The statements are gone once written, so nothing may run or rewrite the whole program
+        if (run || watch || link || superinstructions || pairProfile || profileReport || knownPath || layoutPath ||
+            blockProfilePath || tiers.enabled || checkpoints.path || bundlePath || imagePath)
+        {
+            fprintf(stderr, "--pipeline takes only --listing and --stats\n");
+            return 2;
+        }
+        int status = 0;
+        for (int f = 1; f <= fileCount; f++)
+        {
+            if (compilePipelined(argv[f], listing) != 0)
+            {
+                fprintf(stderr, "Compilation of '%s' failed.\n", argv[f]);
+                status = 1;
+                break;
+            }
+            if (stats)
+                fprintf(stderr, "%s: %lld instructions\n", argv[f], pipeline.instructions);
+        }
+        cleanupStackCode();
+        freeidentifierTable();
+        resetSymboleTable();
+        return status;
+    }
+    if (benchRuns && (batch || parallel || instanceSocket || profileReport || watch || pipelined))
+    {
+        fprintf(stderr, "--bench times plain runs only\n");
+        return 2;
+    }
+    if (instanceSocket && (fileCount != 1 || batch || parallel || profileReport || pairProfile || watch))
+    {
+        fprintf(stderr, "--listen takes one file and no other way of running it\n");
+        return 2;
+    }
+    if ((layoutPath || blockProfilePath) && fileCount != 1)
+    {
+        fprintf(stderr, "--layout and --block-profile take one file\n");
+        return 2;
+    }
+    if (blockProfilePath && (!run || batch || parallel || instanceSocket || benchRuns))
+    {
+        fprintf(stderr, "--block-profile counts the blocks of a plain --run\n");
+        return 2;
+    }
+    if (tiers.enabled && (!run || batch || instanceSocket || profileReport || blockProfilePath || watch))
+    {
+        // Batches run in SIMD lanes, profiles and event-loop slices in their own interpreter loops
+        fprintf(stderr, "--tiered runs plain, --bench and --parallel runs\n");
+        return 2;
+    }
+    if (checkpointOptions && checkpoints.path == NULL)
+    {
+        fprintf(stderr, "--resume and --checkpoint-interval need --checkpoint\n");
+        return 2;
+    }
+    if (checkpoints.path && (fileCount != 1 || !run || batch || parallel || instanceSocket || benchRuns || profileReport ||
+                             blockProfilePath || tiers.enabled || watch))
+    {
+        // The state of one interpreted run: a checkpoint is of one program and one input
+        fprintf(stderr, "--checkpoint takes a plain --run of one file\n");
+        return 2;
+    }
+    if (bundlePath && (run || pairProfile || imagePath || watch))
+    {
+        fprintf(stderr, "--bundle only compiles: no --run, --batch, --parallel, --bench, --listen, --pair-profile, --image or --watch\n");
+        return 2;
+    }
+    if (imagePath && (knownPath || superinstructions || layoutPath || blockProfilePath || watch ||
+                      passManager.printAfter || passManager.timePasses || passManager.verifyEach))
+    {
+        // Bundled programs are loaded compiled: no pass runs on them
+        fprintf(stderr, "--image takes the bundled code as it is: no --specialize, --superinstructions, --layout,\n"
+                        "--block-profile, --watch or pass options\n");
+        return 2;
+    }
+    if (watch)
+    {
+        // The kept code is spliced in place, so nothing may rewrite it between edits
+        if (fileCount != 1 || batch || parallel || link || superinstructions || pairProfile || profileReport ||
+            knownPath || layoutPath || blockProfilePath)
+        {
+            fprintf(stderr, "--watch takes one file and only --listing, --run, --input and --stats\n");
+            return 2;
+        }
+        return watchFile(argv[1], listing, run, inputPath, stats);
+    }
+    if (imagePath && openBundle(imagePath) != 0)
+        return 1;
+    // Bundled code is linked as for running it: no LABELs, jumps carry their target positions
+    BundleBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    if (bundlePath)
+        link = stripLabels = 1;
+
+    OpcodePairProfile *profile = NULL;
+    if (pairProfile || superProfile)
+    {
+        profile = (OpcodePairProfile *)calloc(1, sizeof(OpcodePairProfile));
+        if (superProfile && readOpcodePairProfile(profile, superProfile) != 0)
+        {
+            free(profile);
+            return 1;
+        }
+    }
+
+    // Known readln values, the same for every file
+    int *knownInputs = NULL;
+    int knownCount = 0;
+    if (knownPath && (knownCount = readKnownInputs(knownPath, &knownInputs)) < 0)
+    {
+        free(profile);
+        return 1;
+    }
+
+    // A profile about to be written for the first time lays nothing out yet
+    BlockProfile blockProfile = {0};
+    int haveLayout = 0;
+    if (layoutPath && (blockProfilePath == NULL || strcmp(layoutPath, blockProfilePath) != 0 ||
+                       access(layoutPath, F_OK) == 0))
+    {
+        if (readBlockProfile(&blockProfile, layoutPath) != 0)
+        {
+            free(profile);
+            free(knownInputs);
+            return 1;
+        }
+        haveLayout = 1;
+    }
+
+    int status = 0;
+    for (int f = 1; f <= fileCount && status == 0; f++)
+    {
+        if (imagePath)
+        {
+            // The <file>s name programs of the bundle
+            if (loadBundleProgram(argv[f]) != 0)
+            {
+                status = 1;
+                break;
+            }
+        }
+        else if (compileFile(argv[f]) != 0)
+        {
+            fprintf(stderr, "Compilation of '%s' failed.\n", argv[f]);
+            status = 1;
+            break;
+        }
+        PassOptions options = {knownInputs, knownCount, superProfile ? profile : NULL, stripLabels,
+                               haveLayout ? &blockProfile : NULL};
+        if (!imagePath && runPassPipeline(&options) != 0)
+        {
+            status = 1;
+            break;
+        }
+        int staticBefore = code.size;
+        if (knownPath && runPass(PASS_SPECIALIZE, &options) < 0)
+        {
+            fprintf(stderr, "Specialization of '%s' failed.\n", argv[f]);
+            status = 1;
+            break;
+        }
+        if ((layoutPath || blockProfilePath) && runPass(PASS_LAYOUT, &options) < 0)
+        {
+            status = 1;
+            break;
+        }
+        int staticSpecialized = code.size;
+        if (pairProfile)
+        {
+            collectOpcodePairs(profile);
+            if (passManager.timePasses)
+                printPassReport(argv[f]);
+            continue;
+        }
+
+        if (superinstructions && runPass(PASS_SUPERINSTRUCTIONS, &options) < 0)
+        {
+            status = 1;
+            break;
+        }
+        int staticAfter = code.size;
+        if (link && runPass(PASS_LINK, &options) < 0)
+        {
+            status = 1;
+            break;
+        }
+        if (bundlePath && addBundleProgram(&builder, argv[f]) != 0)
+        {
+            status = 1;
+            break;
+        }
+        if (passManager.timePasses)
+            printPassReport(argv[f]);
+        if (listing)
+            printStackCode();
+
+        long long executed = 0, records = 0;
+        ExecutionProfile executionProfile;
+        memset(&executionProfile, 0, sizeof(executionProfile));
+        if (parallel)
+        {
+            if (executeParallel(inputPath, threads, shardSize, &records, &executed) != 0)
+                status = 1;
+        }
+        else if (batch)
+        {
+            if (executeBatch(inputPath, &records, &executed) != 0)
+                status = 1;
+        }
+        else if (instanceSocket)
+        {
+            if (runInstances(instanceSocket, loops, &records, &executed) != 0)
+                status = 1;
+        }
+        else if (benchRuns)
+        {
+            if (benchmarkStackCode(inputPath, benchRuns, &executed) != 0)
+                status = 1;
+        }
+        else if (run && executeStackCode(0, inputPath, profileReport || blockProfilePath ? &executionProfile : NULL,
+                                         &executed) != 0)
+            status = 1;
+        if (executionProfile.hits != NULL && blockProfilePath && writeBlockProfile(&executionProfile, blockProfilePath) != 0)
+            status = 1;
+        if (executionProfile.hits != NULL && profileReport)
+        {
+            FILE *report = strcmp(profileReport, "-") == 0 ? stderr : fopen(profileReport, "w");
+            if (report == NULL)
+            {
+                fprintf(stderr, "Error: Cannot write profile '%s'\n", profileReport);
+                status = 1;
+            }
+            else
+            {
+                printProfileReport(&executionProfile, argv[f], report);
+                if (report != stderr)
+                    fclose(report);
+            }
+        }
+        freeExecutionProfile(&executionProfile);
+        if (stats)
+        {
+            fprintf(stderr, "%s: %d instructions", argv[f], staticBefore);
+            if (knownPath)
+                fprintf(stderr, " (%d after specialization)", staticSpecialized);
+            if (staticAfter != staticSpecialized)
+                fprintf(stderr, " (%d after superinstructions)", staticAfter);
+            if (code.linked && code.size != staticAfter)
+                fprintf(stderr, " (%d after linking)", code.size);
+            if (parallel)
+                fprintf(stderr, ", %lld records in shards of %d", records, shardSize);
+            else if (batch)
+                fprintf(stderr, ", %lld records in %d-lane batches", records, BATCH_LANES);
+            else if (instanceSocket)
+                fprintf(stderr, ", %lld instances", records);
+            if (run)
+                fprintf(stderr, ", %lld executed", executed);
+            if (checkpoints.resumedAt >= 0)
+                fprintf(stderr, " (resumed after %lld)", checkpoints.resumedAt);
+            if (checkpoints.path)
+                fprintf(stderr, ", %d checkpoints in %.3f ms", checkpoints.written, checkpoints.seconds * 1e3);
+            fprintf(stderr, "\n");
+        }
+        if (tiers.enabled)
+            finishTiers(argv[f], stats);
+    }
+
+    if (pairProfile && status == 0)
+        status = writeOpcodePairProfile(profile, pairProfile) == 0 ? 0 : 1;
+    if (bundlePath && status == 0)
+        status = writeBundle(&builder, bundlePath, stats) == 0 ? 0 : 1;
+    freeBundleBuilder(&builder);
+    free(profile);
+    free(knownInputs);
+    freeBlockProfile(&blockProfile);
+    cleanupStackCode();
+    freeidentifierTable();
+    resetSymboleTable();
+    return status;
+}
+
+// Additional functions implementations//
+char ReadLetter()
+{
+    char c = source_position < source_length ? source_text[source_position++] : EOF;
+    // printf("c=%c \n", c);
+    return c;
+}
+void UnreadLetter(char c)
+{
+    if (c != EOF)
+        source_position--;
+}
+char SkipWhiteSpace(void)
+{
+    char c;
+    while ((c = ReadLetter()) != EOF && isspace(c))
+    {
+        if (c == '\n')
+            line_number++;
+    }
+
+    return c;
+}
+const char *CodeToKeyword(int code)
+{
+    switch (code)
+    {
+    case program:
+        return "program";
+    case begin:
+        return "begin";
+    case END:
+        return "end";
+    case id:
+        return "Symbole";
+    case comment:
+        return "comment";
+    case nb:
+        return "number";
+    case aff:
+        return ":=";
+    case po:
+        return "(";
+    case pf:
+        return ")";
+    case pv:
+        return ";";
+    case dp:
+        return ":";
+    case IF:
+        return "if";
+    case THEN:
+        return "then";
+    case ENDIF:
+        return "endif";
+    case WHILE:
+        return "while";
+    case DO:
+        return "do";
+    case ENDWHILE:
+        return "endwhile";
+    case VAR:
+        return "var";
+    case INT:
+        return "int";
+    case oparith:
+        return "arithmetic_operator";
+    case oprel:
+        return "relational_operator";
+    case writeln:
+        return "writeln";
+    case readln:
+        return "readln";
+    case point:
+        return ".";
+    case virg:
+        return ",";
+    case ARRAY:
+        return "array";
+    case OF:
+        return "of";
+    case co:
+        return "[";
+    case cf:
+        return "]";
+    default:
+        return "unknown";
+    }
+}
+void Safe_Strcpy(char *dest, const char *src, size_t size)
+{
+    if (size > 0)
+    {
+        strncpy(dest, src, size - 1);
+        dest[size - 1] = '\0';
+    }
+}
+int Isnst()
+{
+    return token.code == id || token.code == writeln ||
+           token.code == readln || token.code == IF || token.code == WHILE;
+}
+void Error(const char *message)
+{
+    error_count++;
+    if (unit.probing)
+        return; // recompileUnit() falls back to a full compile, which reports it
+    fprintf(stderr, "Error at line %d: %s\n", line_number, message);
+
+    if (error_count >= MAX_ERRORS)
+    {
+        fprintf(stderr, "Too many errors. Stopping compilation.\n");
+        exit(1);
+    }
+}
+void AddToSymbolesTable(int symbol)
+{
+    // The identifiers are the interned lexemes themselves: the table only keeps their order
+    if (lexemes.listed[symbol])
+        return;
+    if (lexemes.listedCount >= lexemes.listedCapacity)
+    {
+        lexemes.listedCapacity = lexemes.listedCapacity ? lexemes.listedCapacity * 2 : 64;
+        lexemes.listedOrder = (int *)realloc(lexemes.listedOrder, lexemes.listedCapacity * sizeof(int));
+    }
+    lexemes.listed[symbol] = 1;
+    lexemes.listedOrder[lexemes.listedCount++] = symbol;
+}
+void PrintSymboleTable(void)
+{
+    printf("\nSymbole Table:\n");
+    printf("    +----------------------+-------+\n");
+    printf("    | %-20s | %-5s |\n", "Name", "Code");
+    printf("    +----------------------+-------+\n");
+
+    for (int i = 0; IdentTab[i].name != NULL; i++)
+    {
+        printf("    | %-20s | %-5d |\n", IdentTab[i].name, IdentTab[i].code);
+        printf("    +----------------------+-------+\n");
+    }
+    for (int i = 0; i < lexemes.listedCount; i++)
+    {
+        printf("    | %-20s | %-5d |\n", lexemes.names[lexemes.listedOrder[i]], id);
+        printf("    +----------------------+-------+\n");
+    }
+}
+
+// Grammar functions implementation//
+void P()
+{
+    if (token.code == program)
+    {
+        semanticP();
+        Accept(program);
+        Accept(id);
+        Accept(pv);
+        Dcl();
+        Accept(begin);
+        unit.bodyStart = token.offset;
+        StatementList();
+        unit.bodyEnd = token.offset;
+        unit.endLine = line_number;
+        Accept(END);
+        Accept(point);
+    }
+}
+void Dcl()
+{
+    if (token.code == VAR)
+    {
+        Accept(VAR);
+        int first = identifierTable.size;
+        ListId();
+        Accept(dp);
+        if (token.code == ARRAY)
+        {
+            // array[N] of int: the names just declared become arrays of N elements
+            Accept(ARRAY);
+            Accept(co);
+            int length = token.code == nb ? token.value : 0;
+            Accept(nb);
+            Accept(cf);
+            Accept(OF);
+            semanticArrayDcl(first, length);
+        }
+        Accept(INT);
+        Accept(pv);
+        Dcl();
+    }
+}
+void ListId()
+{
+    if (token.code == id)
+    {
+        const char *varName = lexemeName(token.symbol);
+        semanticDcl(varName);
+        Accept(id);
+        ListIdComp();
+    }
+}
+void ListIdComp()
+{
+    if (token.code == virg)
+    {
+        Accept(virg);
+        ListId();
+    }
+}
+void ListInst()
+{
+    if (Isnst())
+    {
+
+        I();
+        ListInstComp();
+    }
+}
+void ListInstComp()
+{
+    if (token.code != END && token.code != ENDIF && token.code != ENDWHILE)
+    {
+        ListInst();
+    }
+}
+void StatementList()
+{
+    // ListInst at the top level, where the incremental compiler keeps statement boundaries
+    while (Isnst() && !(unit.probing && error_count > 0))
+    {
+        long start = token.offset;
+        int line = line_number;
+        int codeStart = code.size;
+        unit.current = start;
+        I();
+        if (unit.recording)
+            recordStatement(start, line, codeStart);
+        else if (pipeline.active)
+            publishStatement(codeStart);
+    }
+}
+void I()
+{
+    code.line = line_number;
+    switch (token.code)
+    {
+    case id:
+    {
+        int symbol = token.symbol;
+        const char *varName = lexemeName(symbol);
+        const identifierEntry *entry = lookupidentifierSymbol(symbol);
+        Accept(id);
+        if (token.code == co)
+        {
+            // a[i] := e: the index, then the value, then the store
+            resetExprArena();
+            int index = Subscript();
+            semanticIndex(varName, index);
+            Accept(aff);
+            emitExpression(index);
+            resetExprArena();
+            emitExpression(Exp());
+            emitArray(ASSIGN_AT, varName, NULL, NULL);
+            Accept(pv);
+            break;
+        }
+        Accept(aff);
+        if (entry != NULL && entry->type == TYPE_ARRAY)
+        {
+            ArrayOperation(varName);
+            Accept(pv);
+            break;
+        }
+        semanticAssignment(varName);
+        emitStackSlot(STORE, symbolSlot(symbol));
+        resetExprArena();
+        emitExpression(Exp());
+        emitStack(ASSIGN, NULL);
+        Accept(pv);
+        break;
+    }
+    case writeln:
+        Accept(writeln);
+        Accept(po);
+        if (token.code == id)
+        {
+            const char *varName = lexemeName(token.symbol);
+            const identifierEntry *entry = lookupidentifierSymbol(token.symbol);
+            if (entry != NULL && entry->type == TYPE_ARRAY)
+            {
+                // writeln(a[i])
+                resetExprArena();
+                emitExpression(Variable());
+                emitStack(WRITE, NULL);
+            }
+            else
+            {
+                semanticWriteln(varName);
+                emitStackSlot(VALUE, symbolSlot(token.symbol));
+                emitStack(WRITE, NULL);
+                Accept(id);
+            }
+        }
+        Accept(pf);
+        Accept(pv);
+        break;
+
+    case readln:
+        Accept(readln);
+        Accept(po);
+        if (token.code == id)
+        {
+            const char *varName = lexemeName(token.symbol);
+            semanticReadln(varName);
+            emitStackSlot(READ, symbolSlot(token.symbol));
+            Accept(id);
+        }
+        Accept(pf);
+        Accept(pv);
+        break;
+
+    case IF:
+        Accept(IF);
+        int falseLabel = newStackLabel();
+        int endLabel = newStackLabel();
+
+        emitExpression(C());
+        emitStackLabel(GO_FALSE, falseLabel);
+
+        Accept(THEN);
+        ListInst();
+
+        code.line = line_number;
+        emitStackLabel(GOTO, endLabel);
+        emitStackLabel(LABEL, falseLabel);
+
+        Accept(ENDIF);
+        emitStackLabel(LABEL, endLabel);
+        break;
+
+    case WHILE:
+    {
+        // Rotated loop: enter at the test, which sits once at the bottom
+        //     goto Ltest; Lbody: body; Ltest: !C; go_false Lbody
+        int whileLine = code.line;
+        Accept(WHILE);
+        int bodyLabel = newStackLabel();
+        int testLabel = newStackLabel();
+
+        // Negated so that the test fuses into a compare-and-branch
+        int condition = C();
+        if (condition >= 0)
+            exprArena.nodes[condition].op = negateComparison(exprArena.nodes[condition].op);
+        int testStart = code.size;
+        emitExpression(condition);
+        int testLength = 0;
+        Instruction *test = cutInstructions(testStart, &testLength);
+
+        Accept(DO);
+        emitStackLabel(GOTO, testLabel);
+        emitStackLabel(LABEL, bodyLabel);
+        ListInst();
+
+        code.line = whileLine;
+        emitStackLabel(LABEL, testLabel);
+        appendInstructions(test, testLength);
+        emitStackLabel(GO_FALSE, bodyLabel);
+        free(test);
+        Accept(ENDWHILE);
+        break;
+    }
+    }
+}
+int C()
+{
+    resetExprArena();
+    int left = Exp();
+    InstructionType op = token.code == oprel ? (InstructionType)token.value : COMP_EQ;
+    Accept(oprel);
+    int right = Exp();
+    return newExprNode(op, left, right);
+}
+int Exp()
+{
+    int node = -1;
+    switch (token.code)
+    {
+    case id:
+        node = ExpComp(Variable());
+        break;
+    case nb:
+        node = newExprLeaf(EXPR_NUMBER, token.value);
+        Accept(nb);
+        node = ExpComp(node);
+        break;
+    case po:
+        Accept(po);
+        node = Exp();
+        Accept(pf);
+        node = ExpComp(node);
+        break;
+    default:
+        Error("Invalid expression");
+    }
+    return node;
+}
+int ExpComp(int left)
+{
+    if (token.code == oparith)
+    {
+        char op = (char)token.value;
+        Accept(oparith);
+        int right = Exp();
+        return ExpComp(newExprNode(arithmeticType(op), left, right));
+    }
+    return left;
+}
+int Variable()
+{
+    // A scalar, or an array element: arrays are read one element at a time
+    const char *varName = lexemeName(token.symbol);
+    int symbol = token.symbol;
+    const identifierEntry *entry = lookupidentifierSymbol(symbol);
+    int array = entry != NULL && entry->type == TYPE_ARRAY;
+    if (!array)
+        semanticExpression(entry, varName);
+    Accept(id);
+    if (token.code != co)
+    {
+        if (array)
+            semanticExpression(entry, varName); // reports the missing index
+        return newExprLeaf(EXPR_VARIABLE, symbol);
+    }
+    int index = Subscript();
+    semanticIndex(varName, index);
+    return newExprIndex(symbol, index);
+}
+int Subscript()
+{
+    Accept(co);
+    int index = Exp();
+    Accept(cf);
+    return index;
+}
+void ArrayOperation(const char *target)
+{
+    // a := b op c, element by element over whole arrays of the same length
+    const char *left = token.code == id ? lexemeName(token.symbol) : NULL;
+    Accept(id);
+    char op = token.code == oparith ? (char)token.value : '+';
+    Accept(oparith);
+    const char *right = token.code == id ? lexemeName(token.symbol) : NULL;
+    Accept(id);
+    if (left == NULL || right == NULL)
+        return;
+    semanticArrayOperation(target, left, right, op);
+    emitArray(op == '-' ? ARRAY_SUB : (op == '*' ? ARRAY_MUL : ARRAY_ADD), target, left, right);
+}
+
+// identifier table functions implementation//
+void initidentifierTable()
+{
+    identifierTable.capacity = 100;
+    identifierTable.size = 0;
+    identifierTable.entries = (identifierEntry *)malloc(identifierTable.capacity * sizeof(identifierEntry));
+    identifierTable.bySymbol = NULL;
+    identifierTable.symbolCapacity = 0;
+}
+void freeidentifierTable()
+{
+    for (int i = 0; i < identifierTable.size; i++)
+    {
+        free(identifierTable.entries[i].name);
+    }
+    free(identifierTable.entries);
+    identifierTable.entries = NULL;
+    identifierTable.size = 0;
+    identifierTable.capacity = 0;
+    free(identifierTable.bySymbol);
+    identifierTable.bySymbol = NULL;
+    identifierTable.symbolCapacity = 0;
+}
+identifierEntry *lookupidentifier(const char *name)
+{
+    // Identifiers are lexemes: a name the lexer never scanned is not declared either
+    return lookupidentifierSymbol(findLexeme(name, strlen(name)));
+}
+identifierEntry *lookupidentifierSymbol(int symbol)
+{
+    if (symbol < 0 || symbol >= identifierTable.symbolCapacity || identifierTable.bySymbol[symbol] == 0)
+        return NULL;
+    return &identifierTable.entries[identifierTable.bySymbol[symbol] - 1];
+}
+void addidentifier(const char *name, DataType type, int line)
+{
+    if (identifierTable.size >= identifierTable.capacity)
+    {
+        // Expand table if needed
+        identifierTable.capacity *= 2;
+        identifierTable.entries = (identifierEntry *)realloc(identifierTable.entries,
+                                                             identifierTable.capacity * sizeof(identifierEntry));
+    }
+
+    int symbol = internLexeme(name, strlen(name));
+    if (symbol >= identifierTable.symbolCapacity)
+    {
+        int capacity = identifierTable.symbolCapacity ? identifierTable.symbolCapacity : 64;
+        while (capacity <= symbol)
+            capacity *= 2;
+        identifierTable.bySymbol = (int *)realloc(identifierTable.bySymbol, capacity * sizeof(int));
+        memset(identifierTable.bySymbol + identifierTable.symbolCapacity, 0,
+               (capacity - identifierTable.symbolCapacity) * sizeof(int));
+        identifierTable.symbolCapacity = capacity;
+    }
+    identifierTable.bySymbol[symbol] = identifierTable.size + 1;
+
+    identifierEntry *entry = &identifierTable.entries[identifierTable.size++];
+    entry->name = strdup(name);
+    entry->type = type;
+    entry->isDeclared = 1;
+    entry->isInitialized = 0;
+    entry->value = 0;
+    entry->line = line;
+    entry->initOffset = -1;
+    entry->length = 0;
+}
+void printidentifierTable()
+{
+    printf("\nidentifier Table Contents:\n");
+    printf("+-----------------------------------------------------------------+\n");
+    printf("| %-20s | %-10s | %-12s | %-12s |\n", "Name", "Type", "Declared", "Initialized");
+    printf("+-----------------------------------------------------------------+\n");
+
+    for (int i = 0; i < identifierTable.size; i++)
+    {
+        char type[16];
+        if (identifierTable.entries[i].type == TYPE_ARRAY)
+            snprintf(type, sizeof(type), "INT[%d]", identifierTable.entries[i].length);
+        else
+            snprintf(type, sizeof(type), "%s", identifierTable.entries[i].type == TYPE_INT ? "INT" : "UNKNOWN");
+        printf("| %-20s | %-10s | %-12s | %-12s |\n",
+               identifierTable.entries[i].name,
+               type,
+               identifierTable.entries[i].isDeclared ? "YES" : "NO",
+               identifierTable.entries[i].isInitialized ? "YES" : "NO");
+    }
+
+    printf("+-----------------------------------------------------------------+\n");
+}
+
+// Semantic Analysis functions implementation//
+void semanticError(const char *message, int line)
+{
+    error_count++;
+    if (!unit.probing)
+        fprintf(stderr, "Semantic Error at line %d: %s\n", line, message);
+}
+void semanticP()
+{
+    initidentifierTable();
+}
+void semanticDcl(const char *varName)
+{
+    if (lookupidentifier(varName) != NULL)
+    {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Variable '%s' already declared", varName);
+        semanticError(error_msg, line_number);
+    }
+    else
+    {
+        addidentifier(varName, TYPE_INT, line_number);
+    }
+}
+void semanticAssignment(const char *varName)
+{
+    identifierEntry *entry = lookupidentifier(varName);
+    if (entry == NULL)
+    {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Variable '%s' used without declaration", varName);
+        semanticError(error_msg, line_number);
+    }
+    else
+    {
+        if (!entry->isInitialized)
+            entry->initOffset = unit.current;
+        entry->isInitialized = 1;
+    }
+}
+void semanticExpression(const identifierEntry *entry, const char *varName)
+{
+    // entry: varName as the caller looked it up, NULL when it is not declared
+    if (varName != NULL)
+    {
+        if (entry == NULL)
+        {
+            char error_msg[100];
+            snprintf(error_msg, sizeof(error_msg), "Variable '%s' used without declaration", varName);
+            semanticError(error_msg, line_number);
+        }
+        else if (entry->type == TYPE_ARRAY)
+        {
+            char error_msg[100];
+            snprintf(error_msg, sizeof(error_msg), "Array '%s' used without index", varName);
+            semanticError(error_msg, line_number);
+        }
+        else if (!entry->isInitialized)
+        {
+            char error_msg[100];
+            snprintf(error_msg, sizeof(error_msg), "Variable '%s' used without initialization", varName);
+            semanticError(error_msg, line_number);
+        }
+    }
+}
+void semanticReadln(const char *varName)
+{
+
+    identifierEntry *entry = lookupidentifier(varName);
+    if (entry == NULL)
+    {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Cannot read into undeclared variable '%s'", varName);
+        semanticError(error_msg, line_number);
+    }
+    else if (entry->type == TYPE_ARRAY)
+    {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Cannot read into array '%s'", varName);
+        semanticError(error_msg, line_number);
+    }
+    else
+    {
+        if (!entry->isInitialized)
+            entry->initOffset = unit.current;
+        entry->isInitialized = 1;
+    }
+}
+void semanticWriteln(const char *varName)
+{
+    identifierEntry *entry = lookupidentifier(varName);
+    if (entry == NULL)
+    {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Cannot write undeclared variable '%s'", varName);
+        semanticError(error_msg, line_number);
+    }
+    else if (!entry->isInitialized)
+    {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Cannot write uninitialized variable '%s'", varName);
+        semanticError(error_msg, line_number);
+    }
+}
+void semanticArrayDcl(int first, int length)
+{
+    // Arrays live in the frame, which starts zeroed: they count as initialized
+    if (length < 1 || length > MAX_ARRAY_LENGTH)
+    {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Array length must be between 1 and %d", MAX_ARRAY_LENGTH);
+        semanticError(error_msg, line_number);
+        return;
+    }
+    for (int i = first; i < identifierTable.size; i++)
+    {
+        identifierEntry *entry = &identifierTable.entries[i];
+        entry->type = TYPE_ARRAY;
+        entry->length = length;
+        entry->isInitialized = 1;
+        entry->initOffset = 0;
+    }
+}
+void semanticIndex(const char *arrayName, int index)
+{
+    identifierEntry *entry = lookupidentifier(arrayName);
+    char error_msg[100];
+    int value;
+    if (entry == NULL)
+        return; // reported as undeclared already
+    if (entry->type != TYPE_ARRAY)
+    {
+        snprintf(error_msg, sizeof(error_msg), "Variable '%s' is not an array", arrayName);
+        semanticError(error_msg, line_number);
+    }
+    else if (constantExpression(index, &value) && (value < 0 || value >= entry->length))
+    {
+        snprintf(error_msg, sizeof(error_msg), "Index %d out of bounds for array '%s' of length %d", value,
+                 arrayName, entry->length);
+        semanticError(error_msg, line_number);
+    }
+}
+void semanticArrayOperation(const char *target, const char *left, const char *right, char op)
+{
+    const char *names[3] = {target, left, right};
+    char error_msg[100];
+    for (int i = 0; i < 3; i++)
+    {
+        identifierEntry *entry = lookupidentifier(names[i]);
+        if (entry == NULL)
+            snprintf(error_msg, sizeof(error_msg), "Variable '%s' used without declaration", names[i]);
+        else if (entry->type != TYPE_ARRAY)
+            snprintf(error_msg, sizeof(error_msg), "Variable '%s' is not an array", names[i]);
+        else if (entry->length != lookupidentifier(target)->length)
+            snprintf(error_msg, sizeof(error_msg), "Arrays '%s' and '%s' differ in length", target, names[i]);
+        else
+            continue;
+        semanticError(error_msg, line_number);
+        return;
+    }
+    if (op == '/')
+        semanticError("Whole arrays can only be added, subtracted or multiplied", line_number);
+}
+
+// Accept and Next functions implementation//
+void Accept(int expected_token)
+{
+    if (token.code == expected_token)
+    {
+        if (token.code != -5)
+        {
+            Token next = Next();
+            if (next.code == -1)
+            {
+                Error("Lexical error while getting next token");
+            }
+            token = next;
+        }
+    }
+    else
+    {
+        char error_msg[100];
+        snprintf(error_msg, sizeof(error_msg), "Syntax error: Expected \" %s \" but got \" %s \"", CodeToKeyword(expected_token), CodeToKeyword(token.code));
+        Error(error_msg);
+    }
+}
+Token Next()
+{
+    for (;;)
+    {
+        // Tokens are scanned here, or on the lexer thread of a pipelined compile
+        Token next = pipeline.active ? takeToken() : scanToken();
+        line_number = next.line;
+        if (next.code == LEXICAL_ERROR)
+        {
+            char error_msg[MAX_ERROR_LENGTH];
+            snprintf(error_msg, MAX_ERROR_LENGTH,
+                     "Invalid character: '%c' (ASCII: %d)", (char)next.value, next.value);
+            Error(error_msg);
+            continue;
+        }
+        if (next.code == UNCLOSED_COMMENT)
+        {
+            Error("Unclosed comment");
+            next.code = po;
+        }
+        else if (next.code == NUMBER_TOO_LARGE)
+        {
+            char error_msg[MAX_ERROR_LENGTH];
+            snprintf(error_msg, MAX_ERROR_LENGTH, "Integer literal %.*s is larger than %d", next.length,
+                     source_text + next.offset, INT_MAX);
+            Error(error_msg);
+            next.code = nb;
+        }
+        else if (next.code == id)
+        {
+            // Words are interned here, keeping the lexeme table on the parsing thread
+            next.symbol = internHashedLexeme(source_text + next.offset, next.length, (unsigned)next.value);
+            next.code = lexemes.codes[next.symbol];
+            next.value = 0;
+            if (next.code == id)
+                AddToSymbolesTable(next.symbol);
+        }
+        return next;
+    }
+}
+Token scanToken()
+{
+    Token tempToken;
+    tempToken.code = -1;
+    tempToken.symbol = -1;
+    tempToken.value = 0;
+    char c = SkipWhiteSpace();
+    tempToken.offset = source_position - (c != EOF);
+    tempToken.length = 1;
+    tempToken.line = line_number;
+
+    if (c == EOF)
+    {
+        tempToken.code = -5;
+        tempToken.length = 0;
+        return tempToken;
+    }
+
+    if (isalpha(c))
+    {
+        // The lexeme stays in the source buffer; Next() interns it by this hash
+        // (FNV-1a over the folded spelling, as hashName() computes it for the stored name)
+        unsigned hash = (2166136261u ^ (unsigned char)tolower((unsigned char)c)) * 16777619u;
+        long end = source_position;
+        while (end < source_length && isalnum((unsigned char)source_text[end]))
+        {
+            hash = (hash ^ (unsigned char)tolower((unsigned char)source_text[end])) * 16777619u;
+            end++;
+        }
+        source_position = end;
+        tempToken.length = (int)(end - tempToken.offset);
+        tempToken.code = id;
+        tempToken.value = (int)hash;
+        return tempToken;
+    }
+
+    if (isdigit(c))
+    {
+        unsigned value = 0;
+        int tooLarge = 0;
+        do
+        {
+            tooLarge |= value > (unsigned)(INT_MAX - (c - '0')) / 10;
+            value = value * 10 + (unsigned)(c - '0');
+            c = ReadLetter();
+        } while (isdigit(c));
+        UnreadLetter(c);
+
+        tempToken.code = tooLarge ? NUMBER_TOO_LARGE : nb;
+        tempToken.length = (int)(source_position - tempToken.offset);
+        tempToken.value = (int)value;
+        return tempToken;
+    }
+
+    switch (c)
+    {
+    case ':':
+        if ((c = ReadLetter()) == '=')
+        {
+
+            tempToken.code = aff;
+            tempToken.length = 2;
+        }
+        else
+        {
+            UnreadLetter(c);
+            tempToken.code = dp;
+        }
+        break;
+
+    case '<':
+    case '>':
+    case '=':
+    {
+        char op[3] = {c, '\0', '\0'};
+        if ((c = ReadLetter()) == '=')
+        {
+            op[1] = '=';
+        }
+        else
+        {
+            UnreadLetter(c);
+        }
+        tempToken.code = oprel;
+        tempToken.length = op[1] ? 2 : 1;
+        tempToken.value = getComparisonType(op);
+        break;
+    }
+
+    case '+':
+    case '-':
+    case '*':
+    case '/':
+        tempToken.code = oparith;
+        tempToken.value = c;
+        break;
+
+    case '(':
+        tempToken.code = po;
+        break;
+
+    case ')':
+        tempToken.code = pf;
+        break;
+
+    case ';':
+        tempToken.code = pv;
+        break;
+
+    case '.':
+        tempToken.code = point;
+        break;
+
+    case ',':
+        tempToken.code = virg;
+        break;
+
+    case '[':
+        tempToken.code = co;
+        break;
+
+    case ']':
+        tempToken.code = cf;
+        break;
+
+    default:
+        tempToken.code = LEXICAL_ERROR;
+        tempToken.value = c;
+        return tempToken;
+    }
+    if (c == '(')
+    {
+        char nextChar = ReadLetter();
+        if (nextChar == '*')
+        {
+            char prev = '\0';
+            while ((c = ReadLetter()) != EOF)
+            {
+                if (c == '\n')
+                    line_number++;
+                if (prev == '*' && c == ')')
+                    return scanToken();
+                prev = c;
+            }
+            tempToken.code = UNCLOSED_COMMENT;
+            tempToken.line = line_number;
+            return tempToken;
+        }
+        else
+        {
+            UnreadLetter(nextChar);
+        }
+    }
+
+    return tempToken;
+}
+
+// Lexeme functions implementation//
+void openSource(const char *text, long start, long end)
+{
+    source_text = text;
+    source_position = start;
+    source_length = end;
+}
+int internLexeme(const char *text, int length)
+{
+    // FNV-1a over the folded spelling, as hashName() computes it for the stored name
+    unsigned hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)tolower((unsigned char)text[i]);
+        hash *= 16777619u;
+    }
+    return internHashedLexeme(text, length, hash);
+}
+int internHashedLexeme(const char *text, int length, unsigned hash)
+{
+    if (lexemes.bucketCount == 0)
+    {
+        lexemes.bucketCount = 64;
+        lexemes.buckets = (int *)calloc(lexemes.bucketCount, sizeof(int));
+        for (int i = 0; keywords[i].keyword != NULL; i++)
+        {
+            int symbol = internLexeme(keywords[i].keyword, strlen(keywords[i].keyword));
+            lexemes.codes[symbol] = keywords[i].token_code;
+        }
+    }
+
+    unsigned mask = lexemes.bucketCount - 1;
+    unsigned bucket = hash & mask;
+    while (lexemes.buckets[bucket] != 0)
+    {
+        int symbol = lexemes.buckets[bucket] - 1;
+        const char *name = lexemes.names[symbol];
+        int i = 0;
+        while (i < length && name[i] == tolower((unsigned char)text[i]))
+            i++;
+        if (i == length && name[length] == '\0')
+            return symbol;
+        bucket = (bucket + 1) & mask;
+    }
+
+    if (lexemes.count >= lexemes.capacity)
+    {
+        lexemes.capacity = lexemes.capacity ? lexemes.capacity * 2 : 64;
+        lexemes.names = (char **)realloc(lexemes.names, lexemes.capacity * sizeof(char *));
+        lexemes.codes = (int *)realloc(lexemes.codes, lexemes.capacity * sizeof(int));
+        lexemes.listed = (char *)realloc(lexemes.listed, lexemes.capacity);
+    }
+    int symbol = lexemes.count++;
+    char *name = (char *)malloc(length + 1);
+    for (int i = 0; i < length; i++)
+        name[i] = tolower((unsigned char)text[i]);
+    name[length] = '\0';
+    lexemes.names[symbol] = name;
+    lexemes.codes[symbol] = id;
+    lexemes.listed[symbol] = 0;
+    lexemes.buckets[bucket] = symbol + 1;
+
+    // Keep the load factor under one half
+    if (lexemes.count * 2 > lexemes.bucketCount)
+    {
+        free(lexemes.buckets);
+        lexemes.bucketCount *= 2;
+        lexemes.buckets = (int *)calloc(lexemes.bucketCount, sizeof(int));
+        mask = lexemes.bucketCount - 1;
+        for (int i = 0; i < lexemes.count; i++)
+        {
+            bucket = hashName(lexemes.names[i]) & mask;
+            while (lexemes.buckets[bucket] != 0)
+                bucket = (bucket + 1) & mask;
+            lexemes.buckets[bucket] = i + 1;
+        }
+    }
+    return symbol;
+}
+int findLexeme(const char *text, int length)
+{
+    // As internLexeme() looks it up, without adding it: -1 for a word never scanned
+    if (lexemes.bucketCount == 0)
+        return -1;
+    unsigned hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)tolower((unsigned char)text[i]);
+        hash *= 16777619u;
+    }
+    unsigned mask = lexemes.bucketCount - 1;
+    for (unsigned bucket = hash & mask; lexemes.buckets[bucket] != 0; bucket = (bucket + 1) & mask)
+    {
+        int symbol = lexemes.buckets[bucket] - 1;
+        const char *name = lexemes.names[symbol];
+        int i = 0;
+        while (i < length && name[i] == tolower((unsigned char)text[i]))
+            i++;
+        if (i == length && name[length] == '\0')
+            return symbol;
+    }
+    return -1;
+}
+const char *lexemeName(int symbol)
+{
+    return symbol >= 0 && symbol < lexemes.count ? lexemes.names[symbol] : "";
+}
+void freeLexemes()
+{
+    for (int i = 0; i < lexemes.count; i++)
+        free(lexemes.names[i]);
+    free(lexemes.names);
+    free(lexemes.codes);
+    free(lexemes.listed);
+    free(lexemes.listedOrder);
+    free(lexemes.buckets);
+    memset(&lexemes, 0, sizeof(lexemes));
+}
+
+// Intermediate code functions implementation//
+void initStackCode()
+{
+    code.capacity = 100;
+    code.size = 0;
+    code.labelCount = 0;
+    code.instructions = (Instruction *)malloc(code.capacity * sizeof(Instruction));
+    code.variableCapacity = 16;
+    code.variableCount = 0;
+    code.variables = (char **)malloc(code.variableCapacity * sizeof(char *));
+    code.variableBucketCount = 32;
+    code.variableBuckets = (int *)calloc(code.variableBucketCount, sizeof(int));
+    code.symbolSlots = NULL;
+    code.symbolSlotCapacity = 0;
+    code.stackDepth = 0;
+    code.maxStackDepth = 0;
+    code.verified = 0;
+    code.linked = 0;
+    code.labels = NULL;
+    code.labelTableSize = 0;
+    code.line = 0;
+    code.temporaryCount = 0;
+    code.layoutHash = 0;
+    code.layoutBlocks = 0;
+}
+int newStackLabel()
+{
+    return ++code.labelCount;
+}
+void emitStack(InstructionType type, const char *operand)
+{
+    if (type == VALUE || type == STORE || type == READ)
+    {
+        emitStackSlot(type, internStackVariable(operand));
+        return;
+    }
+    if (code.size >= code.capacity)
+    {
+        code.capacity *= 2;
+        code.instructions = (Instruction *)realloc(code.instructions,
+                                                   code.capacity * sizeof(Instruction));
+    }
+
+    code.instructions[code.size].type = type;
+    code.instructions[code.size].label = -1;
+    code.instructions[code.size].arg = type == PUSH && operand != NULL ? atoi(operand) : -1;
+    code.instructions[code.size].arg2 = -1;
+    code.instructions[code.size].arg3 = -1;
+    code.instructions[code.size].length = 0;
+    code.instructions[code.size].line = code.line;
+    code.instructions[code.size].block = -1;
+    code.size++;
+
+    code.verified = 0;
+    code.stackDepth += stackEffect(type);
+    if (code.stackDepth > code.maxStackDepth)
+        code.maxStackDepth = code.stackDepth;
+}
+void emitStackSlot(InstructionType type, int slot)
+{
+    // VALUE, STORE and READ: the slot is all there is, the listing prints its name
+    if (code.size >= code.capacity)
+    {
+        code.capacity *= 2;
+        code.instructions = (Instruction *)realloc(code.instructions,
+                                                   code.capacity * sizeof(Instruction));
+    }
+
+    Instruction *instr = &code.instructions[code.size++];
+    instr->type = type;
+    instr->label = -1;
+    instr->arg = slot;
+    instr->arg2 = -1;
+    instr->arg3 = -1;
+    instr->length = 0;
+    instr->line = code.line;
+    instr->block = -1;
+
+    code.verified = 0;
+    code.stackDepth += stackEffect(type);
+    if (code.stackDepth > code.maxStackDepth)
+        code.maxStackDepth = code.stackDepth;
+}
+void emitStackLabel(InstructionType type, int label)
+{
+    // LABEL and the jumps: the label is a number, as newStackLabel() hands them out
+    emitStack(type, NULL);
+    code.instructions[code.size - 1].label = label;
+}
+int symbolSlot(int symbol)
+{
+    // The parser names variables by their interned lexeme: no string to copy or hash again
+    if (symbol >= code.symbolSlotCapacity)
+    {
+        int capacity = code.symbolSlotCapacity ? code.symbolSlotCapacity : 64;
+        while (capacity <= symbol)
+            capacity *= 2;
+        code.symbolSlots = (int *)realloc(code.symbolSlots, capacity * sizeof(int));
+        memset(code.symbolSlots + code.symbolSlotCapacity, 0, (capacity - code.symbolSlotCapacity) * sizeof(int));
+        code.symbolSlotCapacity = capacity;
+    }
+    if (code.symbolSlots[symbol] == 0)
+        code.symbolSlots[symbol] = internStackVariable(lexemeName(symbol)) + 1;
+    return code.symbolSlots[symbol] - 1;
+}
+void printStackCode()
+{
+    char buffer[64];
+
+    printListingHeader();
+
+    int cursor = 0;
+    for (int i = 0; i <= code.size; i++)
+    {
+        // Labels stripped by the linker are printed from the side table
+        int label;
+        while (code.linked && (label = labelAt(i, &cursor)) >= 0)
+        {
+            if (i < code.size && code.instructions[i].type == LABEL)
+                continue;
+            snprintf(buffer, sizeof(buffer), "L%d:", label);
+            printf("| %-29s |\n", buffer);
+        }
+        if (i == code.size)
+            break;
+        formatInstruction(&code.instructions[i], buffer, sizeof(buffer));
+        printf("| %-29s |\n", buffer);
+    }
+
+    // Print footer
+    printf("+-------------------------------+\n");
+    printf("| Total Instructions: %-9d |\n", code.size);
+    printf("| Max Stack Depth: %-12d |\n", code.maxStackDepth);
+    printf("+-------------------------------+\n\n");
+}
+void printListingHeader()
+{
+    // Print header with nice formatting
+    printf("\n+-------------------------------+\n");
+    printf("|     Stack-Based Instructions  |\n");
+    printf("+-------------------------------+\n");
+    printf("| %-29s |\n", "Instruction");
+    printf("+-------------------------------+\n");
+}
+const char *instructionName(InstructionType type)
+{
+    switch (type)
+    {
+    case PUSH:
+        return "PUSH";
+    case VALUE:
+        return "VALUE";
+    case STORE:
+        return "STORE";
+    case ADD:
+        return "ADD";
+    case SUB:
+        return "SUB";
+    case MUL:
+        return "MUL";
+    case DIV:
+        return "DIV";
+    case ASSIGN:
+        return "ASSIGN";
+    case SWAP:
+        return "SWAP";
+    case COMP_LT:
+        return "COMP_LT";
+    case COMP_GT:
+        return "COMP_GT";
+    case COMP_LE:
+        return "COMP_LE";
+    case COMP_GE:
+        return "COMP_GE";
+    case COMP_EQ:
+        return "COMP_EQ";
+    case COMP_NE:
+        return "COMP_NE";
+    case GO_FALSE:
+        return "GO_FALSE";
+    case GO_TRUE:
+        return "GO_TRUE";
+    case GOTO:
+        return "GOTO";
+    case LABEL:
+        return "LABEL";
+    case READ:
+        return "READ";
+    case WRITE:
+        return "WRITE";
+    case VALUE_AT:
+        return "VALUE_AT";
+    case ASSIGN_AT:
+        return "ASSIGN_AT";
+    case ARRAY_ADD:
+        return "ARRAY_ADD";
+    case ARRAY_SUB:
+        return "ARRAY_SUB";
+    case ARRAY_MUL:
+        return "ARRAY_MUL";
+    case SELECT:
+        return "SELECT";
+    case VADD:
+        return "VADD";
+    case VSUB:
+        return "VSUB";
+    case VMUL:
+        return "VMUL";
+    case GO_FALSE_LT:
+        return "GO_FALSE_LT";
+    case GO_FALSE_GT:
+        return "GO_FALSE_GT";
+    case GO_FALSE_LE:
+        return "GO_FALSE_LE";
+    case GO_FALSE_GE:
+        return "GO_FALSE_GE";
+    case GO_FALSE_EQ:
+        return "GO_FALSE_EQ";
+    case GO_FALSE_NE:
+        return "GO_FALSE_NE";
+    case VALUE2_ADD:
+        return "VALUE2_ADD";
+    case VALUE2_SUB:
+        return "VALUE2_SUB";
+    case VALUE2_MUL:
+        return "VALUE2_MUL";
+    case PUSH_ADD:
+        return "PUSH_ADD";
+    case PUSH_SUB:
+        return "PUSH_SUB";
+    case PUSH_MUL:
+        return "PUSH_MUL";
+    case ASSIGN_TO:
+        return "ASSIGN_TO";
+    case ASSIGN_CONST:
+        return "ASSIGN_CONST";
+    case ASSIGN_VALUE:
+        return "ASSIGN_VALUE";
+    case WRITE_VALUE:
+        return "WRITE_VALUE";
+    default:
+        return "UNKNOWN";
+    }
+}
+void formatInstruction(const Instruction *instr, char *buffer, size_t size)
+{
+    formatInstructionNames(instr, code.variables, code.variableCount, code.linked, buffer, size);
+}
+void formatInstructionNames(const Instruction *instr, char *const *names, int nameCount, int linked,
+                            char *buffer, size_t size)
+{
+    // The slot names are passed in for the pipeline writer, which keeps its own copy
+    const char *slot = instr->arg >= 0 && instr->arg < nameCount ? names[instr->arg] : "?";
+    const char *slot2 = instr->arg2 >= 0 && instr->arg2 < nameCount ? names[instr->arg2] : "?";
+    const char *slot3 = instr->arg3 >= 0 && instr->arg3 < nameCount ? names[instr->arg3] : "?";
+    // Arrays are printed by name: a[0] names the first slot
+    int array = (int)strcspn(slot, "["), array2 = (int)strcspn(slot2, "["), array3 = (int)strcspn(slot3, "[");
+    char target[16] = "";
+    if (linked && isJumpInstruction(instr->type))
+        snprintf(target, sizeof(target), " (@%d)", instr->arg);
+
+    switch (instr->type)
+    {
+    // Value operations
+    case PUSH:
+        snprintf(buffer, size, "push %d", instr->arg);
+        break;
+    case VALUE:
+        snprintf(buffer, size, "value %s", slot);
+        break;
+    case STORE:
+        snprintf(buffer, size, "store %s", slot);
+        break;
+
+    // Arithmetic operators
+    case ADD:
+        snprintf(buffer, size, "+");
+        break;
+    case SUB:
+        snprintf(buffer, size, "-");
+        break;
+    case MUL:
+        snprintf(buffer, size, "*");
+        break;
+    case DIV:
+        snprintf(buffer, size, "/");
+        break;
+    case ASSIGN:
+        snprintf(buffer, size, ":=");
+        break;
+    case SWAP:
+        snprintf(buffer, size, "swap");
+        break;
+
+    // Comparison operators
+    case COMP_LT:
+    case COMP_GT:
+    case COMP_LE:
+    case COMP_GE:
+    case COMP_EQ:
+    case COMP_NE:
+        snprintf(buffer, size, "%s", instructionName(instr->type));
+        break;
+
+    // Control flow
+    case GO_FALSE:
+        snprintf(buffer, size, "go_false L%d%s", instr->label, target);
+        break;
+    case GO_TRUE:
+        snprintf(buffer, size, "go_true L%d%s", instr->label, target);
+        break;
+    case GOTO:
+        snprintf(buffer, size, "goto L%d%s", instr->label, target);
+        break;
+    case LABEL:
+        snprintf(buffer, size, "L%d:", instr->label);
+        break;
+
+    // I/O operations
+    case READ:
+        snprintf(buffer, size, "read %s", slot);
+        break;
+    case WRITE:
+        snprintf(buffer, size, "write");
+        break;
+    case SELECT:
+        snprintf(buffer, size, "select");
+        break;
+
+    // Array operations
+    case VALUE_AT:
+        snprintf(buffer, size, "value_at %.*s", array, slot);
+        break;
+    case ASSIGN_AT:
+        snprintf(buffer, size, "assign_at %.*s", array, slot);
+        break;
+    case ARRAY_ADD:
+        snprintf(buffer, size, "array %.*s := %.*s + %.*s", array, slot, array2, slot2, array3, slot3);
+        break;
+    case ARRAY_SUB:
+        snprintf(buffer, size, "array %.*s := %.*s - %.*s", array, slot, array2, slot2, array3, slot3);
+        break;
+    case ARRAY_MUL:
+        snprintf(buffer, size, "array %.*s := %.*s * %.*s", array, slot, array2, slot2, array3, slot3);
+        break;
+
+    // Vector operations, on the VECTOR_WIDTH slots starting at each name
+    case VADD:
+        snprintf(buffer, size, "vadd%d %s := %s + %s", VECTOR_WIDTH, slot, slot2, slot3);
+        break;
+    case VSUB:
+        snprintf(buffer, size, "vsub%d %s := %s - %s", VECTOR_WIDTH, slot, slot2, slot3);
+        break;
+    case VMUL:
+        snprintf(buffer, size, "vmul%d %s := %s * %s", VECTOR_WIDTH, slot, slot2, slot3);
+        break;
+
+    // Superinstructions
+    case GO_FALSE_LT:
+        snprintf(buffer, size, "go_false_lt L%d%s", instr->label, target);
+        break;
+    case GO_FALSE_GT:
+        snprintf(buffer, size, "go_false_gt L%d%s", instr->label, target);
+        break;
+    case GO_FALSE_LE:
+        snprintf(buffer, size, "go_false_le L%d%s", instr->label, target);
+        break;
+    case GO_FALSE_GE:
+        snprintf(buffer, size, "go_false_ge L%d%s", instr->label, target);
+        break;
+    case GO_FALSE_EQ:
+        snprintf(buffer, size, "go_false_eq L%d%s", instr->label, target);
+        break;
+    case GO_FALSE_NE:
+        snprintf(buffer, size, "go_false_ne L%d%s", instr->label, target);
+        break;
+    case VALUE2_ADD:
+        snprintf(buffer, size, "value2 %s + %s", slot, slot2);
+        break;
+    case VALUE2_SUB:
+        snprintf(buffer, size, "value2 %s - %s", slot, slot2);
+        break;
+    case VALUE2_MUL:
+        snprintf(buffer, size, "value2 %s * %s", slot, slot2);
+        break;
+    case PUSH_ADD:
+        snprintf(buffer, size, "push_add %d", instr->arg);
+        break;
+    case PUSH_SUB:
+        snprintf(buffer, size, "push_sub %d", instr->arg);
+        break;
+    case PUSH_MUL:
+        snprintf(buffer, size, "push_mul %d", instr->arg);
+        break;
+    case ASSIGN_TO:
+        snprintf(buffer, size, "assign_to %s", slot);
+        break;
+    case ASSIGN_CONST:
+        snprintf(buffer, size, "assign_const %s, %d", slot, instr->arg2);
+        break;
+    case ASSIGN_VALUE:
+        snprintf(buffer, size, "assign_value %s, %s", slot, slot2);
+        break;
+    case WRITE_VALUE:
+        snprintf(buffer, size, "write_value %s", slot);
+        break;
+
+    default:
+        snprintf(buffer, size, "unknown instruction");
+    }
+}
+int instructionUses(const Instruction *instr, int uses[MAX_INSTRUCTION_USES])
+{
+    switch (instr->type)
+    {
+    case VALUE:
+    case WRITE_VALUE:
+        uses[0] = instr->arg;
+        return 1;
+    case ASSIGN_VALUE:
+        uses[0] = instr->arg2;
+        return 1;
+    case VALUE2_ADD:
+    case VALUE2_SUB:
+    case VALUE2_MUL:
+        uses[0] = instr->arg;
+        uses[1] = instr->arg2;
+        return 2;
+    case VADD:
+    case VSUB:
+    case VMUL:
+        for (int k = 0; k < VECTOR_WIDTH; k++)
+        {
+            uses[k] = instr->arg2 + k;
+            uses[VECTOR_WIDTH + k] = instr->arg3 + k;
+        }
+        return 2 * VECTOR_WIDTH;
+    default:
+        return 0;
+    }
+}
+Instruction *cutInstructions(int start, int *count)
+{
+    // Removes [start, size) and hands it back, to be re-appended elsewhere
+    *count = code.size - start;
+    Instruction *cut = (Instruction *)malloc((*count + 1) * sizeof(Instruction));
+    memcpy(cut, code.instructions + start, *count * sizeof(Instruction));
+    for (int i = 0; i < *count; i++)
+        code.stackDepth -= stackEffect(cut[i].type);
+    code.size = start;
+    code.verified = 0;
+    return cut;
+}
+void appendInstructions(const Instruction *instructions, int count)
+{
+    while (code.size + count > code.capacity)
+    {
+        code.capacity *= 2;
+        code.instructions = (Instruction *)realloc(code.instructions,
+                                                   code.capacity * sizeof(Instruction));
+    }
+    for (int i = 0; i < count; i++)
+    {
+        code.instructions[code.size++] = instructions[i];
+        code.stackDepth += stackEffect(instructions[i].type);
+        if (code.stackDepth > code.maxStackDepth)
+            code.maxStackDepth = code.stackDepth;
+    }
+    code.verified = 0;
+}
+void newStackTemporary(char *name, size_t size)
+{
+    // '$' cannot start an identifier, so temporaries never clash with user variables
+    snprintf(name, size, "$t%d", ++code.temporaryCount);
+}
+void generateAssignment(const char *target, const char *arg1, const char *arg2)
+{
+    emitStack(VALUE, arg1);
+    emitStack(VALUE, arg2);
+    emitStack(ADD, NULL);
+    emitStack(STORE, target);
+}
+void generateIfStatement(const char *condition_var, const char *constant,
+                         const char *write_var)
+{
+    int endLabel = newStackLabel();
+
+    emitStack(VALUE, condition_var);
+    emitStack(PUSH, constant);
+    emitStack(COMP_GT, NULL);
+    emitStackLabel(GO_FALSE, endLabel);
+    emitStack(VALUE, write_var);
+    emitStack(WRITE, NULL);
+    emitStackLabel(LABEL, endLabel);
+}
+void cleanupStackCode()
+{
+    free(code.instructions);
+    code.instructions = NULL;
+    code.size = 0;
+    code.capacity = 0;
+    code.labelCount = 0;
+
+    for (int i = 0; i < code.variableCount; i++)
+    {
+        free(code.variables[i]);
+    }
+    free(code.variables);
+    free(code.variableBuckets);
+    free(code.symbolSlots);
+    code.variables = NULL;
+    code.variableBuckets = NULL;
+    code.symbolSlots = NULL;
+    code.symbolSlotCapacity = 0;
+    code.variableCount = 0;
+    code.variableCapacity = 0;
+    code.variableBucketCount = 0;
+    code.stackDepth = 0;
+    code.maxStackDepth = 0;
+    code.verified = 0;
+    code.linked = 0;
+    free(code.labels);
+    code.labels = NULL;
+    code.labelTableSize = 0;
+    code.layoutHash = 0;
+    code.layoutBlocks = 0;
+    freeExprArena();
+    freeAnalyses();
+}
+unsigned hashName(const char *name)
+{
+    // FNV-1a
+    unsigned hash = 2166136261u;
+    while (*name)
+    {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+int internStackVariable(const char *name)
+{
+    unsigned mask = code.variableBucketCount - 1;
+    unsigned bucket = hashName(name) & mask;
+    while (code.variableBuckets[bucket] != 0)
+    {
+        int slot = code.variableBuckets[bucket] - 1;
+        if (strcmp(code.variables[slot], name) == 0)
+        {
+            return slot;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+
+    if (code.variableCount >= code.variableCapacity)
+    {
+        code.variableCapacity *= 2;
+        code.variables = (char **)realloc(code.variables, code.variableCapacity * sizeof(char *));
+    }
+    int slot = code.variableCount++;
+    code.variables[slot] = strdup(name);
+    code.variableBuckets[bucket] = slot + 1;
+
+    // Keep the load factor under one half
+    if (code.variableCount * 2 > code.variableBucketCount)
+    {
+        free(code.variableBuckets);
+        code.variableBucketCount *= 2;
+        code.variableBuckets = (int *)calloc(code.variableBucketCount, sizeof(int));
+        mask = code.variableBucketCount - 1;
+        for (int i = 0; i < code.variableCount; i++)
+        {
+            bucket = hashName(code.variables[i]) & mask;
+            while (code.variableBuckets[bucket] != 0)
+                bucket = (bucket + 1) & mask;
+            code.variableBuckets[bucket] = i + 1;
+        }
+    }
+    return slot;
+}
+int internStackArray(const char *name, int length)
+{
+    // The elements are the slots a[0], a[1]...: interned together, so that they follow one another.
+    // Identifiers have no length limit, so the names are built in a buffer sized for this one.
+    size_t size = strlen(name) + 16;
+    char *element = (char *)malloc(size);
+    snprintf(element, size, "%s[0]", name);
+    int first = code.variableCount;
+    int slot = internStackVariable(element);
+    for (int k = 1; slot == first && k < length; k++)
+    {
+        snprintf(element, size, "%s[%d]", name, k);
+        internStackVariable(element);
+    }
+    free(element);
+    return slot;
+}
+int isArraySlot(int slot)
+{
+    return strchr(code.variables[slot], '[') != NULL;
+}
+void emitArray(InstructionType type, const char *target, const char *left, const char *right)
+{
+    // Arrays are named by their first slot; the length is the declared one
+    const identifierEntry *entry = lookupidentifier(target);
+    int length = entry != NULL && entry->length > 0 ? entry->length : 1;
+    emitStack(type, target);
+    Instruction *instr = &code.instructions[code.size - 1];
+    instr->arg = internStackArray(target, length);
+    if (left != NULL)
+        instr->arg2 = internStackArray(left, length);
+    if (right != NULL)
+        instr->arg3 = internStackArray(right, length);
+    instr->length = length;
+}
+
+int stackEffect(InstructionType type)
+{
+    switch (type)
+    {
+    case PUSH:
+    case VALUE:
+    case STORE:
+    case VALUE2_ADD:
+    case VALUE2_SUB:
+    case VALUE2_MUL:
+        return 1;
+    case GO_FALSE_LT:
+    case GO_FALSE_GT:
+    case GO_FALSE_LE:
+    case GO_FALSE_GE:
+    case GO_FALSE_EQ:
+    case GO_FALSE_NE:
+        return -2;
+    case ASSIGN_TO:
+        return -1;
+    case ADD:
+    case SUB:
+    case MUL:
+    case DIV:
+    case COMP_LT:
+    case COMP_GT:
+    case COMP_LE:
+    case COMP_GE:
+    case COMP_EQ:
+    case COMP_NE:
+    case GO_FALSE:
+    case GO_TRUE:
+    case WRITE:
+        return -1;
+    case ASSIGN:
+    case ASSIGN_AT:
+    case SELECT:
+        return -2;
+    default:
+        return 0;
+    }
+}
+
+// Expression tree functions implementation//
+void resetExprArena()
+{
+    exprArena.size = 0;
+}
+void freeExprArena()
+{
+    free(exprArena.nodes);
+    memset(&exprArena, 0, sizeof(exprArena));
+}
+int newExprLeaf(ExprKind kind, int name)
+{
+    int node = newExprNode(ADD, -1, -1);
+    exprArena.nodes[node].kind = kind;
+    exprArena.nodes[node].name = name;
+    exprArena.nodes[node].need = 1;
+    return node;
+}
+int newExprNode(InstructionType op, int left, int right)
+{
+    if (exprArena.size >= exprArena.capacity)
+    {
+        exprArena.capacity = exprArena.capacity ? exprArena.capacity * 2 : 64;
+        exprArena.nodes = (ExprNode *)realloc(exprArena.nodes, exprArena.capacity * sizeof(ExprNode));
+    }
+
+    int leftNeed = left >= 0 ? exprArena.nodes[left].need : 0;
+    int rightNeed = right >= 0 ? exprArena.nodes[right].need : 0;
+    ExprNode *node = &exprArena.nodes[exprArena.size];
+    node->kind = EXPR_BINARY;
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    node->name = -1;
+    node->need = leftNeed == rightNeed ? leftNeed + 1 : (leftNeed > rightNeed ? leftNeed : rightNeed);
+    return exprArena.size++;
+}
+int newExprIndex(int name, int index)
+{
+    // The element takes the place of its index on the stack, so it needs no more room
+    int node = newExprNode(ADD, index, -1);
+    exprArena.nodes[node].kind = EXPR_INDEX;
+    exprArena.nodes[node].name = name;
+    exprArena.nodes[node].need = index >= 0 ? exprArena.nodes[index].need : 1;
+    return node;
+}
+int constantExpression(int node, int *value)
+{
+    // Numbers and arithmetic on them, as the interpreter computes it; a division by zero is not folded
+    if (node < 0)
+        return 0;
+    const ExprNode *expr = &exprArena.nodes[node];
+    int left, right;
+    switch (expr->kind)
+    {
+    case EXPR_NUMBER:
+        *value = expr->name;
+        return 1;
+    case EXPR_BINARY:
+        if (!constantExpression(expr->left, &left) || !constantExpression(expr->right, &right) ||
+            (expr->op == DIV && right == 0))
+            return 0;
+        *value = foldOperation(expr->op, left, right);
+        return 1;
+    default:
+        return 0;
+    }
+}
+InstructionType arithmeticType(char op)
+{
+    switch (op)
+    {
+    case '-':
+        return SUB;
+    case '*':
+        return MUL;
+    case '/':
+        return DIV;
+    default:
+        return ADD;
+    }
+}
+InstructionType mirrorComparison(InstructionType op)
+{
+    switch (op)
+    {
+    case COMP_LT:
+        return COMP_GT;
+    case COMP_GT:
+        return COMP_LT;
+    case COMP_LE:
+        return COMP_GE;
+    case COMP_GE:
+        return COMP_LE;
+    default:
+        return op;
+    }
+}
+InstructionType negateComparison(InstructionType op)
+{
+    switch (op)
+    {
+    case COMP_LT:
+        return COMP_GE;
+    case COMP_GE:
+        return COMP_LT;
+    case COMP_GT:
+        return COMP_LE;
+    case COMP_LE:
+        return COMP_GT;
+    case COMP_EQ:
+        return COMP_NE;
+    case COMP_NE:
+        return COMP_EQ;
+    default:
+        return op;
+    }
+}
+void emitExpression(int index)
+{
+    if (index < 0)
+        return;
+
+    ExprNode node = exprArena.nodes[index];
+    switch (node.kind)
+    {
+    case EXPR_VARIABLE:
+        emitStackSlot(VALUE, symbolSlot(node.name));
+        break;
+    case EXPR_NUMBER:
+    {
+        char digits[16];
+        digits[formatInteger(digits, node.name) - 1] = '\0'; // drop its newline
+        emitStack(PUSH, digits);
+        break;
+    }
+    case EXPR_INDEX:
+        emitExpression(node.left);
+        emitArray(VALUE_AT, lexemeName(node.name), NULL, NULL);
+        break;
+    case EXPR_BINARY:
+    {
+        int leftNeed = node.left >= 0 ? exprArena.nodes[node.left].need : 0;
+        int rightNeed = node.right >= 0 ? exprArena.nodes[node.right].need : 0;
+        if (rightNeed <= leftNeed)
+        {
+            emitExpression(node.left);
+            emitExpression(node.right);
+            emitStack(node.op, NULL);
+            break;
+        }
+
+        // Deeper subtree first, then fix up the operand order
+        emitExpression(node.right);
+        emitExpression(node.left);
+        if (node.op == SUB || node.op == DIV)
+        {
+            emitStack(SWAP, NULL);
+            emitStack(node.op, NULL);
+        }
+        else
+        {
+            emitStack(mirrorComparison(node.op), NULL);
+        }
+        break;
+    }
+    }
+}
+
+// Control flow graph functions implementation//
+int isJumpInstruction(InstructionType type)
+{
+    return type == GOTO || type == GO_FALSE || type == GO_TRUE ||
+           (type >= GO_FALSE_LT && type <= GO_FALSE_NE);
+}
+int buildControlFlowGraph(ControlFlowGraph *cfg)
+{
+    int n = code.size;
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->blockOf = (int *)malloc((n + 1) * sizeof(int));
+    cfg->defSlot = (int *)malloc((n + 1) * sizeof(int));
+
+    LabelIndex labels;
+    buildLabelIndex(&labels);
+
+    // Linked code may have no LABELs left: its jump targets start blocks instead
+    char *isTarget = (char *)calloc(n + 1, 1);
+    for (int i = 0; code.linked && i < n; i++)
+    {
+        if (isJumpInstruction(code.instructions[i].type) && code.instructions[i].arg >= 0 &&
+            code.instructions[i].arg <= n)
+            isTarget[code.instructions[i].arg] = 1;
+    }
+
+    // Leaders: first instruction, first of a run of labels, instruction after a jump
+    int blockCount = 0;
+    for (int i = 0; i < n; i++)
+    {
+        InstructionType type = code.instructions[i].type;
+        if (i == 0 || isJumpInstruction(code.instructions[i - 1].type) || isTarget[i] ||
+            (type == LABEL && code.instructions[i - 1].type != LABEL))
+        {
+            blockCount++;
+        }
+        cfg->blockOf[i] = blockCount - 1;
+    }
+    free(isTarget);
+    cfg->blockCount = blockCount;
+    cfg->blocks = (BasicBlock *)malloc((blockCount + 1) * sizeof(BasicBlock));
+    for (int i = 0; i < n; i++)
+    {
+        BasicBlock *block = &cfg->blocks[cfg->blockOf[i]];
+        if (i == 0 || cfg->blockOf[i - 1] != cfg->blockOf[i])
+            block->start = i;
+        block->end = i + 1;
+    }
+
+    // Successors
+    int status = 0;
+    int *predCount = (int *)calloc(blockCount + 1, sizeof(int));
+    for (int b = 0; b < blockCount; b++)
+    {
+        BasicBlock *block = &cfg->blocks[b];
+        Instruction *last = &code.instructions[block->end - 1];
+        int edges = 0;
+        block->succ[0] = block->succ[1] = -1;
+
+        if (last->type != GOTO && b + 1 < blockCount)
+            block->succ[edges++] = b + 1;
+        if (isJumpInstruction(last->type))
+        {
+            int target = jumpTargetPosition(last, &labels);
+            if (target < 0)
+            {
+                fprintf(stderr, "CFG Error: jump to undefined label 'L%d'\n", last->label);
+                status = -1;
+            }
+            else if (target == n)
+            {
+                // Jump to the end of the program: no successor block
+            }
+            else if (edges == 0 || block->succ[0] != cfg->blockOf[target])
+            {
+                block->succ[edges++] = cfg->blockOf[target];
+            }
+        }
+        for (int e = 0; e < edges; e++)
+            predCount[block->succ[e]]++;
+    }
+    freeLabelIndex(&labels);
+
+    // Predecessors, laid out contiguously per block
+    int offset = 0;
+    for (int b = 0; b < blockCount; b++)
+    {
+        cfg->blocks[b].predStart = offset;
+        cfg->blocks[b].predCount = 0;
+        offset += predCount[b];
+    }
+    cfg->preds = (int *)malloc((offset + 1) * sizeof(int));
+    for (int b = 0; b < blockCount; b++)
+    {
+        for (int e = 0; e < 2 && cfg->blocks[b].succ[e] >= 0; e++)
+        {
+            BasicBlock *succ = &cfg->blocks[cfg->blocks[b].succ[e]];
+            cfg->preds[succ->predStart + succ->predCount++] = b;
+        }
+    }
+    free(predCount);
+
+    // Def sites: ASSIGN completes the STORE it matches, READ defines directly
+    int variableCount = code.variableCount;
+    int *pending = (int *)malloc((n + 1) * sizeof(int));
+    int pendingCount = 0;
+    cfg->variableCount = variableCount;
+    cfg->defStart = (int *)calloc(variableCount + 1, sizeof(int));
+    cfg->useStart = (int *)calloc(variableCount + 1, sizeof(int));
+    for (int i = 0; i < n; i++)
+    {
+        Instruction *instr = &code.instructions[i];
+        cfg->defSlot[i] = -1;
+        switch (instr->type)
+        {
+        case STORE:
+            pending[pendingCount++] = instr->arg;
+            break;
+        case ASSIGN:
+            if (pendingCount > 0)
+                cfg->defSlot[i] = pending[--pendingCount];
+            break;
+        case READ:
+        case ASSIGN_TO:
+        case ASSIGN_CONST:
+        case ASSIGN_VALUE:
+            cfg->defSlot[i] = instr->arg;
+            break;
+        default:
+            break;
+        }
+        if (cfg->defSlot[i] >= 0)
+            cfg->defStart[cfg->defSlot[i] + 1]++;
+        int uses[MAX_INSTRUCTION_USES];
+        for (int u = instructionUses(instr, uses) - 1; u >= 0; u--)
+            cfg->useStart[uses[u] + 1]++;
+    }
+    free(pending);
+
+    for (int v = 0; v < variableCount; v++)
+    {
+        cfg->defStart[v + 1] += cfg->defStart[v];
+        cfg->useStart[v + 1] += cfg->useStart[v];
+    }
+    cfg->defs = (int *)malloc((cfg->defStart[variableCount] + 1) * sizeof(int));
+    cfg->uses = (int *)malloc((cfg->useStart[variableCount] + 1) * sizeof(int));
+    int *defFill = (int *)malloc((variableCount + 1) * sizeof(int));
+    int *useFill = (int *)malloc((variableCount + 1) * sizeof(int));
+    memcpy(defFill, cfg->defStart, (variableCount + 1) * sizeof(int));
+    memcpy(useFill, cfg->useStart, (variableCount + 1) * sizeof(int));
+    for (int i = 0; i < n; i++)
+    {
+        int uses[MAX_INSTRUCTION_USES];
+        if (cfg->defSlot[i] >= 0)
+            cfg->defs[defFill[cfg->defSlot[i]]++] = i;
+        for (int u = instructionUses(&code.instructions[i], uses) - 1; u >= 0; u--)
+            cfg->uses[useFill[uses[u]]++] = i;
+    }
+    free(defFill);
+    free(useFill);
+
+    if (status != 0)
+        freeControlFlowGraph(cfg);
+    return status;
+}
+void freeControlFlowGraph(ControlFlowGraph *cfg)
+{
+    free(cfg->blocks);
+    free(cfg->preds);
+    free(cfg->blockOf);
+    free(cfg->defSlot);
+    free(cfg->defStart);
+    free(cfg->defs);
+    free(cfg->useStart);
+    free(cfg->uses);
+    memset(cfg, 0, sizeof(*cfg));
+}
+void printControlFlowGraph(const ControlFlowGraph *cfg)
+{
+    DataflowProblem liveness;
+    computeLiveness(&liveness, cfg);
+
+    printf("\n+-----------------------------------------------------------------+\n");
+    printf("| Control Flow Graph: %-6d blocks                                |\n", cfg->blockCount);
+    printf("+-----------------------------------------------------------------+\n");
+    for (int b = 0; b < cfg->blockCount; b++)
+    {
+        const BasicBlock *block = &cfg->blocks[b];
+        printf("B%d [%d..%d]", b, block->start, block->end - 1);
+        if (code.instructions[block->start].type == LABEL)
+            printf(" L%d:", code.instructions[block->start].label);
+        printf("\n    preds:");
+        for (int p = 0; p < block->predCount; p++)
+            printf(" B%d", cfg->preds[block->predStart + p]);
+        printf("\n    succs:");
+        for (int e = 0; e < 2 && block->succ[e] >= 0; e++)
+            printf(" B%d", block->succ[e]);
+        printf("\n    live in:");
+        BitWord *in = dataflowSet(liveness.in, &liveness, b);
+        for (int v = 0; v < cfg->variableCount; v++)
+        {
+            if (bitsetContains(in, v))
+                printf(" %s", code.variables[v]);
+        }
+        printf("\n");
+    }
+
+    printf("+-----------------------------------------------------------------+\n");
+    printf("| %-20s | %-20s | %-17s |\n", "Variable", "Defs", "Uses");
+    printf("+-----------------------------------------------------------------+\n");
+    for (int v = 0; v < cfg->variableCount; v++)
+    {
+        printf("| %-20s | %-20d | %-17d |\n", code.variables[v],
+               cfg->defStart[v + 1] - cfg->defStart[v],
+               cfg->useStart[v + 1] - cfg->useStart[v]);
+    }
+    printf("+-----------------------------------------------------------------+\n");
+    freeDataflow(&liveness);
+}
+
+// Label index functions implementation//
+void buildLabelIndex(LabelIndex *index)
+{
+    buildLabelRange(index, 0);
+}
+void buildLabelRange(LabelIndex *index, int start)
+{
+    // Only the labels defined in [start, size)
+    index->count = 0;
+    index->duplicate = -1;
+    for (int i = start; i < code.size; i++)
+    {
+        if (code.instructions[i].type == LABEL)
+            index->count++;
+    }
+
+    unsigned bucketCount = 16;
+    while (bucketCount < (unsigned)index->count * 2)
+        bucketCount *= 2;
+    index->mask = bucketCount - 1;
+    index->buckets = (int *)calloc(bucketCount, sizeof(int));
+    index->capacity = index->count + 1;
+    index->positions = (int *)malloc(index->capacity * sizeof(int));
+
+    int ordinal = 0;
+    for (int i = start; i < code.size; i++)
+    {
+        if (code.instructions[i].type != LABEL)
+            continue;
+        if (findLabel(index, code.instructions[i].label) >= 0)
+        {
+            if (index->duplicate < 0)
+                index->duplicate = i;
+            continue;
+        }
+        unsigned bucket = hashLabel(code.instructions[i].label) & index->mask;
+        while (index->buckets[bucket] != 0)
+            bucket = (bucket + 1) & index->mask;
+        index->positions[ordinal] = i;
+        index->buckets[bucket] = ++ordinal;
+    }
+    index->count = ordinal;
+}
+int findLabel(const LabelIndex *index, int label)
+{
+    unsigned bucket = hashLabel(label) & index->mask;
+    while (index->buckets[bucket] != 0)
+    {
+        int ordinal = index->buckets[bucket] - 1;
+        if (code.instructions[index->positions[ordinal]].label == label)
+            return ordinal;
+        bucket = (bucket + 1) & index->mask;
+    }
+    return -1;
+}
+int addLabel(LabelIndex *index, int position)
+{
+    // The label defined at position, for an index kept up to date while code is
+    // appended; as in buildLabelRange() the first definition of a label stays
+    int label = code.instructions[position].label;
+    int ordinal = findLabel(index, label);
+    if (ordinal >= 0)
+    {
+        if (index->duplicate < 0)
+            index->duplicate = position;
+        return ordinal;
+    }
+    if (index->count + 1 > index->capacity)
+    {
+        index->capacity *= 2;
+        index->positions = (int *)realloc(index->positions, index->capacity * sizeof(int));
+    }
+    if ((unsigned)(index->count + 1) * 2 > index->mask + 1)
+    {
+        free(index->buckets);
+        index->mask = index->mask * 2 + 1;
+        index->buckets = (int *)calloc(index->mask + 1, sizeof(int));
+        for (int i = 0; i < index->count; i++)
+        {
+            unsigned bucket = hashLabel(code.instructions[index->positions[i]].label) & index->mask;
+            while (index->buckets[bucket] != 0)
+                bucket = (bucket + 1) & index->mask;
+            index->buckets[bucket] = i + 1;
+        }
+    }
+    unsigned bucket = hashLabel(label) & index->mask;
+    while (index->buckets[bucket] != 0)
+        bucket = (bucket + 1) & index->mask;
+    index->positions[index->count] = position;
+    index->buckets[bucket] = ++index->count;
+    return index->count - 1;
+}
+unsigned hashLabel(int label)
+{
+    // Labels are numbered in order: spread them over the buckets (Fibonacci hashing)
+    return (unsigned)label * 2654435761u;
+}
+void freeLabelIndex(LabelIndex *index)
+{
+    free(index->buckets);
+    free(index->positions);
+    index->buckets = NULL;
+    index->positions = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+// Verifier functions implementation//
+void verifierError(const char *message, int pc)
+{
+    fprintf(stderr, "Verification Error at instruction %d: %s\n", pc, message);
+}
+int compareInts(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+int jumpTargetPosition(const Instruction *instr, const LabelIndex *labels)
+{
+    if (code.linked)
+        return instr->arg >= 0 && instr->arg <= code.size ? instr->arg : -1;
+    int label = findLabel(labels, instr->label);
+    return label >= 0 ? labels->positions[label] : -1;
+}
+int matchJoinShape(JoinShapes *shapes, int join, const char *types, int depth)
+{
+    // The first path to reach a join point records its stack shape, the others must match it
+    if (shapes->depth[join] >= 0)
+        return shapes->depth[join] == depth &&
+                       (depth == 0 || memcmp(types, shapes->types + shapes->offset[join], depth) == 0)
+                   ? 0
+                   : -1;
+    if (shapes->size + depth > shapes->capacity)
+    {
+        shapes->capacity = (shapes->capacity + depth) * 2;
+        shapes->types = (char *)realloc(shapes->types, shapes->capacity);
+    }
+    if (depth > 0)
+        memcpy(shapes->types + shapes->size, types, depth);
+    shapes->offset[join] = shapes->size;
+    shapes->depth[join] = depth;
+    shapes->size += depth;
+    return 0;
+}
+int verifyStackCode()
+{
+    // Abstract operand stack: each entry is either a value or a variable address
+    enum
+    {
+        SLOT_VALUE,
+        SLOT_ADDRESS
+    };
+    char types[MAX_STACK_DEPTH];
+    char error_msg[MAX_ERROR_LENGTH];
+    int depth = 0;
+    int maxDepth = 0;
+    int reachable = 1;
+    int errors = 0;
+
+    LabelIndex labels;
+    buildLabelIndex(&labels);
+    if (!code.linked && labels.duplicate >= 0)
+    {
+        snprintf(error_msg, sizeof(error_msg), "Label 'L%d' defined twice",
+                 code.instructions[labels.duplicate].label);
+        verifierError(error_msg, labels.duplicate);
+        errors++;
+    }
+
+    // Join points: the sorted, distinct positions that jumps land on
+    int joinCount = 0;
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        if (isJumpInstruction(code.instructions[pc].type))
+            joinCount++;
+    }
+    int *joins = (int *)malloc((joinCount + 1) * sizeof(int));
+    joinCount = 0;
+    for (int pc = 0; pc < code.size && errors == 0; pc++)
+    {
+        Instruction *instr = &code.instructions[pc];
+        if (!isJumpInstruction(instr->type))
+            continue;
+        int target = jumpTargetPosition(instr, &labels);
+        if (target < 0)
+        {
+            snprintf(error_msg, sizeof(error_msg), "Jump to undefined label 'L%d'", instr->label);
+            verifierError(error_msg, pc);
+            errors++;
+        }
+        joins[joinCount++] = target;
+    }
+    qsort(joins, joinCount, sizeof(int), compareInts);
+    int distinct = 0;
+    for (int j = 0; j < joinCount; j++)
+    {
+        if (distinct == 0 || joins[distinct - 1] != joins[j])
+            joins[distinct++] = joins[j];
+    }
+    joinCount = distinct;
+
+    // Stack shape expected at each join: depth (-1 = not seen yet) and a snapshot of the types
+    JoinShapes shapes;
+    shapes.depth = (int *)malloc((joinCount + 1) * sizeof(int));
+    shapes.offset = (int *)malloc((joinCount + 1) * sizeof(int));
+    shapes.capacity = 64;
+    shapes.types = (char *)malloc(shapes.capacity);
+    shapes.size = 0;
+    for (int j = 0; j < joinCount; j++)
+        shapes.depth[j] = -1;
+    int nextJoin = 0;
+
+    for (int pc = 0; pc <= code.size && errors == 0; pc++)
+    {
+        Instruction *instr = pc < code.size ? &code.instructions[pc] : NULL;
+        int join = -1;
+        if (nextJoin < joinCount && joins[nextJoin] == pc)
+            join = nextJoin++;
+
+        if (join >= 0 || (instr && instr->type == LABEL))
+        {
+            if (join < 0 || shapes.depth[join] < 0)
+            {
+                // Only reachable through later jumps: statements start on an empty stack
+                if (!reachable)
+                    depth = 0;
+            }
+            else if (!reachable)
+            {
+                depth = shapes.depth[join];
+                memcpy(types, shapes.types + shapes.offset[join], depth);
+            }
+            if (join >= 0 && matchJoinShape(&shapes, join, types, depth) != 0)
+            {
+                snprintf(error_msg, sizeof(error_msg), "Stack mismatch at join point %d", pc);
+                verifierError(error_msg, pc);
+                errors++;
+                break;
+            }
+            reachable = 1;
+        }
+        if (instr == NULL)
+            break;
+        if (!reachable)
+            continue;
+
+        // Operand checks
+        switch (instr->type)
+        {
+        case VALUE:
+        case STORE:
+        case READ:
+        case ASSIGN_TO:
+        case ASSIGN_CONST:
+        case WRITE_VALUE:
+            if (instr->arg < 0 || instr->arg >= code.variableCount)
+            {
+                verifierError("Variable slot out of range", pc);
+                errors++;
+            }
+            break;
+        case VALUE2_ADD:
+        case VALUE2_SUB:
+        case VALUE2_MUL:
+        case ASSIGN_VALUE:
+            if (instr->arg < 0 || instr->arg >= code.variableCount ||
+                instr->arg2 < 0 || instr->arg2 >= code.variableCount)
+            {
+                verifierError("Variable slot out of range", pc);
+                errors++;
+            }
+            break;
+        case VADD:
+        case VSUB:
+        case VMUL:
+            if (instr->arg < 0 || instr->arg2 < 0 || instr->arg3 < 0 ||
+                instr->arg + VECTOR_WIDTH > code.variableCount || instr->arg2 + VECTOR_WIDTH > code.variableCount ||
+                instr->arg3 + VECTOR_WIDTH > code.variableCount)
+            {
+                verifierError("Variable slot out of range", pc);
+                errors++;
+            }
+            break;
+        case VALUE_AT:
+        case ASSIGN_AT:
+        case ARRAY_ADD:
+        case ARRAY_SUB:
+        case ARRAY_MUL:
+        {
+            // The whole array must lie in the frame: the index is checked when it is known
+            int bases[3] = {instr->arg, instr->arg2, instr->arg3};
+            int arrays = instr->type == VALUE_AT || instr->type == ASSIGN_AT ? 1 : 3;
+            for (int a = 0; a < arrays; a++)
+            {
+                if (instr->length < 1 || bases[a] < 0 || bases[a] > code.variableCount - instr->length)
+                {
+                    verifierError("Variable slot out of range", pc);
+                    errors++;
+                    break;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        // Pops, with the type each operand must have
+        int pops = 0;
+        char expected[3] = {SLOT_VALUE, SLOT_VALUE, SLOT_VALUE};
+        switch (instr->type)
+        {
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case COMP_LT:
+        case COMP_GT:
+        case COMP_LE:
+        case COMP_GE:
+        case COMP_EQ:
+        case COMP_NE:
+        case GO_FALSE_LT:
+        case GO_FALSE_GT:
+        case GO_FALSE_LE:
+        case GO_FALSE_GE:
+        case GO_FALSE_EQ:
+        case GO_FALSE_NE:
+            pops = 2;
+            break;
+        case ASSIGN:
+            pops = 2;
+            expected[0] = SLOT_ADDRESS;
+            break;
+        case SWAP:
+        case ASSIGN_AT:
+            pops = 2;
+            break;
+        case SELECT:
+            pops = 3;
+            break;
+        case GO_FALSE:
+        case GO_TRUE:
+        case WRITE:
+        case VALUE_AT:
+        case PUSH_ADD:
+        case PUSH_SUB:
+        case PUSH_MUL:
+        case ASSIGN_TO:
+            pops = 1;
+            expected[0] = SLOT_VALUE;
+            break;
+        default:
+            break;
+        }
+        if (depth < pops)
+        {
+            verifierError("Operand stack underflow", pc);
+            errors++;
+            break;
+        }
+        if (instr->type == SWAP)
+        {
+            char top = types[depth - 1];
+            types[depth - 1] = types[depth - 2];
+            types[depth - 2] = top;
+            continue;
+        }
+        for (int k = 0; k < pops; k++)
+        {
+            // expected[0] is the deepest operand
+            if (types[depth - pops + k] != expected[k])
+            {
+                verifierError(expected[k] == SLOT_ADDRESS ? "Assignment target is not an address"
+                                                          : "Operand is a variable address, not a value",
+                              pc);
+                errors++;
+            }
+        }
+        depth -= pops;
+
+        // Pushes
+        switch (instr->type)
+        {
+        case STORE:
+            types[depth++] = SLOT_ADDRESS;
+            break;
+        case PUSH:
+        case VALUE:
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case COMP_LT:
+        case COMP_GT:
+        case COMP_LE:
+        case COMP_GE:
+        case COMP_EQ:
+        case COMP_NE:
+        case VALUE2_ADD:
+        case VALUE2_SUB:
+        case VALUE2_MUL:
+        case PUSH_ADD:
+        case PUSH_SUB:
+        case PUSH_MUL:
+        case SELECT:
+        case VALUE_AT:
+            types[depth++] = SLOT_VALUE;
+            break;
+        default:
+            break;
+        }
+        if (depth > maxDepth)
+            maxDepth = depth;
+        if (depth >= MAX_STACK_DEPTH)
+        {
+            verifierError("Operand stack exceeds the maximum depth", pc);
+            errors++;
+            break;
+        }
+
+        // Record or check the stack shape at the jump target
+        if (isJumpInstruction(instr->type))
+        {
+            int target = jumpTargetPosition(instr, &labels);
+            int *found = (int *)bsearch(&target, joins, joinCount, sizeof(int), compareInts);
+            int join = (int)(found - joins);
+            if (matchJoinShape(&shapes, join, types, depth) != 0)
+            {
+                snprintf(error_msg, sizeof(error_msg), "Stack mismatch on jump to 'L%d'", instr->label);
+                verifierError(error_msg, pc);
+                errors++;
+            }
+            if (instr->type == GOTO)
+                reachable = 0;
+        }
+    }
+
+    if (errors == 0 && reachable && depth != 0)
+    {
+        verifierError("Operand stack not empty at end of program", code.size);
+        errors++;
+    }
+
+    free(joins);
+    free(shapes.depth);
+    free(shapes.offset);
+    free(shapes.types);
+    freeLabelIndex(&labels);
+
+    if (errors > 0)
+        return -1;
+    code.verified = 1;
+    code.maxStackDepth = maxDepth;
+    return 0;
+}
+
+// Linker functions implementation//
+int linkStackCode(int stripLabels)
+{
+    if (code.linked)
+        return 0;
+
+    LabelIndex labels;
+    buildLabelIndex(&labels);
+    if (labels.duplicate >= 0)
+    {
+        fprintf(stderr, "Link Error: label 'L%d' defined twice\n", code.instructions[labels.duplicate].label);
+        freeLabelIndex(&labels);
+        return -1;
+    }
+
+    // Position of every instruction once labels are dropped
+    int n = code.size;
+    int *position = (int *)malloc((n + 1) * sizeof(int));
+    int kept = 0;
+    for (int i = 0; i < n; i++)
+    {
+        position[i] = kept;
+        if (!(stripLabels && code.instructions[i].type == LABEL))
+            kept++;
+    }
+    position[n] = kept;
+
+    int status = 0;
+    for (int i = 0; i < n; i++)
+    {
+        Instruction *instr = &code.instructions[i];
+        if (!isJumpInstruction(instr->type))
+            continue;
+        int label = findLabel(&labels, instr->label);
+        if (label < 0)
+        {
+            fprintf(stderr, "Link Error: jump to undefined label 'L%d'\n", instr->label);
+            status = -1;
+            continue;
+        }
+        instr->arg = position[labels.positions[label]];
+    }
+
+    if (status == 0)
+    {
+        code.labels = (LinkedLabel *)malloc((labels.count + 1) * sizeof(LinkedLabel));
+        code.labelTableSize = 0;
+        for (int l = 0; l < labels.count; l++)
+        {
+            code.labels[code.labelTableSize].label = code.instructions[labels.positions[l]].label;
+            code.labels[code.labelTableSize].position = position[labels.positions[l]];
+            code.labelTableSize++;
+        }
+
+        if (stripLabels)
+        {
+            int w = 0;
+            for (int i = 0; i < n; i++)
+            {
+                if (code.instructions[i].type != LABEL)
+                    code.instructions[w++] = code.instructions[i];
+            }
+            code.size = w;
+        }
+        // Linking only renames jump targets: a verified program stays verified
+        code.linked = 1;
+    }
+
+    free(position);
+    freeLabelIndex(&labels);
+    return status;
+}
+int labelAt(int position, int *cursor)
+{
+    // Side table entries are in program order, so one cursor walks them all; -1 when none is left here
+    if (*cursor < code.labelTableSize && code.labels[*cursor].position == position)
+        return code.labels[(*cursor)++].label;
+    return -1;
+}
+
+// Execution functions implementation//
+void runtimeError(const char *message, int pc)
+{
+    fprintf(stderr, "Runtime Error at instruction %d: %s\n", pc, message);
+}
+void recordError(long long record, const char *message, int pc)
+{
+    // One call, so that lines from concurrent records do not interleave
+    fprintf(stderr, "Record %lld: Runtime Error at instruction %d: %s\n", record, pc, message);
+}
+int initVm(VmState *vm)
+{
+    vm->pc = 0;
+    vm->sp = 0;
+    vm->executed = 0;
+    vm->record = 0;
+    vm->profile = NULL;
+    vm->slice = 0;
+    vm->blockingReads = 0;
+    // Verified programs get exactly the stack they need
+    vm->stackCapacity = code.verified ? code.maxStackDepth : MAX_STACK_DEPTH;
+    vm->stack = (int *)malloc((vm->stackCapacity + 1) * sizeof(int));
+    vm->frameSize = code.variableCount;
+    vm->frame = (int *)calloc(vm->frameSize + 1, sizeof(int));
+    return vm->stack != NULL && vm->frame != NULL ? 0 : -1;
+}
+void freeVm(VmState *vm)
+{
+    free(vm->stack);
+    free(vm->frame);
+    vm->stack = NULL;
+    vm->frame = NULL;
+}
+
+// The interpreter loop is instantiated twice: with every bounds and operand check for
+// unverified code, and without them once verifyStackCode() has proven the program safe.
+static inline VmStatus runVmLoop(VmState *vm, const int checked, const int profiled, const int sliced,
+                                 const int tiered)
+{
+    const Instruction *instructions = code.instructions;
+    int *stack = vm->stack;
+    int *frame = vm->frame;
+    int pc = vm->pc;
+    int sp = vm->sp;
+    long long executed = 0;
+    VmStatus status = VM_HALTED;
+    ExecutionProfile *profile = vm->profile;
+    int previous = -1;
+    long long backEdges = 0; // taken backward jumps not yet added to the tier counter
+
+#define VM_FAIL(message)                  \
+    do                                    \
+    {                                     \
+        if (vm->record > 0)               \
+            recordError(vm->record, message, pc); \
+        else                              \
+            runtimeError(message, pc);    \
+        status = VM_ERROR;                \
+        goto done;                        \
+    } while (0)
+#define VM_NEED(pops, pushes)                                        \
+    do                                                               \
+    {                                                                \
+        if (checked && sp < (pops))                                  \
+            VM_FAIL("Operand stack underflow");                      \
+        if (checked && sp - (pops) + (pushes) > vm->stackCapacity)   \
+            VM_FAIL("Operand stack overflow");                       \
+    } while (0)
+#define VM_SLOT(slot)                                                \
+    do                                                               \
+    {                                                                \
+        if (checked && ((slot) < 0 || (slot) >= vm->frameSize))      \
+            VM_FAIL("Variable slot out of range");                   \
+    } while (0)
+
+    while (pc < code.size)
+    {
+        const Instruction *instr = &instructions[pc];
+        // Event-loop instances give the next one its turn, or wait until their output is sent
+        if (sliced && (executed >= vm->slice || vm->output->size >= INSTANCE_OUTPUT_LIMIT))
+        {
+            status = VM_YIELDED;
+            goto done;
+        }
+        executed++;
+        if (profiled)
+        {
+            profile->hits[pc]++;
+            if (previous >= 0)
+                profile->pairs.counts[previous][instr->type]++;
+            previous = instr->type;
+        }
+        switch (instr->type)
+        {
+        case PUSH:
+            VM_NEED(0, 1);
+            stack[sp++] = instr->arg;
+            break;
+        case VALUE:
+            VM_NEED(0, 1);
+            VM_SLOT(instr->arg);
+            stack[sp++] = frame[instr->arg];
+            break;
+        case STORE:
+            VM_NEED(0, 1);
+            VM_SLOT(instr->arg);
+            stack[sp++] = instr->arg;
+            break;
+        case ADD:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = (int)((unsigned)stack[sp - 1] + (unsigned)stack[sp]);
+            break;
+        case SUB:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = (int)((unsigned)stack[sp - 1] - (unsigned)stack[sp]);
+            break;
+        case MUL:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = (int)((unsigned)stack[sp - 1] * (unsigned)stack[sp]);
+            break;
+        case DIV:
+            VM_NEED(2, 1);
+            sp--;
+            if (stack[sp] == 0)
+                VM_FAIL("Division by zero");
+            if (stack[sp] == -1)
+                stack[sp - 1] = (int)(0u - (unsigned)stack[sp - 1]);
+            else
+                stack[sp - 1] = stack[sp - 1] / stack[sp];
+            break;
+        case ASSIGN:
+            VM_NEED(2, 0);
+            VM_SLOT(stack[sp - 2]);
+            frame[stack[sp - 2]] = stack[sp - 1];
+            sp -= 2;
+            break;
+        case SWAP:
+        {
+            VM_NEED(2, 2);
+            int top = stack[sp - 1];
+            stack[sp - 1] = stack[sp - 2];
+            stack[sp - 2] = top;
+            break;
+        }
+        case COMP_LT:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = stack[sp - 1] < stack[sp];
+            break;
+        case COMP_GT:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = stack[sp - 1] > stack[sp];
+            break;
+        case COMP_LE:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = stack[sp - 1] <= stack[sp];
+            break;
+        case COMP_GE:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = stack[sp - 1] >= stack[sp];
+            break;
+        case COMP_EQ:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = stack[sp - 1] == stack[sp];
+            break;
+        case COMP_NE:
+            VM_NEED(2, 1);
+            sp--;
+            stack[sp - 1] = stack[sp - 1] != stack[sp];
+            break;
+        case GO_FALSE:
+        case GO_TRUE:
+        case GOTO:
+        case GO_FALSE_LT:
+        case GO_FALSE_GT:
+        case GO_FALSE_LE:
+        case GO_FALSE_GE:
+        case GO_FALSE_EQ:
+        case GO_FALSE_NE:
+        {
+            int taken = 1;
+            switch (instr->type)
+            {
+            case GO_FALSE:
+            case GO_TRUE:
+                VM_NEED(1, 0);
+                sp--;
+                taken = (stack[sp] != 0) == (instr->type == GO_TRUE);
+                break;
+            case GO_FALSE_LT:
+                VM_NEED(2, 0);
+                sp -= 2;
+                taken = !(stack[sp] < stack[sp + 1]);
+                break;
+            case GO_FALSE_GT:
+                VM_NEED(2, 0);
+                sp -= 2;
+                taken = !(stack[sp] > stack[sp + 1]);
+                break;
+            case GO_FALSE_LE:
+                VM_NEED(2, 0);
+                sp -= 2;
+                taken = !(stack[sp] <= stack[sp + 1]);
+                break;
+            case GO_FALSE_GE:
+                VM_NEED(2, 0);
+                sp -= 2;
+                taken = !(stack[sp] >= stack[sp + 1]);
+                break;
+            case GO_FALSE_EQ:
+                VM_NEED(2, 0);
+                sp -= 2;
+                taken = !(stack[sp] == stack[sp + 1]);
+                break;
+            case GO_FALSE_NE:
+                VM_NEED(2, 0);
+                sp -= 2;
+                taken = !(stack[sp] != stack[sp + 1]);
+                break;
+            default:
+                break;
+            }
+            if (taken)
+            {
+                if (checked && (instr->arg < 0 || instr->arg > code.size))
+                    VM_FAIL("Jump target out of range");
+                if (profiled)
+                    profile->taken[pc]++;
+                if (tiered && instr->arg <= pc && ++backEdges == TIER_CHECK_INTERVAL)
+                {
+                    // A safe point: the operand stack is all in vm->stack, native code can go on from here
+                    backEdges = 0;
+                    if (countBackEdges(TIER_CHECK_INTERVAL) && nativeEntry(instr->arg) != NULL)
+                    {
+                        pc = instr->arg;
+                        status = VM_PROMOTED;
+                        goto done;
+                    }
+                }
+                pc = instr->arg;
+                continue;
+            }
+            break;
+        }
+        case LABEL:
+            break;
+        case READ:
+            VM_SLOT(instr->arg);
+            if (sliced && !vm->blockingReads && !inputReady(vm->input))
+            {
+                executed--; // run again once the value has arrived
+                status = VM_WAITING;
+                goto done;
+            }
+            if (vm->prompt)
+            {
+                writeText(vm->output, code.variables[instr->arg]);
+                writeText(vm->output, " = ");
+                flushOutput(vm->output);
+            }
+            if (readInteger(vm->input, &frame[instr->arg]) != 0)
+                VM_FAIL("Invalid input for readln");
+            break;
+        case WRITE:
+            VM_NEED(1, 0);
+            writeInteger(vm->output, stack[--sp]);
+            break;
+        case VALUE_AT:
+            VM_NEED(1, 1);
+            VM_SLOT(instr->arg);
+            VM_SLOT(instr->arg + instr->length - 1);
+            // Verified or not, the index is only known now
+            if ((unsigned)stack[sp - 1] >= (unsigned)instr->length)
+                VM_FAIL("Array index out of bounds");
+            stack[sp - 1] = frame[instr->arg + stack[sp - 1]];
+            break;
+        case ASSIGN_AT:
+            VM_NEED(2, 0);
+            VM_SLOT(instr->arg);
+            VM_SLOT(instr->arg + instr->length - 1);
+            if ((unsigned)stack[sp - 2] >= (unsigned)instr->length)
+                VM_FAIL("Array index out of bounds");
+            frame[instr->arg + stack[sp - 2]] = stack[sp - 1];
+            sp -= 2;
+            break;
+        case ARRAY_ADD:
+        case ARRAY_SUB:
+        case ARRAY_MUL:
+            VM_SLOT(instr->arg);
+            VM_SLOT(instr->arg2);
+            VM_SLOT(instr->arg3);
+            VM_SLOT(instr->arg + instr->length - 1);
+            VM_SLOT(instr->arg2 + instr->length - 1);
+            VM_SLOT(instr->arg3 + instr->length - 1);
+            runArrayOperation(instr->type, frame + instr->arg, frame + instr->arg2, frame + instr->arg3, instr->length);
+            break;
+        case VADD:
+        case VSUB:
+        case VMUL:
+        {
+            VM_SLOT(instr->arg + VECTOR_WIDTH - 1);
+            VM_SLOT(instr->arg2 + VECTOR_WIDTH - 1);
+            VM_SLOT(instr->arg3 + VECTOR_WIDTH - 1);
+            // Unaligned loads of whole slot runs; the compiler emits SSE (AVX with -mavx) for the op
+            SlotVector left, right, result;
+            memcpy(&left, frame + instr->arg2, sizeof(left));
+            memcpy(&right, frame + instr->arg3, sizeof(right));
+            if (instr->type == VADD)
+                result = left + right;
+            else if (instr->type == VSUB)
+                result = left - right;
+            else
+                result = left * right;
+            memcpy(frame + instr->arg, &result, sizeof(result));
+            break;
+        }
+        case SELECT:
+        {
+            VM_NEED(3, 1);
+            sp -= 2;
+            int chosen = -(stack[sp + 1] != 0); // all ones picks the then value
+            stack[sp - 1] = (stack[sp - 1] & chosen) | (stack[sp] & ~chosen);
+            break;
+        }
+        case VALUE2_ADD:
+            VM_NEED(0, 1);
+            VM_SLOT(instr->arg);
+            VM_SLOT(instr->arg2);
+            stack[sp++] = (int)((unsigned)frame[instr->arg] + (unsigned)frame[instr->arg2]);
+            break;
+        case VALUE2_SUB:
+            VM_NEED(0, 1);
+            VM_SLOT(instr->arg);
+            VM_SLOT(instr->arg2);
+            stack[sp++] = (int)((unsigned)frame[instr->arg] - (unsigned)frame[instr->arg2]);
+            break;
+        case VALUE2_MUL:
+            VM_NEED(0, 1);
+            VM_SLOT(instr->arg);
+            VM_SLOT(instr->arg2);
+            stack[sp++] = (int)((unsigned)frame[instr->arg] * (unsigned)frame[instr->arg2]);
+            break;
+        case PUSH_ADD:
+            VM_NEED(1, 1);
+            stack[sp - 1] = (int)((unsigned)stack[sp - 1] + (unsigned)instr->arg);
+            break;
+        case PUSH_SUB:
+            VM_NEED(1, 1);
+            stack[sp - 1] = (int)((unsigned)stack[sp - 1] - (unsigned)instr->arg);
+            break;
+        case PUSH_MUL:
+            VM_NEED(1, 1);
+            stack[sp - 1] = (int)((unsigned)stack[sp - 1] * (unsigned)instr->arg);
+            break;
+        case ASSIGN_TO:
+            VM_NEED(1, 0);
+            VM_SLOT(instr->arg);
+            frame[instr->arg] = stack[--sp];
+            break;
+        case ASSIGN_CONST:
+            VM_SLOT(instr->arg);
+            frame[instr->arg] = instr->arg2;
+            break;
+        case ASSIGN_VALUE:
+            VM_SLOT(instr->arg);
+            VM_SLOT(instr->arg2);
+            frame[instr->arg] = frame[instr->arg2];
+            break;
+        case WRITE_VALUE:
+            VM_SLOT(instr->arg);
+            writeInteger(vm->output, frame[instr->arg]);
+            break;
+        default:
+            VM_FAIL("Unknown instruction");
+        }
+        pc++;
+    }
+
+done:
+#undef VM_FAIL
+#undef VM_NEED
+#undef VM_SLOT
+    vm->pc = pc;
+    vm->sp = sp;
+    vm->executed += executed;
+    if (profiled && executed > 1)
+        profile->pairs.total += executed - 1;
+    if (tiered && backEdges > 0)
+        countBackEdges(backEdges);
+    return status;
+}
+VmStatus runVm(VmState *vm)
+{
+    // Profiling gets its own copies so that the plain loops pay nothing for it
+    if (vm->profile != NULL)
+        return code.verified ? runVmLoop(vm, 0, 1, 0, 0) : runVmLoop(vm, 1, 1, 0, 0);
+    if (vm->slice > 0)
+        return code.verified ? runVmLoop(vm, 0, 0, 1, 0) : runVmLoop(vm, 1, 0, 1, 0);
+    // Native code is compiled without the runtime checks, so only verified code is tiered
+    if (tiers.enabled && code.verified)
+        return runTiered(vm);
+    if (code.verified)
+        return runVmLoop(vm, 0, 0, 0, 0);
+    return runVmLoop(vm, 1, 0, 0, 0);
+}
+void runArrayOperation(InstructionType type, int *target, const int *left, const int *right, int length)
+{
+    // VECTOR_WIDTH elements per step, as the vector instructions do, then the rest one by one.
+    // The arrays are either the same or disjoint, so each element is read before it is written.
+    int k = 0;
+#define ARRAY_LOOP(op)                                                  \
+    do                                                                  \
+    {                                                                   \
+        for (; k + VECTOR_WIDTH <= length; k += VECTOR_WIDTH)           \
+        {                                                               \
+            SlotVector a, b, result;                                    \
+            memcpy(&a, left + k, sizeof(a));                            \
+            memcpy(&b, right + k, sizeof(b));                           \
+            result = a op b;                                            \
+            memcpy(target + k, &result, sizeof(result));                \
+        }                                                               \
+        for (; k < length; k++)                                         \
+            target[k] = (int)((unsigned)left[k] op(unsigned) right[k]); \
+    } while (0)
+
+    if (type == ARRAY_ADD)
+        ARRAY_LOOP(+);
+    else if (type == ARRAY_SUB)
+        ARRAY_LOOP(-);
+    else
+        ARRAY_LOOP(*);
+#undef ARRAY_LOOP
+}
+int prepareStackCode(void)
+{
+    // Code that fails verification still runs, with the checks the verifier would have made unnecessary
+    if (!code.verified && verifyStackCode() != 0)
+        fprintf(stderr, "Verification failed: running with runtime checks.\n");
+    return code.linked ? 0 : linkStackCode(1);
+}
+int executeStackCode(int verbose, const char *inputPath, ExecutionProfile *profile, long long *executed)
+{
+    if (prepareStackCode() != 0)
+        return -1;
+
+    InputStream input;
+    OutputStream output;
+    // The menu reads stdin through stdio, so readln must share its buffer there
+    int opened = inputPath == NULL && verbose ? openInputFile(&input, stdin) : openInput(&input, inputPath);
+    if (opened != 0)
+        return -1;
+
+    VmState vm;
+    if (initVm(&vm) != 0)
+    {
+        runtimeError("Out of memory", 0);
+        closeInput(&input);
+        return -1;
+    }
+    vm.prompt = verbose;
+    vm.input = &input;
+    vm.output = &output;
+    if (profile != NULL)
+    {
+        // Sized for the linked code that actually runs
+        if (initExecutionProfile(profile) != 0)
+        {
+            runtimeError("Out of memory", 0);
+            freeVm(&vm);
+            closeInput(&input);
+            return -1;
+        }
+        vm.profile = profile;
+    }
+
+    if (verbose)
+        printf("\nProgram output:\n");
+    fflush(stdout);
+    if (openOutput(&output, STDOUT_FILENO) != 0)
+    {
+        runtimeError("Out of memory", 0);
+        freeVm(&vm);
+        closeInput(&input);
+        return -1;
+    }
+    if (checkpoints.path != NULL)
+    {
+        checkpoints.hash = hashStackCode();
+        if (checkpoints.resume && restoreCheckpoint(&vm) < 0)
+        {
+            closeOutput(&output);
+            freeVm(&vm);
+            closeInput(&input);
+            return -1;
+        }
+    }
+    VmStatus status = checkpoints.path != NULL ? runCheckpointed(&vm) : runVm(&vm);
+    if (closeOutput(&output) != 0)
+        status = VM_ERROR;
+    closeInput(&input);
+    if (verbose)
+        printf("\nExecuted %lld instructions (%s).\n", vm.executed,
+               code.verified ? "verified, unchecked" : "checked");
+    if (executed)
+        *executed = vm.executed;
+
+    freeVm(&vm);
+    return status == VM_HALTED ? 0 : -1;
+}
+int benchmarkStackCode(const char *inputPath, int runs, long long *executed)
+{
+    // The same input every run, read once; output goes to memory and the first run's is printed
+    if (prepareStackCode() != 0)
+        return -1;
+    long length = 0;
+    char *data = readSource(inputPath ? inputPath : "-", &length);
+    if (data == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open input '%s'\n", inputPath ? inputPath : "-");
+        return -1;
+    }
+
+    double *seconds = (double *)malloc(runs * sizeof(double));
+    OutputStream first;
+    int status = 0;
+    memset(&first, 0, sizeof(first));
+    for (int r = 0; r < runs && status == 0; r++)
+    {
+        InputStream input;
+        OutputStream output;
+        VmState vm;
+        openInputMemory(&input, data, length);
+        if (initVm(&vm) != 0 || openOutput(&output, -1) != 0)
+        {
+            runtimeError("Out of memory", 0);
+            freeVm(&vm);
+            status = -1;
+            break;
+        }
+        vm.input = &input;
+        vm.output = &output;
+        struct timespec started, finished;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+        status = runVm(&vm) == VM_HALTED ? 0 : -1;
+        clock_gettime(CLOCK_MONOTONIC, &finished);
+        seconds[r] = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+        *executed = vm.executed;
+        freeVm(&vm);
+        if (r == 0)
+            first = output;
+        else
+            free(output.buffer);
+    }
+    if (first.buffer != NULL)
+    {
+        first.fd = STDOUT_FILENO;
+        if (closeOutput(&first) != 0)
+            status = -1;
+    }
+
+    if (status == 0)
+    {
+        qsort(seconds, runs, sizeof(double), compareDoubles);
+        fprintf(stderr, "bench: %d runs, best %.3f ms, median %.3f ms, %.0f M instructions/s\n", runs,
+                seconds[0] * 1e3, seconds[runs / 2] * 1e3, seconds[0] > 0 ? *executed / seconds[0] / 1e6 : 0.0);
+    }
+    free(seconds);
+    free(data);
+    return status;
+}
+int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// I/O runtime functions implementation//
+int openInput(InputStream *in, const char *path)
+{
+    memset(in, 0, sizeof(*in));
+    in->fd = STDIN_FILENO;
+    if (path != NULL)
+    {
+        in->fd = open(path, O_RDONLY);
+        if (in->fd < 0)
+        {
+            fprintf(stderr, "Error: Cannot open input file '%s'\n", path);
+            return -1;
+        }
+
+        // Regular files are mapped whole: no copies and no refills
+        struct stat info;
+        if (fstat(in->fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0);
+            if (data != MAP_FAILED)
+            {
+                madvise(data, info.st_size, MADV_SEQUENTIAL);
+                in->buffer = (char *)data;
+                in->size = info.st_size;
+                in->mapped = 1;
+                in->eof = 1;
+                return 0;
+            }
+        }
+    }
+    in->buffer = (char *)malloc(IO_BUFFER_SIZE);
+    return in->buffer != NULL ? 0 : -1;
+}
+int openInputFile(InputStream *in, FILE *file)
+{
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+    in->file = file;
+    in->buffer = (char *)malloc(IO_BUFFER_SIZE);
+    return in->buffer != NULL ? 0 : -1;
+}
+void openInputMemory(InputStream *in, const char *data, size_t size)
+{
+    // Borrows data: not to be passed to closeInput
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+    in->buffer = (char *)data;
+    in->size = size;
+    in->eof = 1;
+}
+int loadInput(InputStream *in)
+{
+    // Pull the rest of a streamed input into one buffer, as if it were mapped
+    if (in->mapped || in->eof)
+        return 0;
+    size_t capacity = IO_BUFFER_SIZE;
+    size_t size = in->size - in->position;
+    char *data = (char *)malloc(capacity);
+    if (data == NULL)
+        return -1;
+    memcpy(data, in->buffer + in->position, size);
+    while (refillInput(in) > 0)
+    {
+        if (size + in->size > capacity)
+        {
+            while (size + in->size > capacity)
+                capacity *= 2;
+            char *grown = (char *)realloc(data, capacity);
+            if (grown == NULL)
+            {
+                free(data);
+                return -1;
+            }
+            data = grown;
+        }
+        memcpy(data + size, in->buffer, in->size);
+        size += in->size;
+    }
+    free(in->buffer);
+    in->buffer = data;
+    in->size = size;
+    in->position = 0;
+    return 0;
+}
+void closeInput(InputStream *in)
+{
+    if (in->mapped)
+        munmap(in->buffer, in->size);
+    else
+        free(in->buffer);
+    if (in->fd > STDIN_FILENO)
+        close(in->fd);
+    in->buffer = NULL;
+}
+int refillInput(InputStream *in)
+{
+    if (in->eof)
+        return 0;
+    in->consumed += in->position;
+    in->position = 0;
+    in->size = 0;
+
+    if (in->file != NULL)
+    {
+        if (fgets(in->buffer, IO_BUFFER_SIZE, in->file) == NULL)
+            in->eof = 1;
+        else
+            in->size = strlen(in->buffer);
+        return (int)in->size;
+    }
+
+    ssize_t count;
+    do
+    {
+        count = read(in->fd, in->buffer, IO_BUFFER_SIZE);
+    } while (count < 0 && errno == EINTR);
+    if (count <= 0)
+        in->eof = 1;
+    else
+        in->size = count;
+    return (int)in->size;
+}
+int readInteger(InputStream *in, int *value)
+{
+    // Skip blanks
+    for (;;)
+    {
+        while (in->position < in->size && (unsigned char)in->buffer[in->position] <= ' ')
+            in->position++;
+        if (in->position < in->size)
+            break;
+        if (refillInput(in) == 0)
+            return -1;
+    }
+
+    int negative = 0;
+    if (in->buffer[in->position] == '-' || in->buffer[in->position] == '+')
+    {
+        negative = in->buffer[in->position] == '-';
+        in->position++;
+        if (in->position >= in->size && refillInput(in) == 0)
+            return -1;
+    }
+
+    // Accumulate modulo 2^32, like the arithmetic instructions
+    unsigned result = 0;
+    int digits = 0;
+    for (;;)
+    {
+        const char *cursor = in->buffer + in->position;
+        const char *end = in->buffer + in->size;
+        while (cursor < end && (unsigned)(*cursor - '0') < 10)
+        {
+            result = result * 10 + (unsigned)(*cursor - '0');
+            cursor++;
+            digits++;
+        }
+        in->position = cursor - in->buffer;
+        if (cursor < end || refillInput(in) == 0)
+            break;
+    }
+    if (digits == 0)
+        return -1;
+    *value = (int)(negative ? 0u - result : result);
+    return 0;
+}
+int openOutput(OutputStream *out, int fd)
+{
+    out->fd = fd;
+    // Memory buffers start small: the parallel runner keeps one per shard
+    out->capacity = fd < 0 ? 4096 : IO_BUFFER_SIZE;
+    out->buffer = (char *)malloc(out->capacity);
+    out->size = 0;
+    out->written = 0;
+    out->error = 0;
+    return out->buffer != NULL ? 0 : -1;
+}
+void flushOutput(OutputStream *out)
+{
+    if (out->fd < 0)
+    {
+        char *grown = (char *)realloc(out->buffer, out->capacity * 2);
+        if (grown != NULL)
+        {
+            out->buffer = grown;
+            out->capacity *= 2;
+        }
+        return;
+    }
+
+    size_t done = 0;
+    while (done < out->size && out->error == 0)
+    {
+        ssize_t count = write(out->fd, out->buffer + done, out->size - done);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            out->error = count < 0 ? errno : EIO;
+        else
+            done += count;
+    }
+    out->written += done;
+    out->size = 0;
+}
+int formatInteger(char *dest, int value)
+{
+    char digits[12];
+    int length = 0;
+    unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+    do
+    {
+        digits[length++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    char *cursor = dest;
+    if (value < 0)
+        *cursor++ = '-';
+    while (length > 0)
+        *cursor++ = digits[--length];
+    *cursor++ = '\n';
+    return (int)(cursor - dest);
+}
+void writeInteger(OutputStream *out, int value)
+{
+    if (out->size + 16 > out->capacity)
+    {
+        flushOutput(out);
+        if (out->size + 16 > out->capacity)
+            return;
+    }
+    out->size += formatInteger(out->buffer + out->size, value);
+}
+void writeText(OutputStream *out, const char *text)
+{
+    writeBytes(out, text, strlen(text));
+}
+void writeBytes(OutputStream *out, const char *text, size_t length)
+{
+    if (out->fd < 0)
+    {
+        // Memory buffers grow until the text fits
+        while (out->size + length > out->capacity)
+        {
+            size_t capacity = out->capacity;
+            flushOutput(out);
+            if (out->capacity == capacity)
+                return;
+        }
+    }
+    else if (out->size + length > out->capacity)
+    {
+        flushOutput(out);
+        if (length > out->capacity)
+        {
+            // Larger than the buffer: write straight through
+            if (out->error == 0 && writeFully(out->fd, text, length) != 0)
+                out->error = errno != 0 ? errno : EIO;
+            if (out->error == 0)
+                out->written += length;
+            return;
+        }
+    }
+    memcpy(out->buffer + out->size, text, length);
+    out->size += length;
+}
+int inputReady(const InputStream *in)
+{
+    // Whether readInteger() can finish without a refill: a whole number, something
+    // that is not one, or the end of the input (event-loop instances, whose input grows)
+    if (in->eof)
+        return 1;
+    size_t position = in->position;
+    while (position < in->size && (unsigned char)in->buffer[position] <= ' ')
+        position++;
+    if (position < in->size && (in->buffer[position] == '-' || in->buffer[position] == '+'))
+        position++;
+    while (position < in->size && (unsigned)(in->buffer[position] - '0') < 10)
+        position++;
+    return position < in->size;
+}
+int skipInput(InputStream *in, long long offset)
+{
+    // Resumed runs: the bytes the checkpointed run had consumed, seeking over them when possible
+    if (!in->mapped && in->fd >= 0 && lseek(in->fd, offset, SEEK_CUR) >= 0)
+    {
+        in->consumed = offset;
+        return 0;
+    }
+    while (in->consumed + (long long)in->size < offset)
+    {
+        in->position = in->size;
+        if (refillInput(in) == 0)
+            return -1;
+    }
+    in->position = offset - in->consumed;
+    return 0;
+}
+int readLineInteger(InputStream *in, int *value)
+{
+    // 1: a value, 0: end of line (consumed), -1: end of input, -2: not a number
+    for (;;)
+    {
+        while (in->position < in->size)
+        {
+            char c = in->buffer[in->position];
+            if (c == '\n')
+            {
+                in->position++;
+                return 0;
+            }
+            if ((unsigned char)c > ' ')
+                return readInteger(in, value) == 0 ? 1 : -2;
+            in->position++;
+        }
+        if (refillInput(in) == 0)
+            return -1;
+    }
+}
+int closeOutput(OutputStream *out)
+{
+    // -1 when any of the output was lost (a full disk, a closed pipe), reported here once
+    flushOutput(out);
+    free(out->buffer);
+    out->buffer = NULL;
+    if (out->error == 0)
+        return 0;
+    fprintf(stderr, "Error: Cannot write output: %s\n", strerror(out->error));
+    return -1;
+}
+
+// Batch execution functions implementation//
+int initBatch(BatchState *batch)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->frameSize = code.variableCount;
+    // Vector types need their natural alignment, which malloc does not promise
+    batch->stack = (LaneVector *)aligned_alloc(sizeof(LaneVector), (code.maxStackDepth + 1) * sizeof(LaneVector));
+    batch->frame = (LaneVector *)aligned_alloc(sizeof(LaneVector), (batch->frameSize + 1) * sizeof(LaneVector));
+    return batch->stack != NULL && batch->frame != NULL ? 0 : -1;
+}
+void freeBatch(BatchState *batch)
+{
+    free(batch->stack);
+    free(batch->frame);
+    free(batch->values);
+    for (int lane = 0; lane < BATCH_LANES; lane++)
+        free(batch->output[lane].text);
+    memset(batch, 0, sizeof(*batch));
+}
+int loadBatch(BatchState *batch, InputStream *in, long long firstRecord)
+{
+    int lanes = 0;
+    batch->valueCount = 0;
+    while (lanes < BATCH_LANES)
+    {
+        int value, result, values = 0;
+        batch->recordStart[lanes] = batch->valueCount;
+        while ((result = readLineInteger(in, &value)) == 1)
+        {
+            if (batch->valueCount == batch->valueCapacity)
+            {
+                int capacity = batch->valueCapacity ? batch->valueCapacity * 2 : 256;
+                int *grown = (int *)realloc(batch->values, capacity * sizeof(int));
+                if (grown == NULL)
+                {
+                    fprintf(stderr, "Error: Out of memory\n");
+                    return -1;
+                }
+                batch->values = grown;
+                batch->valueCapacity = capacity;
+            }
+            batch->values[batch->valueCount++] = value;
+            values++;
+        }
+        if (result == -2)
+        {
+            fprintf(stderr, "Error: Invalid input in record %lld\n", firstRecord + lanes + 1);
+            return -1;
+        }
+        if (result == -1 && values == 0)
+            break;
+        batch->cursor[lanes] = batch->recordStart[lanes];
+        batch->failed[lanes] = 0;
+        batch->output[lanes].size = 0;
+        lanes++;
+    }
+    batch->recordStart[lanes] = batch->valueCount;
+    return lanes;
+}
+void laneWrite(LaneOutput *output, int value)
+{
+    if (output->size + 16 > output->capacity)
+    {
+        size_t capacity = output->capacity ? output->capacity * 2 : 256;
+        char *grown = (char *)realloc(output->text, capacity);
+        if (grown == NULL)
+            return;
+        output->text = grown;
+        output->capacity = capacity;
+    }
+    output->size += formatInteger(output->text + output->size, value);
+}
+static inline LaneVector laneSplat(int value)
+{
+    LaneVector zero = {0};
+    return zero + value;
+}
+static inline LaneVector laneBlend(LaneVector old, LaneVector value, LaneVector mask)
+{
+    return (old & ~mask) | (value & mask);
+}
+void runBatch(BatchState *batch, int lanes, long long firstRecord)
+{
+    const Instruction *instructions = code.instructions;
+    LaneVector *stack = batch->stack;
+    LaneVector *frame = batch->frame;
+    LaneVector pcs = {0};   // where each lane resumes
+    LaneVector sps = {0};   // its stack depth there
+    LaneVector alive = {0};
+    LaneVector mask = {0};  // lanes executing the current instruction
+    int pc = 0;
+    int sp = 0;
+    int active = 0;
+    int converged = 0;     // every live lane is in mask
+    long long executed = 0;
+    const LaneVector none = {0};
+
+    for (int lane = 0; lane < lanes; lane++)
+        alive[lane] = -1;
+    memset(frame, 0, (batch->frameSize + 1) * sizeof(LaneVector));
+
+#define LANE_FAIL(lane, message)                                                  \
+    do                                                                            \
+    {                                                                             \
+        recordError(firstRecord + (lane) + 1, message, pc);                       \
+        batch->failed[lane] = 1;                                                  \
+        alive[lane] = 0;                                                          \
+        mask[lane] = 0;                                                           \
+        active--;                                                                 \
+    } while (0)
+#define LANE_ARITHMETIC(op)                                                              \
+    do                                                                                   \
+    {                                                                                    \
+        sp--;                                                                            \
+        stack[sp - 1] = laneBlend(stack[sp - 1],                                         \
+                                  (LaneVector)((LaneUVector)stack[sp - 1] op(LaneUVector) stack[sp]), \
+                                  mask);                                                 \
+    } while (0)
+#define LANE_COMPARE(op)                                                          \
+    do                                                                            \
+    {                                                                             \
+        sp--;                                                                     \
+        stack[sp - 1] = laneBlend(stack[sp - 1], -(stack[sp - 1] op stack[sp]), mask); \
+    } while (0)
+
+schedule:
+    // Lanes drift apart at conditional jumps. Always run the lowest pc among
+    // the live lanes, so lanes on different paths meet again at the join.
+    pc = code.size;
+    for (int lane = 0; lane < lanes; lane++)
+        if (alive[lane] && pcs[lane] < pc)
+            pc = pcs[lane];
+    if (pc >= code.size)
+        goto done;
+    mask = alive & (pcs == pc);
+    active = 0;
+    for (int lane = 0; lane < lanes; lane++)
+        if (mask[lane])
+        {
+            sp = sps[lane]; // the same for every lane at pc, by verification
+            active++;
+        }
+    converged = memcmp(&mask, &alive, sizeof(LaneVector)) == 0;
+
+    while (pc < code.size)
+    {
+        const Instruction *instr = &instructions[pc];
+        executed += active;
+        switch (instr->type)
+        {
+        case PUSH:
+        case STORE:
+            stack[sp] = laneBlend(stack[sp], laneSplat(instr->arg), mask);
+            sp++;
+            break;
+        case VALUE:
+            stack[sp] = laneBlend(stack[sp], frame[instr->arg], mask);
+            sp++;
+            break;
+        case ADD:
+            LANE_ARITHMETIC(+);
+            break;
+        case SUB:
+            LANE_ARITHMETIC(-);
+            break;
+        case MUL:
+            LANE_ARITHMETIC(*);
+            break;
+        case DIV:
+            sp--;
+            for (int lane = 0; lane < lanes; lane++)
+            {
+                if (!mask[lane])
+                    continue;
+                int divisor = stack[sp][lane];
+                if (divisor == 0)
+                    LANE_FAIL(lane, "Division by zero");
+                else if (divisor == -1)
+                    stack[sp - 1][lane] = (int)(0u - (unsigned)stack[sp - 1][lane]);
+                else
+                    stack[sp - 1][lane] = stack[sp - 1][lane] / divisor;
+            }
+            break;
+        case ASSIGN:
+            for (int lane = 0; lane < lanes; lane++)
+                if (mask[lane])
+                    frame[stack[sp - 2][lane]][lane] = stack[sp - 1][lane];
+            sp -= 2;
+            break;
+        case SWAP:
+        {
+            LaneVector top = stack[sp - 1];
+            stack[sp - 1] = laneBlend(top, stack[sp - 2], mask);
+            stack[sp - 2] = laneBlend(stack[sp - 2], top, mask);
+            break;
+        }
+        case COMP_LT:
+            LANE_COMPARE(<);
+            break;
+        case COMP_GT:
+            LANE_COMPARE(>);
+            break;
+        case COMP_LE:
+            LANE_COMPARE(<=);
+            break;
+        case COMP_GE:
+            LANE_COMPARE(>=);
+            break;
+        case COMP_EQ:
+            LANE_COMPARE(==);
+            break;
+        case COMP_NE:
+            LANE_COMPARE(!=);
+            break;
+        case GO_FALSE:
+        case GO_TRUE:
+        case GOTO:
+        case GO_FALSE_LT:
+        case GO_FALSE_GT:
+        case GO_FALSE_LE:
+        case GO_FALSE_GE:
+        case GO_FALSE_EQ:
+        case GO_FALSE_NE:
+        {
+            LaneVector taken = mask;
+            switch (instr->type)
+            {
+            case GO_FALSE:
+                sp--;
+                taken = stack[sp] == 0;
+                break;
+            case GO_TRUE:
+                sp--;
+                taken = stack[sp] != 0;
+                break;
+            case GO_FALSE_LT:
+                sp -= 2;
+                taken = stack[sp] >= stack[sp + 1];
+                break;
+            case GO_FALSE_GT:
+                sp -= 2;
+                taken = stack[sp] <= stack[sp + 1];
+                break;
+            case GO_FALSE_LE:
+                sp -= 2;
+                taken = stack[sp] > stack[sp + 1];
+                break;
+            case GO_FALSE_GE:
+                sp -= 2;
+                taken = stack[sp] < stack[sp + 1];
+                break;
+            case GO_FALSE_EQ:
+                sp -= 2;
+                taken = stack[sp] != stack[sp + 1];
+                break;
+            case GO_FALSE_NE:
+                sp -= 2;
+                taken = stack[sp] == stack[sp + 1];
+                break;
+            default:
+                break;
+            }
+            taken &= mask;
+            // All lanes together and going the same way: no need to reschedule
+            if (converged)
+            {
+                if (memcmp(&taken, &mask, sizeof(LaneVector)) == 0)
+                {
+                    pc = instr->arg;
+                    continue;
+                }
+                if (memcmp(&taken, &none, sizeof(LaneVector)) == 0)
+                {
+                    pc++;
+                    continue;
+                }
+            }
+            LaneVector next = (taken & instr->arg) | (~taken & (pc + 1));
+            pcs = laneBlend(pcs, next, mask);
+            sps = laneBlend(sps, laneSplat(sp), mask);
+            goto schedule;
+        }
+        case LABEL:
+            break;
+        case READ:
+            for (int lane = 0; lane < lanes; lane++)
+            {
+                if (!mask[lane])
+                    continue;
+                if (batch->cursor[lane] >= batch->recordStart[lane + 1])
+                    LANE_FAIL(lane, "Missing input for readln");
+                else
+                    frame[instr->arg][lane] = batch->values[batch->cursor[lane]++];
+            }
+            break;
+        case WRITE:
+            sp--;
+            for (int lane = 0; lane < lanes; lane++)
+                if (mask[lane])
+                    laneWrite(&batch->output[lane], stack[sp][lane]);
+            break;
+        case VALUE_AT:
+            // Each lane has its own index: a gather
+            for (int lane = 0; lane < lanes; lane++)
+            {
+                if (!mask[lane])
+                    continue;
+                int index = stack[sp - 1][lane];
+                if ((unsigned)index >= (unsigned)instr->length)
+                    LANE_FAIL(lane, "Array index out of bounds");
+                else
+                    stack[sp - 1][lane] = frame[instr->arg + index][lane];
+            }
+            break;
+        case ASSIGN_AT:
+            for (int lane = 0; lane < lanes; lane++)
+            {
+                if (!mask[lane])
+                    continue;
+                int index = stack[sp - 2][lane];
+                if ((unsigned)index >= (unsigned)instr->length)
+                    LANE_FAIL(lane, "Array index out of bounds");
+                else
+                    frame[instr->arg + index][lane] = stack[sp - 1][lane];
+            }
+            sp -= 2;
+            break;
+        case ARRAY_ADD:
+        case ARRAY_SUB:
+        case ARRAY_MUL:
+            for (int k = 0; k < instr->length; k++)
+            {
+                LaneUVector left = (LaneUVector)frame[instr->arg2 + k], right = (LaneUVector)frame[instr->arg3 + k];
+                LaneUVector result = instr->type == ARRAY_ADD ? left + right : (instr->type == ARRAY_SUB ? left - right : left * right);
+                frame[instr->arg + k] = laneBlend(frame[instr->arg + k], (LaneVector)result, mask);
+            }
+            break;
+        case VADD:
+        case VSUB:
+        case VMUL:
+            // Slots are already lane vectors: one operation per slot of the run
+            for (int k = 0; k < VECTOR_WIDTH; k++)
+            {
+                LaneUVector left = (LaneUVector)frame[instr->arg2 + k], right = (LaneUVector)frame[instr->arg3 + k];
+                LaneUVector result = instr->type == VADD ? left + right : (instr->type == VSUB ? left - right : left * right);
+                frame[instr->arg + k] = laneBlend(frame[instr->arg + k], (LaneVector)result, mask);
+            }
+            break;
+        case SELECT:
+            // Per lane, so lanes that disagree on the condition stay together
+            sp -= 2;
+            stack[sp - 1] = laneBlend(stack[sp - 1], laneBlend(stack[sp], stack[sp - 1], stack[sp + 1] != 0), mask);
+            break;
+        case VALUE2_ADD:
+            stack[sp] = laneBlend(stack[sp], (LaneVector)((LaneUVector)frame[instr->arg] + (LaneUVector)frame[instr->arg2]), mask);
+            sp++;
+            break;
+        case VALUE2_SUB:
+            stack[sp] = laneBlend(stack[sp], (LaneVector)((LaneUVector)frame[instr->arg] - (LaneUVector)frame[instr->arg2]), mask);
+            sp++;
+            break;
+        case VALUE2_MUL:
+            stack[sp] = laneBlend(stack[sp], (LaneVector)((LaneUVector)frame[instr->arg] * (LaneUVector)frame[instr->arg2]), mask);
+            sp++;
+            break;
+        case PUSH_ADD:
+            stack[sp - 1] = laneBlend(stack[sp - 1], (LaneVector)((LaneUVector)stack[sp - 1] + (unsigned)instr->arg), mask);
+            break;
+        case PUSH_SUB:
+            stack[sp - 1] = laneBlend(stack[sp - 1], (LaneVector)((LaneUVector)stack[sp - 1] - (unsigned)instr->arg), mask);
+            break;
+        case PUSH_MUL:
+            stack[sp - 1] = laneBlend(stack[sp - 1], (LaneVector)((LaneUVector)stack[sp - 1] * (unsigned)instr->arg), mask);
+            break;
+        case ASSIGN_TO:
+            sp--;
+            frame[instr->arg] = laneBlend(frame[instr->arg], stack[sp], mask);
+            break;
+        case ASSIGN_CONST:
+            frame[instr->arg] = laneBlend(frame[instr->arg], laneSplat(instr->arg2), mask);
+            break;
+        case ASSIGN_VALUE:
+            frame[instr->arg] = laneBlend(frame[instr->arg], frame[instr->arg2], mask);
+            break;
+        case WRITE_VALUE:
+            for (int lane = 0; lane < lanes; lane++)
+                if (mask[lane])
+                    laneWrite(&batch->output[lane], frame[instr->arg][lane]);
+            break;
+        default:
+            for (int lane = 0; lane < lanes; lane++)
+                if (mask[lane])
+                    LANE_FAIL(lane, "Unknown instruction");
+            break;
+        }
+        if (active == 0)
+            goto schedule;
+        pc++;
+    }
+    // The lanes in mask ran off the end of the program
+    pcs = laneBlend(pcs, laneSplat(code.size), mask);
+    goto schedule;
+
+done:
+#undef LANE_FAIL
+#undef LANE_ARITHMETIC
+#undef LANE_COMPARE
+    batch->executed += executed;
+}
+int executeBatch(const char *inputPath, long long *records, long long *executed)
+{
+    // Lanes share one stack pointer per pc, which only verification guarantees
+    if (!code.verified && verifyStackCode() != 0)
+    {
+        fprintf(stderr, "Error: Batch execution needs verified code.\n");
+        return -1;
+    }
+    if (!code.linked && linkStackCode(1) != 0)
+        return -1;
+
+    InputStream input;
+    if (openInput(&input, inputPath) != 0)
+        return -1;
+    BatchState batch;
+    OutputStream output;
+    if (initBatch(&batch) != 0 || openOutput(&output, STDOUT_FILENO) != 0)
+    {
+        runtimeError("Out of memory", 0);
+        freeBatch(&batch);
+        closeInput(&input);
+        return -1;
+    }
+    fflush(stdout);
+
+    int status = 0;
+    int lanes;
+    long long count = 0;
+    while ((lanes = loadBatch(&batch, &input, count)) > 0)
+    {
+        runBatch(&batch, lanes, count);
+        // Records leave in input order, whatever order their lanes finished in
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            if (batch.output[lane].size > 0)
+                writeBytes(&output, batch.output[lane].text, batch.output[lane].size);
+            if (batch.failed[lane])
+                status = -1;
+        }
+        count += lanes;
+    }
+    if (lanes < 0)
+        status = -1;
+
+    if (closeOutput(&output) != 0)
+        status = -1;
+    closeInput(&input);
+    if (records)
+        *records = count;
+    if (executed)
+        *executed = batch.executed;
+    freeBatch(&batch);
+    return status;
+}
+
+// Parallel execution functions implementation//
+long long splitShards(ShardPool *pool, size_t size, int shardSize)
+{
+    int capacity = 64;
+    long long record = 1;
+    size_t offset = 0;
+    pool->shards = (Shard *)malloc(capacity * sizeof(Shard));
+    pool->shardCount = 0;
+    if (pool->shards == NULL)
+        return -1;
+    while (offset < size)
+    {
+        if (pool->shardCount == capacity)
+        {
+            capacity *= 2;
+            Shard *grown = (Shard *)realloc(pool->shards, capacity * sizeof(Shard));
+            if (grown == NULL)
+                return -1;
+            pool->shards = grown;
+        }
+        Shard *shard = &pool->shards[pool->shardCount++];
+        memset(shard, 0, sizeof(*shard));
+        shard->start = offset;
+        shard->firstRecord = record;
+        for (int n = 0; n < shardSize && offset < size; n++)
+        {
+            const char *newline = (const char *)memchr(pool->data + offset, '\n', size - offset);
+            offset = newline ? (size_t)(newline - pool->data) + 1 : size;
+            record++;
+        }
+        shard->end = offset;
+    }
+    return record - 1;
+}
+int takeShard(ShardWorker *worker)
+{
+    unsigned long long range = atomic_load(&worker->range);
+    for (;;)
+    {
+        unsigned low = (unsigned)range;
+        unsigned high = (unsigned)(range >> 32);
+        if (low >= high)
+            return -1;
+        if (atomic_compare_exchange_weak(&worker->range, &range, SHARD_RANGE(low + 1, high)))
+            return (int)low;
+    }
+}
+int stealShards(ShardWorker *thief)
+{
+    ShardPool *pool = thief->pool;
+    for (int k = 1; k < pool->workerCount; k++)
+    {
+        ShardWorker *victim = &pool->workers[(thief->index + k) % pool->workerCount];
+        unsigned long long range = atomic_load(&victim->range);
+        for (;;)
+        {
+            unsigned low = (unsigned)range;
+            unsigned high = (unsigned)(range >> 32);
+            if (low >= high)
+                break;
+            // Take the upper half; the owner keeps popping from the bottom
+            unsigned middle = low + (high - low) / 2;
+            if (atomic_compare_exchange_weak(&victim->range, &range, SHARD_RANGE(low, middle)))
+            {
+                atomic_store(&thief->range, SHARD_RANGE(middle + 1, high));
+                return (int)middle;
+            }
+        }
+    }
+    return -1;
+}
+void runShard(ShardWorker *worker, Shard *shard)
+{
+    VmState *vm = &worker->vm;
+    const char *cursor = worker->pool->data + shard->start;
+    const char *end = worker->pool->data + shard->end;
+    long long record = shard->firstRecord;
+    InputStream input;
+
+    if (openOutput(&shard->output, -1) != 0)
+    {
+        shard->failed = 1;
+        return;
+    }
+    vm->input = &input;
+    vm->output = &shard->output;
+    while (cursor < end)
+    {
+        const char *newline = (const char *)memchr(cursor, '\n', end - cursor);
+        const char *lineEnd = newline ? newline : end;
+        openInputMemory(&input, cursor, lineEnd - cursor);
+        vm->pc = 0;
+        vm->sp = 0;
+        vm->record = record++;
+        memset(vm->frame, 0, (vm->frameSize + 1) * sizeof(int));
+        if (runVm(vm) != VM_HALTED)
+            shard->failed = 1;
+        cursor = lineEnd + 1;
+    }
+}
+void *shardWorkerMain(void *arg)
+{
+    ShardWorker *worker = (ShardWorker *)arg;
+    ShardPool *pool = worker->pool;
+    int index;
+    while ((index = takeShard(worker)) >= 0 || (index = stealShards(worker)) >= 0)
+    {
+        runShard(worker, &pool->shards[index]);
+        pthread_mutex_lock(&pool->lock);
+        pool->shards[index].done = 1;
+        pthread_cond_signal(&pool->shardDone);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+int executeParallel(const char *inputPath, int threads, int shardSize, long long *records, long long *executed)
+{
+    // Workers share the code read-only, so verify and link it before they start
+    if (prepareStackCode() != 0)
+        return -1;
+
+    InputStream input;
+    if (openInput(&input, inputPath) != 0)
+        return -1;
+    ShardPool pool;
+    memset(&pool, 0, sizeof(pool));
+    long long count = -1;
+    if (loadInput(&input) == 0)
+    {
+        pool.data = input.buffer;
+        count = splitShards(&pool, input.size, shardSize > 0 ? shardSize : DEFAULT_SHARD_SIZE);
+    }
+    if (count < 0)
+    {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(pool.shards);
+        closeInput(&input);
+        return -1;
+    }
+
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > pool.shardCount)
+        threads = pool.shardCount;
+    if (threads < 1)
+        threads = 1;
+    pool.workerCount = threads;
+    pool.workers = (ShardWorker *)calloc(threads, sizeof(ShardWorker));
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.shardDone, NULL);
+
+    int status = 0;
+    int started = 0;
+    for (int w = 0; w < threads; w++)
+    {
+        ShardWorker *worker = &pool.workers[w];
+        worker->index = w;
+        worker->pool = &pool;
+        // Contiguous initial ranges; stealing evens out the uneven shards
+        atomic_init(&worker->range, SHARD_RANGE((long long)pool.shardCount * w / threads,
+                                                (long long)pool.shardCount * (w + 1) / threads));
+        if (initVm(&worker->vm) != 0)
+            status = -1;
+    }
+    if (status == 0)
+    {
+        for (int w = 0; w < threads; w++)
+        {
+            ShardWorker *worker = &pool.workers[w];
+            worker->started = pthread_create(&worker->thread, NULL, shardWorkerMain, worker) == 0;
+            started += worker->started;
+        }
+        // Without any thread the caller does the work; otherwise idle workers
+        // steal the shards of any thread that failed to start
+        if (started == 0)
+            shardWorkerMain(&pool.workers[0]);
+    }
+    else
+        runtimeError("Out of memory", 0);
+
+    OutputStream output;
+    fflush(stdout);
+    if (status == 0 && openOutput(&output, STDOUT_FILENO) == 0)
+    {
+        // Merge in input order, while later shards are still running
+        for (int i = 0; i < pool.shardCount; i++)
+        {
+            Shard *shard = &pool.shards[i];
+            pthread_mutex_lock(&pool.lock);
+            while (!shard->done)
+                pthread_cond_wait(&pool.shardDone, &pool.lock);
+            pthread_mutex_unlock(&pool.lock);
+            if (shard->output.buffer != NULL)
+                writeBytes(&output, shard->output.buffer, shard->output.size);
+            free(shard->output.buffer);
+            if (shard->failed)
+                status = -1;
+        }
+        if (closeOutput(&output) != 0)
+            status = -1;
+    }
+
+    long long total = 0;
+    for (int w = 0; w < threads; w++)
+    {
+        ShardWorker *worker = &pool.workers[w];
+        if (worker->started)
+            pthread_join(worker->thread, NULL);
+        total += worker->vm.executed;
+        freeVm(&worker->vm);
+    }
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.shardDone);
+    free(pool.workers);
+    free(pool.shards);
+    closeInput(&input);
+    if (records)
+        *records = count;
+    if (executed)
+        *executed = total;
+    return status;
+}
+
+// Profiler functions implementation//
+int initExecutionProfile(ExecutionProfile *profile)
+{
+    memset(profile, 0, sizeof(*profile));
+    profile->size = code.size;
+    profile->hits = (long long *)calloc(code.size + 1, sizeof(long long));
+    profile->taken = (long long *)calloc(code.size + 1, sizeof(long long));
+    return profile->hits != NULL && profile->taken != NULL ? 0 : -1;
+}
+void freeExecutionProfile(ExecutionProfile *profile)
+{
+    free(profile->hits);
+    free(profile->taken);
+    profile->hits = NULL;
+    profile->taken = NULL;
+    profile->size = 0;
+}
+int compareHotspots(const void *a, const void *b)
+{
+    const RankedCount *x = (const RankedCount *)a, *y = (const RankedCount *)b;
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+void printProfileReport(const ExecutionProfile *profile, const char *sourcePath, FILE *out)
+{
+    long long total = 0;
+    int lastLine = 0;
+    for (int i = 0; i < profile->size; i++)
+    {
+        total += profile->hits[i];
+        if (code.instructions[i].line > lastLine)
+            lastLine = code.instructions[i].line;
+    }
+    double scale = total > 0 ? 100.0 / total : 0.0;
+
+    // Annotated source: every instruction is charged to its statement's line
+    long long *lineHits = (long long *)calloc(lastLine + 1, sizeof(long long));
+    int *lineInstructions = (int *)calloc(lastLine + 1, sizeof(int));
+    for (int i = 0; i < profile->size; i++)
+    {
+        lineHits[code.instructions[i].line] += profile->hits[i];
+        lineInstructions[code.instructions[i].line]++;
+    }
+    fprintf(out, "\nProfile of %s: %lld instructions executed\n\n", sourcePath, total);
+    fprintf(out, "  Executions       %%   Line | Source\n");
+    fprintf(out, "----------------------------+--------------------------------------\n");
+    FILE *source = fopen(sourcePath, "r");
+    char text[512];
+    int line = 0;
+    while (source != NULL && fgets(text, sizeof(text), source) != NULL)
+    {
+        size_t length = strlen(text);
+        int complete = length > 0 && text[length - 1] == '\n';
+        if (complete)
+            text[length - 1] = '\0';
+        line++;
+        if (line <= lastLine && lineInstructions[line] > 0)
+            fprintf(out, "%12lld  %5.1f%%  %5d | %s\n", lineHits[line], lineHits[line] * scale, line, text);
+        else
+            fprintf(out, "%12s  %6s  %5d | %s\n", "", "", line, text);
+        // Overlong lines: print the rest without a new prefix
+        while (!complete && fgets(text, sizeof(text), source) != NULL)
+        {
+            length = strlen(text);
+            complete = length > 0 && text[length - 1] == '\n';
+            fputs(text, out);
+        }
+    }
+    if (source != NULL)
+        fclose(source);
+    else
+        fprintf(out, "(source '%s' not available)\n", sourcePath);
+    free(lineHits);
+    free(lineInstructions);
+
+    // Hottest instructions
+    RankedCount *ranked = (RankedCount *)malloc((profile->size + 1) * sizeof(RankedCount));
+    int rankedCount = 0;
+    for (int i = 0; i < profile->size; i++)
+        if (profile->hits[i] > 0)
+        {
+            ranked[rankedCount].count = profile->hits[i];
+            ranked[rankedCount].index = i;
+            rankedCount++;
+        }
+    qsort(ranked, rankedCount, sizeof(RankedCount), compareHotspots);
+    fprintf(out, "\nHotspots:\n");
+    fprintf(out, "  Rank  Instr   Line  %-24s  Executions       %%  Taken / not taken\n", "Instruction");
+    for (int r = 0; r < rankedCount && r < PROFILE_HOTSPOTS; r++)
+    {
+        const Instruction *instr = &code.instructions[ranked[r].index];
+        char buffer[64];
+        formatInstruction(instr, buffer, sizeof(buffer));
+        fprintf(out, "  %4d  %5d  %5d  %-24s  %10lld  %5.1f%%", r + 1, ranked[r].index, instr->line, buffer,
+                ranked[r].count, ranked[r].count * scale);
+        if (isJumpInstruction(instr->type) && instr->type != GOTO)
+            fprintf(out, "  %lld / %lld", profile->taken[ranked[r].index],
+                    ranked[r].count - profile->taken[ranked[r].index]);
+        fprintf(out, "\n");
+    }
+
+    // Labels: how often control reached each one, by jump or fall-through
+    int cursor = 0;
+    int printed = 0;
+    for (int i = 0; i < profile->size; i++)
+    {
+        int label;
+        while ((label = labelAt(i, &cursor)) >= 0 || code.instructions[i].type == LABEL)
+        {
+            if (label < 0)
+                label = code.instructions[i].label;
+            char name[16];
+            snprintf(name, sizeof(name), "L%d", label);
+            if (printed++ == 0)
+                fprintf(out, "\nLabels:\n");
+            fprintf(out, "  %-8s @%-6d %10lld\n", name, i, profile->hits[i]);
+            if (code.instructions[i].type == LABEL)
+                break;
+        }
+    }
+
+    // Opcode pairs
+    rankedCount = 0;
+    ranked = (RankedCount *)realloc(ranked, INSTRUCTION_TYPE_COUNT * INSTRUCTION_TYPE_COUNT * sizeof(RankedCount));
+    for (int a = 0; a < INSTRUCTION_TYPE_COUNT; a++)
+        for (int b = 0; b < INSTRUCTION_TYPE_COUNT; b++)
+            if (profile->pairs.counts[a][b] > 0)
+            {
+                ranked[rankedCount].count = profile->pairs.counts[a][b];
+                ranked[rankedCount].index = a * INSTRUCTION_TYPE_COUNT + b;
+                rankedCount++;
+            }
+    qsort(ranked, rankedCount, sizeof(RankedCount), compareHotspots);
+    double pairScale = profile->pairs.total > 0 ? 100.0 / profile->pairs.total : 0.0;
+    fprintf(out, "\nOpcode pairs:\n");
+    for (int r = 0; r < rankedCount && r < PROFILE_HOTSPOTS; r++)
+    {
+        char pair[64];
+        snprintf(pair, sizeof(pair), "%s -> %s", instructionName(ranked[r].index / INSTRUCTION_TYPE_COUNT),
+                 instructionName(ranked[r].index % INSTRUCTION_TYPE_COUNT));
+        fprintf(out, "  %-32s %10lld  %5.1f%%\n", pair, ranked[r].count, ranked[r].count * pairScale);
+    }
+    free(ranked);
+}
+
+// Loop optimization functions implementation//
+int optimizeLoops()
+{
+    return optimizeLoopRange(0);
+}
+int optimizeLoopRange(int start)
+{
+    if (code.linked)
+        return 0;
+
+    // Rotated loops end in a backward conditional jump to a body label that
+    // follows the entry goto. The code is put back one instruction at a time, so
+    // a loop is at the end when its back edge arrives: inner loops come first,
+    // and rewriting one moves nothing but the loop itself.
+    // Hoisted values are read inside their loop only, and loops of the same height
+    // are never nested: they share their temporaries instead of each making its own.
+    int optimized = 0;
+    int verified = code.verified;
+    int count;
+    Instruction *input = cutInstructions(start, &count);
+    LabelIndex labels;
+    buildLabelRange(&labels, code.size);
+    int *ordinals = NULL; // labels of the loop being rewritten, in order
+    int ordinalCapacity = 0;
+    LoopTemporaries temporaries = {0};
+    for (int i = 0; i < count; i++)
+    {
+        appendInstructions(&input[i], 1);
+        int pc = code.size - 1;
+        const Instruction *instr = &code.instructions[pc];
+        if (instr->type == LABEL)
+            addLabel(&labels, pc);
+        if (!isJumpInstruction(instr->type) || instr->type == GOTO)
+            continue;
+        int target = jumpTargetPosition(instr, &labels);
+        if (target <= start || target > pc || code.instructions[target - 1].type != GOTO)
+            continue;
+        // Again until nothing changes: a hoisted factor can make a product reducible
+        for (int pass = 0; pass < 4; pass++)
+        {
+            int bodyStart = jumpTargetPosition(&code.instructions[pc], &labels);
+            int ordinalCount = 0;
+            for (int p = bodyStart; p <= pc; p++)
+            {
+                if (code.instructions[p].type != LABEL)
+                    continue;
+                if (ordinalCount >= ordinalCapacity)
+                {
+                    ordinalCapacity = ordinalCapacity ? ordinalCapacity * 2 : 16;
+                    ordinals = (int *)realloc(ordinals, ordinalCapacity * sizeof(int));
+                }
+                int ordinal = findLabel(&labels, code.instructions[p].label);
+                ordinals[ordinalCount++] = labels.positions[ordinal] == p ? ordinal : -1; // -1: a redefinition
+            }
+            beginLoopTemporaries(&temporaries, bodyStart - 1);
+            if (!optimizeLoop(bodyStart - 1, bodyStart, &pc, &temporaries))
+                break;
+            endLoopTemporaries(&temporaries, bodyStart - 1, pc);
+            optimized++;
+            // The rewritten loop keeps its labels, in the same order
+            for (int p = bodyStart - 1, k = 0; p < code.size && k < ordinalCount; p++)
+            {
+                if (code.instructions[p].type != LABEL)
+                    continue;
+                if (ordinals[k] >= 0)
+                    labels.positions[ordinals[k]] = p;
+                k++;
+            }
+        }
+    }
+    free(ordinals);
+    free(input);
+    freeLabelIndex(&labels);
+    freeLoopTemporaries(&temporaries);
+    if (optimized == 0)
+        code.verified = verified;
+    return optimized;
+}
+int inductionStep(const Instruction *instr, int available, int *step)
+{
+    // i := i + c, i := c + i or i := i - c, as emitted: STORE i; ...; ASSIGN
+    if (available < 5 || instr[0].type != STORE || instr[4].type != ASSIGN)
+        return 0;
+    int slot = instr[0].arg;
+    if (instr[1].type == VALUE && instr[1].arg == slot && instr[2].type == PUSH &&
+        (instr[3].type == ADD || instr[3].type == SUB))
+    {
+        *step = instr[3].type == ADD ? instr[2].arg : (int)(0u - (unsigned)instr[2].arg);
+        return 1;
+    }
+    if (instr[1].type == PUSH && instr[2].type == VALUE && instr[2].arg == slot && instr[3].type == ADD)
+    {
+        *step = instr[1].arg;
+        return 1;
+    }
+    return 0;
+}
+int optimizeLoop(int preheader, int bodyStart, int *loopEnd, LoopTemporaries *temporaries)
+{
+    int backEdge = *loopEnd;
+    int length = backEdge - bodyStart + 1;
+    if (code.variableCount + 1 > loopSlots.capacity)
+    {
+        int capacity = loopSlots.capacity ? loopSlots.capacity : 16;
+        while (capacity < code.variableCount + 1)
+            capacity *= 2;
+        loopSlots.writes = (int *)realloc(loopSlots.writes, capacity * sizeof(int));
+        loopSlots.steps = (int *)realloc(loopSlots.steps, capacity * sizeof(int));
+        memset(loopSlots.writes + loopSlots.capacity, 0, (capacity - loopSlots.capacity) * sizeof(int));
+        memset(loopSlots.steps + loopSlots.capacity, 0, (capacity - loopSlots.capacity) * sizeof(int));
+        loopSlots.capacity = capacity;
+    }
+    int *writes = loopSlots.writes;
+    int *steps = loopSlots.steps;
+    int *written = (int *)malloc(length * sizeof(int)); // slots to clear again on return
+    int writtenCount = 0;
+    int *rewrite = (int *)malloc(length * sizeof(int)); // value computed by the code starting here
+    LoopValue *values = (LoopValue *)malloc((length + 1) * sizeof(LoopValue));
+    LoopValue stack[MAX_STACK_DEPTH];
+    int valueCount = 0;
+    int depth = 0;
+    int usable = 1;
+
+    // Variables the loop writes; induction variables are written by steps only
+    for (int p = bodyStart; p <= backEdge && usable; p++)
+    {
+        const Instruction *instr = &code.instructions[p];
+        int step;
+        rewrite[p - bodyStart] = -1;
+        if (instr->type >= SELECT)
+            usable = 0; // if-conversion, vectorization and superinstructions come after this pass
+        else if (instr->type == STORE || instr->type == READ)
+        {
+            if (writes[instr->arg]++ == 0)
+                written[writtenCount++] = instr->arg;
+            if (inductionStep(instr, backEdge - p + 1, &step))
+                steps[instr->arg]++;
+        }
+    }
+#define LOOP_INDUCTION(slot) (steps[slot] > 0 && steps[slot] == writes[slot])
+
+#define LOOP_CANDIDATE(v)                                      \
+    do                                                         \
+    {                                                          \
+        if ((v).invariant && (v).end > (v).start)              \
+        {                                                      \
+            values[valueCount] = (v);                          \
+            rewrite[(v).start - bodyStart] = valueCount++;     \
+        }                                                      \
+    } while (0)
+
+    // Evaluate the operand stack symbolically: each entry is the code range
+    // that computed it. Invariant ranges are hoisted once they stop growing.
+    for (int p = bodyStart; p <= backEdge && usable; p++)
+    {
+        const Instruction *instr = &code.instructions[p];
+        int pops = 0;
+        switch (instr->type)
+        {
+        case PUSH:
+        case VALUE:
+        case STORE:
+        {
+            int invariant = instr->type == PUSH || (instr->type == VALUE && writes[instr->arg] == 0);
+            LoopValue leaf = {LOOP_HOIST, p, p, invariant, -1, -1, -1};
+            if (depth >= MAX_STACK_DEPTH)
+                usable = 0;
+            else
+                stack[depth++] = leaf;
+            break;
+        }
+        case SWAP:
+        {
+            if (depth < 2)
+            {
+                usable = 0;
+                break;
+            }
+            LoopValue top = stack[depth - 1];
+            stack[depth - 1] = stack[depth - 2];
+            stack[depth - 2] = top;
+            break;
+        }
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case COMP_LT:
+        case COMP_GT:
+        case COMP_LE:
+        case COMP_GE:
+        case COMP_EQ:
+        case COMP_NE:
+        {
+            if (depth < 2)
+            {
+                usable = 0;
+                break;
+            }
+            LoopValue right = stack[--depth];
+            LoopValue left = stack[--depth];
+            LoopValue result = {LOOP_HOIST, left.start < right.start ? left.start : right.start, p,
+                                left.invariant && right.invariant, -1, -1, -1};
+            // Hoisted code runs even if the loop does not: it must not trap
+            if (instr->type == DIV && !(right.start == right.end && code.instructions[right.start].type == PUSH &&
+                                        code.instructions[right.start].arg != 0))
+                result.invariant = 0;
+
+            // Induction variable times an invariant operand: a running product
+            if (instr->type == MUL && left.start == p - 2 && left.end == p - 2 && right.start == p - 1 && right.end == p - 1)
+            {
+                const Instruction *a = &code.instructions[p - 2], *b = &code.instructions[p - 1];
+                if (a->type == VALUE && LOOP_INDUCTION(a->arg) && right.invariant)
+                    result.induction = a->arg, result.factor = p - 1;
+                else if (b->type == VALUE && LOOP_INDUCTION(b->arg) && left.invariant)
+                    result.induction = b->arg, result.factor = p - 2;
+                if (result.induction >= 0)
+                {
+                    result.kind = LOOP_REDUCE;
+                    values[valueCount] = result;
+                    rewrite[result.start - bodyStart] = valueCount++;
+                }
+            }
+            if (!result.invariant)
+            {
+                LOOP_CANDIDATE(left);
+                LOOP_CANDIDATE(right);
+            }
+            stack[depth++] = result;
+            break;
+        }
+        case VALUE_AT:
+        {
+            // The loop may store into the array, and a hoisted load could fail: never invariant
+            if (depth < 1)
+            {
+                usable = 0;
+                break;
+            }
+            LoopValue index = stack[depth - 1];
+            LOOP_CANDIDATE(index);
+            LoopValue element = {LOOP_HOIST, index.start, p, 0, -1, -1, -1};
+            stack[depth - 1] = element;
+            break;
+        }
+        case ASSIGN:
+        case ASSIGN_AT:
+            pops = 2;
+            break;
+        case WRITE:
+        case GO_FALSE:
+        case GO_TRUE:
+            pops = 1;
+            break;
+        default:
+            break;
+        }
+        if (pops > depth)
+            usable = 0;
+        for (int k = 0; k < pops && usable; k++)
+        {
+            depth--;
+            LOOP_CANDIDATE(stack[depth]);
+        }
+    }
+#undef LOOP_CANDIDATE
+
+    if (!usable || valueCount == 0)
+    {
+        for (int i = 0; i < writtenCount; i++)
+            writes[written[i]] = steps[written[i]] = 0;
+        free(written);
+        free(rewrite);
+        free(values);
+        return 0;
+    }
+
+    // Preheader: one temporary per hoisted value. Products of the same
+    // induction variable and factor share theirs.
+    char operand[MAX_LEXEME_LENGTH];
+    int tailCount;
+    Instruction *tail = cutInstructions(preheader, &tailCount);
+#define LOOP_AT(position) (&tail[(position) - preheader])
+    code.line = tail[0].line;
+    for (int v = 0; v < valueCount; v++)
+    {
+        LoopValue *value = &values[v];
+        for (int w = 0; w < v && value->kind == LOOP_REDUCE; w++)
+        {
+            if (values[w].kind == LOOP_REDUCE && values[w].induction == value->induction &&
+                LOOP_AT(values[w].factor)->type == LOOP_AT(value->factor)->type &&
+                LOOP_AT(values[w].factor)->arg == LOOP_AT(value->factor)->arg)
+            {
+                value->temporary = values[w].temporary;
+                break;
+            }
+        }
+        if (value->temporary >= 0)
+        {
+            value->kind = LOOP_SHARED;
+            continue;
+        }
+        value->temporary = takeLoopTemporary(temporaries);
+        emitStack(STORE, code.variables[value->temporary]);
+        appendInstructions(LOOP_AT(value->start), value->end - value->start + 1);
+        emitStack(ASSIGN, NULL);
+    }
+
+    // Each step of an induction variable steps its products by step * factor,
+    // computed here when the factor is a variable
+    int *stepTemporaries = (int *)malloc((valueCount * 2 + 1) * sizeof(int)); // pairs: value, temporary
+    int stepTemporaryCount = 0;
+    for (int p = bodyStart; p <= backEdge; p++)
+    {
+        int step;
+        if (!inductionStep(LOOP_AT(p), backEdge - p + 1, &step))
+            continue;
+        for (int v = 0; v < valueCount; v++)
+        {
+            if (values[v].kind != LOOP_REDUCE || values[v].induction != LOOP_AT(p)->arg)
+                continue;
+            const Instruction *factor = LOOP_AT(values[v].factor);
+            if (factor->type != VALUE || step == 1)
+                continue;
+            int temporary = takeLoopTemporary(temporaries);
+            emitStack(STORE, code.variables[temporary]);
+            snprintf(operand, sizeof(operand), "%d", step);
+            emitStack(PUSH, operand);
+            emitStack(VALUE, code.variables[factor->arg]);
+            emitStack(MUL, NULL);
+            emitStack(ASSIGN, NULL);
+            stepTemporaries[stepTemporaryCount++] = temporary;
+        }
+    }
+
+    // The loop, with hoisted ranges read from their temporaries
+    int stepTemporary = 0;
+    int newBackEdge = -1;
+    for (int i = 0; i < tailCount; i++)
+    {
+        int position = preheader + i;
+        int value = position >= bodyStart && position <= backEdge ? rewrite[position - bodyStart] : -1;
+        code.line = tail[i].line;
+        if (value >= 0)
+        {
+            emitStack(VALUE, code.variables[values[value].temporary]);
+            i += values[value].end - values[value].start;
+            continue;
+        }
+        appendInstructions(&tail[i], 1);
+        if (position == backEdge)
+            newBackEdge = code.size - 1;
+
+        int step;
+        if (position < bodyStart || position > backEdge || tail[i].type != STORE ||
+            !inductionStep(&tail[i], tailCount - i, &step))
+            continue;
+        appendInstructions(&tail[i + 1], 4);
+        i += 4;
+        for (int v = 0; v < valueCount; v++)
+        {
+            if (values[v].kind != LOOP_REDUCE || values[v].induction != tail[i - 4].arg)
+                continue;
+            const Instruction *factor = LOOP_AT(values[v].factor);
+            const char *product = code.variables[values[v].temporary];
+            emitStack(STORE, product);
+            emitStack(VALUE, product);
+            if (factor->type == PUSH)
+            {
+                snprintf(operand, sizeof(operand), "%d", (int)((unsigned)step * (unsigned)factor->arg));
+                emitStack(PUSH, operand);
+            }
+            else if (step == 1)
+                emitStack(VALUE, code.variables[factor->arg]);
+            else
+                emitStack(VALUE, code.variables[stepTemporaries[stepTemporary++]]);
+            emitStack(ADD, NULL);
+            emitStack(ASSIGN, NULL);
+        }
+    }
+#undef LOOP_AT
+#undef LOOP_INDUCTION
+    free(stepTemporaries);
+    free(tail);
+    for (int i = 0; i < writtenCount; i++)
+        writes[written[i]] = steps[written[i]] = 0;
+    free(written);
+    free(rewrite);
+    free(values);
+    *loopEnd = newBackEdge;
+    return 1;
+}
+void beginLoopTemporaries(LoopTemporaries *temporaries, int start)
+{
+    // The loops rewritten inside this one are the last frames, ending at or after its start
+    temporaries->height = 1;
+    for (int f = temporaries->frameCount - 1; f >= 0 && temporaries->frameEnds[f] >= start; f--)
+    {
+        if (temporaries->frameHeights[f] >= temporaries->height)
+            temporaries->height = temporaries->frameHeights[f] + 1;
+    }
+    temporaries->taken = 0;
+    if (temporaries->height > temporaries->poolCount)
+    {
+        int count = temporaries->height;
+        temporaries->pools = (int **)realloc(temporaries->pools, count * sizeof(int *));
+        temporaries->poolSizes = (int *)realloc(temporaries->poolSizes, count * sizeof(int));
+        temporaries->poolCapacities = (int *)realloc(temporaries->poolCapacities, count * sizeof(int));
+        for (int h = temporaries->poolCount; h < count; h++)
+        {
+            temporaries->pools[h] = NULL;
+            temporaries->poolSizes[h] = temporaries->poolCapacities[h] = 0;
+        }
+        temporaries->poolCount = count;
+    }
+}
+int takeLoopTemporary(LoopTemporaries *temporaries)
+{
+    int h = temporaries->height - 1;
+    if (temporaries->taken < temporaries->poolSizes[h])
+        return temporaries->pools[h][temporaries->taken++];
+    if (temporaries->poolSizes[h] >= temporaries->poolCapacities[h])
+    {
+        temporaries->poolCapacities[h] = temporaries->poolCapacities[h] ? temporaries->poolCapacities[h] * 2 : 8;
+        temporaries->pools[h] = (int *)realloc(temporaries->pools[h], temporaries->poolCapacities[h] * sizeof(int));
+    }
+    char name[MAX_LEXEME_LENGTH];
+    newStackTemporary(name, sizeof(name));
+    int slot = internStackVariable(name);
+    temporaries->pools[h][temporaries->poolSizes[h]++] = slot;
+    temporaries->taken++;
+    return slot;
+}
+void endLoopTemporaries(LoopTemporaries *temporaries, int start, int end)
+{
+    // The frames inside the loop just rewritten give way to its own; their positions
+    // are from before the rewrite, but still at or after its start
+    while (temporaries->frameCount > 0 && temporaries->frameEnds[temporaries->frameCount - 1] >= start)
+        temporaries->frameCount--;
+    if (temporaries->frameCount >= temporaries->frameCapacity)
+    {
+        temporaries->frameCapacity = temporaries->frameCapacity ? temporaries->frameCapacity * 2 : 16;
+        temporaries->frameEnds = (int *)realloc(temporaries->frameEnds, temporaries->frameCapacity * sizeof(int));
+        temporaries->frameHeights =
+            (int *)realloc(temporaries->frameHeights, temporaries->frameCapacity * sizeof(int));
+    }
+    temporaries->frameEnds[temporaries->frameCount] = end;
+    temporaries->frameHeights[temporaries->frameCount++] = temporaries->height;
+}
+void freeLoopTemporaries(LoopTemporaries *temporaries)
+{
+    for (int h = 0; h < temporaries->poolCount; h++)
+        free(temporaries->pools[h]);
+    free(temporaries->pools);
+    free(temporaries->poolSizes);
+    free(temporaries->poolCapacities);
+    free(temporaries->frameEnds);
+    free(temporaries->frameHeights);
+}
+
+// Value numbering functions implementation//
+int numberValues()
+{
+    return numberValueRange(0);
+}
+int numberValueRange(int start)
+{
+    if (code.linked || start >= code.size)
+        return 0;
+    for (int pc = start; pc < code.size; pc++)
+    {
+        if (code.instructions[pc].type >= SELECT)
+            return 0; // if-conversion, vectorization and superinstructions come after this pass
+    }
+
+    ValueTable *table = &valueTable;
+    if (code.variableCount + 1 > table->variableCapacity)
+    {
+        int capacity = table->variableCapacity ? table->variableCapacity : 16;
+        while (capacity < code.variableCount + 1)
+            capacity *= 2;
+        table->variableValues = (int *)realloc(table->variableValues, capacity * sizeof(int));
+        table->variableStamps = (int *)realloc(table->variableStamps, capacity * sizeof(int));
+        memset(table->variableStamps + table->variableCapacity, 0,
+               (capacity - table->variableCapacity) * sizeof(int));
+        table->variableCapacity = capacity;
+    }
+
+    // The whole range is emitted again, one basic block at a time
+    int count;
+    Instruction *tail = cutInstructions(start, &count);
+    if (start == 0)
+        code.maxStackDepth = 0;
+    int rewrites = 0;
+    for (int first = 0; first < count;)
+    {
+        // A label starts a block, a jump ends one
+        int last = first;
+        while (last + 1 < count && tail[last + 1].type != LABEL && !isJumpInstruction(tail[last].type))
+            last++;
+        rewrites += numberBlock(table, tail + first, last - first + 1);
+        first = last + 1;
+    }
+
+    free(tail);
+    return rewrites;
+}
+int lookupValue(ValueTable *table, InstructionType op, int left, int right)
+{
+    unsigned hash = 2166136261u;
+    hash = (hash ^ (unsigned)op) * 16777619u;
+    hash = (hash ^ (unsigned)left) * 16777619u;
+    hash = (hash ^ (unsigned)right) * 16777619u;
+    unsigned bucket = hash & table->bucketMask;
+    // Every input read and array load is a value of its own
+    while (op != READ && op != VALUE_AT && table->buckets[bucket] != 0)
+    {
+        int number = table->buckets[bucket] - 1;
+        const ValueNumber *value = &table->values[number];
+        if (value->op == op && value->left == left && value->right == right)
+            return number;
+        bucket = (bucket + 1) & table->bucketMask;
+    }
+
+    int number = table->count++;
+    table->values[number].op = op;
+    table->values[number].left = left;
+    table->values[number].right = right;
+    table->values[number].holder = -1;
+    if (op != READ && op != VALUE_AT)
+        table->buckets[bucket] = number + 1;
+    return number;
+}
+int variableValue(ValueTable *table, int slot)
+{
+    if (table->variableStamps[slot] != table->stamp)
+    {
+        // First read in the block: whatever the variable held on entry
+        table->variableStamps[slot] = table->stamp;
+        table->variableValues[slot] = lookupValue(table, VALUE, slot, 0);
+        table->values[table->variableValues[slot]].holder = slot;
+    }
+    return table->variableValues[slot];
+}
+void assignValue(ValueTable *table, int slot, int number)
+{
+    table->variableStamps[slot] = table->stamp;
+    table->variableValues[slot] = number;
+    int holder = table->values[number].holder;
+    if (holder < 0 || table->variableStamps[holder] != table->stamp || table->variableValues[holder] != number)
+        table->values[number].holder = slot;
+}
+int compareNumberedRanges(const void *a, const void *b)
+{
+    const NumberedRange *x = (const NumberedRange *)a, *y = (const NumberedRange *)b;
+    if (x->size != y->size)
+        return y->size - x->size;
+    if (x->number != y->number)
+        return x->number - y->number;
+    return x->start - y->start;
+}
+int compareComputedRanges(const void *a, const void *b)
+{
+    const NumberedRange *x = (const NumberedRange *)a, *y = (const NumberedRange *)b;
+    if (x->statement != y->statement)
+        return x->statement - y->statement;
+    return x->end - y->end;
+}
+int numberBlock(ValueTable *table, Instruction *block, int count)
+{
+    NumberedRange *ranges = (NumberedRange *)malloc((count + 1) * sizeof(NumberedRange));
+    int stackNumber[MAX_STACK_DEPTH], stackStart[MAX_STACK_DEPTH];
+    int rangeCount = 0, depth = 0, statement = 0, usable = 1, rewrites = 0;
+
+    // Each instruction makes at most one new value
+    table->stamp++;
+    table->count = 0;
+    if (count + 1 > table->capacity)
+    {
+        table->capacity = count + 1;
+        table->values = (ValueNumber *)realloc(table->values, table->capacity * sizeof(ValueNumber));
+    }
+    int bucketCount = 16;
+    while (bucketCount < 2 * (count + 1))
+        bucketCount *= 2;
+    if (bucketCount > table->bucketCount)
+    {
+        free(table->buckets);
+        table->buckets = (int *)malloc(bucketCount * sizeof(int));
+        table->bucketCount = bucketCount;
+    }
+    memset(table->buckets, 0, bucketCount * sizeof(int));
+    table->bucketMask = bucketCount - 1;
+#define VALUE_HELD(slot, number) \
+    ((slot) >= 0 && table->variableStamps[slot] == table->stamp && table->variableValues[slot] == (number))
+
+    // Evaluate the operand stack symbolically: each entry is a value number
+    // and the code range that computed it
+    for (int p = 0; p < count && usable; p++)
+    {
+        Instruction *instr = &block[p];
+        int number = -1;
+        if (depth == 0)
+            statement = p;
+        switch (instr->type)
+        {
+        case PUSH:
+            number = lookupValue(table, PUSH, instr->arg, 0);
+            break;
+        case VALUE:
+        {
+            number = variableValue(table, instr->arg);
+            ValueNumber *value = &table->values[number];
+            if (!VALUE_HELD(value->holder, number))
+                value->holder = instr->arg;
+            // Constants and copies propagate into later reads
+            if (value->op == PUSH)
+            {
+                instr->type = PUSH;
+                instr->arg = value->left;
+                rewrites++;
+            }
+            else if (value->holder != instr->arg)
+            {
+                instr->arg = value->holder;
+                rewrites++;
+            }
+            break;
+        }
+        case STORE:
+            break;
+        case SWAP:
+        {
+            if (depth < 2)
+            {
+                usable = 0;
+                break;
+            }
+            int topNumber = stackNumber[depth - 1], topStart = stackStart[depth - 1];
+            stackNumber[depth - 1] = stackNumber[depth - 2];
+            stackStart[depth - 1] = stackStart[depth - 2];
+            stackNumber[depth - 2] = topNumber;
+            stackStart[depth - 2] = topStart;
+            continue;
+        }
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case COMP_LT:
+        case COMP_GT:
+        case COMP_LE:
+        case COMP_GE:
+        case COMP_EQ:
+        case COMP_NE:
+        {
+            if (depth < 2)
+            {
+                usable = 0;
+                break;
+            }
+            int right = stackNumber[--depth], rightStart = stackStart[depth];
+            int left = stackNumber[--depth], leftStart = stackStart[depth];
+            InstructionType op = instr->type;
+            // One number for x + y and y + x, and for x > y and y < x
+            if (op == COMP_GT || op == COMP_GE || ((op == ADD || op == MUL || op == COMP_EQ || op == COMP_NE) && left > right))
+            {
+                int swapped = left;
+                left = right;
+                right = swapped;
+                op = mirrorComparison(op);
+            }
+            number = lookupValue(table, op, left, right);
+            NumberedRange *range = &ranges[rangeCount++];
+            range->number = number;
+            range->start = leftStart < rightStart ? leftStart : rightStart;
+            range->end = p;
+            range->statement = statement;
+            range->holder = VALUE_HELD(table->values[number].holder, number) ? table->values[number].holder : -1;
+            range->temporary = -1;
+            range->computed = 0;
+            range->next = -1;
+            stackNumber[depth] = number;
+            stackStart[depth++] = range->start;
+            continue;
+        }
+        case ASSIGN:
+            if (depth < 2)
+                usable = 0;
+            else
+                assignValue(table, block[stackStart[depth - 2]].arg, stackNumber[depth - 1]);
+            depth -= 2;
+            continue;
+        case READ:
+            assignValue(table, instr->arg, lookupValue(table, READ, instr->arg, 0));
+            continue;
+        case VALUE_AT:
+            // Stores through other indices may change the element: each load is a value of its own
+            if (depth < 1)
+                usable = 0;
+            else
+                stackNumber[depth - 1] = lookupValue(table, VALUE_AT, instr->arg, 0);
+            continue;
+        case ASSIGN_AT:
+            depth -= 2;
+            if (depth < 0)
+                usable = 0;
+            continue;
+        case WRITE:
+        case GO_FALSE:
+        case GO_TRUE:
+            if (--depth < 0)
+                usable = 0;
+            continue;
+        default:
+            continue;
+        }
+        if (depth >= MAX_STACK_DEPTH)
+        {
+            usable = 0;
+            break;
+        }
+        stackNumber[depth] = number;
+        stackStart[depth++] = p;
+    }
+#undef VALUE_HELD
+
+    if (!usable || rangeCount == 0)
+    {
+        appendInstructions(block, count);
+        free(ranges);
+        return rewrites;
+    }
+
+    // Decide the longest ranges first: a range inside one that is read from
+    // a variable is gone, one inside a range computed into a temporary is not
+    int *longest = (int *)calloc(table->count, sizeof(int));
+    for (int r = 0; r < rangeCount; r++)
+    {
+        int size = ranges[r].end - ranges[r].start + 1;
+        if (size > longest[ranges[r].number])
+            longest[ranges[r].number] = size;
+    }
+    for (int r = 0; r < rangeCount; r++)
+        ranges[r].size = longest[ranges[r].number];
+    free(longest);
+    qsort(ranges, rangeCount, sizeof(NumberedRange), compareNumberedRanges);
+
+    int *covered = (int *)malloc(count * sizeof(int)); // end of the widest replaced range over each instruction
+    for (int p = 0; p < count; p++)
+        covered[p] = -1;
+#define VALUE_REPLACE(range, slot)                          \
+    do                                                      \
+    {                                                       \
+        (range)->temporary = (slot);                        \
+        for (int q = (range)->start; q <= (range)->end; q++) \
+        {                                                   \
+            if (covered[q] < (range)->end)                  \
+                covered[q] = (range)->end;                  \
+        }                                                   \
+        rewrites++;                                         \
+    } while (0)
+
+    int computedCount = 0;
+    char name[MAX_LEXEME_LENGTH];
+    for (int group = 0, next; group < rangeCount; group = next)
+    {
+        int computed = -1, saved = 0;
+        for (next = group; next < rangeCount && ranges[next].number == ranges[group].number; next++)
+        {
+            NumberedRange *range = &ranges[next];
+            if (covered[range->start] >= range->end)
+                continue;
+            if (range->holder >= 0)
+                VALUE_REPLACE(range, range->holder);
+            else if (computed < 0)
+                computed = next;
+            else
+                saved += range->end - range->start;
+        }
+        // Computing it into a temporary first costs a STORE, an ASSIGN and a VALUE
+        if (saved <= 3)
+            continue;
+        newStackTemporary(name, sizeof(name));
+        int temporary = internStackVariable(name);
+        ranges[computed].temporary = temporary;
+        ranges[computed].computed = 1;
+        computedCount++;
+        for (int r = computed + 1; r < next; r++)
+        {
+            if (covered[ranges[r].start] < ranges[r].end && ranges[r].holder < 0)
+                VALUE_REPLACE(&ranges[r], temporary);
+        }
+    }
+#undef VALUE_REPLACE
+
+    // Replaced ranges by start, widest first; computed ones by statement
+    int *first = (int *)malloc(count * sizeof(int));
+    for (int p = 0; p < count; p++)
+        first[p] = -1;
+    NumberedRange *computedRanges = (NumberedRange *)malloc((computedCount + 1) * sizeof(NumberedRange));
+    computedCount = 0;
+    for (int r = 0; r < rangeCount; r++)
+    {
+        if (ranges[r].temporary < 0)
+            continue;
+        if (ranges[r].computed)
+            computedRanges[computedCount++] = ranges[r];
+        int *link = &first[ranges[r].start];
+        while (*link >= 0 && ranges[*link].end > ranges[r].end)
+            link = &ranges[*link].next;
+        ranges[r].next = *link;
+        *link = r;
+    }
+    qsort(computedRanges, computedCount, sizeof(NumberedRange), compareComputedRanges);
+
+    // Inner temporaries end first, so they are assigned before the ranges reading them
+    int computed = 0;
+    for (int p = 0; p < count; p++)
+    {
+        code.line = block[p].line;
+        while (computed < computedCount && computedRanges[computed].statement == p)
+        {
+            const NumberedRange *range = &computedRanges[computed++];
+            emitStack(STORE, code.variables[range->temporary]);
+            emitNumberedRange(block, ranges, first, range->start, range->end);
+            code.line = block[p].line;
+            emitStack(ASSIGN, NULL);
+        }
+        if (first[p] >= 0)
+        {
+            emitStack(VALUE, code.variables[ranges[first[p]].temporary]);
+            p = ranges[first[p]].end;
+            continue;
+        }
+        appendInstructions(&block[p], 1);
+    }
+
+    free(first);
+    free(covered);
+    free(computedRanges);
+    free(ranges);
+    return rewrites;
+}
+void emitNumberedRange(const Instruction *block, const NumberedRange *ranges, const int *first,
+                       int start, int end)
+{
+    for (int p = start; p <= end; p++)
+    {
+        // Only the replaced ranges inside this one apply, not the range itself
+        int r = first[p];
+        while (r >= 0 && p == start && ranges[r].end >= end)
+            r = ranges[r].next;
+        code.line = block[p].line;
+        if (r >= 0)
+        {
+            emitStack(VALUE, code.variables[ranges[r].temporary]);
+            p = ranges[r].end;
+            continue;
+        }
+        appendInstructions(&block[p], 1);
+    }
+}
+
+// Partial evaluation functions implementation//
+int readKnownInputs(const char *path, int **values)
+{
+    InputStream in;
+    if (openInput(&in, path) != 0)
+        return -1;
+    int count = 0, capacity = 16, value;
+    *values = (int *)malloc(capacity * sizeof(int));
+    while (readInteger(&in, &value) == 0)
+    {
+        if (count == capacity)
+        {
+            capacity *= 2;
+            *values = (int *)realloc(*values, capacity * sizeof(int));
+        }
+        (*values)[count++] = value;
+    }
+    // readInteger() stops on the end of the input, or on something else that is not a number
+    int invalid = in.position < in.size;
+    closeInput(&in);
+    if (invalid)
+    {
+        fprintf(stderr, "Error: Invalid known input in '%s' after %d values\n", path, count);
+        free(*values);
+        *values = NULL;
+        return -1;
+    }
+    return count;
+}
+int specializeProgram(const int *inputs, int inputCount)
+{
+    // Runs on the code as compiled: before superinstructions and linking
+    if (code.linked)
+        return -1;
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        if (code.instructions[pc].type >= GO_FALSE_LT)
+            return -1;
+    }
+    // The operand stack is then known to balance and ASSIGN always gets an address
+    if (!code.verified && verifyStackCode() != 0)
+    {
+        fprintf(stderr, "Specialization needs verifiable code.\n");
+        return -1;
+    }
+
+    Specializer spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.slots = code.variableCount;
+    spec.inputs = inputs;
+    spec.inputCount = inputCount;
+    // Taken from the pass manager: still those of the original code once it is cut
+    const LabelIndex *labels = requireLabels();
+    spec.cfg = requireControlFlowGraph();
+    spec.liveness = requireLiveness();
+    if (spec.cfg == NULL || spec.liveness == NULL)
+        return -1;
+    spec.targets = (int *)malloc((code.size + 1) * sizeof(int));
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        spec.targets[pc] = -1;
+        if (isJumpInstruction(code.instructions[pc].type))
+            spec.targets[pc] = jumpTargetPosition(&code.instructions[pc], labels);
+    }
+    spec.versions = (int *)malloc((code.size + 1) * sizeof(int));
+    spec.backEdges = (int *)malloc((code.size + 1) * sizeof(int));
+    for (int pc = 0; pc <= code.size; pc++)
+        spec.versions[pc] = spec.backEdges[pc] = -1;
+    // Every variable starts out known: the frame is zeroed. Array elements are left to the
+    // residual program's frame, which is zeroed too, as their indices are rarely known.
+    spec.known = (unsigned char *)malloc(spec.slots + 1);
+    spec.values = (int *)calloc(spec.slots + 1, sizeof(int));
+    memset(spec.known, 1, spec.slots + 1);
+    for (int slot = 0; slot < spec.slots; slot++)
+        spec.known[slot] = !isArraySlot(slot);
+    spec.pointKnown = (unsigned char *)malloc(spec.slots + 1);
+    spec.pointValues = (int *)malloc((spec.slots + 1) * sizeof(int));
+
+    // The residual program replaces the original one as it is emitted
+    int labelCount = code.labelCount;
+    int originalDepth = code.maxStackDepth;
+    Instruction *original = cutInstructions(0, &spec.size);
+    spec.original = original;
+    code.stackDepth = 0;
+    code.maxStackDepth = 0;
+    int status = specializeTrace(&spec, 0);
+    while (status == 0 && spec.taskCount > 0)
+    {
+        SpecializationTask task = spec.tasks[--spec.taskCount];
+        const SpecializedPoint *site = &spec.points[task.site];
+        code.line = site->pc < spec.size ? original[site->pc].line : 0;
+        if (task.from >= 0)
+        {
+            // Stores the variables the point does not know, then joins it
+            emitStackLabel(LABEL, spec.points[task.from].label);
+            loadSpecializedState(&spec, task.from);
+            materializeVariables(&spec, site);
+            // Falls into the point when its code comes next
+            const SpecializationTask *next = spec.taskCount > 0 ? &spec.tasks[spec.taskCount - 1] : NULL;
+            if (next == NULL || next->site != task.site || next->from >= 0)
+                emitStackLabel(GOTO, site->label);
+            continue;
+        }
+        emitStackLabel(LABEL, site->label);
+        loadSpecializedState(&spec, task.site);
+        status = specializeTrace(&spec, site->pc);
+    }
+    if (status == 0 && spec.endLabel != 0)
+        emitStackLabel(LABEL, spec.endLabel);
+
+    if (status != 0)
+    {
+        if (spec.steps > SPECIALIZE_STEPS)
+            fprintf(stderr, "Specialization stopped after %lld steps: a loop does not end on the known inputs.\n",
+                    SPECIALIZE_STEPS);
+        else if (code.size > SPECIALIZE_CODE)
+            fprintf(stderr, "Specialization stopped: the residual program exceeds %d instructions.\n",
+                    SPECIALIZE_CODE);
+        else
+            fprintf(stderr, "Specialization stopped: operands are left on the stack at a jump.\n");
+        // The original program is kept as it was
+        code.size = 0;
+        code.stackDepth = 0;
+        appendInstructions(original, spec.size);
+        code.labelCount = labelCount;
+        code.maxStackDepth = originalDepth;
+    }
+
+    for (int p = 0; p < spec.pointCount; p++)
+    {
+        free(spec.points[p].known);
+        free(spec.points[p].values);
+    }
+    free(spec.points);
+    free(spec.tasks);
+    free(spec.targets);
+    free(spec.versions);
+    free(spec.backEdges);
+    free(spec.known);
+    free(spec.values);
+    free(spec.pointKnown);
+    free(spec.pointValues);
+    free(original);
+    return status;
+}
+int specializeTrace(Specializer *spec, int pc)
+{
+    // Evaluates what the known values decide and emits the rest, until the program ends
+    // or the trace joins a point already specialized
+    const Instruction *original = spec->original;
+    StaticOperand *stack = spec->stack;
+    while (pc < spec->size)
+    {
+        const Instruction *instr = &original[pc];
+        if (++spec->steps > SPECIALIZE_STEPS || code.size > SPECIALIZE_CODE)
+            return -1;
+        code.line = instr->line;
+        switch (instr->type)
+        {
+        case PUSH:
+        case STORE:
+            stack[spec->depth].known = 1;
+            stack[spec->depth].value = instr->arg;
+            stack[spec->depth].address = instr->type == STORE ? instr->arg : -1;
+            spec->depth++;
+            break;
+        case VALUE:
+            if (!spec->known[instr->arg])
+            {
+                materializeOperands(spec);
+                appendInstructions(instr, 1);
+            }
+            stack[spec->depth].known = spec->known[instr->arg];
+            stack[spec->depth].value = spec->values[instr->arg];
+            stack[spec->depth].address = -1;
+            spec->depth++;
+            break;
+        case READ:
+            if (spec->consumed < spec->inputCount)
+            {
+                spec->known[instr->arg] = 1;
+                spec->values[instr->arg] = spec->inputs[spec->consumed++];
+            }
+            else
+            {
+                appendInstructions(instr, 1);
+                spec->known[instr->arg] = 0;
+                spec->values[instr->arg] = 0;
+            }
+            break;
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case COMP_LT:
+        case COMP_GT:
+        case COMP_LE:
+        case COMP_GE:
+        case COMP_EQ:
+        case COMP_NE:
+        {
+            StaticOperand *left = &stack[spec->depth - 2];
+            const StaticOperand *right = &stack[spec->depth - 1];
+            // A division by zero is left to fail at run time, after the output before it
+            if (instr->type == DIV && left->known && right->known && right->value == 0 &&
+                trapRuntimeError(spec, instr, 2))
+                return 0;
+            if (left->known && right->known && (instr->type != DIV || right->value != 0))
+                left->value = foldOperation(instr->type, left->value, right->value);
+            else
+            {
+                materializeOperands(spec);
+                appendInstructions(instr, 1);
+                left->known = 0;
+            }
+            left->address = -1;
+            spec->depth--;
+            break;
+        }
+        case SWAP:
+        {
+            if (!stack[spec->depth - 1].known || !stack[spec->depth - 2].known)
+            {
+                materializeOperands(spec);
+                appendInstructions(instr, 1);
+            }
+            StaticOperand top = stack[spec->depth - 1];
+            stack[spec->depth - 1] = stack[spec->depth - 2];
+            stack[spec->depth - 2] = top;
+            break;
+        }
+        case ASSIGN:
+        {
+            int slot = stack[spec->depth - 2].address;
+            if (stack[spec->depth - 2].known && stack[spec->depth - 1].known)
+            {
+                spec->known[slot] = 1;
+                spec->values[slot] = stack[spec->depth - 1].value;
+            }
+            else
+            {
+                materializeOperands(spec);
+                appendInstructions(instr, 1);
+                spec->known[slot] = 0;
+                spec->values[slot] = 0;
+            }
+            spec->depth -= 2;
+            break;
+        }
+        case WRITE:
+            materializeOperands(spec);
+            appendInstructions(instr, 1);
+            spec->depth--;
+            break;
+        case VALUE_AT:
+            // So is an index known to be out of bounds: the loop it is in may only end there
+            if (stack[spec->depth - 1].known && (unsigned)stack[spec->depth - 1].value >= (unsigned)instr->length &&
+                trapRuntimeError(spec, instr, 1))
+                return 0;
+            materializeOperands(spec);
+            appendInstructions(instr, 1);
+            stack[spec->depth - 1].known = 0;
+            stack[spec->depth - 1].address = -1;
+            break;
+        case ASSIGN_AT:
+        {
+            int outOfBounds = stack[spec->depth - 2].known &&
+                              (unsigned)stack[spec->depth - 2].value >= (unsigned)instr->length;
+            materializeOperands(spec);
+            appendInstructions(instr, 1);
+            spec->depth -= 2;
+            // A statement of its own, which leaves nothing on the stack when it fails
+            if (outOfBounds)
+            {
+                endSpecializedTrace(spec);
+                return 0;
+            }
+            break;
+        }
+        case ARRAY_ADD:
+        case ARRAY_SUB:
+        case ARRAY_MUL:
+            appendInstructions(instr, 1);
+            break;
+        case VADD:
+        case VSUB:
+        case VMUL:
+        {
+            // A statement of its own: folded when all its operands are known
+            int known = 1;
+            for (int k = 0; k < VECTOR_WIDTH; k++)
+                known &= spec->known[instr->arg2 + k] && spec->known[instr->arg3 + k];
+            if (known)
+            {
+                int values[VECTOR_WIDTH];
+                InstructionType op = instr->type == VADD ? ADD : (instr->type == VSUB ? SUB : MUL);
+                for (int k = 0; k < VECTOR_WIDTH; k++)
+                    values[k] = foldOperation(op, spec->values[instr->arg2 + k], spec->values[instr->arg3 + k]);
+                for (int k = 0; k < VECTOR_WIDTH; k++)
+                {
+                    spec->known[instr->arg + k] = 1;
+                    spec->values[instr->arg + k] = values[k];
+                }
+                break;
+            }
+            char text[16];
+            for (int k = 0; k < 2 * VECTOR_WIDTH; k++)
+            {
+                int slot = (k < VECTOR_WIDTH ? instr->arg2 : instr->arg3 - VECTOR_WIDTH) + k;
+                if (spec->known[slot])
+                {
+                    snprintf(text, sizeof(text), "%d", spec->values[slot]);
+                    emitStack(STORE, code.variables[slot]);
+                    emitStack(PUSH, text);
+                    emitStack(ASSIGN, NULL);
+                    spec->known[slot] = 0;
+                }
+            }
+            appendInstructions(instr, 1);
+            for (int k = 0; k < VECTOR_WIDTH; k++)
+                spec->known[instr->arg + k] = 0;
+            break;
+        }
+        case SELECT:
+        {
+            StaticOperand *chosen = &stack[spec->depth - 3];
+            const StaticOperand *otherwise = &stack[spec->depth - 2];
+            const StaticOperand *condition = &stack[spec->depth - 1];
+            if (condition->known && otherwise->known && (chosen->known || condition->value != 0))
+            {
+                // Unknown operands lie below known ones, so only the then value can stay unknown
+                if (condition->value == 0)
+                    chosen->value = otherwise->value;
+            }
+            else
+            {
+                materializeOperands(spec);
+                appendInstructions(instr, 1);
+                chosen->known = 0;
+            }
+            chosen->address = -1;
+            spec->depth -= 2;
+            break;
+        }
+        case LABEL:
+            break;
+        case GOTO:
+        case GO_FALSE:
+        case GO_TRUE:
+        {
+            int target = spec->targets[pc];
+            int taken = 1;
+            if (instr->type != GOTO)
+            {
+                const StaticOperand *condition = &stack[spec->depth - 1];
+                if (!condition->known)
+                {
+                    // Decided at run time: both sides continue from here
+                    spec->depth--;
+                    if (spec->depth != 0)
+                        return -1; // compiled code never branches with operands left
+                    int created;
+                    int site = findSpecializedPoint(spec, target, &created);
+                    if (created)
+                        pushSpecializationTask(spec, site, -1);
+                    int label = spec->points[site].label;
+                    if (unknownAtPoint(spec, &spec->points[site]))
+                    {
+                        int from = saveSpecializedState(spec, -1, spec->known, spec->values);
+                        spec->points[from].label = newStackLabel();
+                        label = spec->points[from].label;
+                        pushSpecializationTask(spec, site, from);
+                    }
+                    emitStackLabel(instr->type, label);
+
+                    site = findSpecializedPoint(spec, pc + 1, &created);
+                    materializeVariables(spec, &spec->points[site]);
+                    if (!created)
+                    {
+                        emitStackLabel(GOTO, spec->points[site].label);
+                        return 0;
+                    }
+                    emitStackLabel(LABEL, spec->points[site].label);
+                    pc++;
+                    continue;
+                }
+                taken = (condition->value != 0) == (instr->type == GO_TRUE);
+                spec->depth--;
+            }
+            if (!taken)
+                break;
+            if (target <= pc && specializeBackEdge(spec, pc, target))
+                return 0;
+            pc = target;
+            continue;
+        }
+        default:
+            return -1;
+        }
+        pc++;
+    }
+
+    endSpecializedTrace(spec);
+    return 0;
+}
+int foldOperation(InstructionType type, int left, int right)
+{
+    // As the interpreter computes it: wrapping arithmetic, division truncated towards zero
+    switch (type)
+    {
+    case ADD:
+        return (int)((unsigned)left + (unsigned)right);
+    case SUB:
+        return (int)((unsigned)left - (unsigned)right);
+    case MUL:
+        return (int)((unsigned)left * (unsigned)right);
+    case DIV:
+        return right == -1 ? (int)(0u - (unsigned)left) : left / right;
+    case COMP_LT:
+        return left < right;
+    case COMP_GT:
+        return left > right;
+    case COMP_LE:
+        return left <= right;
+    case COMP_GE:
+        return left >= right;
+    case COMP_EQ:
+        return left == right;
+    case COMP_NE:
+        return left != right;
+    default:
+        return 0;
+    }
+}
+int saveSpecializedState(Specializer *spec, int pc, const unsigned char *known, const int *values)
+{
+    if (spec->pointCount == spec->pointCapacity)
+    {
+        spec->pointCapacity = spec->pointCapacity ? spec->pointCapacity * 2 : 64;
+        spec->points = (SpecializedPoint *)realloc(spec->points, spec->pointCapacity * sizeof(SpecializedPoint));
+    }
+    SpecializedPoint *site = &spec->points[spec->pointCount];
+    site->pc = pc;
+    site->consumed = spec->consumed;
+    site->known = (unsigned char *)malloc(spec->slots + 1);
+    site->values = (int *)malloc((spec->slots + 1) * sizeof(int));
+    memcpy(site->known, known, spec->slots + 1);
+    memcpy(site->values, values, (spec->slots + 1) * sizeof(int));
+    site->label = 0;
+    site->next = -1;
+    if (pc >= 0)
+    {
+        site->label = newStackLabel();
+        site->next = spec->versions[pc];
+        spec->versions[pc] = spec->pointCount;
+    }
+    return spec->pointCount++;
+}
+void loadSpecializedState(Specializer *spec, int site)
+{
+    spec->consumed = spec->points[site].consumed;
+    memcpy(spec->known, spec->points[site].known, spec->slots + 1);
+    memcpy(spec->values, spec->points[site].values, (spec->slots + 1) * sizeof(int));
+    spec->depth = 0;
+}
+int sameSpecializedState(const Specializer *spec, const SpecializedPoint *site, int consumed,
+                         const unsigned char *known, const int *values)
+{
+    // Unknown variables hold 0 in values, so the arrays compare whole
+    return site->consumed == consumed && memcmp(site->known, known, spec->slots) == 0 &&
+           memcmp(site->values, values, spec->slots * sizeof(int)) == 0;
+}
+void forgetDeadVariables(Specializer *spec, int pc)
+{
+    // The state a point is keyed on: what the trace knows of the variables live there
+    memcpy(spec->pointKnown, spec->known, spec->slots + 1);
+    memcpy(spec->pointValues, spec->values, (spec->slots + 1) * sizeof(int));
+    BitWord *live = pc < spec->size ? dataflowSet(spec->liveness->in, spec->liveness, spec->cfg->blockOf[pc]) : NULL;
+    for (int slot = 0; slot < spec->slots; slot++)
+    {
+        if (live == NULL || !bitsetContains(live, slot))
+        {
+            spec->pointKnown[slot] = 1;
+            spec->pointValues[slot] = 0;
+        }
+    }
+}
+int findSpecializedPoint(Specializer *spec, int pc, int *created)
+{
+    forgetDeadVariables(spec, pc);
+    int versions = 0, latest = -1;
+    for (int p = spec->versions[pc]; p >= 0; p = spec->points[p].next)
+    {
+        if (sameSpecializedState(spec, &spec->points[p], spec->consumed, spec->pointKnown, spec->pointValues))
+        {
+            *created = 0;
+            return p;
+        }
+        if (spec->points[p].consumed == spec->consumed)
+        {
+            if (latest < 0)
+                latest = p;
+            versions++;
+        }
+    }
+
+    int site = saveSpecializedState(spec, pc, spec->pointKnown, spec->pointValues);
+    *created = 1;
+    if (versions < SPECIALIZE_VARIANTS)
+        return site;
+    // Too many versions: what differs from the newest one is no longer known, which
+    // ends loops whose variables change every time round
+    SpecializedPoint *general = &spec->points[site];
+    const SpecializedPoint *previous = &spec->points[latest];
+    for (int slot = 0; slot < spec->slots; slot++)
+    {
+        if (!previous->known[slot] || previous->values[slot] != general->values[slot])
+        {
+            general->known[slot] = 0;
+            general->values[slot] = 0;
+        }
+    }
+    for (int p = general->next; p >= 0; p = spec->points[p].next)
+    {
+        if (sameSpecializedState(spec, &spec->points[p], general->consumed, general->known, general->values))
+        {
+            // Already there: the new version is dropped again
+            spec->versions[pc] = general->next;
+            free(general->known);
+            free(general->values);
+            spec->pointCount--;
+            *created = 0;
+            return p;
+        }
+    }
+    return site;
+}
+int unknownAtPoint(const Specializer *spec, const SpecializedPoint *site)
+{
+    // Whether joining the point takes stores first: it does not know all the trace knows
+    for (int slot = 0; slot < spec->slots; slot++)
+    {
+        if (spec->known[slot] && !site->known[slot])
+            return 1;
+    }
+    return 0;
+}
+int specializeBackEdge(Specializer *spec, int pc, int target)
+{
+    // A loop decided by known values is unrolled, unless it comes round in the same
+    // state: it then becomes a loop of the residual program
+    if (spec->depth != 0)
+        return 0;
+    forgetDeadVariables(spec, target);
+    for (int p = spec->versions[target]; p >= 0; p = spec->points[p].next)
+    {
+        if (sameSpecializedState(spec, &spec->points[p], spec->consumed, spec->pointKnown, spec->pointValues) &&
+            !unknownAtPoint(spec, &spec->points[p]))
+        {
+            emitStackLabel(GOTO, spec->points[p].label);
+            return 1;
+        }
+    }
+    int saved = spec->backEdges[pc];
+    if (saved < 0)
+    {
+        spec->backEdges[pc] = saveSpecializedState(spec, -1, spec->known, spec->values);
+        return 0;
+    }
+    SpecializedPoint *previous = &spec->points[saved];
+    if (sameSpecializedState(spec, previous, spec->consumed, spec->known, spec->values))
+    {
+        int site = saveSpecializedState(spec, target, spec->pointKnown, spec->pointValues);
+        emitStackLabel(LABEL, spec->points[site].label);
+        return 0;
+    }
+    previous->consumed = spec->consumed;
+    memcpy(previous->known, spec->known, spec->slots + 1);
+    memcpy(previous->values, spec->values, (spec->slots + 1) * sizeof(int));
+    return 0;
+}
+int trapRuntimeError(Specializer *spec, const Instruction *failing, int operands)
+{
+    // failing takes the top operands and leaves a value. Only known operands are on the stack:
+    // the residual program just fails there, in a statement of its own, and the trace ends
+    int address = -1;
+    for (int i = spec->depth - 1; i >= 0; i--)
+    {
+        if (!spec->stack[i].known)
+            return 0;
+        if (spec->stack[i].address >= 0)
+            address = spec->stack[i].address;
+    }
+    char text[16];
+    if (address >= 0)
+        emitStack(STORE, code.variables[address]);
+    for (int i = spec->depth - operands; i < spec->depth; i++)
+    {
+        snprintf(text, sizeof(text), "%d", spec->stack[i].value);
+        emitStack(PUSH, text);
+    }
+    appendInstructions(failing, 1);
+    if (address >= 0)
+        emitStack(ASSIGN, NULL);
+    else
+    {
+        // In a condition: the jump takes the value off the stack
+        if (spec->endLabel == 0)
+            spec->endLabel = newStackLabel();
+        emitStackLabel(GO_FALSE, spec->endLabel);
+    }
+    spec->depth = 0;
+    endSpecializedTrace(spec);
+    return 1;
+}
+void endSpecializedTrace(Specializer *spec)
+{
+    // The end of the program: the code of the points still to specialize follows
+    if (spec->taskCount > 0)
+    {
+        if (spec->endLabel == 0)
+            spec->endLabel = newStackLabel();
+        emitStackLabel(GOTO, spec->endLabel);
+    }
+}
+void pushSpecializationTask(Specializer *spec, int site, int from)
+{
+    if (spec->taskCount == spec->taskCapacity)
+    {
+        spec->taskCapacity = spec->taskCapacity ? spec->taskCapacity * 2 : 64;
+        spec->tasks = (SpecializationTask *)realloc(spec->tasks, spec->taskCapacity * sizeof(SpecializationTask));
+    }
+    spec->tasks[spec->taskCount].site = site;
+    spec->tasks[spec->taskCount].from = from;
+    spec->taskCount++;
+}
+void materializeOperands(Specializer *spec)
+{
+    // Known operands sit above the others: those are pushed by the residual code, in order
+    int first = spec->depth;
+    while (first > 0 && spec->stack[first - 1].known)
+        first--;
+    for (int i = first; i < spec->depth; i++)
+    {
+        char text[16];
+        StaticOperand *operand = &spec->stack[i];
+        if (operand->address >= 0)
+            emitStack(STORE, code.variables[operand->address]);
+        else
+        {
+            snprintf(text, sizeof(text), "%d", operand->value);
+            emitStack(PUSH, text);
+        }
+        operand->known = 0;
+    }
+}
+void materializeVariables(Specializer *spec, const SpecializedPoint *site)
+{
+    // Variables the point does not know must hold their values in the residual program's frame
+    char text[16];
+    for (int slot = 0; slot < spec->slots; slot++)
+    {
+        if (spec->known[slot] && !site->known[slot])
+        {
+            snprintf(text, sizeof(text), "%d", spec->values[slot]);
+            emitStack(STORE, code.variables[slot]);
+            emitStack(PUSH, text);
+            emitStack(ASSIGN, NULL);
+            spec->known[slot] = 0;
+            spec->values[slot] = 0;
+        }
+    }
+}
+
+// Pass manager functions implementation//
+// In pipeline order; -O<n> runs the passes of level 1 to n, options add the others
+const OptimizationPass optimizationPasses[PASS_COUNT] = {
+    {"loops", 1, loopPass},
+    {"value-numbering", 1, valueNumberingPass},
+    {"dead-stores", 2, deadStorePass},
+    {"simplify-jumps", 2, simplifyJumpPass},
+    {"if-convert", 2, ifConversionPass},
+    {"slp", 2, vectorizePass},
+    {"specialize", 0, specializePass},
+    {"layout", 0, layoutPass},
+    {"superinstructions", 0, superinstructionPass},
+    {"link", 0, linkPass},
+};
+const char *analysisNames[ANALYSIS_COUNT] = {"labels", "cfg", "liveness"};
+
+const LabelIndex *requireLabels(void)
+{
+    if (!analysisValid(ANALYSIS_LABELS))
+    {
+        freeLabelIndex(&passManager.labels);
+        buildLabelIndex(&passManager.labels);
+        passManager.valid[ANALYSIS_LABELS] = 1;
+    }
+    return &passManager.labels;
+}
+const ControlFlowGraph *requireControlFlowGraph(void)
+{
+    if (!analysisValid(ANALYSIS_CFG))
+    {
+        freeControlFlowGraph(&passManager.cfg);
+        if (buildControlFlowGraph(&passManager.cfg) != 0)
+            return NULL;
+        passManager.valid[ANALYSIS_CFG] = 1;
+    }
+    return &passManager.cfg;
+}
+const DataflowProblem *requireLiveness(void)
+{
+    if (!analysisValid(ANALYSIS_LIVENESS))
+    {
+        const ControlFlowGraph *cfg = requireControlFlowGraph();
+        if (cfg == NULL)
+            return NULL;
+        freeDataflow(&passManager.liveness);
+        computeLiveness(&passManager.liveness, cfg);
+        passManager.valid[ANALYSIS_LIVENESS] = 1;
+    }
+    return &passManager.liveness;
+}
+int analysisValid(AnalysisId analysis)
+{
+    // Also recomputed when the code was replaced without a pass saying so
+    if (passManager.valid[analysis] && passManager.validFor[analysis] == code.instructions &&
+        passManager.validSize[analysis] == code.size)
+    {
+        passManager.reused[analysis]++;
+        return 1;
+    }
+    passManager.valid[analysis] = 0;
+    passManager.validFor[analysis] = code.instructions;
+    passManager.validSize[analysis] = code.size;
+    passManager.computed[analysis]++;
+    return 0;
+}
+void invalidateAnalyses(void)
+{
+    for (int a = 0; a < ANALYSIS_COUNT; a++)
+        passManager.valid[a] = 0;
+}
+void freeAnalyses(void)
+{
+    invalidateAnalyses();
+    freeLabelIndex(&passManager.labels);
+    freeControlFlowGraph(&passManager.cfg);
+    freeDataflow(&passManager.liveness);
+}
+int findPass(const char *name, size_t length)
+{
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+    {
+        if (strlen(optimizationPasses[pass].name) == length && strncmp(optimizationPasses[pass].name, name, length) == 0)
+            return pass;
+    }
+    return -1;
+}
+int checkPassList(const char *list)
+{
+    if (strcmp(list, "all") == 0)
+        return 0;
+    for (const char *name = list; *name != '\0';)
+    {
+        size_t length = strcspn(name, ",");
+        if (findPass(name, length) < 0)
+        {
+            fprintf(stderr, "Unknown pass '%.*s'; the passes are:", (int)length, name);
+            for (int pass = 0; pass < PASS_COUNT; pass++)
+                fprintf(stderr, " %s", optimizationPasses[pass].name);
+            fprintf(stderr, "\n");
+            return -1;
+        }
+        name += length + (name[length] == ',');
+    }
+    return 0;
+}
+int printsAfter(int pass)
+{
+    const char *list = passManager.printAfter;
+    if (list == NULL)
+        return 0;
+    if (strcmp(list, "all") == 0)
+        return 1;
+    for (const char *name = list; *name != '\0';)
+    {
+        size_t length = strcspn(name, ",");
+        if (findPass(name, length) == pass)
+            return 1;
+        name += length + (name[length] == ',');
+    }
+    return 0;
+}
+int runPass(int pass, const PassOptions *options)
+{
+    const OptimizationPass *info = &optimizationPasses[pass];
+    PassRecord *record = &passManager.records[pass];
+    int before = code.size;
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    int changes = info->run(options);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    record->runs++;
+    record->seconds += (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+    record->before = before;
+    record->after = code.size;
+    if (changes > 0)
+        record->changes += changes;
+    // The analyses describe the code as it was before
+    if (changes != 0 || code.size != before)
+        invalidateAnalyses();
+    if (changes < 0)
+        return -1;
+
+    if (passManager.verifyEach && verifyIr() != 0)
+    {
+        fprintf(stderr, "IR verification failed after pass '%s'.\n", info->name);
+        return -1;
+    }
+    if (printsAfter(pass))
+    {
+        printf("\n*** After %s: %d instructions ***", info->name, code.size);
+        printStackCode();
+    }
+    return changes;
+}
+int runPassPipeline(const PassOptions *options)
+{
+    // A freshly parsed program: nothing computed so far describes it
+    invalidateAnalyses();
+    if (passManager.verifyEach && verifyIr() != 0)
+    {
+        fprintf(stderr, "IR verification failed after parsing.\n");
+        return -1;
+    }
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+    {
+        int level = optimizationPasses[pass].level;
+        if (level > 0 && level <= passManager.level && runPass(pass, options) < 0)
+            return -1;
+    }
+    return 0;
+}
+int verifyIr(void)
+{
+    // Consistency of the instructions themselves; the verifier then checks stack and jumps
+    char error_msg[MAX_ERROR_LENGTH];
+    int errors = 0;
+    for (int pc = 0; pc < code.size && errors < MAX_ERRORS; pc++)
+    {
+        const Instruction *instr = &code.instructions[pc];
+        error_msg[0] = '\0';
+        if ((int)instr->type < 0 || instr->type >= INSTRUCTION_TYPE_COUNT)
+            snprintf(error_msg, sizeof(error_msg), "Unknown opcode %d", (int)instr->type);
+        else if (instr->type == VALUE || instr->type == STORE || instr->type == READ)
+        {
+            if (instr->arg < 0 || instr->arg >= code.variableCount)
+                snprintf(error_msg, sizeof(error_msg), "Slot %d out of range", instr->arg);
+        }
+        else if ((instr->type == VADD || instr->type == VSUB || instr->type == VMUL) &&
+                 (instr->arg < 0 || instr->arg2 < 0 || instr->arg3 < 0 ||
+                  instr->arg + VECTOR_WIDTH > code.variableCount || instr->arg2 + VECTOR_WIDTH > code.variableCount ||
+                  instr->arg3 + VECTOR_WIDTH > code.variableCount))
+            snprintf(error_msg, sizeof(error_msg), "Vector slots out of range");
+        else if (instr->type >= VALUE_AT && instr->type <= ARRAY_MUL)
+        {
+            int bases[3] = {instr->arg, instr->arg2, instr->arg3};
+            for (int a = 0; a < (instr->type <= ASSIGN_AT ? 1 : 3) && error_msg[0] == '\0'; a++)
+            {
+                if (bases[a] < 0 || bases[a] >= code.variableCount || !isArraySlot(bases[a]))
+                    snprintf(error_msg, sizeof(error_msg), "Slot %d is not an array element", bases[a]);
+            }
+        }
+        else if ((instr->type == LABEL || isJumpInstruction(instr->type)) && instr->label <= 0)
+            snprintf(error_msg, sizeof(error_msg), "Label number %d", instr->label);
+        if (error_msg[0] != '\0')
+        {
+            verifierError(error_msg, pc);
+            errors++;
+        }
+    }
+    if (errors == 0 && verifyStackCode() != 0)
+        errors++;
+    return errors == 0 ? 0 : -1;
+}
+void printPassReport(const char *filename)
+{
+    double total = 0;
+    fprintf(stderr, "%s: passes at -O%d\n", filename, passManager.level);
+    fprintf(stderr, "  %-18s %5s %11s   %s\n", "pass", "runs", "time (ms)", "instructions");
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+    {
+        PassRecord *record = &passManager.records[pass];
+        if (record->runs == 0)
+            continue;
+        fprintf(stderr, "  %-18s %5d %11.3f   %d -> %d (%+d), %d changes\n", optimizationPasses[pass].name,
+                record->runs, record->seconds * 1e3, record->before, record->after, record->after - record->before,
+                record->changes);
+        total += record->seconds;
+        memset(record, 0, sizeof(*record));
+    }
+    fprintf(stderr, "  %-18s %5s %11.3f\n", "total", "", total * 1e3);
+    fprintf(stderr, "  analyses:");
+    for (int a = 0; a < ANALYSIS_COUNT; a++)
+    {
+        fprintf(stderr, " %s computed %d, reused %d%s", analysisNames[a], passManager.computed[a],
+                passManager.reused[a], a + 1 < ANALYSIS_COUNT ? ";" : "\n");
+        passManager.computed[a] = passManager.reused[a] = 0;
+    }
+}
+int loopPass(const PassOptions *options)
+{
+    (void)options;
+    return optimizeLoops();
+}
+int valueNumberingPass(const PassOptions *options)
+{
+    (void)options;
+    return numberValues();
+}
+int deadStorePass(const PassOptions *options)
+{
+    (void)options;
+    return eliminateDeadStores();
+}
+int simplifyJumpPass(const PassOptions *options)
+{
+    (void)options;
+    return simplifyJumps();
+}
+int ifConversionPass(const PassOptions *options)
+{
+    (void)options;
+    return convertBranches();
+}
+int vectorizePass(const PassOptions *options)
+{
+    (void)options;
+    return vectorizeStatements();
+}
+int specializePass(const PassOptions *options)
+{
+    return specializeProgram(options->knownInputs, options->knownCount) == 0 ? 1 : -1;
+}
+int layoutPass(const PassOptions *options)
+{
+    return layoutBlocks(options->blockProfile);
+}
+int superinstructionPass(const PassOptions *options)
+{
+    if (options->pairProfile != NULL)
+        return selectSuperinstructions(options->pairProfile);
+    // Without a corpus profile, rank by the program's own pairs
+    OpcodePairProfile *own = (OpcodePairProfile *)calloc(1, sizeof(OpcodePairProfile));
+    collectOpcodePairs(own);
+    int fused = selectSuperinstructions(own);
+    free(own);
+    return fused;
+}
+int linkPass(const PassOptions *options)
+{
+    if (code.linked)
+        return 0;
+    return linkStackCode(options->stripLabels) == 0 ? 1 : -1;
+}
+
+// Dead code functions implementation//
+int eliminateDeadStores(void)
+{
+    // x := e with x dead afterwards goes, unless e may fail (a division or an array load).
+    // Liveness here is strong: the reads of a dead store's expression do not make their
+    // variables live, so whole chains of stores feeding dead ones go in a single solve
+    if (code.linked)
+        return 0;
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        if (code.instructions[pc].type >= SELECT)
+            return 0; // if-conversion, vectorization and superinstructions come after this pass
+    }
+    const ControlFlowGraph *cfg = requireControlFlowGraph();
+    if (cfg == NULL)
+        return 0;
+
+    Instruction *instructions = code.instructions;
+    int *storeOf = (int *)malloc((code.size + 1) * sizeof(int)); // removable ASSIGN -> its STORE, -1 otherwise
+    int starts[MAX_STACK_DEPTH]; // operand -> first instruction computing it
+    for (int pc = 0; pc < code.size; pc++)
+        storeOf[pc] = -1;
+    for (int b = 0; b < cfg->blockCount; b++)
+    {
+        const BasicBlock *block = &cfg->blocks[b];
+        int depth = 0, usable = 1;
+        for (int pc = block->start; pc < block->end && usable; pc++)
+        {
+            InstructionType type = instructions[pc].type;
+            if (type == PUSH || type == VALUE || type == STORE)
+                starts[depth++] = pc;
+            else if (type == ASSIGN && depth >= 2)
+            {
+                int traps = 0;
+                for (int p = starts[depth - 2]; p < pc && !traps; p++)
+                    traps = instructions[p].type == DIV || instructions[p].type == VALUE_AT;
+                storeOf[pc] = traps ? -1 : starts[depth - 2];
+                depth -= 2;
+            }
+            else if (type == SWAP)
+                usable = 0; // operands no longer come from contiguous code
+            else
+                depth += stackEffect(type);
+            if (depth < 0 || depth >= MAX_STACK_DEPTH)
+                usable = 0; // operands left across blocks
+        }
+        for (int pc = block->start; pc < block->end && !usable; pc++)
+            storeOf[pc] = -1;
+    }
+
+    // Backward worklist over the blocks, as in solveDataflow, with the transfer function
+    // above in place of gen and kill
+    DataflowProblem strong;
+    initDataflow(&strong, cfg, cfg->variableCount, DATAFLOW_BACKWARD, MEET_UNION);
+    int words = strong.words;
+    int n = cfg->blockCount;
+    BitWord *arrays = (BitWord *)calloc(words + 1, sizeof(BitWord));
+    for (int slot = 0; slot < cfg->variableCount; slot++)
+    {
+        if (isArraySlot(slot))
+            bitsetAdd(arrays, slot);
+    }
+    int *worklist = (int *)malloc((n + 1) * sizeof(int));
+    char *queued = (char *)malloc(n + 1);
+    int head = 0, count = n;
+    for (int i = 0; i < n; i++)
+    {
+        worklist[i] = n - 1 - i;
+        queued[i] = 1;
+    }
+    BitWord *live = (BitWord *)malloc((words + 1) * sizeof(BitWord));
+    while (count > 0)
+    {
+        int b = worklist[head];
+        head = (head + 1) % n;
+        count--;
+        queued[b] = 0;
+
+        const BasicBlock *block = &cfg->blocks[b];
+        BitWord *out = dataflowSet(strong.out, &strong, b);
+        for (int w = 0; w < words; w++)
+            out[w] = 0;
+        for (int e = 0; e < 2; e++)
+        {
+            if (block->succ[e] < 0)
+                continue;
+            BitWord *in = dataflowSet(strong.in, &strong, block->succ[e]);
+            for (int w = 0; w < words; w++)
+                out[w] |= in[w];
+        }
+        memcpy(live, out, words * sizeof(BitWord));
+        transferStrongLiveness(cfg, b, live, storeOf, NULL);
+
+        BitWord *in = dataflowSet(strong.in, &strong, b);
+        int changed = 0;
+        for (int w = 0; w < words; w++)
+        {
+            live[w] |= arrays[w]; // array elements are read through run-time indices
+            changed |= live[w] != in[w];
+            in[w] = live[w];
+        }
+        if (!changed)
+            continue;
+        for (int e = 0; e < block->predCount; e++)
+        {
+            int pred = cfg->preds[block->predStart + e];
+            if (!queued[pred])
+            {
+                queued[pred] = 1;
+                worklist[(head + count) % n] = pred;
+                count++;
+            }
+        }
+    }
+
+    // One more walk with the final sets marks the dead stores, then the code is compacted once
+    char *dead = (char *)calloc(code.size + 1, 1);
+    int removed = 0;
+    for (int b = 0; b < n; b++)
+    {
+        memcpy(live, dataflowSet(strong.out, &strong, b), words * sizeof(BitWord));
+        removed += transferStrongLiveness(cfg, b, live, storeOf, dead);
+    }
+    if (removed > 0)
+    {
+        int size;
+        Instruction *old = cutInstructions(0, &size);
+        for (int pc = 0; pc < size; pc++)
+        {
+            if (!dead[pc])
+                appendInstructions(&old[pc], 1);
+        }
+        free(old);
+    }
+    freeDataflow(&strong);
+    free(arrays);
+    free(worklist);
+    free(queued);
+    free(live);
+    free(storeOf);
+    free(dead);
+    return removed;
+}
+int transferStrongLiveness(const ControlFlowGraph *cfg, int b, BitWord *live, const int *storeOf,
+                           char *dead)
+{
+    // Walks block b backwards from the variables live after it; a removable store to a dead
+    // variable is skipped with its expression (and marked in dead when given)
+    const Instruction *instructions = code.instructions;
+    int removed = 0;
+    for (int pc = cfg->blocks[b].end - 1; pc >= cfg->blocks[b].start; pc--)
+    {
+        int store = storeOf[pc];
+        if (store >= 0 && !bitsetContains(live, instructions[store].arg))
+        {
+            if (dead != NULL)
+                memset(dead + store, 1, pc - store + 1);
+            removed++;
+            pc = store;
+            continue;
+        }
+        if (cfg->defSlot[pc] >= 0)
+            bitsetRemove(live, cfg->defSlot[pc]);
+        int uses[MAX_INSTRUCTION_USES];
+        for (int u = instructionUses(&instructions[pc], uses) - 1; u >= 0; u--)
+            bitsetAdd(live, uses[u]);
+    }
+    return removed;
+}
+int simplifyJumps(void)
+{
+    // Jumps to jumps go straight to the final target, jumps to the next instruction and
+    // code after a goto that no label reaches are dropped, then labels nothing jumps to
+    if (code.linked)
+        return 0;
+    const LabelIndex *labels = requireLabels();
+    if (labels->duplicate >= 0)
+        return 0;
+    int size = code.size;
+    Instruction *instructions = code.instructions;
+    char *dead = (char *)calloc(size + 1, 1);
+    int *references = (int *)calloc(labels->count + 1, sizeof(int));
+    int changes = 0;
+#define SKIP_LABELS(position)                                                      \
+    do                                                                             \
+    {                                                                              \
+        while ((position) < size && instructions[position].type == LABEL)         \
+            (position)++;                                                          \
+    } while (0)
+
+    for (int pc = 0; pc < size; pc++)
+    {
+        Instruction *instr = &instructions[pc];
+        if (!isJumpInstruction(instr->type))
+            continue;
+        // Bounded, so that a loop of gotos cannot hold the pass
+        for (int hops = 0; hops < 16; hops++)
+        {
+            int label = findLabel(labels, instr->label);
+            if (label < 0)
+                break;
+            int target = labels->positions[label];
+            SKIP_LABELS(target);
+            if (target >= size || instructions[target].type != GOTO || target == pc ||
+                instructions[target].label == instr->label)
+                break;
+            instr->label = instructions[target].label;
+            changes++;
+        }
+    }
+    for (int pc = 0; pc < size; pc++)
+    {
+        if (instructions[pc].type != GOTO)
+            continue;
+        int label = findLabel(labels, instructions[pc].label);
+        int target = label >= 0 ? labels->positions[label] : -1;
+        int next = pc + 1;
+        SKIP_LABELS(target);
+        SKIP_LABELS(next);
+        if (target == next)
+        {
+            dead[pc] = 1;
+            changes++;
+        }
+        // Nothing falls past a goto: what follows runs only if a label is reached
+        for (int p = pc + 1; p < size && instructions[p].type != LABEL; p++)
+        {
+            dead[p] = 1;
+            changes++;
+        }
+    }
+    for (int pc = 0; pc < size; pc++)
+    {
+        if (!dead[pc] && isJumpInstruction(instructions[pc].type))
+        {
+            int label = findLabel(labels, instructions[pc].label);
+            if (label >= 0)
+                references[label]++;
+        }
+    }
+    for (int pc = 0; pc < size; pc++)
+    {
+        int label = instructions[pc].type == LABEL ? findLabel(labels, instructions[pc].label) : -1;
+        if (label >= 0 && references[label] == 0)
+        {
+            dead[pc] = 1;
+            changes++;
+        }
+    }
+#undef SKIP_LABELS
+
+    int kept = 0;
+    for (int pc = 0; pc < size; pc++)
+        kept += !dead[pc];
+    if (kept != size)
+    {
+        int count;
+        Instruction *old = cutInstructions(0, &count);
+        for (int pc = 0; pc < count; pc++)
+        {
+            if (!dead[pc])
+                appendInstructions(&old[pc], 1);
+        }
+        free(old);
+    }
+    free(dead);
+    free(references);
+    return changes;
+}
+
+// If-conversion functions implementation//
+int convertBranches(void)
+{
+    // if c then x := e; ... endif, with e unable to fail, becomes
+    // STORE x; e; VALUE x; c; SELECT; := for each assignment: no jump left to mispredict
+    if (code.linked)
+        return 0;
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        if (code.instructions[pc].type >= GO_FALSE_LT)
+            return 0; // superinstructions are selected after this pass
+    }
+    const LabelIndex *labels = requireLabels();
+    if (labels->duplicate >= 0)
+        return 0;
+
+    int count = code.size;
+    const Instruction *instructions = code.instructions;
+    int *depthAt = (int *)malloc((count + 1) * sizeof(int)); // operands before each instruction
+    int *references = (int *)calloc(labels->count + 1, sizeof(int));
+    int *convertAt = (int *)malloc((count + 1) * sizeof(int)); // condition start -> its jump
+    int *labelOf = (int *)malloc((count + 1) * sizeof(int));   // looked up before the code is cut
+    int depth = 0, converted = 0;
+    for (int pc = 0; pc < count; pc++)
+    {
+        InstructionType type = instructions[pc].type;
+        depthAt[pc] = depth;
+        depth += stackEffect(type);
+        convertAt[pc] = -1;
+        labelOf[pc] = type == LABEL || isJumpInstruction(type) ? findLabel(labels, instructions[pc].label) : -1;
+        if (isJumpInstruction(type) && labelOf[pc] >= 0)
+            references[labelOf[pc]]++;
+    }
+    depthAt[count] = depth;
+    for (int pc = 0; pc < count; pc++)
+    {
+        int end;
+        if (instructions[pc].type == GO_FALSE &&
+            convertibleBranch(instructions, count, depthAt, pc, labels, &end))
+        {
+            int start = pc;
+            while (depthAt[start] > 0)
+                start--;
+            convertAt[start] = pc;
+            converted++;
+            pc = end - 1;
+        }
+    }
+
+    if (converted > 0)
+    {
+        int size;
+        Instruction *old = cutInstructions(0, &size);
+        for (int pc = 0; pc < size; pc++)
+        {
+            int jump = convertAt[pc];
+            if (jump < 0)
+            {
+                appendInstructions(&old[pc], 1);
+                continue;
+            }
+            int p = jump + 1;
+            while (old[p].type == STORE)
+            {
+                // STORE x; e; ASSIGN -> STORE x; e; VALUE x; condition; SELECT; ASSIGN
+                int assign = p + 1;
+                while (depthAt[assign + 1] > 0)
+                    assign++;
+                Instruction previous = old[p], select = old[jump];
+                previous.type = VALUE;
+                select.type = SELECT;
+                select.label = -1;
+                appendInstructions(&old[p], assign - p);
+                appendInstructions(&previous, 1);
+                appendInstructions(&old[pc], jump - pc);
+                appendInstructions(&select, 1);
+                appendInstructions(&old[assign], 1);
+                p = assign + 1;
+            }
+            // The labels at the end stay when other jumps still land on them
+            references[labelOf[jump]]--;
+            if (old[p].type == GOTO)
+                references[labelOf[p++]]--;
+            for (; p < size && old[p].type == LABEL; p++)
+            {
+                if (labelOf[p] < 0 || references[labelOf[p]] > 0)
+                    appendInstructions(&old[p], 1);
+            }
+            pc = p - 1;
+        }
+        free(old);
+    }
+    free(depthAt);
+    free(references);
+    free(convertAt);
+    free(labelOf);
+    return converted;
+}
+int convertibleBranch(const Instruction *instructions, int count, const int *depthAt, int jump,
+                      const LabelIndex *labels, int *end)
+{
+    // A statement-level condition, then only assignments, then the label the jump goes to
+    // (after a goto to a label right there, as the parser leaves it)
+    int start = jump;
+    while (start > 0 && depthAt[start] > 0)
+        start--;
+    if (depthAt[start] != 0 || depthAt[jump] != 1 || !pureExpression(instructions, start, jump, 1))
+        return 0;
+
+    int conditionReads[MAX_STACK_DEPTH], readCount = 0;
+    for (int pc = start; pc < jump; pc++)
+    {
+        if (instructions[pc].type == VALUE && readCount < MAX_STACK_DEPTH)
+            conditionReads[readCount++] = instructions[pc].arg;
+        else if (instructions[pc].type == VALUE)
+            return 0;
+    }
+    int assignments = 0, body = 0, pc = jump + 1;
+    while (pc < count && instructions[pc].type == STORE)
+    {
+        // The condition is evaluated again for every assignment, so it must not read what
+        // the ones before have written
+        for (int r = 0; r < readCount && assignments > 0; r++)
+        {
+            for (int a = jump + 1; a < pc; a++)
+            {
+                if (instructions[a].type == STORE && depthAt[a] == 0 && instructions[a].arg == conditionReads[r])
+                    return 0;
+            }
+        }
+        int assign = pc + 1;
+        while (assign < count && depthAt[assign + 1] > 0)
+            assign++;
+        if (assign >= count || instructions[assign].type != ASSIGN || depthAt[assign] != 2 ||
+            !pureExpression(instructions, pc + 1, assign, 0))
+            return 0;
+        body += assign - pc + 1;
+        pc = assign + 1;
+        if (++assignments > IF_CONVERSION_MAX_ASSIGNMENTS)
+            return 0;
+    }
+    if (assignments == 0)
+        return 0;
+
+    int exitJump = pc < count && instructions[pc].type == GOTO ? pc++ : -1;
+    int reachesTarget = 0, reachesExit = exitJump < 0;
+    for (; pc < count && instructions[pc].type == LABEL; pc++)
+    {
+        reachesTarget |= instructions[pc].label == instructions[jump].label;
+        reachesExit |= exitJump >= 0 && instructions[pc].label == instructions[exitJump].label;
+    }
+    if (!reachesTarget || !reachesExit || findLabel(labels, instructions[jump].label) < 0 ||
+        (exitJump >= 0 && findLabel(labels, instructions[exitJump].label) < 0))
+        return 0;
+
+    // Cost: branchy code pays the jump and, as the direction is not known, half a
+    // misprediction; the selects pay the condition again for every assignment
+    int condition = jump - start;
+    int branchy = condition + 1 + (body + (exitJump >= 0)) / 2 + IF_CONVERSION_MISS_COST / 2;
+    int selects = body + assignments * (condition + 2);
+    *end = pc;
+    return selects <= branchy;
+}
+int pureExpression(const Instruction *instructions, int start, int end, int divisions)
+{
+    // Reads and arithmetic only; a division may fail, so it runs only where it did
+    for (int pc = start; pc < end; pc++)
+    {
+        switch (instructions[pc].type)
+        {
+        case PUSH:
+        case VALUE:
+        case ADD:
+        case SUB:
+        case MUL:
+        case COMP_LT:
+        case COMP_GT:
+        case COMP_LE:
+        case COMP_GE:
+        case COMP_EQ:
+        case COMP_NE:
+            break;
+        case DIV:
+            if (!divisions)
+                return 0;
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Vectorization functions implementation//
+int vectorizeStatements(void)
+{
+    // VECTOR_WIDTH adjacent statements x_k := y_k op z_k that do not read one another's
+    // results become one vector instruction, once x, y and z each sit in adjacent slots
+    if (code.linked)
+        return 0;
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        if (code.instructions[pc].type >= GO_FALSE_LT)
+            return 0; // superinstructions are selected after this pass
+    }
+    const int statement = 5; // STORE x; VALUE y; VALUE z; op; ASSIGN
+    int count = code.size, slots = code.variableCount;
+    const Instruction *instructions = code.instructions;
+    int *groupOf = (int *)malloc((slots + 1) * sizeof(int)); // the run a slot was placed in
+    int *groupIndex = (int *)malloc((slots + 1) * sizeof(int));
+    int (*groups)[VECTOR_WIDTH] = (int (*)[VECTOR_WIDTH])malloc((3 * count / (statement * VECTOR_WIDTH) + 1) *
+                                                                sizeof(*groups));
+    char *packed = (char *)calloc(count + 1, 1); // first statement of a pack
+    int groupCount = 0, packs = 0;
+    for (int v = 0; v < slots; v++)
+        groupOf[v] = -1;
+
+    for (int pc = 0; pc + statement * VECTOR_WIDTH <= count; pc++)
+    {
+        InstructionType op = vectorCandidate(instructions, pc);
+        if (op == LABEL)
+            continue;
+        int tuples[3][VECTOR_WIDTH], usable = 1;
+        for (int k = 0; k < VECTOR_WIDTH && usable; k++)
+        {
+            const Instruction *at = &instructions[pc + k * statement];
+            usable = vectorCandidate(instructions, pc + k * statement) == op;
+            tuples[0][k] = at[0].arg;
+            tuples[1][k] = at[1].arg;
+            tuples[2][k] = at[2].arg;
+            // The statements read what the ones before them wrote; the vector reads everything first
+            for (int j = 0; j < k && usable; j++)
+                usable = tuples[0][j] != tuples[0][k] && tuples[0][j] != tuples[1][k] && tuples[0][j] != tuples[2][k];
+        }
+        if (!usable)
+            continue;
+        int placed = groupCount;
+        for (int t = 0; t < 3 && usable; t++)
+            usable = placeSlotGroup(groupOf, groupIndex, groups, &groupCount, tuples[t]);
+        if (!usable)
+        {
+            // Some of these slots already belong to another run
+            for (; groupCount > placed; groupCount--)
+                for (int k = 0; k < VECTOR_WIDTH; k++)
+                    groupOf[groups[groupCount - 1][k]] = -1;
+            continue;
+        }
+        packed[pc] = 1;
+        packs++;
+        pc += statement * VECTOR_WIDTH - 1;
+    }
+
+    if (packs > 0)
+    {
+        // The runs first, in the order they were placed, then the other slots as they were
+        int *newSlot = (int *)malloc((slots + 1) * sizeof(int));
+        int next = 0;
+        for (int g = 0; g < groupCount; g++)
+            for (int k = 0; k < VECTOR_WIDTH; k++)
+                newSlot[groups[g][k]] = next++;
+        for (int v = 0; v < slots; v++)
+        {
+            if (groupOf[v] < 0)
+                newSlot[v] = next++;
+        }
+
+        int size;
+        Instruction *old = cutInstructions(0, &size);
+        renumberSlots(old, size, newSlot);
+        for (int pc = 0; pc < size; pc++)
+        {
+            if (!packed[pc])
+            {
+                appendInstructions(&old[pc], 1);
+                continue;
+            }
+            Instruction vector = old[pc];
+            InstructionType op = old[pc + 3].type;
+            vector.type = op == ADD ? VADD : (op == SUB ? VSUB : VMUL);
+            vector.arg2 = old[pc + 1].arg;
+            vector.arg3 = old[pc + 2].arg;
+            appendInstructions(&vector, 1);
+            pc += statement * VECTOR_WIDTH - 1;
+        }
+        free(old);
+        free(newSlot);
+    }
+    free(groupOf);
+    free(groupIndex);
+    free(groups);
+    free(packed);
+    return packs;
+}
+InstructionType vectorCandidate(const Instruction *instructions, int pc)
+{
+    // The operation of x := y op z at pc, LABEL when it is something else
+    const Instruction *at = &instructions[pc];
+    if (at[0].type != STORE || at[1].type != VALUE || at[2].type != VALUE || at[4].type != ASSIGN)
+        return LABEL;
+    if (at[3].type != ADD && at[3].type != SUB && at[3].type != MUL)
+        return LABEL;
+    return at[3].type;
+}
+int placeSlotGroup(int *groupOf, int *groupIndex, int (*groups)[VECTOR_WIDTH], int *groupCount, const int *tuple)
+{
+    // A run of slots is either one placed before, in the same order, or made of slots not placed yet
+    int group = groupOf[tuple[0]];
+    for (int k = 0; k < VECTOR_WIDTH; k++)
+    {
+        if (group >= 0 && (groupOf[tuple[k]] != group || groupIndex[tuple[k]] != k))
+            return 0;
+        if (group < 0 && groupOf[tuple[k]] >= 0)
+            return 0;
+        for (int j = 0; j < k && group < 0; j++)
+        {
+            if (tuple[j] == tuple[k])
+                return 0;
+        }
+    }
+    if (group >= 0)
+        return 1;
+    group = (*groupCount)++;
+    for (int k = 0; k < VECTOR_WIDTH; k++)
+    {
+        groupOf[tuple[k]] = group;
+        groupIndex[tuple[k]] = k;
+        groups[group][k] = tuple[k];
+    }
+    return 1;
+}
+void renumberSlots(Instruction *instructions, int count, const int *newSlot)
+{
+    // Moves every variable to newSlot[slot]: the instructions, the names and the name lookup
+    for (int pc = 0; pc < count; pc++)
+    {
+        InstructionType type = instructions[pc].type;
+        if (type == VALUE || type == STORE || type == READ || type == VALUE_AT || type == ASSIGN_AT)
+            instructions[pc].arg = newSlot[instructions[pc].arg];
+        else if (type == ARRAY_ADD || type == ARRAY_SUB || type == ARRAY_MUL)
+        {
+            // Array slots are never grouped: each array keeps its order, and so stays in one run
+            instructions[pc].arg = newSlot[instructions[pc].arg];
+            instructions[pc].arg2 = newSlot[instructions[pc].arg2];
+            instructions[pc].arg3 = newSlot[instructions[pc].arg3];
+        }
+    }
+    char **names = (char **)malloc((code.variableCount + 1) * sizeof(char *));
+    for (int v = 0; v < code.variableCount; v++)
+        names[newSlot[v]] = code.variables[v];
+    memcpy(code.variables, names, code.variableCount * sizeof(char *));
+    free(names);
+
+    unsigned mask = code.variableBucketCount - 1;
+    memset(code.variableBuckets, 0, code.variableBucketCount * sizeof(int));
+    for (int v = 0; v < code.variableCount; v++)
+    {
+        unsigned bucket = hashName(code.variables[v]) & mask;
+        while (code.variableBuckets[bucket] != 0)
+            bucket = (bucket + 1) & mask;
+        code.variableBuckets[bucket] = v + 1;
+    }
+}
+
+// Layout functions implementation//
+unsigned long long hashStackCode(void)
+{
+    // FNV-1a over what the instructions do: a profile is only applied to the code it was taken on
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        const Instruction *instr = &code.instructions[pc];
+        int fields[6] = {(int)instr->type, instr->label, instr->arg, instr->arg2, instr->arg3, instr->length};
+        const unsigned char *bytes = (const unsigned char *)fields;
+        for (size_t k = 0; k < sizeof(fields); k++)
+            hash = (hash ^ bytes[k]) * 1099511628211ULL;
+    }
+    return hash;
+}
+int layoutChain(int *chains, int block)
+{
+    // Union-find over the chains being built, halving the paths
+    while (chains[block] != block)
+    {
+        chains[block] = chains[chains[block]];
+        block = chains[block];
+    }
+    return block;
+}
+int layoutBlocks(const BlockProfile *profile)
+{
+    // Blocks are chained along their most frequent edges, hottest first, and the chains are
+    // placed by decreasing count after the entry's: what rarely runs ends up at the end.
+    // Jumps then follow the new order, inverted where the common successor now falls through.
+    enum
+    {
+        EXIT = -1, // past the last instruction
+        NONE = -2
+    };
+    if (code.linked)
+        return 0;
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        if (code.instructions[pc].type >= GO_FALSE_LT)
+            return 0; // superinstructions are selected after this pass
+    }
+    unsigned long long hash = hashStackCode();
+    const ControlFlowGraph *cfg = requireControlFlowGraph();
+    const LabelIndex *labels = requireLabels();
+    if (cfg == NULL || labels->duplicate >= 0)
+        return 0;
+    int blockCount = cfg->blockCount;
+    for (int pc = 0; pc < code.size; pc++)
+        code.instructions[pc].block = cfg->blockOf[pc];
+    code.layoutHash = hash;
+    code.layoutBlocks = blockCount;
+    if (profile == NULL || blockCount < 2)
+        return 0;
+    if (profile->hash != hash || profile->blockCount != blockCount)
+    {
+        fprintf(stderr, "Warning: The block profile is of another version of the program; blocks left in order\n");
+        return 0;
+    }
+
+    int *jumpTarget = (int *)malloc(blockCount * sizeof(int));
+    int *fall = (int *)malloc(blockCount * sizeof(int));
+    RankedCount *edges = (RankedCount *)malloc(2 * blockCount * sizeof(RankedCount));
+    int *edgeFrom = (int *)malloc(2 * blockCount * sizeof(int));
+    int *edgeTo = (int *)malloc(2 * blockCount * sizeof(int));
+    int edgeCount = 0;
+    for (int b = 0; b < blockCount; b++)
+    {
+        const Instruction *last = &code.instructions[cfg->blocks[b].end - 1];
+        jumpTarget[b] = fall[b] = NONE;
+        if (isJumpInstruction(last->type))
+        {
+            int target = jumpTargetPosition(last, labels);
+            jumpTarget[b] = target >= code.size ? EXIT : cfg->blockOf[target];
+        }
+        if (last->type != GOTO)
+            fall[b] = b + 1 < blockCount ? b + 1 : EXIT;
+
+        // The profile names the block a conditional jump went to, as laid out when it was taken
+        long long count = profile->counts[b];
+        long long jumped = count, fallen = count;
+        if (jumpTarget[b] != NONE && fall[b] != NONE)
+        {
+            int toFall = profile->jumpTargets[b] == fall[b];
+            long long taken = toFall || profile->jumpTargets[b] == jumpTarget[b] ? profile->jumps[b] : 0;
+            jumped = toFall ? count - taken : taken;
+            fallen = toFall ? taken : count - taken;
+        }
+        int successors[2] = {jumpTarget[b], fall[b]};
+        long long weights[2] = {jumped, fallen};
+        for (int e = 0; e < 2; e++)
+        {
+            // Nothing is placed before the entry block
+            if (successors[e] > 0 && successors[e] != b && weights[e] > 0)
+            {
+                edges[edgeCount].count = weights[e];
+                edges[edgeCount].index = edgeCount;
+                edgeFrom[edgeCount] = b;
+                edgeTo[edgeCount] = successors[e];
+                edgeCount++;
+            }
+        }
+    }
+    qsort(edges, edgeCount, sizeof(RankedCount), compareHotspots);
+
+    int *chains = (int *)malloc(blockCount * sizeof(int));
+    int *next = (int *)malloc(blockCount * sizeof(int));
+    int *previous = (int *)malloc(blockCount * sizeof(int));
+    for (int b = 0; b < blockCount; b++)
+    {
+        chains[b] = b;
+        next[b] = previous[b] = -1;
+    }
+    // Hottest edges first, then the original fall-throughs, so cold code keeps its order
+    for (int e = 0; e < edgeCount + blockCount - 1; e++)
+    {
+        int from = e < edgeCount ? edgeFrom[edges[e].index] : e - edgeCount;
+        int to = e < edgeCount ? edgeTo[edges[e].index] : fall[from];
+        if (to <= 0 || next[from] >= 0 || previous[to] >= 0 || layoutChain(chains, from) == layoutChain(chains, to))
+            continue;
+        next[from] = to;
+        previous[to] = from;
+        chains[layoutChain(chains, to)] = layoutChain(chains, from);
+    }
+
+    // Chains by their hottest block, the entry's first
+    RankedCount *heads = (RankedCount *)malloc(blockCount * sizeof(RankedCount));
+    int headCount = 0;
+    for (int b = 1; b < blockCount; b++)
+    {
+        if (previous[b] >= 0)
+            continue;
+        heads[headCount].count = 0;
+        heads[headCount].index = b;
+        for (int c = b; c >= 0; c = next[c])
+            if (profile->counts[c] > heads[headCount].count)
+                heads[headCount].count = profile->counts[c];
+        headCount++;
+    }
+    qsort(heads, headCount, sizeof(RankedCount), compareHotspots);
+    int *order = (int *)malloc(blockCount * sizeof(int));
+    int placed = 0;
+    for (int h = -1; h < headCount; h++)
+        for (int c = h < 0 ? 0 : heads[h].index; c >= 0; c = next[c])
+            order[placed++] = c;
+
+    // Decide every block's exit first: the blocks jumped to must be labeled before they are emitted
+    char *invert = (char *)calloc(blockCount, 1);
+    char *dropJump = (char *)calloc(blockCount, 1);
+    char *needsLabel = (char *)calloc(blockCount + 1, 1); // the end at blockCount
+    int *extraJump = (int *)malloc(blockCount * sizeof(int));
+    int changes = 0;
+    for (int k = 0; k < blockCount; k++)
+    {
+        int b = order[k], following = k + 1 < blockCount ? order[k + 1] : EXIT;
+        changes += b != k;
+        extraJump[b] = NONE;
+        if (fall[b] == NONE)
+            dropJump[b] = jumpTarget[b] == following;
+        else if (fall[b] != following && jumpTarget[b] == following)
+        {
+            invert[b] = 1;
+            needsLabel[fall[b] == EXIT ? blockCount : fall[b]] = 1;
+        }
+        else if (fall[b] != following)
+        {
+            extraJump[b] = fall[b];
+            needsLabel[fall[b] == EXIT ? blockCount : fall[b]] = 1;
+        }
+        changes += dropJump[b] + invert[b];
+    }
+
+    if (changes > 0)
+    {
+        int count;
+        Instruction *old = cutInstructions(0, &count);
+        int *labelName = (int *)malloc((blockCount + 1) * sizeof(int));
+        for (int b = 0; b <= blockCount; b++)
+        {
+            labelName[b] = -1;
+            if (b < blockCount && old[cfg->blocks[b].start].type == LABEL)
+                labelName[b] = old[cfg->blocks[b].start].label;
+            else if (needsLabel[b])
+                labelName[b] = newStackLabel();
+        }
+        for (int k = 0; k < blockCount; k++)
+        {
+            int b = order[k];
+            const BasicBlock *block = &cfg->blocks[b];
+            code.line = old[block->start].line;
+            if (old[block->start].type != LABEL && needsLabel[b])
+            {
+                emitStackLabel(LABEL, labelName[b]);
+                code.instructions[code.size - 1].block = b;
+            }
+            appendInstructions(old + block->start, block->end - block->start - dropJump[b]);
+            if (invert[b])
+            {
+                // The comparison in front is negated when there is one, so that it still fuses
+                Instruction *jump = &code.instructions[code.size - 1];
+                Instruction *test = block->end - block->start >= 2 ? jump - 1 : NULL;
+                if (test != NULL && test->type >= COMP_LT && test->type <= COMP_NE)
+                    test->type = negateComparison(test->type);
+                else
+                    jump->type = jump->type == GO_FALSE ? GO_TRUE : GO_FALSE;
+                jump->label = labelName[fall[b] == EXIT ? blockCount : fall[b]];
+            }
+            if (extraJump[b] != NONE)
+            {
+                code.line = old[block->end - 1].line;
+                emitStackLabel(GOTO, labelName[extraJump[b] == EXIT ? blockCount : extraJump[b]]);
+                code.instructions[code.size - 1].block = b;
+            }
+        }
+        if (needsLabel[blockCount])
+            emitStackLabel(LABEL, labelName[blockCount]);
+        free(labelName);
+        free(old);
+    }
+    free(jumpTarget);
+    free(fall);
+    free(edges);
+    free(edgeFrom);
+    free(edgeTo);
+    free(chains);
+    free(next);
+    free(previous);
+    free(heads);
+    free(order);
+    free(invert);
+    free(dropJump);
+    free(needsLabel);
+    free(extraJump);
+    return changes;
+}
+int readBlockProfile(BlockProfile *profile, const char *filename)
+{
+    memset(profile, 0, sizeof(*profile));
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open profile '%s'\n", filename);
+        return -1;
+    }
+
+    char line[128];
+    int header = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        int block, target;
+        long long count, jumps;
+        if (line[0] == '#')
+            continue;
+        if (!header)
+        {
+            if (sscanf(line, "program %llx %d", &profile->hash, &profile->blockCount) != 2 ||
+                profile->blockCount < 0)
+                break;
+            header = 1;
+            profile->counts = (long long *)calloc(profile->blockCount + 1, sizeof(long long));
+            profile->jumps = (long long *)calloc(profile->blockCount + 1, sizeof(long long));
+            profile->jumpTargets = (int *)malloc((profile->blockCount + 1) * sizeof(int));
+            for (int b = 0; b < profile->blockCount; b++)
+                profile->jumpTargets[b] = -2;
+            continue;
+        }
+        int fields = sscanf(line, "%d %lld %d %lld", &block, &count, &target, &jumps);
+        if (fields < 2 || block < 0 || block >= profile->blockCount)
+            continue;
+        profile->counts[block] = count;
+        if (fields == 4)
+        {
+            profile->jumpTargets[block] = target;
+            profile->jumps[block] = jumps;
+        }
+    }
+    fclose(file);
+    if (!header)
+    {
+        fprintf(stderr, "Error: '%s' is not a block profile\n", filename);
+        return -1;
+    }
+    return 0;
+}
+int writeBlockProfile(const ExecutionProfile *execution, const char *filename)
+{
+    // Counts are kept per block of the code before layout, and added to those of
+    // earlier runs of the same code
+    int blockCount = code.layoutBlocks;
+    if (blockCount == 0 && code.size > 0)
+    {
+        fprintf(stderr, "Error: The program has no numbered blocks to profile\n");
+        return -1;
+    }
+    BlockProfile profile;
+    profile.hash = code.layoutHash;
+    profile.blockCount = blockCount;
+    profile.counts = (long long *)calloc(blockCount + 1, sizeof(long long));
+    profile.jumps = (long long *)calloc(blockCount + 1, sizeof(long long));
+    profile.jumpTargets = (int *)malloc((blockCount + 1) * sizeof(int));
+    for (int b = 0; b < blockCount; b++)
+        profile.jumpTargets[b] = -2;
+    const LabelIndex *labels = code.linked ? NULL : requireLabels();
+    for (int pc = 0; pc < execution->size; pc++)
+    {
+        const Instruction *instr = &code.instructions[pc];
+        int b = instr->block;
+        if (b < 0 || b >= blockCount)
+            continue;
+        if (execution->hits[pc] > profile.counts[b])
+            profile.counts[b] = execution->hits[pc];
+        if (isJumpInstruction(instr->type) && instr->type != GOTO)
+        {
+            int target = jumpTargetPosition(instr, labels);
+            profile.jumpTargets[b] = target >= 0 && target < code.size ? code.instructions[target].block : -1;
+            profile.jumps[b] = execution->taken[pc];
+        }
+    }
+
+    BlockProfile earlier = {0};
+    if (access(filename, F_OK) == 0 && readBlockProfile(&earlier, filename) == 0 &&
+        earlier.hash == profile.hash && earlier.blockCount == blockCount)
+    {
+        for (int b = 0; b < blockCount; b++)
+        {
+            profile.counts[b] += earlier.counts[b];
+            if (earlier.jumpTargets[b] == -2)
+                continue;
+            // Taken then toward the other successor: its jumps are this run's fall-throughs
+            if (profile.jumpTargets[b] == -2 || earlier.jumpTargets[b] == profile.jumpTargets[b])
+            {
+                profile.jumpTargets[b] = earlier.jumpTargets[b];
+                profile.jumps[b] += earlier.jumps[b];
+            }
+            else
+                profile.jumps[b] += earlier.counts[b] - earlier.jumps[b];
+        }
+    }
+    freeBlockProfile(&earlier);
+
+    FILE *file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error: Cannot write profile '%s'\n", filename);
+        freeBlockProfile(&profile);
+        return -1;
+    }
+    fprintf(file, "# block profile: code hash and blocks before layout, then per block reached:\n");
+    fprintf(file, "# block entries [block its conditional jump goes to (-1: the end), times taken]\n");
+    fprintf(file, "program %016llx %d\n", profile.hash, blockCount);
+    for (int b = 0; b < blockCount; b++)
+    {
+        if (profile.counts[b] == 0)
+            continue;
+        if (profile.jumpTargets[b] != -2)
+            fprintf(file, "%d %lld %d %lld\n", b, profile.counts[b], profile.jumpTargets[b], profile.jumps[b]);
+        else
+            fprintf(file, "%d %lld\n", b, profile.counts[b]);
+    }
+    fclose(file);
+    freeBlockProfile(&profile);
+    return 0;
+}
+void freeBlockProfile(BlockProfile *profile)
+{
+    free(profile->counts);
+    free(profile->jumpTargets);
+    free(profile->jumps);
+    memset(profile, 0, sizeof(*profile));
+}
+
+// Tiered execution functions implementation//
+int parseTierThresholds(const char *text)
+{
+    // <runs>[,<back edges>]
+    char *end;
+    long long runs = strtoll(text, &end, 10);
+    long long backEdges = tiers.backEdgeThreshold;
+    if (end == text || runs < 0)
+        return -1;
+    if (*end == ',')
+    {
+        const char *rest = end + 1;
+        backEdges = strtoll(rest, &end, 10);
+        if (end == rest || backEdges < 0)
+            return -1;
+    }
+    if (*end != '\0')
+        return -1;
+    tiers.runThreshold = runs;
+    tiers.backEdgeThreshold = backEdges;
+    return 0;
+}
+VmStatus runTiered(VmState *vm)
+{
+    if (vm->pc == 0 && atomic_fetch_add(&tiers.runs, 1) >= tiers.runThreshold)
+        requestTierUp("runs");
+    const unsigned char *entry = nativeEntry(vm->pc);
+    if (entry != NULL)
+    {
+        atomic_fetch_add(&tiers.nativeRuns, 1);
+        return tiers.native.enter(vm, entry);
+    }
+    VmStatus status = runVmLoop(vm, 0, 0, 0, 1);
+    if (status != VM_PROMOTED)
+        return status;
+    atomic_fetch_add(&tiers.switchedRuns, 1);
+    return tiers.native.enter(vm, nativeEntry(vm->pc));
+}
+int countBackEdges(long long count)
+{
+    if (atomic_fetch_add(&tiers.backEdges, count) + count >= tiers.backEdgeThreshold)
+        requestTierUp("back edges");
+    return atomic_load(&tiers.state) == TIER_NATIVE;
+}
+void requestTierUp(const char *trigger)
+{
+    int expected = TIER_INTERPRETED;
+    if (atomic_load(&tiers.state) != TIER_INTERPRETED ||
+        !atomic_compare_exchange_strong(&tiers.state, &expected, TIER_COMPILING))
+        return;
+    tiers.trigger = trigger;
+    tiers.runsAtTierUp = atomic_load(&tiers.runs);
+    tiers.backEdgesAtTierUp = atomic_load(&tiers.backEdges);
+    // A run threshold of 0 asks for native code from the first run on
+    if (tiers.runThreshold > 0 && pthread_create(&tiers.compiler, NULL, compileTier, NULL) == 0)
+        tiers.compilerStarted = 1;
+    else
+        compileTier(NULL);
+}
+void *compileTier(void *unused)
+{
+    (void)unused;
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    int status = compileNative(&tiers.native);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    tiers.compileSeconds = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+    // Publishes the code: runs look at the state before they look at the code
+    atomic_store(&tiers.state, status == 0 ? TIER_NATIVE : TIER_FAILED);
+    return NULL;
+}
+const unsigned char *nativeEntry(int pc)
+{
+    if (atomic_load(&tiers.state) != TIER_NATIVE || tiers.native.entries[pc] < 0)
+        return NULL;
+    return tiers.native.text + tiers.native.entries[pc];
+}
+void finishTiers(const char *filename, int stats)
+{
+    if (tiers.compilerStarted)
+        pthread_join(tiers.compiler, NULL);
+    int state = atomic_load(&tiers.state);
+    if (stats && state == TIER_NATIVE)
+        fprintf(stderr, "%s: tiered, native after %lld runs and %lld back edges (%s), %d instructions into %zu bytes "
+                        "in %.3f ms; %lld runs started native, %lld switched at a loop\n",
+                filename, tiers.runsAtTierUp, tiers.backEdgesAtTierUp, tiers.trigger, code.size, tiers.native.size,
+                tiers.compileSeconds * 1e3, atomic_load(&tiers.nativeRuns), atomic_load(&tiers.switchedRuns));
+    else if (stats && state == TIER_FAILED)
+        fprintf(stderr, "%s: tiered, interpreted: %s\n", filename, tiers.failure);
+    else if (stats)
+        fprintf(stderr, "%s: tiered, interpreted: %lld runs and %lld back edges, below %lld and %lld\n", filename,
+                atomic_load(&tiers.runs), atomic_load(&tiers.backEdges), tiers.runThreshold, tiers.backEdgeThreshold);
+
+    // The next file starts over in the interpreter; the options stay
+    freeNativeCode(&tiers.native);
+    tiers.compilerStarted = 0;
+    tiers.trigger = tiers.failure = NULL;
+    tiers.runsAtTierUp = tiers.backEdgesAtTierUp = 0;
+    tiers.compileSeconds = 0;
+    atomic_store(&tiers.runs, 0);
+    atomic_store(&tiers.backEdges, 0);
+    atomic_store(&tiers.nativeRuns, 0);
+    atomic_store(&tiers.switchedRuns, 0);
+    atomic_store(&tiers.state, TIER_INTERPRETED);
+}
+int nativeRead(VmState *vm, int pc)
+{
+    const Instruction *instr = &code.instructions[pc];
+    if (vm->prompt)
+    {
+        writeText(vm->output, code.variables[instr->arg]);
+        writeText(vm->output, " = ");
+        flushOutput(vm->output);
+    }
+    if (readInteger(vm->input, &vm->frame[instr->arg]) == 0)
+        return 0;
+    nativeFail(vm, "Invalid input for readln", pc);
+    return -1;
+}
+void nativeFail(VmState *vm, const char *message, int pc)
+{
+    // As VM_FAIL reports it
+    if (vm->record > 0)
+        recordError(vm->record, message, pc);
+    else
+        runtimeError(message, pc);
+    vm->pc = pc;
+}
+int compileNative(NativeCode *native)
+{
+#if defined(__x86_64__)
+    if (!code.linked || !code.verified)
+    {
+        tiers.failure = "the code is not linked and verified";
+        return -1;
+    }
+    int n = code.size;
+    NativeCompiler *c = (NativeCompiler *)calloc(1, sizeof(NativeCompiler));
+    int *depths = (int *)malloc((n + 1) * sizeof(int));
+    char *leaders = (char *)calloc(n + 1, 1);
+    if (c == NULL || depths == NULL || leaders == NULL)
+    {
+        free(c);
+        free(depths);
+        free(leaders);
+        tiers.failure = "out of memory";
+        return -1;
+    }
+    c->offsets = (int *)malloc((n + 2) * sizeof(int));
+    for (int pc = 0; pc < n + 2; pc++)
+        c->offsets[pc] = -1;
+    int status = nativeStackDepths(depths, leaders);
+    if (status != 0)
+        tiers.failure = "the operand stack depth is not the same on every path";
+
+    // Prologue: push rbp, rbx, r12-r15, keep rsp 16-byte aligned for calls, load the registers, jump to the entry
+    static const unsigned char saves[] = {0x55, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57};
+    for (size_t i = 0; i < sizeof(saves); i++)
+        nativeByte(c, saves[i]);
+    nativeRegister(c, 0, 1, 0x83, 5, NATIVE_RSP);
+    nativeByte(c, 8);
+    nativeRegister(c, 0, 1, 0x89, NATIVE_RDI, NATIVE_R12);
+    nativeMemory(c, 0, 1, 0x8b, NATIVE_RBX, NATIVE_R12, -1, (int)offsetof(VmState, frame));
+    nativeMemory(c, 0, 1, 0x8b, NATIVE_R13, NATIVE_R12, -1, (int)offsetof(VmState, stack));
+    nativeRegister(c, 0, 0, 0x31, NATIVE_R14, NATIVE_R14);
+    nativeRegister(c, 0, 0, 0xff, 4, NATIVE_RSI);
+
+    int reachable = 0;
+    for (int pc = 0; pc < n && status == 0;)
+    {
+        if (leaders[pc])
+        {
+            if (reachable)
+                nativeFlushAll(c);
+            reachable = depths[pc] >= 0;
+            c->offsets[pc] = (int)c->size;
+            if (reachable)
+            {
+                // Blocks are entered with the whole operand stack in memory
+                c->depth = depths[pc];
+                for (int k = 0; k < c->depth; k++)
+                    c->stack[k] = (NativeOperand){NATIVE_STACK, k};
+                c->blockEnd = pc + 1;
+                while (c->blockEnd < n && !leaders[c->blockEnd])
+                    c->blockEnd++;
+                // add r14, block length: counted on entry, where the interpreter counts one by one
+                nativeRegister(c, 0, 1, 0x81, 0, NATIVE_R14);
+                nativeInt(c, c->blockEnd - pc);
+            }
+        }
+        if (!reachable)
+        {
+            pc++;
+            continue;
+        }
+        c->pc = pc;
+        int consumed = compileNativeInstruction(c, &code.instructions[pc], leaders, &reachable);
+        if (consumed == 0)
+        {
+            tiers.failure = "unknown instruction";
+            status = -1;
+        }
+        pc += consumed;
+    }
+
+    // Halt: pc past the end, as the interpreter leaves it, then the epilogue shared with the error stubs
+    c->offsets[n] = (int)c->size;
+    nativeMemory(c, 0, 0, 0xc7, 0, NATIVE_R12, -1, (int)offsetof(VmState, pc));
+    nativeInt(c, n);
+    nativeMemory(c, 0, 0, 0xc7, 0, NATIVE_R12, -1, (int)offsetof(VmState, sp));
+    nativeInt(c, depths[n] > 0 ? depths[n] : 0);
+    nativeMoveImmediate(c, NATIVE_RAX, VM_HALTED);
+    c->offsets[n + 1] = (int)c->size;
+    nativeMemory(c, 0, 1, 0x01, NATIVE_R14, NATIVE_R12, -1, (int)offsetof(VmState, executed));
+    nativeRegister(c, 0, 1, 0x83, 0, NATIVE_RSP);
+    nativeByte(c, 8);
+    static const unsigned char restores[] = {0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5b, 0x5d, 0xc3};
+    for (size_t i = 0; i < sizeof(restores); i++)
+        nativeByte(c, restores[i]);
+
+    for (int s = 0; s < c->stubCount; s++)
+    {
+        NativeStub *stub = &c->stubs[s];
+        stub->offset = (int)c->size;
+        if (stub->unexecuted > 0)
+        {
+            nativeRegister(c, 0, 1, 0x81, 5, NATIVE_R14);
+            nativeInt(c, stub->unexecuted);
+        }
+        if (stub->message != NULL)
+        {
+            nativeRegister(c, 0, 1, 0x89, NATIVE_R12, NATIVE_RDI);
+            nativePrefix(c, 0, 1, 0xb8 + NATIVE_RSI, 0, 0, 0);
+            unsigned long long message = (unsigned long long)stub->message;
+            for (int b = 0; b < 8; b++)
+                nativeByte(c, (int)(message >> (8 * b)) & 0xff);
+            nativeMoveImmediate(c, NATIVE_RDX, stub->pc);
+            nativeCall(c, (unsigned long long)nativeFail);
+        }
+        nativeMoveImmediate(c, NATIVE_RAX, VM_ERROR);
+        nativeJump(c, -1, n + 1);
+    }
+
+    for (int f = 0; f < c->fixupCount && status == 0; f++)
+    {
+        int target = c->fixups[f].target >= 0 ? c->offsets[c->fixups[f].target] : c->stubs[-1 - c->fixups[f].target].offset;
+        if (target < 0)
+        {
+            tiers.failure = "a jump into unreachable code";
+            status = -1;
+            break;
+        }
+        int relative = target - (c->fixups[f].at + 4);
+        memcpy(c->bytes + c->fixups[f].at, &relative, sizeof(relative));
+    }
+
+    if (status == 0)
+    {
+        // Written while writable, then executable and no longer writable
+        void *text = mmap(NULL, c->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (text == MAP_FAILED)
+        {
+            tiers.failure = "cannot map the native code";
+            status = -1;
+        }
+        else
+        {
+            memcpy(text, c->bytes, c->size);
+            if (mprotect(text, c->size, PROT_READ | PROT_EXEC) != 0)
+            {
+                munmap(text, c->size);
+                tiers.failure = "cannot make the native code executable";
+                status = -1;
+            }
+            else
+            {
+                native->text = (unsigned char *)text;
+                native->size = c->size;
+                native->entries = (int *)malloc((n + 1) * sizeof(int));
+                for (int pc = 0; pc <= n; pc++)
+                    native->entries[pc] = pc == n || (leaders[pc] && depths[pc] >= 0) ? c->offsets[pc] : -1;
+                native->enter = (VmStatus (*)(VmState *, const unsigned char *))text;
+            }
+        }
+    }
+    free(c->bytes);
+    free(c->offsets);
+    free(c->fixups);
+    free(c->stubs);
+    free(c);
+    free(depths);
+    free(leaders);
+    return status;
+#else
+    (void)native;
+    tiers.failure = "native code is only generated for x86-64";
+    return -1;
+#endif
+}
+void freeNativeCode(NativeCode *native)
+{
+    if (native->text != NULL)
+        munmap(native->text, native->size);
+    free(native->entries);
+    memset(native, 0, sizeof(*native));
+}
+int nativeStackDepths(int *depths, char *leaders)
+{
+    // The depth at each instruction, the same along every path in verified code, and the block leaders
+    int n = code.size;
+    for (int pc = 0; pc <= n; pc++)
+        depths[pc] = -1;
+    leaders[0] = 1;
+    for (int pc = 0; pc < n; pc++)
+    {
+        if (isJumpInstruction(code.instructions[pc].type))
+        {
+            if (code.instructions[pc].arg < 0 || code.instructions[pc].arg > n)
+                return -1;
+            leaders[code.instructions[pc].arg] = 1;
+            leaders[pc + 1] = 1;
+        }
+    }
+
+    int *work = (int *)malloc((n + 1) * sizeof(int));
+    int count = 0, status = 0;
+    depths[0] = 0;
+    work[count++] = 0;
+    while (count > 0 && status == 0)
+    {
+        int pc = work[--count];
+        if (pc == n)
+            continue;
+        const Instruction *instr = &code.instructions[pc];
+        int after = depths[pc] + stackEffect(instr->type);
+        int next[2] = {instr->type == GOTO ? -1 : pc + 1, isJumpInstruction(instr->type) ? instr->arg : -1};
+        for (int i = 0; i < 2 && status == 0; i++)
+        {
+            if (next[i] < 0)
+                continue;
+            if (after < 0 || after > MAX_STACK_DEPTH)
+                status = -1;
+            else if (depths[next[i]] < 0)
+            {
+                depths[next[i]] = after;
+                work[count++] = next[i];
+            }
+            else if (depths[next[i]] != after)
+                status = -1;
+        }
+    }
+    free(work);
+    return status;
+}
+int compileNativeInstruction(NativeCompiler *c, const Instruction *instr, const char *leaders, int *reachable)
+{
+    // Instructions compiled: 2 when a comparison and its jump become one cmp/jcc, 0 on failure
+    NativeOperand top;
+    switch (instr->type)
+    {
+    case PUSH:
+    case STORE:
+        nativePush(c, NATIVE_CONSTANT, instr->arg);
+        break;
+    case VALUE:
+        nativePush(c, NATIVE_SLOT, instr->arg);
+        break;
+    case ADD:
+    case SUB:
+    case MUL:
+        nativeArithmetic(c, instr->type);
+        break;
+    case DIV:
+        nativeDivide(c);
+        break;
+    case ASSIGN:
+    {
+        NativeOperand value = c->stack[c->depth - 1], address = c->stack[c->depth - 2];
+        c->depth -= 2;
+        if (address.kind == NATIVE_CONSTANT)
+        {
+            nativeStore(c, address.value, value);
+            break;
+        }
+        // mov [rbx + rdx*4], ecx with any slot: no pending load may stay behind
+        nativeFlushSlots(c, 0, 0x7fffffff);
+        nativeLoad(c, &address, NATIVE_RDX);
+        nativeLoad(c, &value, NATIVE_RCX);
+        nativeMemory(c, 0, 0, 0x89, NATIVE_RCX, NATIVE_RBX, NATIVE_RDX, 0);
+        break;
+    }
+    case SWAP:
+    {
+        NativeOperand *low = &c->stack[c->depth - 2], *high = &c->stack[c->depth - 1];
+        NativeOperand below = *low, above = *high;
+        int lowAt = 4 * (c->depth - 2), highAt = 4 * (c->depth - 1);
+        // Entries in memory stay at their own depth, so their values are moved
+        if (below.kind == NATIVE_STACK && above.kind == NATIVE_STACK)
+        {
+            nativeMemory(c, 0, 0, 0x8b, NATIVE_RCX, NATIVE_R13, -1, lowAt);
+            nativeMemory(c, 0, 0, 0x8b, NATIVE_RDX, NATIVE_R13, -1, highAt);
+            nativeMemory(c, 0, 0, 0x89, NATIVE_RDX, NATIVE_R13, -1, lowAt);
+            nativeMemory(c, 0, 0, 0x89, NATIVE_RCX, NATIVE_R13, -1, highAt);
+        }
+        else if (below.kind == NATIVE_STACK)
+        {
+            nativeMemory(c, 0, 0, 0x8b, NATIVE_RCX, NATIVE_R13, -1, lowAt);
+            nativeMemory(c, 0, 0, 0x89, NATIVE_RCX, NATIVE_R13, -1, highAt);
+            *low = above;
+            *high = (NativeOperand){NATIVE_STACK, c->depth - 1};
+        }
+        else if (above.kind == NATIVE_STACK)
+        {
+            nativeMemory(c, 0, 0, 0x8b, NATIVE_RCX, NATIVE_R13, -1, highAt);
+            nativeMemory(c, 0, 0, 0x89, NATIVE_RCX, NATIVE_R13, -1, lowAt);
+            *low = (NativeOperand){NATIVE_STACK, c->depth - 2};
+            *high = below;
+        }
+        else
+        {
+            *low = above;
+            *high = below;
+        }
+        break;
+    }
+    case COMP_LT:
+    case COMP_GT:
+    case COMP_LE:
+    case COMP_GE:
+    case COMP_EQ:
+    case COMP_NE:
+    {
+        const Instruction *next = instr + 1;
+        if (c->pc + 1 < code.size && !leaders[c->pc + 1] && (next->type == GO_FALSE || next->type == GO_TRUE))
+        {
+            nativeCompareJump(c, instr->type, next->type == GO_TRUE, next->arg, reachable);
+            return 2;
+        }
+        if (nativeArithmetic(c, instr->type) == 0)
+        {
+            // setcc al; movzx eax, al
+            nativeRegister(c, 0, 0, 0x0f90 | nativeCondition(instr->type), 0, NATIVE_RAX);
+            nativeRegister(c, 0, 0, 0x0fb6, NATIVE_RAX, NATIVE_RAX);
+            nativePush(c, NATIVE_EAX, 0);
+        }
+        break;
+    }
+    case GO_FALSE:
+    case GO_TRUE:
+        top = c->stack[--c->depth];
+        if (top.kind == NATIVE_CONSTANT)
+        {
+            nativeFlushAll(c);
+            if ((top.value != 0) == (instr->type == GO_TRUE))
+            {
+                nativeJump(c, -1, instr->arg);
+                *reachable = 0;
+            }
+            break;
+        }
+        if (top.kind == NATIVE_EAX)
+            nativeRegister(c, 0, 0, 0x85, NATIVE_RAX, NATIVE_RAX);
+        else
+        {
+            nativeMemory(c, 0, 0, 0x83, 7, top.kind == NATIVE_SLOT ? NATIVE_RBX : NATIVE_R13, -1, 4 * top.value);
+            nativeByte(c, 0);
+        }
+        nativeFlushAll(c);
+        nativeJump(c, instr->type == GO_TRUE ? 0x5 : 0x4, instr->arg);
+        break;
+    case GOTO:
+        nativeFlushAll(c);
+        nativeJump(c, -1, instr->arg);
+        *reachable = 0;
+        break;
+    case GO_FALSE_LT:
+    case GO_FALSE_GT:
+    case GO_FALSE_LE:
+    case GO_FALSE_GE:
+    case GO_FALSE_EQ:
+    case GO_FALSE_NE:
+        nativeCompareJump(c, (InstructionType)(instr->type - GO_FALSE_LT + COMP_LT), 0, instr->arg, reachable);
+        break;
+    case LABEL:
+        break;
+    case READ:
+        nativeSpillEax(c);
+        nativeFlushSlots(c, instr->arg, instr->arg + 1);
+        nativeRegister(c, 0, 1, 0x89, NATIVE_R12, NATIVE_RDI);
+        nativeMoveImmediate(c, NATIVE_RSI, c->pc);
+        nativeCall(c, (unsigned long long)nativeRead);
+        nativeRegister(c, 0, 0, 0x85, NATIVE_RAX, NATIVE_RAX);
+        nativeFailJump(c, 0x5, NULL);
+        break;
+    case WRITE:
+    case WRITE_VALUE:
+        if (instr->type == WRITE)
+            top = c->stack[--c->depth];
+        else
+            top = (NativeOperand){NATIVE_SLOT, instr->arg};
+        nativeLoad(c, &top, NATIVE_RSI);
+        nativeSpillEax(c);
+        nativeMemory(c, 0, 1, 0x8b, NATIVE_RDI, NATIVE_R12, -1, (int)offsetof(VmState, output));
+        nativeCall(c, (unsigned long long)writeInteger);
+        break;
+    case VALUE_AT:
+        top = c->stack[c->depth - 1];
+        if (top.kind == NATIVE_CONSTANT)
+        {
+            if ((unsigned)top.value < (unsigned)instr->length)
+                c->stack[c->depth - 1] = (NativeOperand){NATIVE_SLOT, instr->arg + top.value};
+            else
+            {
+                nativeFailJump(c, -1, "Array index out of bounds");
+                c->stack[c->depth - 1] = (NativeOperand){NATIVE_CONSTANT, 0};
+            }
+            break;
+        }
+        c->depth--;
+        nativeSpillEax(c);
+        nativeLoad(c, &top, NATIVE_RAX);
+        // cmp eax, length; jae: negative indexes are out of bounds too
+        nativeRegister(c, 0, 0, 0x81, 7, NATIVE_RAX);
+        nativeInt(c, instr->length);
+        nativeFailJump(c, 0x3, "Array index out of bounds");
+        nativeMemory(c, 0, 0, 0x8b, NATIVE_RAX, NATIVE_RBX, NATIVE_RAX, 4 * instr->arg);
+        nativePush(c, NATIVE_EAX, 0);
+        break;
+    case ASSIGN_AT:
+    {
+        NativeOperand value = c->stack[c->depth - 1], index = c->stack[c->depth - 2];
+        c->depth -= 2;
+        if (index.kind == NATIVE_CONSTANT)
+        {
+            if ((unsigned)index.value < (unsigned)instr->length)
+                nativeStore(c, instr->arg + index.value, value);
+            else
+                nativeFailJump(c, -1, "Array index out of bounds");
+            break;
+        }
+        nativeFlushSlots(c, instr->arg, instr->arg + instr->length);
+        nativeSpillEax(c);
+        nativeLoad(c, &index, NATIVE_RCX);
+        nativeRegister(c, 0, 0, 0x81, 7, NATIVE_RCX);
+        nativeInt(c, instr->length);
+        nativeFailJump(c, 0x3, "Array index out of bounds");
+        if (value.kind == NATIVE_CONSTANT)
+        {
+            nativeMemory(c, 0, 0, 0xc7, 0, NATIVE_RBX, NATIVE_RCX, 4 * instr->arg);
+            nativeInt(c, value.value);
+        }
+        else
+        {
+            nativeLoad(c, &value, NATIVE_RAX);
+            nativeMemory(c, 0, 0, 0x89, NATIVE_RAX, NATIVE_RBX, NATIVE_RCX, 4 * instr->arg);
+        }
+        break;
+    }
+    case ARRAY_ADD:
+    case ARRAY_SUB:
+    case ARRAY_MUL:
+        nativeFlushSlots(c, instr->arg, instr->arg + instr->length);
+        nativeSpillEax(c);
+        nativeMoveImmediate(c, NATIVE_RDI, instr->type);
+        nativeMemory(c, 0, 1, 0x8d, NATIVE_RSI, NATIVE_RBX, -1, 4 * instr->arg);
+        nativeMemory(c, 0, 1, 0x8d, NATIVE_RDX, NATIVE_RBX, -1, 4 * instr->arg2);
+        nativeMemory(c, 0, 1, 0x8d, NATIVE_RCX, NATIVE_RBX, -1, 4 * instr->arg3);
+        nativeMoveImmediate(c, NATIVE_R8, instr->length);
+        nativeCall(c, (unsigned long long)runArrayOperation);
+        break;
+    case VADD:
+    case VSUB:
+    case VMUL:
+        nativeFlushSlots(c, instr->arg, instr->arg + VECTOR_WIDTH);
+        if (instr->type != VMUL || __builtin_cpu_supports("sse4.1"))
+        {
+            // movdqu xmm0, left; movdqu xmm1, right; paddd/psubd/pmulld xmm0, xmm1; movdqu target, xmm0
+            nativeMemory(c, 0xf3, 0, 0x0f6f, 0, NATIVE_RBX, -1, 4 * instr->arg2);
+            nativeMemory(c, 0xf3, 0, 0x0f6f, 1, NATIVE_RBX, -1, 4 * instr->arg3);
+            nativeRegister(c, 0x66, 0, instr->type == VADD ? 0x0ffe : instr->type == VSUB ? 0x0ffa : 0x0f3840, 0, 1);
+            nativeMemory(c, 0xf3, 0, 0x0f7f, 0, NATIVE_RBX, -1, 4 * instr->arg);
+        }
+        else
+        {
+            // All the products before any store, as the vector does it
+            static const int lanes[VECTOR_WIDTH] = {NATIVE_RCX, NATIVE_RDX, NATIVE_RSI, NATIVE_RDI};
+            for (int k = 0; k < VECTOR_WIDTH; k++)
+            {
+                nativeMemory(c, 0, 0, 0x8b, lanes[k], NATIVE_RBX, -1, 4 * (instr->arg2 + k));
+                nativeMemory(c, 0, 0, 0x0faf, lanes[k], NATIVE_RBX, -1, 4 * (instr->arg3 + k));
+            }
+            for (int k = 0; k < VECTOR_WIDTH; k++)
+                nativeMemory(c, 0, 0, 0x89, lanes[k], NATIVE_RBX, -1, 4 * (instr->arg + k));
+        }
+        break;
+    case SELECT:
+    {
+        NativeOperand chosen, condition = c->stack[c->depth - 1];
+        NativeOperand otherwise = c->stack[c->depth - 2], then = c->stack[c->depth - 3];
+        c->depth -= 3;
+        if (condition.kind == NATIVE_CONSTANT)
+        {
+            chosen = condition.value != 0 ? then : otherwise;
+            if (chosen.kind == NATIVE_STACK && chosen.value != c->depth)
+            {
+                nativeLoad(c, &chosen, NATIVE_RCX);
+                chosen.kind = NATIVE_ECX;
+            }
+            c->stack[c->depth++] = chosen;
+            if (chosen.kind == NATIVE_ECX)
+                nativeFlush(c, c->depth - 1);
+            break;
+        }
+        nativeSpillEax(c);
+        nativeLoad(c, &condition, NATIVE_RDX);
+        nativeLoad(c, &otherwise, NATIVE_RCX);
+        nativeLoad(c, &then, NATIVE_RAX);
+        // test edx, edx; cmovz eax, ecx
+        nativeRegister(c, 0, 0, 0x85, NATIVE_RDX, NATIVE_RDX);
+        nativeRegister(c, 0, 0, 0x0f44, NATIVE_RAX, NATIVE_RCX);
+        nativePush(c, NATIVE_EAX, 0);
+        break;
+    }
+    case VALUE2_ADD:
+    case VALUE2_SUB:
+    case VALUE2_MUL:
+        nativePush(c, NATIVE_SLOT, instr->arg);
+        nativePush(c, NATIVE_SLOT, instr->arg2);
+        nativeArithmetic(c, (InstructionType)(instr->type - VALUE2_ADD + ADD));
+        break;
+    case PUSH_ADD:
+    case PUSH_SUB:
+    case PUSH_MUL:
+        nativePush(c, NATIVE_CONSTANT, instr->arg);
+        nativeArithmetic(c, (InstructionType)(instr->type - PUSH_ADD + ADD));
+        break;
+    case ASSIGN_TO:
+        top = c->stack[--c->depth];
+        nativeStore(c, instr->arg, top);
+        break;
+    case ASSIGN_CONST:
+        nativeStore(c, instr->arg, (NativeOperand){NATIVE_CONSTANT, instr->arg2});
+        break;
+    case ASSIGN_VALUE:
+        nativeStore(c, instr->arg, (NativeOperand){NATIVE_SLOT, instr->arg2});
+        break;
+    default:
+        return 0;
+    }
+    return 1;
+}
+void nativeByte(NativeCompiler *c, int byte)
+{
+    if (c->size == c->capacity)
+    {
+        c->capacity = c->capacity ? c->capacity * 2 : 4096;
+        c->bytes = (unsigned char *)realloc(c->bytes, c->capacity);
+    }
+    c->bytes[c->size++] = (unsigned char)byte;
+}
+void nativeInt(NativeCompiler *c, int value)
+{
+    for (int b = 0; b < 4; b++)
+        nativeByte(c, (int)((unsigned)value >> (8 * b)) & 0xff);
+}
+void nativePrefix(NativeCompiler *c, int prefix, int wide, int opcode, int reg, int index, int base)
+{
+    // Legacy prefix, REX, then the one to three opcode bytes
+    if (prefix)
+        nativeByte(c, prefix);
+    int rex = (wide ? 8 : 0) | (reg & 8 ? 4 : 0) | (index & 8 ? 2 : 0) | (base & 8 ? 1 : 0);
+    if (rex)
+        nativeByte(c, 0x40 | rex);
+    if (opcode > 0xffff)
+        nativeByte(c, opcode >> 16);
+    if (opcode > 0xff)
+        nativeByte(c, (opcode >> 8) & 0xff);
+    nativeByte(c, opcode & 0xff);
+}
+void nativeRegister(NativeCompiler *c, int prefix, int wide, int opcode, int reg, int rm)
+{
+    nativePrefix(c, prefix, wide, opcode, reg, 0, rm);
+    nativeByte(c, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+void nativeMemory(NativeCompiler *c, int prefix, int wide, int opcode, int reg, int base, int index, int disp)
+{
+    // [base + index*4 + disp32], index -1 for none
+    nativePrefix(c, prefix, wide, opcode, reg, index < 0 ? 0 : index, base);
+    if (index < 0 && (base & 7) != NATIVE_RSP)
+        nativeByte(c, 0x80 | (reg & 7) << 3 | (base & 7));
+    else
+    {
+        nativeByte(c, 0x80 | (reg & 7) << 3 | NATIVE_RSP);
+        nativeByte(c, index < 0 ? 0x20 | (base & 7) : 0x80 | (index & 7) << 3 | (base & 7));
+    }
+    nativeInt(c, disp);
+}
+void nativeMoveImmediate(NativeCompiler *c, int reg, int value)
+{
+    nativePrefix(c, 0, 0, 0xb8 + (reg & 7), 0, 0, reg);
+    nativeInt(c, value);
+}
+void nativeCall(NativeCompiler *c, unsigned long long function)
+{
+    // mov rax, imm64; call rax
+    nativePrefix(c, 0, 1, 0xb8, 0, 0, NATIVE_RAX);
+    for (int b = 0; b < 8; b++)
+        nativeByte(c, (int)(function >> (8 * b)) & 0xff);
+    nativeRegister(c, 0, 0, 0xff, 2, NATIVE_RAX);
+}
+void nativeJump(NativeCompiler *c, int condition, int target)
+{
+    // jmp rel32, or jcc rel32 for a condition code; patched once every offset is known
+    if (condition < 0)
+        nativeByte(c, 0xe9);
+    else
+    {
+        nativeByte(c, 0x0f);
+        nativeByte(c, 0x80 | condition);
+    }
+    if (c->fixupCount == c->fixupCapacity)
+    {
+        c->fixupCapacity = c->fixupCapacity ? c->fixupCapacity * 2 : 64;
+        c->fixups = (NativeFixup *)realloc(c->fixups, c->fixupCapacity * sizeof(NativeFixup));
+    }
+    c->fixups[c->fixupCount++] = (NativeFixup){(int)c->size, target};
+    nativeInt(c, 0);
+}
+void nativeFailJump(NativeCompiler *c, int condition, const char *message)
+{
+    if (c->stubCount == c->stubCapacity)
+    {
+        c->stubCapacity = c->stubCapacity ? c->stubCapacity * 2 : 16;
+        c->stubs = (NativeStub *)realloc(c->stubs, c->stubCapacity * sizeof(NativeStub));
+    }
+    c->stubs[c->stubCount] = (NativeStub){c->pc, message, c->blockEnd - c->pc - 1, -1};
+    nativeJump(c, condition, -1 - c->stubCount++);
+}
+void nativePush(NativeCompiler *c, NativeOperandKind kind, int value)
+{
+    c->stack[c->depth++] = (NativeOperand){kind, value};
+}
+void nativeLoad(NativeCompiler *c, const NativeOperand *operand, int reg)
+{
+    switch (operand->kind)
+    {
+    case NATIVE_CONSTANT:
+        nativeMoveImmediate(c, reg, operand->value);
+        break;
+    case NATIVE_SLOT:
+        nativeMemory(c, 0, 0, 0x8b, reg, NATIVE_RBX, -1, 4 * operand->value);
+        break;
+    case NATIVE_STACK:
+        nativeMemory(c, 0, 0, 0x8b, reg, NATIVE_R13, -1, 4 * operand->value);
+        break;
+    case NATIVE_EAX:
+        if (reg != NATIVE_RAX)
+            nativeRegister(c, 0, 0, 0x89, NATIVE_RAX, reg);
+        break;
+    case NATIVE_ECX:
+        if (reg != NATIVE_RCX)
+            nativeRegister(c, 0, 0, 0x89, NATIVE_RCX, reg);
+        break;
+    }
+}
+void nativeFlush(NativeCompiler *c, int k)
+{
+    // Writes the entry at depth k to vm->stack[k]
+    NativeOperand *entry = &c->stack[k];
+    if (entry->kind == NATIVE_STACK)
+        return;
+    if (entry->kind == NATIVE_CONSTANT)
+    {
+        nativeMemory(c, 0, 0, 0xc7, 0, NATIVE_R13, -1, 4 * k);
+        nativeInt(c, entry->value);
+    }
+    else
+    {
+        int reg = entry->kind == NATIVE_EAX ? NATIVE_RAX : NATIVE_RCX;
+        nativeLoad(c, entry, reg);
+        nativeMemory(c, 0, 0, 0x89, reg, NATIVE_R13, -1, 4 * k);
+    }
+    *entry = (NativeOperand){NATIVE_STACK, k};
+}
+void nativeFlushAll(NativeCompiler *c)
+{
+    for (int k = 0; k < c->depth; k++)
+        nativeFlush(c, k);
+}
+void nativeFlushSlots(NativeCompiler *c, int first, int last)
+{
+    // Loads still pending from slots [first, last), before they are written
+    for (int k = 0; k < c->depth; k++)
+    {
+        if (c->stack[k].kind == NATIVE_SLOT && c->stack[k].value >= first && c->stack[k].value < last)
+            nativeFlush(c, k);
+    }
+}
+void nativeSpillEax(NativeCompiler *c)
+{
+    for (int k = 0; k < c->depth; k++)
+    {
+        if (c->stack[k].kind == NATIVE_EAX)
+            nativeFlush(c, k);
+    }
+}
+void nativeStore(NativeCompiler *c, int slot, NativeOperand value)
+{
+    nativeFlushSlots(c, slot, slot + 1);
+    if (value.kind == NATIVE_CONSTANT)
+    {
+        nativeMemory(c, 0, 0, 0xc7, 0, NATIVE_RBX, -1, 4 * slot);
+        nativeInt(c, value.value);
+        return;
+    }
+    int reg = value.kind == NATIVE_EAX ? NATIVE_RAX : NATIVE_RCX;
+    nativeLoad(c, &value, reg);
+    nativeMemory(c, 0, 0, 0x89, reg, NATIVE_RBX, -1, 4 * slot);
+}
+int nativeArithmetic(NativeCompiler *c, InstructionType type)
+{
+    // Pops two entries; ADD, SUB and MUL push the result in eax, comparisons only set the flags.
+    // Returns 1 when both were constants and the folded result was pushed instead.
+    NativeOperand left = c->stack[c->depth - 2], right = c->stack[c->depth - 1];
+    c->depth -= 2;
+    if (left.kind == NATIVE_CONSTANT && right.kind == NATIVE_CONSTANT)
+    {
+        nativePush(c, NATIVE_CONSTANT, foldOperation(type, left.value, right.value));
+        return 1;
+    }
+    if ((type == ADD || type == MUL) && (left.kind == NATIVE_CONSTANT || right.kind == NATIVE_EAX))
+    {
+        NativeOperand swapped = left;
+        left = right;
+        right = swapped;
+    }
+    nativeSpillEax(c);
+    if (right.kind == NATIVE_EAX)
+    {
+        nativeRegister(c, 0, 0, 0x89, NATIVE_RAX, NATIVE_RCX);
+        right.kind = NATIVE_ECX;
+    }
+    nativeLoad(c, &left, NATIVE_RAX);
+
+    int opcode = type == ADD ? 0x03 : type == SUB ? 0x2b : type == MUL ? 0x0faf : 0x3b;
+    switch (right.kind)
+    {
+    case NATIVE_CONSTANT:
+        if (type == MUL)
+            nativeRegister(c, 0, 0, 0x69, NATIVE_RAX, NATIVE_RAX);
+        else
+            nativeRegister(c, 0, 0, 0x81, type == ADD ? 0 : type == SUB ? 5 : 7, NATIVE_RAX);
+        nativeInt(c, right.value);
+        break;
+    case NATIVE_SLOT:
+        nativeMemory(c, 0, 0, opcode, NATIVE_RAX, NATIVE_RBX, -1, 4 * right.value);
+        break;
+    case NATIVE_STACK:
+        nativeMemory(c, 0, 0, opcode, NATIVE_RAX, NATIVE_R13, -1, 4 * right.value);
+        break;
+    default:
+        nativeRegister(c, 0, 0, opcode, NATIVE_RAX, NATIVE_RCX);
+        break;
+    }
+    if (type == ADD || type == SUB || type == MUL)
+        nativePush(c, NATIVE_EAX, 0);
+    return 0;
+}
+void nativeDivide(NativeCompiler *c)
+{
+    NativeOperand left = c->stack[c->depth - 2], right = c->stack[c->depth - 1];
+    c->depth -= 2;
+    if (left.kind == NATIVE_CONSTANT && right.kind == NATIVE_CONSTANT && right.value != 0)
+    {
+        nativePush(c, NATIVE_CONSTANT, foldOperation(DIV, left.value, right.value));
+        return;
+    }
+    nativeSpillEax(c);
+    if (right.kind == NATIVE_CONSTANT && right.value == 0)
+    {
+        nativeFailJump(c, -1, "Division by zero");
+        nativePush(c, NATIVE_CONSTANT, 0);
+        return;
+    }
+    if (right.kind == NATIVE_CONSTANT)
+    {
+        nativeLoad(c, &left, NATIVE_RAX);
+        if (right.value == -1)
+            nativeRegister(c, 0, 0, 0xf7, 3, NATIVE_RAX);
+        else
+        {
+            nativeMoveImmediate(c, NATIVE_RCX, right.value);
+            nativeByte(c, 0x99);
+            nativeRegister(c, 0, 0, 0xf7, 7, NATIVE_RCX);
+        }
+    }
+    else
+    {
+        nativeLoad(c, &right, NATIVE_RCX);
+        nativeLoad(c, &left, NATIVE_RAX);
+        nativeRegister(c, 0, 0, 0x85, NATIVE_RCX, NATIVE_RCX);
+        nativeFailJump(c, 0x4, "Division by zero");
+        // -1 negates, as the interpreter does: idiv would trap on INT_MIN / -1.
+        // cmp ecx, -1; jne 1f; neg eax; jmp 2f; 1: cdq; idiv ecx; 2:
+        static const unsigned char divide[] = {0x83, 0xf9, 0xff, 0x75, 0x04, 0xf7, 0xd8, 0xeb, 0x03, 0x99, 0xf7, 0xf9};
+        for (size_t i = 0; i < sizeof(divide); i++)
+            nativeByte(c, divide[i]);
+    }
+    nativePush(c, NATIVE_EAX, 0);
+}
+void nativeCompareJump(NativeCompiler *c, InstructionType comparison, int when, int target, int *reachable)
+{
+    // Pops the operands of the comparison and jumps to target when its result is `when`
+    NativeOperand left = c->stack[c->depth - 2], right = c->stack[c->depth - 1];
+    if (left.kind == NATIVE_CONSTANT && right.kind == NATIVE_CONSTANT)
+    {
+        c->depth -= 2;
+        nativeFlushAll(c);
+        if (foldOperation(comparison, left.value, right.value) == when)
+        {
+            nativeJump(c, -1, target);
+            *reachable = 0;
+        }
+        return;
+    }
+    nativeArithmetic(c, comparison);
+    nativeFlushAll(c);
+    nativeJump(c, nativeCondition(comparison) ^ (when ? 0 : 1), target);
+}
+int nativeCondition(InstructionType comparison)
+{
+    // x86 condition codes of the signed comparisons: l, g, le, ge, e, ne
+    switch (comparison)
+    {
+    case COMP_LT:
+        return 0xc;
+    case COMP_GT:
+        return 0xf;
+    case COMP_LE:
+        return 0xe;
+    case COMP_GE:
+        return 0xd;
+    case COMP_EQ:
+        return 0x4;
+    default:
+        return 0x5;
+    }
+}
+
+// Checkpoint functions implementation//
+VmStatus runCheckpointed(VmState *vm)
+{
+    // Slices of the interpreter loop: between two, the whole state is in vm and the streams
+    vm->slice = CHECKPOINT_SLICE;
+    vm->blockingReads = 1;
+    struct timespec last, now;
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    VmStatus status;
+    int warned = 0;
+    while ((status = runVm(vm)) == VM_YIELDED)
+    {
+        // Slices also end on 64 KiB of pending output, which the event loop would send
+        if (vm->output->size >= INSTANCE_OUTPUT_LIMIT)
+            flushOutput(vm->output);
+        // Output that cannot be written ends the run, which the last checkpoint can resume
+        if (vm->output->error != 0)
+        {
+            status = VM_ERROR;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9 < checkpoints.interval)
+            continue;
+        // A checkpoint that cannot be written leaves the previous one; the run goes on
+        if (writeCheckpoint(vm) != 0 && !warned)
+        {
+            fprintf(stderr, "Warning: Cannot write checkpoint '%s': %s\n", checkpoints.path, strerror(errno));
+            warned = 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &last);
+        checkpoints.seconds += (last.tv_sec - now.tv_sec) + (last.tv_nsec - now.tv_nsec) / 1e9;
+    }
+    vm->slice = 0;
+    vm->blockingReads = 0;
+    // A finished run leaves nothing to resume; a failed one keeps its last checkpoint
+    if (status == VM_HALTED)
+        unlink(checkpoints.path);
+    return status;
+}
+int writeCheckpoint(VmState *vm)
+{
+    // Everything written before the checkpoint is in the output once it exists
+    flushOutput(vm->output);
+    if (vm->output->error != 0)
+    {
+        errno = vm->output->error;
+        return -1;
+    }
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.pc = vm->pc;
+    header.hash = checkpoints.hash;
+    header.sp = vm->sp;
+    header.frameSize = vm->frameSize;
+    header.executed = vm->executed;
+    header.inputOffset = vm->input->consumed + (long long)vm->input->position;
+    header.outputWritten = vm->output->written;
+    header.outputPosition = lseek(vm->output->fd, 0, SEEK_CUR);
+
+    // Written beside it and renamed over it: a crash leaves the old checkpoint or the new one
+    size_t length = strlen(checkpoints.path);
+    char *temporary = (char *)malloc(length + 5);
+    memcpy(temporary, checkpoints.path, length);
+    memcpy(temporary + length, ".tmp", 5);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int status = fd < 0 ? -1 : 0;
+    if (status == 0 && (writeFully(fd, &header, sizeof(header)) != 0 ||
+                        writeFully(fd, vm->stack, vm->sp * sizeof(int)) != 0 ||
+                        writeFully(fd, vm->frame, vm->frameSize * sizeof(int)) != 0 || fsync(fd) != 0))
+        status = -1;
+    if (fd >= 0 && close(fd) != 0)
+        status = -1;
+    if (status == 0 && rename(temporary, checkpoints.path) != 0)
+        status = -1;
+    if (status != 0)
+    {
+        int error = errno;
+        unlink(temporary);
+        errno = error;
+    }
+    else
+        checkpoints.written++;
+    free(temporary);
+    return status;
+}
+int restoreCheckpoint(VmState *vm)
+{
+    // 1: restored, 0: no checkpoint yet (the run starts from the beginning), -1: error
+    int fd = open(checkpoints.path, O_RDONLY);
+    if (fd < 0)
+    {
+        if (errno == ENOENT)
+            return 0;
+        fprintf(stderr, "Error: Cannot open checkpoint '%s': %s\n", checkpoints.path, strerror(errno));
+        return -1;
+    }
+    CheckpointHeader header;
+    const char *problem = NULL;
+    if (readFully(fd, &header, sizeof(header)) != 0 || header.magic != CHECKPOINT_MAGIC)
+        problem = "is not a checkpoint";
+    else if (header.hash != checkpoints.hash || header.frameSize != vm->frameSize || header.pc < 0 ||
+             header.pc > code.size || header.sp < 0 || header.sp > vm->stackCapacity)
+        problem = "was taken on another program";
+    else if (readFully(fd, vm->stack, header.sp * sizeof(int)) != 0 ||
+             readFully(fd, vm->frame, header.frameSize * sizeof(int)) != 0)
+        problem = "is truncated";
+    else if (skipInput(vm->input, header.inputOffset) != 0)
+        problem = "consumed more input than there is";
+    close(fd);
+    if (problem != NULL)
+    {
+        fprintf(stderr, "Error: Checkpoint '%s' %s\n", checkpoints.path, problem);
+        return -1;
+    }
+
+    vm->pc = header.pc;
+    vm->sp = header.sp;
+    vm->executed = header.executed;
+    vm->output->written = header.outputWritten;
+    // Output a regular file already has past the checkpoint is written again: cut it off
+    struct stat info;
+    if (header.outputPosition >= 0 && fstat(vm->output->fd, &info) == 0 && S_ISREG(info.st_mode) &&
+        info.st_size >= header.outputPosition && ftruncate(vm->output->fd, header.outputPosition) == 0)
+        lseek(vm->output->fd, header.outputPosition, SEEK_SET);
+    checkpoints.resumedAt = header.executed;
+    return 1;
+}
+int readFully(int fd, void *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t count = read(fd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return -1;
+        data = (char *)data + count;
+        size -= (size_t)count;
+    }
+    return 0;
+}
+int writeFully(int fd, const void *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t count = write(fd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return -1;
+        data = (const char *)data + count;
+        size -= (size_t)count;
+    }
+    return 0;
+}
+
+// Bundle functions implementation//
+void bundleProgramName(const char *filename, char *name, size_t size)
+{
+    // Programs are bundled under their file name without directory and extension: dir/fib.txt is fib
+    const char *base = strrchr(filename, '/');
+    base = base != NULL ? base + 1 : filename;
+    const char *dot = strrchr(base, '.');
+    int length = dot != NULL && dot != base ? (int)(dot - base) : (int)strlen(base);
+    snprintf(name, size, "%.*s", length, base);
+}
+int bundleConstantField(InstructionType type)
+{
+    // Which of arg (1) or arg2 (2) holds a constant rather than a slot or a jump target
+    switch (type)
+    {
+    case PUSH:
+    case PUSH_ADD:
+    case PUSH_SUB:
+    case PUSH_MUL:
+        return 1;
+    case ASSIGN_CONST:
+        return 2;
+    default:
+        return 0;
+    }
+}
+int addBundleProgram(BundleBuilder *builder, const char *filename)
+{
+    char programName[256];
+    bundleProgramName(filename, programName, sizeof(programName));
+    BundleProgram added;
+    added.name = internBundleString(builder, programName);
+    for (int p = 0; p < builder->programCount; p++)
+    {
+        if (builder->programs[p].name == added.name)
+        {
+            fprintf(stderr, "Error: Two programs named '%s' in the bundle\n", programName);
+            return -1;
+        }
+    }
+    added.first = builder->instructionCount;
+    added.size = code.size;
+    added.variables = builder->symbolCount;
+    added.variableCount = code.variableCount;
+    added.labels = builder->labelCount;
+    added.labelCount = code.labelTableSize;
+    added.maxStackDepth = code.maxStackDepth;
+    added.hash = hashStackCode();
+
+    for (int pc = 0; pc < code.size; pc++)
+    {
+        const Instruction *instr = &code.instructions[pc];
+        builder->instructions = (BundleInstruction *)growBundleArray(builder->instructions, builder->instructionCount,
+                                                                     &builder->instructionCapacity,
+                                                                     sizeof(BundleInstruction));
+        BundleInstruction *stored = &builder->instructions[builder->instructionCount++];
+        stored->type = instr->type;
+        stored->label = instr->label;
+        stored->arg = instr->arg;
+        stored->arg2 = instr->arg2;
+        if (bundleConstantField(instr->type) == 1)
+            stored->arg = internBundleConstant(builder, instr->arg);
+        else if (bundleConstantField(instr->type) == 2)
+            stored->arg2 = internBundleConstant(builder, instr->arg2);
+        stored->arg3 = instr->arg3;
+        stored->length = instr->length;
+        stored->line = instr->line;
+    }
+    for (int slot = 0; slot < code.variableCount; slot++)
+    {
+        builder->symbols = (int *)growBundleArray(builder->symbols, builder->symbolCount, &builder->symbolCapacity,
+                                                  sizeof(int));
+        builder->symbols[builder->symbolCount++] = internBundleString(builder, code.variables[slot]);
+    }
+    for (int l = 0; l < code.labelTableSize; l++)
+    {
+        builder->labels = (BundleLabel *)growBundleArray(builder->labels, builder->labelCount, &builder->labelCapacity,
+                                                         sizeof(BundleLabel));
+        builder->labels[builder->labelCount].label = code.labels[l].label;
+        builder->labels[builder->labelCount++].position = code.labels[l].position;
+    }
+
+    // Strings and constants are interned, so the same code encodes to the same numbers: keep one copy
+    for (int p = 0; p < builder->programCount; p++)
+    {
+        const BundleProgram *other = &builder->programs[p];
+        if (other->hash != added.hash || other->size != added.size || other->variableCount != added.variableCount ||
+            other->labelCount != added.labelCount ||
+            memcmp(builder->instructions + other->first, builder->instructions + added.first,
+                   added.size * sizeof(BundleInstruction)) != 0 ||
+            memcmp(builder->symbols + other->variables, builder->symbols + added.variables,
+                   added.variableCount * sizeof(int)) != 0 ||
+            memcmp(builder->labels + other->labels, builder->labels + added.labels,
+                   added.labelCount * sizeof(BundleLabel)) != 0)
+            continue;
+        builder->instructionCount = added.first;
+        builder->symbolCount = added.variables;
+        builder->labelCount = added.labels;
+        added.first = other->first;
+        added.variables = other->variables;
+        added.labels = other->labels;
+        builder->shared++;
+        break;
+    }
+    builder->programs = (BundleProgram *)growBundleArray(builder->programs, builder->programCount,
+                                                         &builder->programCapacity, sizeof(BundleProgram));
+    builder->programs[builder->programCount++] = added;
+    return 0;
+}
+int internBundleString(BundleBuilder *builder, const char *text)
+{
+    // Keep the load factor under one half
+    if (builder->stringCount * 2 >= builder->stringBucketCount)
+    {
+        free(builder->stringBuckets);
+        builder->stringBucketCount = builder->stringBucketCount > 0 ? builder->stringBucketCount * 2 : 256;
+        builder->stringBuckets = (int *)calloc(builder->stringBucketCount, sizeof(int));
+        unsigned mask = builder->stringBucketCount - 1;
+        for (int i = 0; i < builder->stringCount; i++)
+        {
+            unsigned bucket = hashName(builder->stringData + builder->strings[i]) & mask;
+            while (builder->stringBuckets[bucket] != 0)
+                bucket = (bucket + 1) & mask;
+            builder->stringBuckets[bucket] = i + 1;
+        }
+    }
+    unsigned mask = builder->stringBucketCount - 1;
+    unsigned bucket = hashName(text) & mask;
+    while (builder->stringBuckets[bucket] != 0)
+    {
+        int string = builder->stringBuckets[bucket] - 1;
+        if (strcmp(builder->stringData + builder->strings[string], text) == 0)
+            return string;
+        bucket = (bucket + 1) & mask;
+    }
+
+    long long length = (long long)strlen(text) + 1;
+    if (builder->stringBytes + length > builder->stringDataCapacity)
+    {
+        builder->stringDataCapacity = (builder->stringBytes + length) * 2 + 4096;
+        builder->stringData = (char *)realloc(builder->stringData, builder->stringDataCapacity);
+    }
+    memcpy(builder->stringData + builder->stringBytes, text, length);
+    builder->strings = (int *)growBundleArray(builder->strings, builder->stringCount, &builder->stringCapacity,
+                                              sizeof(int));
+    builder->strings[builder->stringCount] = (int)builder->stringBytes;
+    builder->stringBytes += length;
+    builder->stringBuckets[bucket] = builder->stringCount + 1;
+    return builder->stringCount++;
+}
+int internBundleConstant(BundleBuilder *builder, int value)
+{
+    if (builder->constantCount * 2 >= builder->constantBucketCount)
+    {
+        free(builder->constantBuckets);
+        builder->constantBucketCount = builder->constantBucketCount > 0 ? builder->constantBucketCount * 2 : 256;
+        builder->constantBuckets = (int *)calloc(builder->constantBucketCount, sizeof(int));
+        unsigned mask = builder->constantBucketCount - 1;
+        for (int i = 0; i < builder->constantCount; i++)
+        {
+            unsigned bucket = ((unsigned)builder->constants[i] * 2654435761u) & mask;
+            while (builder->constantBuckets[bucket] != 0)
+                bucket = (bucket + 1) & mask;
+            builder->constantBuckets[bucket] = i + 1;
+        }
+    }
+    unsigned mask = builder->constantBucketCount - 1;
+    unsigned bucket = ((unsigned)value * 2654435761u) & mask;
+    while (builder->constantBuckets[bucket] != 0)
+    {
+        int constant = builder->constantBuckets[bucket] - 1;
+        if (builder->constants[constant] == value)
+            return constant;
+        bucket = (bucket + 1) & mask;
+    }
+    builder->constants = (int *)growBundleArray(builder->constants, builder->constantCount,
+                                                &builder->constantCapacity, sizeof(int));
+    builder->constants[builder->constantCount] = value;
+    builder->constantBuckets[bucket] = builder->constantCount + 1;
+    return builder->constantCount++;
+}
+void *growBundleArray(void *array, int count, int *capacity, size_t size)
+{
+    // Room for one more element
+    if (count < *capacity)
+        return array;
+    *capacity = *capacity > 0 ? *capacity * 2 : 64;
+    return realloc(array, (size_t)*capacity * size);
+}
+int writeBundle(BundleBuilder *builder, const char *path, int stats)
+{
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BUNDLE_MAGIC;
+    header.programCount = builder->programCount;
+    header.indexSize = 2;
+    while (header.indexSize < 2 * builder->programCount)
+        header.indexSize *= 2;
+    header.stringCount = builder->stringCount;
+    header.constantCount = builder->constantCount;
+    header.instructionCount = builder->instructionCount;
+    header.symbolCount = builder->symbolCount;
+    header.labelCount = builder->labelCount;
+    header.stringBytes = builder->stringBytes;
+
+    // The sections follow one another; the programs come first, 8-byte aligned after the header
+    long long offset = sizeof(header);
+    header.programs = offset;
+    offset += (long long)header.programCount * sizeof(BundleProgram);
+    header.index = offset;
+    offset += (long long)header.indexSize * sizeof(int);
+    header.strings = offset;
+    offset += (long long)header.stringCount * sizeof(int);
+    header.constants = offset;
+    offset += (long long)header.constantCount * sizeof(int);
+    header.instructions = offset;
+    offset += (long long)header.instructionCount * sizeof(BundleInstruction);
+    header.symbols = offset;
+    offset += (long long)header.symbolCount * sizeof(int);
+    header.labels = offset;
+    offset += (long long)header.labelCount * sizeof(BundleLabel);
+    header.stringData = offset;
+    header.size = offset + header.stringBytes;
+
+    // Program index: open addressing on the name, program + 1 (0 = empty)
+    int *index = (int *)calloc(header.indexSize, sizeof(int));
+    unsigned mask = header.indexSize - 1;
+    for (int p = 0; p < builder->programCount; p++)
+    {
+        unsigned bucket = hashName(builder->stringData + builder->strings[builder->programs[p].name]) & mask;
+        while (index[bucket] != 0)
+            bucket = (bucket + 1) & mask;
+        index[bucket] = p + 1;
+    }
+
+    // Written beside it and renamed over it: runtimes that have the old image mapped keep reading it
+    size_t length = strlen(path);
+    char *temporary = (char *)malloc(length + 5);
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".tmp", 5);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int status = fd < 0 ? -1 : 0;
+    if (status == 0 &&
+        (writeFully(fd, &header, sizeof(header)) != 0 ||
+         writeFully(fd, builder->programs, header.programCount * sizeof(BundleProgram)) != 0 ||
+         writeFully(fd, index, header.indexSize * sizeof(int)) != 0 ||
+         writeFully(fd, builder->strings, header.stringCount * sizeof(int)) != 0 ||
+         writeFully(fd, builder->constants, header.constantCount * sizeof(int)) != 0 ||
+         writeFully(fd, builder->instructions, header.instructionCount * sizeof(BundleInstruction)) != 0 ||
+         writeFully(fd, builder->symbols, header.symbolCount * sizeof(int)) != 0 ||
+         writeFully(fd, builder->labels, header.labelCount * sizeof(BundleLabel)) != 0 ||
+         writeFully(fd, builder->stringData, header.stringBytes) != 0))
+        status = -1;
+    if (fd >= 0 && close(fd) != 0)
+        status = -1;
+    if (status == 0 && rename(temporary, path) != 0)
+        status = -1;
+    if (status != 0)
+    {
+        fprintf(stderr, "Error: Cannot write bundle '%s': %s\n", path, strerror(errno));
+        unlink(temporary);
+    }
+    else if (stats)
+        fprintf(stderr, "%s: %d programs (%d sharing code), %d instructions, %d strings, %d constants, %lld bytes\n",
+                path, header.programCount, builder->shared, header.instructionCount, header.stringCount,
+                header.constantCount, header.size);
+    free(temporary);
+    free(index);
+    return status;
+}
+void freeBundleBuilder(BundleBuilder *builder)
+{
+    free(builder->programs);
+    free(builder->strings);
+    free(builder->stringData);
+    free(builder->stringBuckets);
+    free(builder->constants);
+    free(builder->constantBuckets);
+    free(builder->instructions);
+    free(builder->symbols);
+    free(builder->labels);
+    memset(builder, 0, sizeof(*builder));
+}
+int openBundle(const char *path)
+{
+    // A server worker keeps the image of its last request mapped for as long as the file is the same
+    struct stat info;
+    if (bundle.data != NULL && strcmp(bundle.path, path) == 0 && stat(path, &info) == 0 &&
+        info.st_dev == bundle.device && info.st_ino == bundle.inode && (size_t)info.st_size == bundle.size &&
+        info.st_mtim.tv_sec == bundle.modified.tv_sec && info.st_mtim.tv_nsec == bundle.modified.tv_nsec)
+        return 0;
+    closeBundle();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        fprintf(stderr, "Error: Cannot open bundle '%s': %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    void *data = info.st_size >= (off_t)sizeof(BundleHeader)
+                     ? mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+                     : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED || checkBundle((const BundleHeader *)data, info.st_size) != 0)
+    {
+        fprintf(stderr, "Error: '%s' is not a bundle image\n", path);
+        if (data != MAP_FAILED)
+            munmap(data, info.st_size);
+        return -1;
+    }
+
+    const BundleHeader *header = (const BundleHeader *)data;
+    bundle.path = strdup(path);
+    bundle.device = info.st_dev;
+    bundle.inode = info.st_ino;
+    bundle.modified = info.st_mtim;
+    bundle.data = (const char *)data;
+    bundle.size = info.st_size;
+    bundle.header = header;
+    bundle.programs = (const BundleProgram *)(bundle.data + header->programs);
+    bundle.index = (const int *)(bundle.data + header->index);
+    bundle.strings = (const int *)(bundle.data + header->strings);
+    bundle.constants = (const int *)(bundle.data + header->constants);
+    bundle.instructions = (const BundleInstruction *)(bundle.data + header->instructions);
+    bundle.symbols = (const int *)(bundle.data + header->symbols);
+    bundle.labels = (const BundleLabel *)(bundle.data + header->labels);
+    bundle.stringData = bundle.data + header->stringData;
+    return 0;
+}
+int checkBundle(const BundleHeader *header, size_t size)
+{
+    // Only the layout is checked here; each program is checked as it is loaded
+    if (header->magic != BUNDLE_MAGIC || header->size != (long long)size || header->programCount < 0 ||
+        header->indexSize <= header->programCount || (header->indexSize & (header->indexSize - 1)) != 0 ||
+        header->stringCount < 0 || header->constantCount < 0 || header->instructionCount < 0 ||
+        header->symbolCount < 0 || header->labelCount < 0 || header->stringBytes < 1 || header->programs % 8 != 0)
+        return -1;
+    long long offsets[8] = {header->programs, header->index, header->strings, header->constants,
+                            header->instructions, header->symbols, header->labels, header->stringData};
+    long long bytes[8] = {(long long)header->programCount * sizeof(BundleProgram),
+                          (long long)header->indexSize * sizeof(int),
+                          (long long)header->stringCount * sizeof(int),
+                          (long long)header->constantCount * sizeof(int),
+                          (long long)header->instructionCount * sizeof(BundleInstruction),
+                          (long long)header->symbolCount * sizeof(int),
+                          (long long)header->labelCount * sizeof(BundleLabel),
+                          header->stringBytes};
+    for (int s = 0; s < 8; s++)
+    {
+        if (offsets[s] < (long long)sizeof(BundleHeader) || offsets[s] % 4 != 0 || offsets[s] > header->size ||
+            bytes[s] > header->size - offsets[s])
+            return -1;
+    }
+    // Every string offset then reaches a terminating NUL
+    return ((const char *)header)[header->stringData + header->stringBytes - 1] == '\0' ? 0 : -1;
+}
+int findBundleProgram(const char *name)
+{
+    unsigned mask = bundle.header->indexSize - 1;
+    unsigned bucket = hashName(name) & mask;
+    for (int probe = 0; probe < bundle.header->indexSize && bundle.index[bucket] != 0; probe++)
+    {
+        int found = bundle.index[bucket] - 1;
+        const char *other = found >= 0 && found < bundle.header->programCount ? bundleString(bundle.programs[found].name) : NULL;
+        if (other != NULL && strcmp(other, name) == 0)
+            return found;
+        bucket = (bucket + 1) & mask;
+    }
+    return -1;
+}
+int loadBundleProgram(const char *name)
+{
+    // By its bundled name, or by the file it was compiled from
+    int found = findBundleProgram(name);
+    if (found < 0)
+    {
+        char programName[256];
+        bundleProgramName(name, programName, sizeof(programName));
+        found = findBundleProgram(programName);
+    }
+    if (found < 0)
+    {
+        fprintf(stderr, "Error: No program '%s' in bundle '%s'\n", name, bundle.path);
+        return -1;
+    }
+
+    const BundleHeader *header = bundle.header;
+    const BundleProgram *entry = &bundle.programs[found];
+    cleanupStackCode();
+    freeidentifierTable();
+    resetSymboleTable();
+    error_count = 0;
+    initStackCode();
+    if (entry->size < 0 || entry->first < 0 || entry->first > header->instructionCount - entry->size ||
+        entry->variableCount < 0 || entry->variables < 0 || entry->variables > header->symbolCount - entry->variableCount ||
+        entry->labelCount < 0 || entry->labels < 0 || entry->labels > header->labelCount - entry->labelCount)
+        goto damaged;
+
+    for (int slot = 0; slot < entry->variableCount; slot++)
+    {
+        const char *slotName = bundleString(bundle.symbols[entry->variables + slot]);
+        if (slotName == NULL || internStackVariable(slotName) != slot)
+            goto damaged;
+    }
+    code.capacity = entry->size + 1;
+    code.instructions = (Instruction *)realloc(code.instructions, code.capacity * sizeof(Instruction));
+    for (int pc = 0; pc < entry->size; pc++)
+    {
+        const BundleInstruction *stored = &bundle.instructions[entry->first + pc];
+        Instruction *instr = &code.instructions[pc];
+        if (stored->type < 0 || stored->type >= INSTRUCTION_TYPE_COUNT)
+            goto damaged;
+        instr->type = (InstructionType)stored->type;
+        instr->label = stored->label;
+        instr->arg = stored->arg;
+        instr->arg2 = stored->arg2;
+        int field = bundleConstantField(instr->type);
+        int constant = field == 1 ? stored->arg : stored->arg2;
+        if (field != 0 && (constant < 0 || constant >= header->constantCount))
+            goto damaged;
+        if (field == 1)
+            instr->arg = bundle.constants[constant];
+        else if (field == 2)
+            instr->arg2 = bundle.constants[constant];
+        instr->arg3 = stored->arg3;
+        instr->length = stored->length;
+        instr->line = stored->line;
+        instr->block = -1;
+        code.size++;
+    }
+    code.labels = (LinkedLabel *)malloc((entry->labelCount + 1) * sizeof(LinkedLabel));
+    for (int l = 0; l < entry->labelCount; l++)
+    {
+        const BundleLabel *stored = &bundle.labels[entry->labels + l];
+        code.labels[l].label = stored->label;
+        code.labels[l].position = stored->position;
+        code.labelTableSize++;
+        if (stored->label > code.labelCount)
+            code.labelCount = stored->label;
+    }
+    code.linked = 1;
+    code.maxStackDepth = entry->maxStackDepth;
+
+    // Bundled code was verified when it was compiled; the verifier also keeps a damaged image from running
+    if (verifyIr() != 0)
+    {
+        fprintf(stderr, "Error: Program '%s' in bundle '%s' does not verify\n", name, bundle.path);
+        return -1;
+    }
+    return 0;
+
+damaged:
+    fprintf(stderr, "Error: Program '%s' in bundle '%s' is damaged\n", name, bundle.path);
+    return -1;
+}
+const char *bundleString(int string)
+{
+    // NULL for a string outside the image
+    if (string < 0 || string >= bundle.header->stringCount || bundle.strings[string] < 0 ||
+        bundle.strings[string] >= bundle.header->stringBytes)
+        return NULL;
+    return bundle.stringData + bundle.strings[string];
+}
+void closeBundle(void)
+{
+    if (bundle.data != NULL)
+        munmap((void *)bundle.data, bundle.size);
+    free(bundle.path);
+    memset(&bundle, 0, sizeof(bundle));
+}
+
+// Incremental compilation functions implementation//
+int compileUnit(const char *source, long length)
+{
+    cleanupStackCode();
+    freeidentifierTable();
+    resetSymboleTable();
+    error_count = 0;
+    line_number = 1;
+    initStackCode();
+    unit.valid = 0;
+    unit.statementCount = 0;
+    unit.reparsed = 0;
+
+    openSource(source, 0, length);
+    unit.recording = 1;
+    token = Next();
+    if (token.code == -1)
+    {
+        fprintf(stderr, "Error getting first token\n");
+        unit.recording = 0;
+        return -1;
+    }
+
+    P();
+    unit.recording = 0;
+    unit.reparsed = unit.statementCount;
+    if (error_count != 0)
+        return error_count;
+
+    free(unit.source);
+    unit.source = (char *)malloc(length + 1);
+    memcpy(unit.source, source, length);
+    unit.source[length] = '\0';
+    unit.length = length;
+    unit.valid = 1;
+    return 0;
+}
+int recompileUnit(const char *source, long length)
+{
+    if (!unit.valid)
+        return compileUnit(source, length);
+
+    // The damaged span lies between the longest common prefix and suffix
+    long limit = length < unit.length ? length : unit.length;
+    long prefix = 0, suffix = 0;
+    while (prefix < limit && source[prefix] == unit.source[prefix])
+        prefix++;
+    while (suffix < limit - prefix &&
+           source[length - 1 - suffix] == unit.source[unit.length - 1 - suffix])
+        suffix++;
+    unit.reparsed = 0;
+    if (prefix == length && length == unit.length)
+        return 0;
+
+    long changedEnd = unit.length - suffix;
+    long delta = length - unit.length;
+    if (unit.statementCount == 0 || prefix < unit.bodyStart || changedEnd > unit.bodyEnd)
+        return compileUnit(source, length); // declarations or program header changed
+    if (changedEnd == unit.bodyEnd && isalnum((unsigned char)source[unit.bodyEnd + delta - 1]))
+        return compileUnit(source, length); // the edit runs into "end"
+
+    // Statements that touch the span, boundaries included: "endif" followed by
+    // inserted text may lex as one identifier
+    int low = 0, high = unit.statementCount - 1;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (unit.statements[middle].end >= prefix)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    int first = low;
+    low = first;
+    high = unit.statementCount - 1;
+    while (low < high)
+    {
+        int middle = (low + high + 1) / 2;
+        if (unit.statements[middle].start <= changedEnd)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    if (reparseStatements(first, low, source, length) != 0)
+        return compileUnit(source, length);
+    return 0;
+}
+int reparseStatements(int first, int last, const char *source, long length)
+{
+    long delta = length - unit.length;
+    long regionStart = unit.statements[first].start;
+    long oldRegionEnd = unit.statements[last].end;
+    long regionEnd = oldRegionEnd + delta;
+    int nextLine = last + 1 < unit.statementCount ? unit.statements[last + 1].line : unit.endLine;
+    int codeStart = unit.statements[first].codeStart;
+    int codeEnd = unit.statements[last].codeEnd;
+    int oldCount = unit.statementCount;
+
+    // Initialization state as it stood before the first damaged statement
+    for (int i = 0; i < identifierTable.size; i++)
+    {
+        identifierEntry *entry = &identifierTable.entries[i];
+        entry->isInitialized = entry->initOffset >= 0 && entry->initOffset < regionStart;
+    }
+
+    // The new statements are parsed after the current code, then moved into place
+    int oldSize = code.size;
+    openSource(source, regionStart, regionEnd);
+    unit.recording = 1;
+    unit.probing = 1;
+    line_number = unit.statements[first].line;
+    token = Next();
+    StatementList();
+    int complete = error_count == 0 && token.code == -5;
+    unit.recording = 0;
+    unit.probing = 0;
+
+    // Removing a variable's first initialization would mean re-checking every later use
+    for (int i = 0; i < identifierTable.size && complete; i++)
+    {
+        const identifierEntry *entry = &identifierTable.entries[i];
+        if (!entry->isInitialized && entry->initOffset >= regionStart && entry->initOffset < oldRegionEnd)
+            complete = 0;
+    }
+    if (!complete)
+        return -1;
+    for (int i = 0; i < identifierTable.size; i++)
+    {
+        identifierEntry *entry = &identifierTable.entries[i];
+        if (!entry->isInitialized && entry->initOffset >= oldRegionEnd)
+            entry->initOffset += delta;
+        entry->isInitialized = entry->initOffset >= 0;
+    }
+
+    // Splice: a single move of the untouched tail, then the new code goes in front of it
+    int added = unit.statementCount - oldCount;
+    int addedSize = code.size - oldSize;
+    int codeDelta = codeStart + addedSize - codeEnd;
+    int lineDelta = line_number - nextLine;
+    Instruction *fresh = (Instruction *)malloc((addedSize + 1) * sizeof(Instruction));
+    memcpy(fresh, code.instructions + oldSize, addedSize * sizeof(Instruction));
+    code.size = oldSize;
+    while (code.size + codeDelta > code.capacity)
+    {
+        code.capacity *= 2;
+        code.instructions = (Instruction *)realloc(code.instructions, code.capacity * sizeof(Instruction));
+    }
+    memmove(code.instructions + codeEnd + codeDelta, code.instructions + codeEnd,
+            (oldSize - codeEnd) * sizeof(Instruction));
+    memcpy(code.instructions + codeStart, fresh, addedSize * sizeof(Instruction));
+    free(fresh);
+    code.size = oldSize + codeDelta;
+    for (int pc = codeStart + addedSize; pc < code.size && lineDelta != 0; pc++)
+        code.instructions[pc].line += lineDelta;
+    code.verified = 0;
+    for (int k = oldCount; k < unit.statementCount; k++)
+    {
+        unit.statements[k].codeStart += codeStart - oldSize;
+        unit.statements[k].codeEnd += codeStart - oldSize;
+    }
+
+    StatementRange *statements = (StatementRange *)malloc((added + 1) * sizeof(StatementRange));
+    memcpy(statements, unit.statements + oldCount, added * sizeof(StatementRange));
+    memmove(unit.statements + first + added, unit.statements + last + 1,
+            (oldCount - last - 1) * sizeof(StatementRange));
+    memcpy(unit.statements + first, statements, added * sizeof(StatementRange));
+    free(statements);
+    unit.statementCount = oldCount - (last - first + 1) + added;
+    code.maxStackDepth = 0;
+    for (int k = 0; k < unit.statementCount; k++)
+    {
+        StatementRange *statement = &unit.statements[k];
+        if (k >= first + added)
+        {
+            statement->start += delta;
+            statement->end += delta;
+            statement->line += lineDelta;
+            statement->codeStart += codeDelta;
+            statement->codeEnd += codeDelta;
+        }
+        if (statement->maxStackDepth > code.maxStackDepth)
+            code.maxStackDepth = statement->maxStackDepth;
+    }
+    unit.bodyEnd += delta;
+    unit.endLine += lineDelta;
+    unit.reparsed = added;
+
+    free(unit.source);
+    unit.source = (char *)malloc(length + 1);
+    memcpy(unit.source, source, length);
+    unit.source[length] = '\0';
+    unit.length = length;
+    return 0;
+}
+void recordStatement(long start, int line, int codeStart)
+{
+    // Loops never span statements, so each one is optimized while it is still last.
+    // Value numbering stays within the statement for the same reason.
+    if (error_count == 0 && passManager.level >= 1)
+    {
+        optimizeLoopRange(codeStart);
+        numberValueRange(codeStart);
+    }
+
+    if (unit.statementCount >= unit.statementCapacity)
+    {
+        unit.statementCapacity = unit.statementCapacity ? unit.statementCapacity * 2 : 64;
+        unit.statements = (StatementRange *)realloc(unit.statements,
+                                                    unit.statementCapacity * sizeof(StatementRange));
+    }
+    StatementRange *statement = &unit.statements[unit.statementCount++];
+    statement->start = start;
+    statement->end = token.offset;
+    statement->line = line;
+    statement->codeStart = codeStart;
+    statement->codeEnd = code.size;
+    statement->maxStackDepth = 0;
+    int depth = 0;
+    for (int pc = codeStart; pc < code.size; pc++)
+    {
+        depth += stackEffect(code.instructions[pc].type);
+        if (depth > statement->maxStackDepth)
+            statement->maxStackDepth = depth;
+    }
+}
+void freeUnit()
+{
+    free(unit.source);
+    free(unit.statements);
+    memset(&unit, 0, sizeof(unit));
+}
+char *readSource(const char *path, long *length)
+{
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    size_t capacity = 1 << 16, size = 0, count;
+    char *text = (char *)malloc(capacity);
+    while ((count = fread(text + size, 1, capacity - size, file)) > 0)
+    {
+        size += count;
+        if (size == capacity)
+        {
+            capacity *= 2;
+            text = (char *)realloc(text, capacity);
+        }
+    }
+    if (file != stdin)
+        fclose(file);
+    *length = (long)size;
+    return text;
+}
+int watchFile(const char *path, int listing, int run, const char *inputPath, int stats)
+{
+    struct stat seen;
+    memset(&seen, 0, sizeof(seen));
+    fprintf(stderr, "Watching '%s', remove it to stop.\n", path);
+
+    for (;;)
+    {
+        struct stat now;
+        if (stat(path, &now) != 0)
+            break;
+        if (now.st_mtim.tv_sec == seen.st_mtim.tv_sec && now.st_mtim.tv_nsec == seen.st_mtim.tv_nsec &&
+            now.st_size == seen.st_size)
+        {
+            struct timespec pause = {0, 50 * 1000 * 1000};
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        seen = now;
+
+        long length = 0;
+        char *source = readSource(path, &length);
+        if (source == NULL)
+            break;
+        struct timespec started, finished;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+        int errors = recompileUnit(source, length);
+        clock_gettime(CLOCK_MONOTONIC, &finished);
+        free(source);
+
+        if (errors != 0)
+        {
+            fprintf(stderr, "Compilation of '%s' failed.\n", path);
+            continue;
+        }
+        if (stats)
+            fprintf(stderr, "%s: %d of %d statements compiled in %.3f ms, %d instructions\n", path,
+                    unit.reparsed, unit.statementCount,
+                    (finished.tv_sec - started.tv_sec) * 1e3 + (finished.tv_nsec - started.tv_nsec) / 1e6,
+                    code.size);
+        if (listing)
+            printStackCode();
+        if (run)
+        {
+            // Running links the code in place; the unit goes on splicing the unlinked copy
+            int size = code.size;
+            Instruction *kept = (Instruction *)malloc((size + 1) * sizeof(Instruction));
+            memcpy(kept, code.instructions, size * sizeof(Instruction));
+            executeStackCode(0, inputPath, NULL, NULL);
+            memcpy(code.instructions, kept, size * sizeof(Instruction));
+            free(kept);
+            code.size = size;
+            code.linked = 0;
+            free(code.labels);
+            code.labels = NULL;
+            code.labelTableSize = 0;
+        }
+        fflush(stdout);
+    }
+    fprintf(stderr, "'%s' is gone, stopped watching.\n", path);
+    freeUnit();
+    return 0;
+}
+
+// Compile server functions implementation//
+int listenSocket(const char *socketPath)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Error: Socket path '%s' is too long\n", socketPath);
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    // A socket nobody answers on was left behind by a server that died
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener >= 0 && connect(listener, (struct sockaddr *)&address, sizeof(address)) == 0)
+    {
+        fprintf(stderr, "Error: A server is already listening on '%s'\n", socketPath);
+        close(listener);
+        return -1;
+    }
+    if (listener >= 0)
+        close(listener);
+    // Only a stale socket is removed: any other file there is the user's
+    struct stat info;
+    if (lstat(socketPath, &info) == 0)
+    {
+        if (!S_ISSOCK(info.st_mode))
+        {
+            fprintf(stderr, "Error: '%s' exists and is not a socket\n", socketPath);
+            return -1;
+        }
+        if (info.st_uid != geteuid())
+        {
+            fprintf(stderr, "Error: '%s' belongs to another user\n", socketPath);
+            return -1;
+        }
+        unlink(socketPath);
+    }
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0)
+    {
+        fprintf(stderr, "Error: Cannot listen on '%s': %s\n", socketPath, strerror(errno));
+        if (listener >= 0)
+            close(listener);
+        return -1;
+    }
+    return listener;
+}
+int defaultServerSocket(char *path, size_t size)
+{
+    // A directory only this user can enter: other users can neither connect nor plant a socket
+    char directory[200];
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime != NULL && runtime[0] != '\0')
+        snprintf(directory, sizeof(directory), "%s", runtime);
+    else
+    {
+        snprintf(directory, sizeof(directory), SERVER_SOCKET_DIRECTORY, (unsigned)geteuid());
+        if (mkdir(directory, 0700) != 0 && errno != EEXIST)
+        {
+            fprintf(stderr, "Error: Cannot create '%s': %s\n", directory, strerror(errno));
+            return -1;
+        }
+    }
+    struct stat info;
+    if (lstat(directory, &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != geteuid() ||
+        (info.st_mode & 077) != 0)
+    {
+        fprintf(stderr, "Error: '%s' is not a directory private to this user\n", directory);
+        return -1;
+    }
+    snprintf(path, size, "%s/%s", directory, SERVER_SOCKET_NAME);
+    return 0;
+}
+int peerIsOwner(int connection)
+{
+    // Requests carry the client's descriptors and directory: only its own user may send them
+#ifdef __linux__
+    struct ucred peer;
+    socklen_t size = sizeof(peer);
+    return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0 && peer.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(connection, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+int runServer(const char *socketPath, int workers)
+{
+    if (workers <= 0)
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers <= 0)
+        workers = 1;
+    int listener = listenSocket(socketPath);
+    if (listener < 0)
+        return 1;
+
+    // Workers inherit the keyword table and the heap warmed up here
+    internLexeme("program", 7);
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopServer; // no SA_RESTART: waitpid() returns on a signal
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    pid_t *pids = (pid_t *)malloc(workers * sizeof(pid_t));
+    for (int w = 0; w < workers; w++)
+        pids[w] = startServerWorker(listener);
+    fprintf(stderr, "Serving on '%s' with %d workers\n", socketPath, workers);
+
+    while (!serverStopping)
+    {
+        pid_t pid = waitpid(-1, NULL, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        // A request that ends its worker (too many errors, a crash) costs only that worker
+        for (int w = 0; w < workers; w++)
+        {
+            if (pids[w] == pid && !serverStopping)
+                pids[w] = startServerWorker(listener);
+        }
+    }
+
+    for (int w = 0; w < workers; w++)
+    {
+        if (pids[w] > 0)
+            kill(pids[w], SIGTERM);
+    }
+    for (int w = 0; w < workers; w++)
+    {
+        if (pids[w] > 0)
+            waitpid(pids[w], NULL, 0);
+    }
+    free(pids);
+    close(listener);
+    unlink(socketPath);
+    return 0;
+}
+pid_t startServerWorker(int listener)
+{
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid; // the parent, or -1
+
+    // All workers accept on the shared socket, one request at a time each
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    for (;;)
+    {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            _exit(1);
+        }
+        serveRequest(connection);
+        close(connection);
+    }
+}
+void stopServer(int signal)
+{
+    (void)signal;
+    serverStopping = 1;
+}
+int serveRequest(int connection)
+{
+    ServerRequest request;
+    int fds[SERVER_FDS];
+    if (receiveRequest(connection, &request, fds) != 0)
+        return -1;
+
+    char *arguments = (char *)malloc(request.length + 1);
+    char **argv = (char **)malloc((request.argc + 1) * sizeof(char *));
+    int received = 0, argc = 0, status = 2;
+    while (received < request.length)
+    {
+        ssize_t count = read(connection, arguments + received, request.length - received);
+        if (count <= 0)
+            break;
+        received += (int)count;
+    }
+    arguments[received] = '\0';
+    for (int i = 0; i < received && argc < request.argc; i += (int)strlen(arguments + i) + 1)
+        argv[argc++] = arguments + i;
+    argv[argc] = NULL;
+
+    // The request runs as the client would have: in its directory, on its stdio
+    int saved[3];
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; i++)
+    {
+        saved[i] = dup(i);
+        dup2(fds[i], i);
+    }
+    if (received != request.length || argc != request.argc)
+        fprintf(stderr, "Error: Malformed request\n");
+    else if (fchdir(fds[3]) != 0)
+        fprintf(stderr, "Error: Cannot enter the client's directory: %s\n", strerror(errno));
+    else
+    {
+        status = 0;
+        for (int i = 1; i < argc && status == 0; i++)
+        {
+            if (strcmp(argv[i], "--watch") == 0 || strncmp(argv[i], "--server", 8) == 0)
+            {
+                fprintf(stderr, "Error: %s is not available through the compile server\n", argv[i]);
+                status = 2;
+            }
+        }
+        // A client that goes away (Ctrl-C, a timeout) takes its request with it, as the compiler would
+        int watch[2] = {connection, -1}, stop[2];
+        pthread_t watcher;
+        int watching = status == 0 && pipe(stop) == 0;
+        if (watching)
+        {
+            watch[1] = stop[0];
+            watching = pthread_create(&watcher, NULL, watchClient, watch) == 0;
+            if (!watching)
+            {
+                close(stop[0]);
+                close(stop[1]);
+            }
+        }
+        if (status == 0)
+            status = runCommandLine(argc, argv);
+        if (watching)
+        {
+            close(stop[1]);
+            pthread_join(watcher, NULL);
+            close(stop[0]);
+        }
+    }
+    fflush(stdout);
+    fflush(stderr);
+    clearerr(stdin);
+    clearerr(stdout);
+    clearerr(stderr);
+    for (int i = 0; i < 3; i++)
+    {
+        dup2(saved[i], i);
+        close(saved[i]);
+    }
+    for (int i = 0; i < SERVER_FDS; i++)
+        close(fds[i]);
+    free(arguments);
+    free(argv);
+
+    if (write(connection, &status, sizeof(status)) != sizeof(status))
+        return -1;
+    return status;
+}
+void *watchClient(void *arg)
+{
+    // The client sends nothing after its request: the connection becomes readable only when it closes
+    const int *watch = (const int *)arg; // connection, read end of the pipe closed when the request ends
+    struct pollfd polls[2] = {{watch[0], POLLIN, 0}, {watch[1], POLLIN, 0}};
+    for (;;)
+    {
+        if (poll(polls, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return NULL;
+        }
+        if (polls[1].revents != 0)
+            return NULL;
+        char byte;
+        ssize_t count = recv(watch[0], &byte, 1, MSG_DONTWAIT);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR) || (polls[0].revents & (POLLHUP | POLLERR)))
+            _exit(1); // the server starts a fresh worker in its place
+    }
+}
+int receiveRequest(int connection, ServerRequest *request, int fds[SERVER_FDS])
+{
+    if (!peerIsOwner(connection))
+    {
+        fprintf(stderr, "Refused a request from another user\n");
+        return -1;
+    }
+    char control[CMSG_SPACE(SERVER_FDS * sizeof(int))];
+    struct iovec part = {request, sizeof(*request)};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t count = recvmsg(connection, &message, 0);
+
+    int fdCount = 0;
+    for (struct cmsghdr *header = count > 0 ? CMSG_FIRSTHDR(&message) : NULL; header != NULL;
+         header = CMSG_NXTHDR(&message, header))
+    {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+            continue;
+        int passed = (int)((header->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (int i = 0; i < passed; i++)
+        {
+            int fd;
+            memcpy(&fd, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+            if (fdCount < SERVER_FDS)
+                fds[fdCount++] = fd;
+            else
+                close(fd);
+        }
+    }
+    if (count != sizeof(*request) || fdCount != SERVER_FDS || (message.msg_flags & MSG_CTRUNC) ||
+        request->magic != SERVER_MAGIC || request->argc < 1 || request->argc > SERVER_MAX_ARGUMENTS ||
+        request->length < 0 || request->length > SERVER_MAX_REQUEST)
+    {
+        for (int i = 0; i < fdCount; i++)
+            close(fds[i]);
+        return -1;
+    }
+    return 0;
+}
+
+// Event loop functions implementation//
+#ifdef __linux__
+int runInstances(const char *socketPath, int loops, long long *instances, long long *executed)
+{
+    // Instances share the code read-only, so verify and link it before they start
+    if (prepareStackCode() != 0)
+        return 1;
+    if (loops <= 0)
+        loops = 1;
+
+    // One descriptor per live instance
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    int listener = listenSocket(socketPath);
+    if (listener < 0)
+        return 1;
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopServer; // no SA_RESTART: epoll_wait() returns on a signal
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    EventLoop *eventLoops = (EventLoop *)calloc(loops, sizeof(EventLoop));
+    int status = 0;
+    for (int l = 0; l < loops && status == 0; l++)
+    {
+        EventLoop *loop = &eventLoops[l];
+        loop->listener = listener;
+        loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+        // Every loop waits on the listener; EPOLLEXCLUSIVE wakes one of them per connection
+        struct epoll_event event = {EPOLLIN | (loops > 1 ? EPOLLEXCLUSIVE : 0), {.ptr = NULL}};
+        if (loop->epoll < 0 || epoll_ctl(loop->epoll, EPOLL_CTL_ADD, listener, &event) != 0)
+        {
+            fprintf(stderr, "Error: Cannot start the event loop: %s\n", strerror(errno));
+            status = 1;
+        }
+    }
+    if (status == 0)
+    {
+        fprintf(stderr, "Running instances on '%s' with %d event loop%s\n", socketPath, loops,
+                loops > 1 ? "s" : "");
+        // The signals are taken by the first loop, which runs here
+        eventLoops[0].signals = 1;
+        sigset_t signals, previous;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, &previous);
+        for (int l = 1; l < loops; l++)
+            eventLoops[l].started = pthread_create(&eventLoops[l].thread, NULL, eventLoopMain, &eventLoops[l]) == 0;
+        pthread_sigmask(SIG_SETMASK, &previous, NULL);
+        eventLoopMain(&eventLoops[0]);
+        for (int l = 1; l < loops; l++)
+        {
+            atomic_store(&eventLoops[l].stopping, 1);
+            if (eventLoops[l].started)
+                pthread_join(eventLoops[l].thread, NULL);
+        }
+    }
+
+    long long failed = 0;
+    for (int l = 0; l < loops; l++)
+    {
+        *instances += eventLoops[l].served;
+        *executed += eventLoops[l].executed;
+        failed += eventLoops[l].failed;
+        if (eventLoops[l].epoll > 0)
+            close(eventLoops[l].epoll);
+    }
+    if (failed > 0)
+        fprintf(stderr, "%lld instances failed or were dropped\n", failed);
+    free(eventLoops);
+    close(listener);
+    unlink(socketPath);
+    return status;
+}
+void *eventLoopMain(void *arg)
+{
+    EventLoop *loop = (EventLoop *)arg;
+    struct epoll_event events[EVENT_BATCH];
+    while (loop->signals ? !serverStopping : !atomic_load(&loop->stopping))
+    {
+        // Block only when nothing is runnable; wake now and then to notice a stop
+        int count = epoll_wait(loop->epoll, events, EVENT_BATCH, loop->head != NULL ? 0 : 1000);
+        if (count < 0 && errno != EINTR)
+            break;
+        for (int e = 0; e < count; e++)
+        {
+            if (events[e].data.ptr == NULL)
+                acceptInstances(loop);
+            else
+                instanceEvent(loop, (Instance *)events[e].data.ptr, events[e].events);
+        }
+
+        // One slice each for the instances queued so far; the rest wait for the next turn
+        Instance *last = loop->tail;
+        for (int turn = 0; loop->head != NULL && turn < EVENT_BATCH; turn++)
+        {
+            Instance *instance = loop->head;
+            loop->head = instance->next;
+            if (loop->head == NULL)
+                loop->tail = NULL;
+            instance->next = NULL;
+            stepInstance(loop, instance);
+            if (instance == last)
+                break;
+        }
+    }
+    // Stopping: the instances still live are dropped with the process
+    return NULL;
+}
+void acceptInstances(EventLoop *loop)
+{
+    for (int a = 0; a < EVENT_BATCH; a++)
+    {
+        int fd = accept(loop->listener, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EMFILE || errno == ENFILE)
+                fprintf(stderr, "Error: Cannot accept an instance: %s\n", strerror(errno));
+            return; // EAGAIN: another loop took it, or none left
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        // Small buffers to start with: most instances exchange a few numbers
+        Instance *instance = (Instance *)calloc(1, sizeof(Instance));
+        if (instance == NULL || initVm(&instance->vm) != 0)
+        {
+            if (instance != NULL)
+                freeVm(&instance->vm);
+            free(instance);
+            close(fd);
+            continue;
+        }
+        instance->fd = fd;
+        instance->input.fd = -1;
+        instance->input.buffer = (char *)malloc(INSTANCE_BUFFER);
+        instance->inputCapacity = INSTANCE_BUFFER;
+        instance->output.fd = -1;
+        instance->output.buffer = (char *)malloc(INSTANCE_BUFFER);
+        instance->output.capacity = INSTANCE_BUFFER;
+        instance->vm.input = &instance->input;
+        instance->vm.output = &instance->output;
+        instance->vm.record = atomic_fetch_add(&instancesStarted, 1) + 1;
+        instance->vm.slice = INSTANCE_SLICE;
+        instance->state = INSTANCE_DONE;
+        loop->live++;
+        struct epoll_event event = {EPOLLIN, {.ptr = instance}};
+        if (instance->input.buffer == NULL || instance->output.buffer == NULL ||
+            epoll_ctl(loop->epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            finishInstance(loop, instance);
+            continue;
+        }
+        instance->events = EPOLLIN;
+        queueInstance(loop, instance);
+    }
+}
+void queueInstance(EventLoop *loop, Instance *instance)
+{
+    instance->state = INSTANCE_QUEUED;
+    instance->next = NULL;
+    if (loop->tail != NULL)
+        loop->tail->next = instance;
+    else
+        loop->head = instance;
+    loop->tail = instance;
+}
+void stepInstance(EventLoop *loop, Instance *instance)
+{
+    if (instance->broken)
+    {
+        finishInstance(loop, instance);
+        return;
+    }
+    long long before = instance->vm.executed;
+    VmStatus status = runVm(&instance->vm);
+    loop->executed += instance->vm.executed - before;
+    if (status == VM_WAITING)
+        instance->state = INSTANCE_READING;
+    else if (status == VM_YIELDED)
+    {
+        if (instance->output.size - instance->sent >= INSTANCE_OUTPUT_LIMIT)
+            instance->state = INSTANCE_WRITING;
+        else
+            queueInstance(loop, instance);
+    }
+    else
+    {
+        instance->state = INSTANCE_DONE;
+        if (status == VM_ERROR)
+            loop->failed++;
+    }
+
+    if (sendOutput(instance) != 0)
+    {
+        finishInstance(loop, instance);
+        return;
+    }
+    if (instance->state == INSTANCE_DONE && instance->output.size == 0)
+    {
+        finishInstance(loop, instance);
+        return;
+    }
+    if (instance->state == INSTANCE_WRITING && instance->output.size < INSTANCE_OUTPUT_LIMIT)
+        queueInstance(loop, instance);
+    watchInstance(loop, instance);
+}
+void instanceEvent(EventLoop *loop, Instance *instance, unsigned events)
+{
+    if (events & (EPOLLHUP | EPOLLERR))
+    {
+        // Closed or reset on the other side: nobody is left to answer
+        dropInstance(loop, instance);
+        return;
+    }
+    if (events & EPOLLIN)
+    {
+        if (receiveInput(instance) != 0)
+        {
+            dropInstance(loop, instance);
+            return;
+        }
+        if (instance->state == INSTANCE_READING && inputReady(&instance->input))
+            queueInstance(loop, instance);
+    }
+    if (events & EPOLLOUT)
+    {
+        if (sendOutput(instance) != 0)
+        {
+            dropInstance(loop, instance);
+            return;
+        }
+        if (instance->state == INSTANCE_DONE && instance->output.size == 0)
+        {
+            finishInstance(loop, instance);
+            return;
+        }
+        if (instance->state == INSTANCE_WRITING && instance->output.size < INSTANCE_OUTPUT_LIMIT)
+            queueInstance(loop, instance);
+    }
+    watchInstance(loop, instance);
+}
+int receiveInput(Instance *instance)
+{
+    InputStream *in = &instance->input;
+    // What readln has consumed is dropped first
+    if (in->position > 0)
+    {
+        memmove(in->buffer, in->buffer + in->position, in->size - in->position);
+        in->consumed += in->position;
+        in->size -= in->position;
+        in->position = 0;
+    }
+    while (!in->eof && in->size < INSTANCE_INPUT_LIMIT)
+    {
+        if (in->size == instance->inputCapacity)
+        {
+            char *grown = (char *)realloc(in->buffer, instance->inputCapacity * 2);
+            if (grown == NULL)
+                return -1;
+            in->buffer = grown;
+            instance->inputCapacity *= 2;
+        }
+        ssize_t count = read(instance->fd, in->buffer + in->size, instance->inputCapacity - in->size);
+        if (count > 0)
+            in->size += count;
+        else if (count == 0)
+            in->eof = 1; // the client is done writing: readln fails at the end, as with --run
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        else if (errno != EINTR)
+        {
+            in->eof = 1;
+            return -1;
+        }
+    }
+    return 0;
+}
+int sendOutput(Instance *instance)
+{
+    OutputStream *out = &instance->output;
+    while (instance->sent < out->size)
+    {
+        ssize_t count = send(instance->fd, out->buffer + instance->sent, out->size - instance->sent, MSG_NOSIGNAL);
+        if (count > 0)
+            instance->sent += count;
+        else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else if (count < 0 && errno == EINTR)
+            continue;
+        else
+            return -1;
+    }
+    out->written += out->size;
+    out->size = 0;
+    instance->sent = 0;
+    return 0;
+}
+void watchInstance(EventLoop *loop, Instance *instance)
+{
+    // Level-triggered: read while there is room and the client may still write,
+    // and wait for room in the socket while output is pending
+    unsigned events = 0;
+    if (!instance->input.eof && instance->input.size - instance->input.position < INSTANCE_INPUT_LIMIT)
+        events |= EPOLLIN;
+    if (instance->output.size > 0)
+        events |= EPOLLOUT;
+    if (events != instance->events)
+    {
+        struct epoll_event event = {events, {.ptr = instance}};
+        epoll_ctl(loop->epoll, EPOLL_CTL_MOD, instance->fd, &event);
+        instance->events = events;
+    }
+}
+void dropInstance(EventLoop *loop, Instance *instance)
+{
+    // A queued instance is still linked into the run queue: it is finished on its turn
+    if (instance->state == INSTANCE_QUEUED)
+    {
+        instance->broken = 1;
+        epoll_ctl(loop->epoll, EPOLL_CTL_DEL, instance->fd, NULL);
+        instance->events = 0;
+        return;
+    }
+    finishInstance(loop, instance);
+}
+void finishInstance(EventLoop *loop, Instance *instance)
+{
+    if (instance->state != INSTANCE_DONE || instance->broken)
+        loop->failed++; // dropped: the client went away first
+    loop->live--;
+    loop->served++;
+    epoll_ctl(loop->epoll, EPOLL_CTL_DEL, instance->fd, NULL);
+    close(instance->fd);
+    freeVm(&instance->vm);
+    free(instance->input.buffer);
+    free(instance->output.buffer);
+    free(instance);
+}
+#else
+int runInstances(const char *socketPath, int loops, long long *instances, long long *executed)
+{
+    (void)socketPath;
+    (void)loops;
+    (void)instances;
+    (void)executed;
+    fprintf(stderr, "Error: --listen needs epoll (Linux)\n");
+    return 1;
+}
+#endif
+
+// Pipeline functions implementation//
+int initRing(SpscRing *ring, int slots, int elementSize)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->slots = (char *)malloc((size_t)slots * elementSize);
+    if (ring->slots == NULL)
+        return -1;
+    ring->elementSize = elementSize;
+    ring->mask = (unsigned)slots - 1;
+    // Spinning only pays when the other side runs on another core
+    ring->spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPINS : 0;
+    return 0;
+}
+void freeRing(SpscRing *ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+}
+void ringPush(SpscRing *ring, const void *element)
+{
+    if (ring->writeIndex - ring->headSeen > ring->mask)
+    {
+        ring->headSeen = atomic_load_explicit(&ring->head, memory_order_acquire);
+        while (ring->writeIndex - ring->headSeen > ring->mask)
+        {
+            // Full: the consumer may be waiting for what is written but not yet published
+            ringFlush(ring);
+            ringWait(&ring->head, ring->headSeen, &ring->producerWaiting, ring->spins);
+            ring->headSeen = atomic_load_explicit(&ring->head, memory_order_acquire);
+        }
+    }
+    memcpy(ring->slots + (size_t)(ring->writeIndex & ring->mask) * ring->elementSize, element,
+           ring->elementSize);
+    ring->writeIndex++;
+    if (ring->writeIndex - atomic_load_explicit(&ring->tail, memory_order_relaxed) >= RING_BATCH)
+        ringFlush(ring);
+}
+void ringPop(SpscRing *ring, void *element)
+{
+    if (ring->readIndex == ring->tailSeen)
+    {
+        ring->tailSeen = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        while (ring->readIndex == ring->tailSeen)
+        {
+            // Empty: hand back the slots read so far before sleeping
+            ringRelease(ring);
+            ringWait(&ring->tail, ring->tailSeen, &ring->consumerWaiting, ring->spins);
+            ring->tailSeen = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        }
+    }
+    memcpy(element, ring->slots + (size_t)(ring->readIndex & ring->mask) * ring->elementSize,
+           ring->elementSize);
+    ring->readIndex++;
+    if (ring->readIndex - atomic_load_explicit(&ring->head, memory_order_relaxed) >= RING_BATCH)
+        ringRelease(ring);
+}
+void ringFlush(SpscRing *ring)
+{
+    // Sequentially consistent, paired with the waiter's flag store then index load
+    atomic_store(&ring->tail, ring->writeIndex);
+    if (atomic_load(&ring->consumerWaiting))
+        ringWake(&ring->tail, &ring->consumerWaiting);
+}
+void ringRelease(SpscRing *ring)
+{
+    atomic_store(&ring->head, ring->readIndex);
+    if (atomic_load(&ring->producerWaiting))
+        ringWake(&ring->head, &ring->producerWaiting);
+}
+void ringWait(_Atomic unsigned *index, unsigned seen, _Atomic int *waiting, int spins)
+{
+    for (int i = 0; i < spins; i++)
+    {
+        if (atomic_load_explicit(index, memory_order_acquire) != seen)
+            return;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    atomic_store(waiting, 1);
+    if (atomic_load(index) == seen)
+    {
+#ifdef __linux__
+        // Returns at once if the index moved after the check
+        syscall(SYS_futex, (unsigned *)index, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+        sched_yield();
+#endif
+    }
+    atomic_store(waiting, 0);
+}
+void ringWake(_Atomic unsigned *index, _Atomic int *waiting)
+{
+    if (atomic_exchange(waiting, 0))
+    {
+#ifdef __linux__
+        syscall(SYS_futex, (unsigned *)index, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+        (void)index;
+#endif
+    }
+}
+Token takeToken()
+{
+    if (pipeline.tokensEnded)
+        return pipeline.end;
+    Token next;
+    ringPop(&pipeline.tokens, &next);
+    if (next.code == -5)
+    {
+        pipeline.tokensEnded = 1;
+        pipeline.end = next;
+    }
+    return next;
+}
+void publishStatement(int codeStart)
+{
+    // Each top-level statement is optimized as in recordStatement(), handed to the
+    // writer and dropped, so the code array stays one statement long
+    if (error_count == 0)
+    {
+        if (passManager.level >= 1)
+        {
+            optimizeLoopRange(codeStart);
+            numberValueRange(codeStart);
+        }
+
+        // New slot names first, so that the writer can print them
+        for (; pipeline.variablesSent < code.variableCount; pipeline.variablesSent++)
+        {
+            IrRecord record = {IR_VARIABLE, pipeline.variablesSent, -1, -1, strdup(code.variables[pipeline.variablesSent])};
+            ringPush(&pipeline.records, &record);
+        }
+        for (int pc = codeStart; pc < code.size; pc++)
+        {
+            const Instruction *instr = &code.instructions[pc];
+            IrRecord record = {instr->type, instr->arg, instr->arg2, instr->arg3, NULL};
+            if (instr->type == LABEL || isJumpInstruction(instr->type))
+                record.arg = instr->label;
+            ringPush(&pipeline.records, &record);
+        }
+    }
+    code.size = codeStart;
+    code.stackDepth = 0;
+}
+void *lexerThreadMain(void *arg)
+{
+    (void)arg;
+    line_number = 1;
+    Token next;
+    do
+    {
+        next = scanToken();
+        ringPush(&pipeline.tokens, &next);
+    } while (next.code != -5);
+    ringFlush(&pipeline.tokens);
+    return NULL;
+}
+void *writerThreadMain(void *arg)
+{
+    (void)arg;
+    char **names = NULL;
+    int nameCount = 0, nameCapacity = 0;
+    int depth = 0, failed = 0, started = 0;
+    char buffer[64];
+
+    for (;;)
+    {
+        IrRecord record;
+        ringPop(&pipeline.records, &record);
+        if (record.type == IR_END)
+        {
+            failed = record.arg;
+            break;
+        }
+        // As printStackCode() prints it; the header waits for the first record,
+        // so that a program failing before its first statement prints nothing
+        if (pipeline.listing && !started)
+            printListingHeader();
+        started = 1;
+        if (record.type == IR_VARIABLE)
+        {
+            if (nameCount >= nameCapacity)
+            {
+                nameCapacity = nameCapacity ? nameCapacity * 2 : 16;
+                names = (char **)realloc(names, nameCapacity * sizeof(char *));
+            }
+            names[nameCount++] = record.name;
+            continue;
+        }
+
+        pipeline.instructions++;
+        depth += stackEffect((InstructionType)record.type);
+        if (depth > pipeline.maxStackDepth)
+            pipeline.maxStackDepth = depth;
+        if (!pipeline.listing)
+            continue;
+        Instruction instr;
+        instr.type = (InstructionType)record.type;
+        instr.label = -1;
+        instr.arg = record.arg;
+        instr.arg2 = record.arg2;
+        instr.arg3 = record.arg3;
+        if (instr.type == LABEL || isJumpInstruction(instr.type))
+        {
+            instr.label = record.arg;
+            instr.arg = -1;
+        }
+        formatInstructionNames(&instr, names, nameCount, 0, buffer, sizeof(buffer));
+        printf("| %-29s |\n", buffer);
+    }
+    if (pipeline.listing && !failed)
+    {
+        if (!started)
+            printListingHeader();
+        printf("+-------------------------------+\n");
+        printf("| Total Instructions: %-9lld |\n", pipeline.instructions);
+        printf("| Max Stack Depth: %-12d |\n", pipeline.maxStackDepth);
+        printf("+-------------------------------+\n\n");
+    }
+    fflush(stdout);
+
+    for (int i = 0; i < nameCount; i++)
+        free(names[i]);
+    free(names);
+    return NULL;
+}
+int compilePipelined(const char *filename, int listing)
+{
+    long length = 0;
+    char *source = readSource(filename, &length);
+    if (source == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        return -1;
+    }
+    if (initRing(&pipeline.tokens, TOKEN_RING_SLOTS, sizeof(Token)) != 0 ||
+        initRing(&pipeline.records, RECORD_RING_SLOTS, sizeof(IrRecord)) != 0)
+    {
+        fprintf(stderr, "Error: Out of memory\n");
+        freeRing(&pipeline.tokens);
+        free(source);
+        return -1;
+    }
+
+    cleanupStackCode();
+    freeidentifierTable();
+    resetSymboleTable();
+    error_count = 0;
+    line_number = 1;
+    initStackCode();
+    openSource(source, 0, length);
+    pipeline.tokensEnded = 0;
+    pipeline.variablesSent = 0;
+    pipeline.listing = listing;
+    pipeline.instructions = 0;
+    pipeline.maxStackDepth = 0;
+    pipeline.active = 1;
+
+    // Lexer thread -> tokens -> parser here -> records -> writer thread
+    pthread_t lexer, writer;
+    if (pthread_create(&lexer, NULL, lexerThreadMain, NULL) != 0)
+    {
+        fprintf(stderr, "Error: Cannot start the lexer thread\n");
+        pipeline.active = 0;
+        freeRing(&pipeline.tokens);
+        freeRing(&pipeline.records);
+        free(source);
+        return -1;
+    }
+    int writing = pthread_create(&writer, NULL, writerThreadMain, NULL) == 0;
+    if (!writing)
+    {
+        fprintf(stderr, "Error: Cannot start the writer thread\n");
+        error_count++;
+    }
+
+    token = Next();
+    P();
+    // The lexer runs to the end of the file, whatever the parser stopped at
+    while (!pipeline.tokensEnded)
+        takeToken();
+    pthread_join(lexer, NULL);
+    if (writing)
+    {
+        IrRecord end = {IR_END, error_count != 0, -1, -1, NULL};
+        ringPush(&pipeline.records, &end);
+        ringFlush(&pipeline.records);
+        pthread_join(writer, NULL);
+    }
+
+    pipeline.active = 0;
+    freeRing(&pipeline.tokens);
+    freeRing(&pipeline.records);
+    free(source);
+    return error_count;
+}
+
+// Superinstruction functions implementation//
+void collectOpcodePairs(OpcodePairProfile *profile)
+{
+    for (int i = 0; i + 1 < code.size; i++)
+    {
+        profile->counts[code.instructions[i].type][code.instructions[i + 1].type]++;
+        profile->total++;
+    }
+}
+int writeOpcodePairProfile(const OpcodePairProfile *profile, const char *filename)
+{
+    FILE *file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error: Cannot write profile '%s'\n", filename);
+        return -1;
+    }
+    fprintf(file, "# opcode pair profile: first second count\n");
+    for (int a = 0; a < INSTRUCTION_TYPE_COUNT; a++)
+    {
+        for (int b = 0; b < INSTRUCTION_TYPE_COUNT; b++)
+        {
+            if (profile->counts[a][b] > 0)
+                fprintf(file, "%s %s %lld\n", instructionName(a), instructionName(b), profile->counts[a][b]);
+        }
+    }
+    fclose(file);
+    return 0;
+}
+int readOpcodePairProfile(OpcodePairProfile *profile, const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open profile '%s'\n", filename);
+        return -1;
+    }
+
+    char line[128], first[32], second[32];
+    long long count;
+    while (fgets(line, sizeof(line), file))
+    {
+        if (line[0] == '#' || sscanf(line, "%31s %31s %lld", first, second, &count) != 3)
+            continue;
+        int a = -1, b = -1;
+        for (int t = 0; t < INSTRUCTION_TYPE_COUNT; t++)
+        {
+            if (strcmp(instructionName(t), first) == 0)
+                a = t;
+            if (strcmp(instructionName(t), second) == 0)
+                b = t;
+        }
+        if (a >= 0 && b >= 0)
+        {
+            profile->counts[a][b] += count;
+            profile->total += count;
+        }
+    }
+    fclose(file);
+    return 0;
+}
+int selectSuperinstructions(const OpcodePairProfile *profile)
+{
+    enum
+    {
+        RULE_ASSIGN_TO,      // STORE x ... ASSIGN
+        RULE_ASSIGN_CONST,   // STORE x; PUSH c; ASSIGN
+        RULE_ASSIGN_VALUE,   // STORE x; VALUE y; ASSIGN
+        RULE_COMPARE_BRANCH, // COMP_xx; GO_FALSE L
+        RULE_LOAD_LOAD_OP,   // VALUE a; VALUE b; ADD/SUB/MUL
+        RULE_PUSH_OP,        // PUSH c; ADD/SUB/MUL
+        RULE_WRITE_VALUE,    // VALUE x; WRITE
+        RULE_COUNT
+    };
+    long long weight[RULE_COUNT] = {0};
+    const long long (*pairs)[INSTRUCTION_TYPE_COUNT] = profile->counts;
+
+    for (int t = 0; t < INSTRUCTION_TYPE_COUNT; t++)
+        weight[RULE_ASSIGN_TO] += pairs[t][ASSIGN];
+    weight[RULE_ASSIGN_CONST] = pairs[PUSH][ASSIGN];
+    weight[RULE_ASSIGN_VALUE] = pairs[VALUE][ASSIGN];
+    for (int t = COMP_LT; t <= COMP_NE; t++)
+        weight[RULE_COMPARE_BRANCH] += pairs[t][GO_FALSE];
+    weight[RULE_LOAD_LOAD_OP] = pairs[VALUE][VALUE];
+    weight[RULE_PUSH_OP] = pairs[PUSH][ADD] + pairs[PUSH][SUB] + pairs[PUSH][MUL];
+    weight[RULE_WRITE_VALUE] = pairs[VALUE][WRITE];
+
+    // A rule is worth a new opcode if its pattern is at least 0.1% of all pairs
+    int enabled[RULE_COUNT];
+    int order[RULE_COUNT];
+    for (int r = 0; r < RULE_COUNT; r++)
+    {
+        enabled[r] = weight[r] > 0 && weight[r] * 1000 >= profile->total;
+        order[r] = r;
+    }
+    for (int r = 1; r < RULE_COUNT; r++)
+    {
+        for (int k = r; k > 0 && weight[order[k]] > weight[order[k - 1]]; k--)
+        {
+            int swap = order[k];
+            order[k] = order[k - 1];
+            order[k - 1] = swap;
+        }
+    }
+
+    // Fusion renumbers instructions, so it runs on labelled code only
+    if (code.linked)
+        return 0;
+
+    Instruction *instructions = code.instructions;
+    int before = code.size;
+    int w = 0;
+
+    // Pass 1: STORE x <expr> ASSIGN -> <expr> ASSIGN_TO x (or a single assign_const/assign_value)
+    if (enabled[RULE_ASSIGN_TO] || enabled[RULE_ASSIGN_CONST] || enabled[RULE_ASSIGN_VALUE])
+    {
+        for (int r = 0; r < code.size; r++)
+        {
+            Instruction instr = instructions[r];
+            int match = -1;
+            if (instr.type == STORE)
+            {
+                int depth = 0;
+                for (int j = r + 1; j < code.size; j++)
+                {
+                    InstructionType type = instructions[j].type;
+                    if (type == ASSIGN && depth == 1)
+                    {
+                        match = j;
+                        break;
+                    }
+                    if (type == STORE || type == LABEL || isJumpInstruction(type) || type == ASSIGN)
+                        break;
+                    depth += stackEffect(type);
+                    if (depth < 0)
+                        break;
+                }
+            }
+            if (match == r + 2 && instructions[r + 1].type == PUSH && enabled[RULE_ASSIGN_CONST])
+            {
+                instr.type = ASSIGN_CONST;
+                instr.arg2 = instructions[r + 1].arg;
+                instructions[w++] = instr;
+                r += 2;
+            }
+            else if (match == r + 2 && instructions[r + 1].type == VALUE && enabled[RULE_ASSIGN_VALUE])
+            {
+                instr.type = ASSIGN_VALUE;
+                instr.arg2 = instructions[r + 1].arg;
+                instructions[w++] = instr;
+                r += 2;
+            }
+            else if (match >= 0 && enabled[RULE_ASSIGN_TO])
+            {
+                // Drop the address push; the matching ASSIGN names the target instead
+                instructions[match].type = ASSIGN_TO;
+                instructions[match].arg = instr.arg;
+            }
+            else
+            {
+                instructions[w++] = instr;
+            }
+        }
+        code.size = w;
+    }
+
+    // Pass 2: greedy left-to-right peephole, most profitable rule first
+    w = 0;
+    for (int r = 0; r < code.size; r++)
+    {
+        Instruction *instr = &instructions[r];
+        Instruction *next = r + 1 < code.size ? &instructions[r + 1] : NULL;
+        Instruction *third = r + 2 < code.size ? &instructions[r + 2] : NULL;
+        Instruction fused = *instr;
+        int consumed = 1;
+
+        for (int k = 0; k < RULE_COUNT && consumed == 1; k++)
+        {
+            int rule = order[k];
+            if (!enabled[rule] || next == NULL)
+                continue;
+            switch (rule)
+            {
+            case RULE_COMPARE_BRANCH:
+                if (instr->type >= COMP_LT && instr->type <= COMP_NE && next->type == GO_FALSE)
+                {
+                    fused = *next;
+                    fused.type = GO_FALSE_LT + (instr->type - COMP_LT);
+                    consumed = 2;
+                }
+                break;
+            case RULE_LOAD_LOAD_OP:
+                if (instr->type == VALUE && next->type == VALUE && third &&
+                    (third->type == ADD || third->type == SUB || third->type == MUL))
+                {
+                    fused.type = third->type == ADD ? VALUE2_ADD : (third->type == SUB ? VALUE2_SUB : VALUE2_MUL);
+                    fused.arg2 = next->arg;
+                    consumed = 3;
+                }
+                break;
+            case RULE_PUSH_OP:
+                if (instr->type == PUSH && (next->type == ADD || next->type == SUB || next->type == MUL))
+                {
+                    fused.type = next->type == ADD ? PUSH_ADD : (next->type == SUB ? PUSH_SUB : PUSH_MUL);
+                    consumed = 2;
+                }
+                break;
+            case RULE_WRITE_VALUE:
+                if (instr->type == VALUE && next->type == WRITE)
+                {
+                    fused.type = WRITE_VALUE;
+                    consumed = 2;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        instructions[w++] = fused;
+        r += consumed - 1;
+    }
+    code.size = w;
+    code.verified = 0;
+    return before - code.size;
+}
+
+// Dataflow functions implementation//
+BitWord *dataflowSet(BitWord *sets, const DataflowProblem *problem, int block)
+{
+    return sets + (size_t)block * problem->words;
+}
+void bitsetAdd(BitWord *set, int bit)
+{
+    set[bit >> 6] |= 1ULL << (bit & 63);
+}
+void bitsetRemove(BitWord *set, int bit)
+{
+    set[bit >> 6] &= ~(1ULL << (bit & 63));
+}
+int bitsetContains(const BitWord *set, int bit)
+{
+    return (set[bit >> 6] >> (bit & 63)) & 1;
+}
+void initDataflow(DataflowProblem *problem, const ControlFlowGraph *cfg, int bits,
+                  DataflowDirection direction, DataflowMeet meet)
+{
+    size_t total;
+    problem->direction = direction;
+    problem->meet = meet;
+    problem->bits = bits;
+    problem->words = (bits + 63) / 64;
+    total = (size_t)(cfg->blockCount + 1) * problem->words;
+    problem->gen = (BitWord *)calloc(total, sizeof(BitWord));
+    problem->kill = (BitWord *)calloc(total, sizeof(BitWord));
+    problem->in = (BitWord *)calloc(total, sizeof(BitWord));
+    problem->out = (BitWord *)calloc(total, sizeof(BitWord));
+}
+void solveDataflow(DataflowProblem *problem, const ControlFlowGraph *cfg)
+{
+    // Sets flow from "before" to "after": in -> out forward, out -> in backward
+    int forward = problem->direction == DATAFLOW_FORWARD;
+    BitWord *before = forward ? problem->in : problem->out;
+    BitWord *after = forward ? problem->out : problem->in;
+    int words = problem->words;
+    int n = cfg->blockCount;
+
+    // Intersection problems start from the top of the lattice
+    if (problem->meet == MEET_INTERSECTION)
+    {
+        for (int b = 0; b < n; b++)
+        {
+            BitWord *set = dataflowSet(after, problem, b);
+            for (int w = 0; w < words; w++)
+                set[w] = ~0ULL;
+        }
+    }
+
+    // Circular worklist seeded in (reverse) program order
+    int *worklist = (int *)malloc((n + 1) * sizeof(int));
+    char *queued = (char *)malloc(n + 1);
+    int head = 0, count = n;
+    for (int i = 0; i < n; i++)
+    {
+        worklist[i] = forward ? i : n - 1 - i;
+        queued[i] = 1;
+    }
+    BitWord *scratch = (BitWord *)malloc((words + 1) * sizeof(BitWord));
+
+    while (count > 0)
+    {
+        int b = worklist[head];
+        head = (head + 1) % n;
+        count--;
+        queued[b] = 0;
+
+        const BasicBlock *block = &cfg->blocks[b];
+        BitWord *meetSet = dataflowSet(before, problem, b);
+        int edges = forward ? block->predCount : (block->succ[0] >= 0) + (block->succ[1] >= 0);
+        for (int w = 0; w < words; w++)
+            meetSet[w] = (problem->meet == MEET_INTERSECTION && edges > 0) ? ~0ULL : 0;
+        for (int e = 0; e < edges; e++)
+        {
+            int other = forward ? cfg->preds[block->predStart + e] : block->succ[e];
+            BitWord *otherSet = dataflowSet(after, problem, other);
+            for (int w = 0; w < words; w++)
+            {
+                if (problem->meet == MEET_UNION)
+                    meetSet[w] |= otherSet[w];
+                else
+                    meetSet[w] &= otherSet[w];
+            }
+        }
+
+        // after = gen | (before & ~kill)
+        BitWord *gen = dataflowSet(problem->gen, problem, b);
+        BitWord *kill = dataflowSet(problem->kill, problem, b);
+        BitWord *afterSet = dataflowSet(after, problem, b);
+        int changed = 0;
+        for (int w = 0; w < words; w++)
+        {
+            scratch[w] = gen[w] | (meetSet[w] & ~kill[w]);
+            changed |= scratch[w] != afterSet[w];
+            afterSet[w] = scratch[w];
+        }
+        if (!changed)
+            continue;
+
+        int followers = forward ? (block->succ[0] >= 0) + (block->succ[1] >= 0) : block->predCount;
+        for (int e = 0; e < followers; e++)
+        {
+            int other = forward ? block->succ[e] : cfg->preds[block->predStart + e];
+            if (!queued[other])
+            {
+                queued[other] = 1;
+                worklist[(head + count) % n] = other;
+                count++;
+            }
+        }
+    }
+
+    free(scratch);
+    free(worklist);
+    free(queued);
+}
+void freeDataflow(DataflowProblem *problem)
+{
+    free(problem->gen);
+    free(problem->kill);
+    free(problem->in);
+    free(problem->out);
+    problem->gen = problem->kill = problem->in = problem->out = NULL;
+}
+void computeLiveness(DataflowProblem *problem, const ControlFlowGraph *cfg)
+{
+    initDataflow(problem, cfg, cfg->variableCount, DATAFLOW_BACKWARD, MEET_UNION);
+    // Array elements are read through indices known only at run time: live everywhere
+    BitWord *arrays = (BitWord *)calloc(problem->words + 1, sizeof(BitWord));
+    for (int slot = 0; slot < cfg->variableCount; slot++)
+    {
+        if (isArraySlot(slot))
+            bitsetAdd(arrays, slot);
+    }
+    for (int b = 0; b < cfg->blockCount; b++)
+    {
+        BitWord *gen = dataflowSet(problem->gen, problem, b);
+        BitWord *kill = dataflowSet(problem->kill, problem, b);
+        for (int w = 0; w < problem->words; w++)
+            gen[w] = arrays[w];
+        // Walk backwards so gen ends up holding the upward-exposed uses
+        for (int i = cfg->blocks[b].end - 1; i >= cfg->blocks[b].start; i--)
+        {
+            if (cfg->defSlot[i] >= 0)
+            {
+                bitsetAdd(kill, cfg->defSlot[i]);
+                bitsetRemove(gen, cfg->defSlot[i]);
+            }
+            int uses[MAX_INSTRUCTION_USES];
+            for (int u = instructionUses(&code.instructions[i], uses) - 1; u >= 0; u--)
+                bitsetAdd(gen, uses[u]);
+        }
+    }
+    free(arrays);
+    solveDataflow(problem, cfg);
 }
\ No newline at end of file